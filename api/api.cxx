@@ -12,6 +12,8 @@ using std::move;
 
 int main()
 {
+  Trace::init("api");
+
   SSLContextConfig sslc;
   sslc.setCertificate(
       "/marina/cert.pem",
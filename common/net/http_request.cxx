@@ -1,8 +1,10 @@
 #include "http_request.hxx"
+#include "wire.hxx"
 #include <proxygen/lib/http/HTTPMessage.h>
 #include <proxygen/lib/ssl/SSLContextConfig.h>
 #include <proxygen/lib/http/session/HTTPUpstreamSession.h>
 #include <proxygen/lib/utils/URL.h>
+#include <stdexcept>
 
 using namespace folly;
 using namespace proxygen;
@@ -15,6 +17,21 @@ HttpRequest::HttpRequest( HTTPMethod mtd,
                           unique_ptr<IOBuf> msg,
                           size_t recv_window,
                           string log_suffix )
+  : HttpRequest(
+      mtd,
+      url,
+      move(msg),
+      "",
+      recv_window,
+      log_suffix)
+{}
+
+HttpRequest::HttpRequest( HTTPMethod mtd, 
+                          const string & url,
+                          unique_ptr<IOBuf> msg,
+                          string content_type,
+                          size_t recv_window,
+                          string log_suffix )
   : httpMethod_{mtd},
     url_{URL(url)},
     recv_window_{recv_window},
@@ -32,6 +49,14 @@ HttpRequest::HttpRequest( HTTPMethod mtd,
     Glog::initialized = true;
   }
 
+  Span span{"http " + url};
+  span.arg("method", methodToString(mtd));
+  trace_ = span.context();
+
+  //the request goes out as soon as the connection is up
+  if(!content_type.empty())
+    request_.getHeaders().set(HTTP_HEADER_CONTENT_TYPE, content_type);
+
   evb_.reset(new EventBase);
 
   SocketAddress addr{url_.getHost(), url_.getPort(), true};
@@ -98,6 +123,22 @@ HttpRequest::HttpRequest( HTTPMethod mtd,
 {}
 
 
+HttpRequest::HttpRequest( HTTPMethod mtd, 
+                          const string & url,
+                          const Json & msg,
+                          http::Encoding enc,
+                          size_t recv_window,
+                          string log_suffix )
+  : HttpRequest(
+      mtd,
+      url,
+      IOBuf::copyBuffer(
+        enc == http::Encoding::Wire ? wire::encode(msg) : msg.dump()),
+      enc == http::Encoding::Wire ? wire::content_type : "application/json",
+      recv_window,
+      log_suffix)
+{}
+
 HttpRequest::~HttpRequest() { }
 
 // ssl -------------------------------------------------------------------------
@@ -154,6 +195,7 @@ void HttpRequest::connectSuccess(HTTPUpstreamSession *session)
     request_.getHeaders().add(HTTP_HEADER_HOST, url_.getHostAndPort());
   if(!request_.getHeaders().getNumberOfValues(HTTP_HEADER_ACCEPT))
     request_.getHeaders().add("Accept", "*/*");
+  request_.getHeaders().set(TraceContext::header, trace_.traceparent());
   
   txn_ = session->newTransaction(this);
   request_.setMethod(httpMethod_);
@@ -172,6 +214,7 @@ void HttpRequest::connectError(const AsyncSocketException &ex)
 {
   LOG(ERROR) 
     << "Couldn't connect to " << url_.getHostAndPort() << ":" << ex.what();
+  fail("couldn't connect to " + url_.getHostAndPort() + ": " + ex.what());
 }
 
 // HTTPTransactionHandler ------------------------------------------------------
@@ -199,6 +242,8 @@ void HttpRequest::onTrailers(unique_ptr<proxygen::HTTPHeaders>) noexcept
 void HttpRequest::onEOM() noexcept
 {
   LOG(INFO) << "Got EOM";
+  if(answered_) return;
+  answered_ = true;
   response_promise_.set_value(move(response_));
 }
     
@@ -210,6 +255,7 @@ void HttpRequest::onUpgrade(proxygen::UpgradeProtocol) noexcept
 void HttpRequest::onError(const proxygen::HTTPException &error) noexcept
 {
   LOG(ERROR) << "An error occurred:" << error.what();
+  fail(error.what());
 }
     
 void HttpRequest::onEgressPaused() noexcept { LOG(INFO) << "Egress paused"; }
@@ -225,6 +271,15 @@ const string & HttpRequest::getServerName() const
   return res;
 }
 
+//a request that went nowhere still answers, whoever waits on the response
+//gets the error instead of blocking forever
+void HttpRequest::fail(const string & why)
+{
+  if(answered_) return;
+  answered_ = true;
+  response_promise_.set_exception(make_exception_ptr(runtime_error{why}));
+}
+
 // result ----------------------------------------------------------------------
 future<http::Message> HttpRequest::response()
 {
@@ -10,6 +10,7 @@
 #include <atomic>
 #include "proto.hxx"
 #include "glog.hxx"
+#include "trace.hxx"
 
 namespace marina
 {
@@ -39,6 +40,15 @@ namespace marina
         size_t recv_window=65536,
         std::string log_suffix="");
 
+      //a json document sent with the given encoding and Content-Type
+      HttpRequest(
+        proxygen::HTTPMethod,
+        const std::string & url,
+        const Json & msg,
+        http::Encoding,
+        size_t recv_window=65536,
+        std::string log_suffix="");
+
       HttpRequest(HttpRequest &&) = default;
       HttpRequest & operator= (HttpRequest &&) = default;
 
@@ -74,6 +84,14 @@ namespace marina
       std::future<http::Message> response();
 
     protected:
+      HttpRequest(
+        proxygen::HTTPMethod,
+        const std::string & url,
+        std::unique_ptr<folly::IOBuf> msg,
+        std::string content_type,
+        size_t recv_window,
+        std::string log_suffix);
+
       proxygen::HTTPTransaction *txn_{nullptr};
       std::unique_ptr<folly::EventBase> evb_{nullptr};
       proxygen::HTTPMethod httpMethod_;
@@ -88,6 +106,12 @@ namespace marina
       folly::HHWheelTimer::UniquePtr timer_{nullptr};
 
       std::promise<http::Message> response_promise_{};
+      bool answered_{false};
+
+      void fail(const std::string & why);
+
+      //the client span of this request, propagated to the server
+      TraceContext trace_{};
   };
 
 }
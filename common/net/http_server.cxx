@@ -10,6 +10,8 @@ using std::max;
 using std::function;
 using std::thread;
 using std::find_if;
+using std::pair;
+using std::make_shared;
 using namespace std::chrono;
 
 using proxygen::HTTPServerOptions;
@@ -27,8 +29,8 @@ using wangle::SSLContextConfig;
 
 using namespace marina;
 
-RqHandler::RqHandler(vector<Handler> handlers, SrvStats *stats) 
-  : stats_{stats},
+RqHandler::RqHandler(const vector<Handler> & handlers, ServerMetrics *metrics) 
+  : metrics_{metrics},
     handlers_{handlers}
 {
   if(!Glog::initialized)
@@ -45,31 +47,54 @@ RqHandler::RqHandler(vector<Handler> handlers, SrvStats *stats)
 void RqHandler::onRequest(unique_ptr<proxygen::HTTPMessage> msg) noexcept
 {
   msg_ = move(msg);
-  stats_->recordRequest();
+  start_ = steady_clock::now();
+
+  const string & path = msg_->getPath();
+  auto method = msg_->getMethod();
+
+  auto handler_it = find_if(handlers_.begin(), handlers_.end(),
+    [&path, &method](const Handler &h)
+    {
+      return h.path == path && h.method == method;
+    } 
+  );
+
+  if(handler_it != handlers_.end())
+  {
+    handler_ = &*handler_it;
+    route_ = &metrics_->route(handler_it - handlers_.begin());
+  }
+  else route_ = &metrics_->unmatched();
+
+  route_->begin();
 }
     
 void RqHandler::onBody(unique_ptr<folly::IOBuf> body) noexcept
 {
+  route_->bytes_in += body->computeChainDataLength();
+
   if(body_) body_->prependChain(move(body));
   else body_ = move(body);
 }
     
 void RqHandler::onEOM() noexcept
 {
-  string path = msg_->getPath();
-  auto method = msg_->getMethod();
-
-  auto handler_it = find_if(handlers_.begin(), handlers_.end(),
-    [&path, &method](const Handler &h)
-    {
-      return h.path == path && h.method == method;
-    } 
-  );
+  unsigned short code{404};
+  size_t out{0};
+
+  //pick up the caller's trace context, everything the handler does on this
+  //thread (db queries, outbound requests ...) becomes a child of this span
+  Span span{
+    msg_->getMethodString() + " " + msg_->getPath(),
+    TraceContext::fromTraceparent(
+        msg_->getHeaders().getSingleOrEmpty(TraceContext::header))
+  };
 
-  if(handler_it != handlers_.end())
+  if(handler_ != nullptr)
   {
-    auto h = *handler_it;
-    auto response = h.f( http::Message{move(msg_), move(body_)} );
+    auto response = handler_->f( http::Message{move(msg_), move(body_)} );
+    code = response.status.code;
+    if(response.content) out = response.content->computeChainDataLength();
 
     ResponseBuilder(downstream_)
       .status(response.status.code, response.status.message)
@@ -82,11 +107,24 @@ void RqHandler::onEOM() noexcept
       .status(404, "Not Found")
       .sendWithEOM();
   }
+
+  span.arg("status", to_string(code));
+
+  auto us = duration_cast<microseconds>(steady_clock::now() - start_).count();
+  route_->end(code, us, out);
+  route_ = nullptr;
+}
+
+// a request that errors out before EOM still has to leave the in-flight gauge
+void RqHandler::finish()
+{
+  if(route_ != nullptr) route_->in_flight--;
+  route_ = nullptr;
 }
 
 void RqHandler::onUpgrade(proxygen::UpgradeProtocol) noexcept {}
-void RqHandler::requestComplete() noexcept { delete this; }
-void RqHandler::onError(proxygen::ProxygenError) noexcept { delete this; }
+void RqHandler::requestComplete() noexcept { finish(); delete this; }
+void RqHandler::onError(proxygen::ProxygenError) noexcept { finish(); delete this; }
 
 HttpsServer::HttpsServer(string ip, size_t http_port, SSLContextConfig sslc)
   : addr_{ip},
@@ -108,6 +146,12 @@ HttpsServer::HttpsServer(string ip, size_t http_port, SSLContextConfig sslc)
   srv_opts_.idleTimeout = milliseconds(60000);
   srv_opts_.shutdownOn = {SIGINT, SIGTERM};
   srv_opts_.enableContentCompression = true;
+
+  //every marina service exposes its request metrics
+  onGet("/metrics", [this](http::Message)
+  {
+    return http::Response{ http::Status::OK(), metrics_->prometheus() };
+  });
 }
  
 void HttpsServer::onGet(string url, function<http::Response(http::Message)> f)
@@ -122,9 +166,14 @@ void HttpsServer::onPost(string url, function<http::Response(http::Message)> f)
 
 void HttpsServer::run()
 {
+  vector<pair<string, string>> routes;
+  for(const auto & h : handlers_)
+    routes.push_back({proxygen::methodToString(h.method), h.path});
+  metrics_ = make_shared<ServerMetrics>(routes);
+
   srv_opts_.handlerFactories = 
     RequestHandlerChain{}
-      .addThen<RqHandlerFactory>(handlers_)
+      .addThen<RqHandlerFactory>(handlers_, metrics_)
       .build();
 
   server_.reset(new HTTPServer(move(srv_opts_)));
@@ -5,21 +5,14 @@
 #include <proxygen/httpserver/RequestHandler.h>
 #include <proxygen/httpserver/HTTPServer.h>
 #include <functional>
+#include <chrono>
 #include "proto.hxx"
 #include "glog.hxx"
 #include "http_request.hxx"
+#include "metrics.hxx"
 
 namespace marina
 {
-  class SrvStats
-  {
-    public:
-      void recordRequest() { ++cnt_; }
-      size_t getRequestCount() { return cnt_; }
-    private:
-      size_t cnt_{0};
-  };
-  
   struct Handler
   {
     std::function<http::Response(http::Message)> f;
@@ -30,7 +23,7 @@ namespace marina
   class RqHandler : public proxygen::RequestHandler
   {
     public:
-      RqHandler(std::vector<Handler> handlers, SrvStats*);
+      RqHandler(const std::vector<Handler> & handlers, ServerMetrics*);
 
       //RequestHandler
       void onRequest(std::unique_ptr<proxygen::HTTPMessage>) noexcept override;
@@ -41,36 +34,40 @@ namespace marina
       void onError(proxygen::ProxygenError) noexcept override;
 
     private:
-      SrvStats *stats_{nullptr};
+      void finish();
+
+      ServerMetrics *metrics_{nullptr};
+      RouteMetrics *route_{nullptr};
+      std::chrono::steady_clock::time_point start_;
       std::unique_ptr<folly::IOBuf> body_{nullptr};
       std::unique_ptr<proxygen::HTTPMessage> msg_{nullptr};
-      std::vector<Handler> handlers_;
+      const std::vector<Handler> & handlers_;
+      const Handler *handler_{nullptr};
   };
   
 
   class RqHandlerFactory : public proxygen::RequestHandlerFactory
   {
     public:
-      RqHandlerFactory(std::vector<Handler> handlers)
-        : handlers_{handlers}
+      RqHandlerFactory(std::vector<Handler> handlers, 
+                       std::shared_ptr<ServerMetrics> metrics)
+        : handlers_{handlers},
+          metrics_{metrics}
       { }
 
-      void onServerStart(folly::EventBase *) noexcept override 
-      { 
-        stats_.reset(new SrvStats); 
-      }
-      void onServerStop() noexcept override { stats_.reset(); }
+      void onServerStart(folly::EventBase *) noexcept override { }
+      void onServerStop() noexcept override { }
 
       proxygen::RequestHandler* 
       onRequest(proxygen::RequestHandler*, proxygen::HTTPMessage*) 
       noexcept override
       {
-        return new RqHandler{handlers_, stats_.get()};
+        return new RqHandler{handlers_, metrics_.get()};
       }
 
     private:
-      folly::ThreadLocalPtr<SrvStats> stats_;
       std::vector<Handler> handlers_;
+      std::shared_ptr<ServerMetrics> metrics_;
   };
 
   class HttpsServer
@@ -91,6 +88,7 @@ namespace marina
       std::unique_ptr<proxygen::HTTPServer> server_{nullptr};
       std::vector<Handler> handlers_;
       std::vector<proxygen::HTTPServer::IPConfig> ips_;
+      std::shared_ptr<ServerMetrics> metrics_{nullptr};
   };
 
   //helpful misc functions
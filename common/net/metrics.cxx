@@ -0,0 +1,198 @@
+#include "metrics.hxx"
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::unique_ptr;
+using std::stringstream;
+using std::atomic;
+using std::memory_order_relaxed;
+using namespace marina;
+
+// Histogram -------------------------------------------------------------------
+
+size_t Histogram::bucketOf(uint64_t v)
+{
+  if(v < 2*SubBuckets) return v;
+  size_t msb = 63 - __builtin_clzll(v);
+  size_t shift = msb - SubBucketBits;
+  return shift*SubBuckets + (v >> shift);
+}
+
+uint64_t Histogram::bucketLow(size_t b)
+{
+  if(b < 2*SubBuckets) return b;
+  size_t shift = b/SubBuckets - 1;
+  return static_cast<uint64_t>(b - shift*SubBuckets) << shift;
+}
+
+uint64_t Histogram::bucketHigh(size_t b)
+{
+  if(b < 2*SubBuckets) return b;
+  size_t shift = b/SubBuckets - 1;
+  return bucketLow(b) + ((1ul << shift) - 1);
+}
+
+void Histogram::record(uint64_t v)
+{
+  buckets_[bucketOf(v)].fetch_add(1, memory_order_relaxed);
+  count_.fetch_add(1, memory_order_relaxed);
+  sum_.fetch_add(v, memory_order_relaxed);
+
+  uint64_t m = max_.load(memory_order_relaxed);
+  while(v > m && !max_.compare_exchange_weak(m, v, memory_order_relaxed));
+}
+
+uint64_t Histogram::count() const { return count_.load(memory_order_relaxed); }
+uint64_t Histogram::sum() const { return sum_.load(memory_order_relaxed); }
+uint64_t Histogram::max() const { return max_.load(memory_order_relaxed); }
+
+uint64_t Histogram::percentile(double p) const
+{
+  uint64_t n = count();
+  if(n == 0) return 0;
+
+  uint64_t target = static_cast<uint64_t>(std::ceil(p / 100.0 * n));
+  if(target == 0) target = 1;
+
+  uint64_t seen{0};
+  for(size_t i=0; i<Buckets; ++i)
+  {
+    seen += buckets_[i].load(memory_order_relaxed);
+    if(seen >= target) return std::min(bucketHigh(i), max());
+  }
+  return max();
+}
+
+uint64_t Histogram::countAtOrBelow(uint64_t bound) const
+{
+  uint64_t n{0};
+  for(size_t i=0; i<Buckets && bucketHigh(i) <= bound; ++i)
+    n += buckets_[i].load(memory_order_relaxed);
+  return n;
+}
+
+// RouteMetrics ----------------------------------------------------------------
+
+RouteMetrics::RouteMetrics(string method, string path)
+  : method{method},
+    path{path}
+{}
+
+void RouteMetrics::begin()
+{
+  in_flight.fetch_add(1, memory_order_relaxed);
+}
+
+void RouteMetrics::end(unsigned short code, uint64_t micros, uint64_t out)
+{
+  if(code < status.size()) status[code].fetch_add(1, memory_order_relaxed);
+  bytes_out.fetch_add(out, memory_order_relaxed);
+  latency.record(micros);
+  in_flight.fetch_sub(1, memory_order_relaxed);
+}
+
+// ServerMetrics ---------------------------------------------------------------
+
+ServerMetrics::ServerMetrics(const vector<pair<string, string>> & routes)
+  : unmatched_{new RouteMetrics{"*", "unmatched"}}
+{
+  for(const auto & r : routes)
+    routes_.emplace_back(new RouteMetrics{r.first, r.second});
+}
+
+RouteMetrics & ServerMetrics::route(size_t i) { return *routes_.at(i); }
+RouteMetrics & ServerMetrics::unmatched() { return *unmatched_; }
+
+namespace
+{
+  //latency histogram bucket boundaries exposed to prometheus, in seconds
+  const vector<double> le_bounds{
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+    1, 2.5, 5, 10, 30, 60, 120
+  };
+
+  const vector<double> quantiles{ 50, 90, 99, 99.9 };
+
+  string labels(const RouteMetrics & r)
+  {
+    return "method=\"" + r.method + "\",route=\"" + r.path + "\"";
+  }
+}
+
+string ServerMetrics::prometheus() const
+{
+  vector<const RouteMetrics*> rs;
+  for(const auto & r : routes_) rs.push_back(r.get());
+  rs.push_back(unmatched_.get());
+
+  stringstream ss;
+  ss << std::setprecision(9);
+
+  ss << "# HELP marina_http_requests_total requests served by route and status"
+     << "\n# TYPE marina_http_requests_total counter\n";
+  for(const auto * r : rs)
+  {
+    for(size_t code=0; code<r->status.size(); ++code)
+    {
+      uint64_t n = r->status[code].load(memory_order_relaxed);
+      if(n == 0) continue;
+      ss << "marina_http_requests_total{" << labels(*r)
+         << ",code=\"" << code << "\"} " << n << "\n";
+    }
+  }
+
+  ss << "# HELP marina_http_requests_in_flight requests currently in service"
+     << "\n# TYPE marina_http_requests_in_flight gauge\n";
+  for(const auto * r : rs)
+    ss << "marina_http_requests_in_flight{" << labels(*r) << "} "
+       << r->in_flight.load(memory_order_relaxed) << "\n";
+
+  ss << "# HELP marina_http_request_bytes_total request body bytes received"
+     << "\n# TYPE marina_http_request_bytes_total counter\n";
+  for(const auto * r : rs)
+    ss << "marina_http_request_bytes_total{" << labels(*r) << "} "
+       << r->bytes_in.load(memory_order_relaxed) << "\n";
+
+  ss << "# HELP marina_http_response_bytes_total response body bytes sent"
+     << "\n# TYPE marina_http_response_bytes_total counter\n";
+  for(const auto * r : rs)
+    ss << "marina_http_response_bytes_total{" << labels(*r) << "} "
+       << r->bytes_out.load(memory_order_relaxed) << "\n";
+
+  ss << "# HELP marina_http_request_duration_seconds request latency"
+     << "\n# TYPE marina_http_request_duration_seconds histogram\n";
+  for(const auto * r : rs)
+  {
+    const Histogram & h = r->latency;
+    for(double le : le_bounds)
+    {
+      ss << "marina_http_request_duration_seconds_bucket{" << labels(*r)
+         << ",le=\"" << le << "\"} "
+         << h.countAtOrBelow(static_cast<uint64_t>(le * 1e6)) << "\n";
+    }
+    ss << "marina_http_request_duration_seconds_bucket{" << labels(*r)
+       << ",le=\"+Inf\"} " << h.count() << "\n";
+    ss << "marina_http_request_duration_seconds_sum{" << labels(*r) << "} "
+       << h.sum() / 1e6 << "\n";
+    ss << "marina_http_request_duration_seconds_count{" << labels(*r) << "} "
+       << h.count() << "\n";
+  }
+
+  ss << "# HELP marina_http_request_duration_quantile_seconds latency quantiles"
+     << "\n# TYPE marina_http_request_duration_quantile_seconds gauge\n";
+  for(const auto * r : rs)
+  {
+    for(double q : quantiles)
+    {
+      ss << "marina_http_request_duration_quantile_seconds{" << labels(*r)
+         << ",quantile=\"" << q/100 << "\"} "
+         << r->latency.percentile(q) / 1e6 << "\n";
+    }
+  }
+
+  return ss.str();
+}
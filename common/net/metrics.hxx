@@ -0,0 +1,89 @@
+#ifndef MARINA_COMMON_NET_METRICS
+#define MARINA_COMMON_NET_METRICS
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace marina
+{
+  /*
+   * A lock-free log-linear latency histogram in the spirit of HdrHistogram.
+   * Values are bucketed with 16 linear sub-buckets per power of two, which
+   * bounds the relative error of any reported value to ~6%. All operations
+   * are relaxed atomics so any number of IO threads may record concurrently.
+   */
+  class Histogram
+  {
+    public:
+      static constexpr size_t SubBucketBits = 4;
+      static constexpr size_t SubBuckets = 1 << SubBucketBits;
+      static constexpr size_t Buckets = (65 - SubBucketBits) * SubBuckets;
+
+      void record(uint64_t value);
+
+      uint64_t count() const;
+      uint64_t sum() const;
+      uint64_t max() const;
+
+      //the (approximate) value at percentile p in [0, 100]
+      uint64_t percentile(double p) const;
+
+      //the number of recorded values that are <= bound
+      uint64_t countAtOrBelow(uint64_t bound) const;
+
+      static size_t bucketOf(uint64_t value);
+      static uint64_t bucketLow(size_t bucket);
+      static uint64_t bucketHigh(size_t bucket);
+
+    private:
+      std::array<std::atomic<uint64_t>, Buckets> buckets_{};
+      std::atomic<uint64_t> count_{0}, sum_{0}, max_{0};
+  };
+
+  /*
+   * Counters for a single (method, path) route of an HttpsServer
+   */
+  struct RouteMetrics
+  {
+    RouteMetrics(std::string method, std::string path);
+
+    const std::string method, path;
+
+    //request counts indexed by http status code
+    std::array<std::atomic<uint64_t>, 600> status{};
+
+    std::atomic<int64_t> in_flight{0};
+    std::atomic<uint64_t> bytes_in{0}, bytes_out{0};
+
+    //request latency in microseconds
+    Histogram latency;
+
+    void begin();
+    void end(unsigned short code, uint64_t micros, uint64_t bytes_out);
+  };
+
+  /*
+   * The metrics of a whole server, shared by every IO thread. The set of
+   * routes is fixed when the server starts so lookups never need a lock.
+   */
+  class ServerMetrics
+  {
+    public:
+      ServerMetrics(const std::vector<std::pair<std::string, std::string>> &);
+
+      RouteMetrics & route(size_t i);
+      RouteMetrics & unmatched();
+
+      //prometheus text exposition format
+      std::string prometheus() const;
+
+    private:
+      std::vector<std::unique_ptr<RouteMetrics>> routes_;
+      std::unique_ptr<RouteMetrics> unmatched_;
+  };
+}
+
+#endif
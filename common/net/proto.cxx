@@ -1,4 +1,5 @@
 #include "proto.hxx"
+#include "wire.hxx"
 
 using std::string;
 using std::unique_ptr;
@@ -18,8 +19,19 @@ string http::Message::bodyAsString()
   return s;
 }
 
+http::Encoding http::Message::encoding() const
+{
+  if(msg != nullptr && wire::isWire(
+        msg->getHeaders().getSingleOrEmpty(proxygen::HTTP_HEADER_CONTENT_TYPE)))
+    return Encoding::Wire;
+
+  return Encoding::Json;
+}
+
 Json http::Message::bodyAsJson()
 {
+  if(encoding() == Encoding::Wire) return wire::decode(bodyAsString());
+
   return Json::parse(bodyAsString());
 }
 
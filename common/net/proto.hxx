@@ -10,12 +10,20 @@ namespace marina
   using Json = nlohmann::json;
   namespace http 
   {
+    //how a json document is carried in a message body
+    enum class Encoding { Json, Wire };
+
     struct Message
     {
       std::unique_ptr<proxygen::HTTPMessage> msg;
       std::unique_ptr<folly::IOBuf> content;
 
       std::string bodyAsString();
+
+      //from the Content-Type of the message
+      Encoding encoding() const;
+
+      //decodes according to the Content-Type of the message
       Json bodyAsJson();
     };
 
@@ -24,10 +32,15 @@ namespace marina
       static Status OK() { return Status{200, "OK"}; }
       static Status NotFound() { return Status{404, "Not Found"}; }
       static Status BadRequest() { return Status{400, "Bad Request"}; }
+      static Status Conflict() { return Status{409, "Conflict"}; }
       static Status InternalServerError()
       {
         return Status{500, "Internal Server Error"};
       }
+      static Status ServiceUnavailable()
+      {
+        return Status{503, "Service Unavailable"};
+      }
       unsigned short code;
       std::string message;
     };
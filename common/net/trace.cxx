@@ -0,0 +1,217 @@
+#include "trace.hxx"
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+#include "glog.hxx"
+#include <3p/json/src/json.hpp>
+
+using std::string;
+using std::mutex;
+using std::lock_guard;
+using std::stringstream;
+using std::hex;
+using std::setw;
+using std::setfill;
+using std::random_device;
+using std::mt19937_64;
+using std::hash;
+using std::thread;
+using namespace std::chrono;
+using namespace marina;
+
+using Json = nlohmann::json;
+
+const string TraceContext::header{"traceparent"};
+
+namespace
+{
+  thread_local TraceContext current_ctx;
+
+  mutex sink_mtx;
+  FILE *sink{nullptr};
+  std::atomic<bool> tracing{false};
+  string service{"marina"};
+
+  uint64_t random64()
+  {
+    thread_local mt19937_64 gen{random_device{}()};
+    uint64_t x;
+    do { x = gen(); } while(x == 0);
+    return x;
+  }
+
+  string hexstr(const uint8_t *p, size_t n)
+  {
+    stringstream ss;
+    for(size_t i=0; i<n; ++i)
+      ss << hex << setw(2) << setfill('0') << static_cast<int>(p[i]);
+    return ss.str();
+  }
+
+  bool unhex(const string & s, uint8_t *p, size_t n)
+  {
+    if(s.size() != 2*n) return false;
+    for(size_t i=0; i<n; ++i)
+    {
+      char *end;
+      string b = s.substr(2*i, 2);
+      p[i] = strtoul(b.c_str(), &end, 16);
+      if(*end != '\0') return false;
+    }
+    return true;
+  }
+
+  uint64_t micros(system_clock::time_point t)
+  {
+    return duration_cast<microseconds>(t.time_since_epoch()).count();
+  }
+
+  void write(const Json & event)
+  {
+    lock_guard<mutex> lk{sink_mtx};
+    if(sink == nullptr) return;
+    fprintf(sink, "%s,\n", event.dump().c_str());
+    fflush(sink);
+  }
+}
+
+// TraceContext ----------------------------------------------------------------
+
+bool TraceContext::valid() const { return span_id != 0; }
+
+TraceContext TraceContext::child() const
+{
+  TraceContext c = *this;
+  if(!valid())
+  {
+    uint64_t hi = random64(), lo = random64();
+    for(size_t i=0; i<8; ++i)
+    {
+      c.trace_id[i] = hi >> (8*(7-i));
+      c.trace_id[8+i] = lo >> (8*(7-i));
+    }
+  }
+  c.span_id = random64();
+  return c;
+}
+
+string TraceContext::traceId() const
+{
+  return hexstr(trace_id.data(), trace_id.size());
+}
+
+string TraceContext::spanId() const
+{
+  uint8_t b[8];
+  for(size_t i=0; i<8; ++i) b[i] = span_id >> (8*(7-i));
+  return hexstr(b, 8);
+}
+
+string TraceContext::traceparent() const
+{
+  return "00-" + traceId() + "-" + spanId() + "-01";
+}
+
+TraceContext TraceContext::fromTraceparent(const string & s)
+{
+  // 00-<32 hex trace id>-<16 hex span id>-<2 hex flags>
+  TraceContext c;
+  if(s.size() != 55 || s[2] != '-' || s[35] != '-' || s[52] != '-') return c;
+
+  uint8_t span[8];
+  if(!unhex(s.substr(3, 32), c.trace_id.data(), 16) ||
+     !unhex(s.substr(36, 16), span, 8))
+  {
+    return TraceContext{};
+  }
+
+  for(size_t i=0; i<8; ++i) c.span_id = (c.span_id << 8) | span[i];
+  return c;
+}
+
+// Trace -----------------------------------------------------------------------
+
+void Trace::init(string service_name)
+{
+  lock_guard<mutex> lk{sink_mtx};
+  service = service_name;
+
+  char *dir = getenv("MARINA_TRACE_DIR");
+  if(dir == nullptr || sink != nullptr) return;
+
+  string path =
+    string{dir} + "/" + service_name + "-" + std::to_string(getpid()) +
+    ".trace.json";
+
+  sink = fopen(path.c_str(), "w");
+  if(sink == nullptr)
+  {
+    LOG(ERROR) << "unable to open trace sink " << path;
+    return;
+  }
+
+  //the chrome trace array format does not require the closing bracket
+  Json meta;
+  meta["name"] = "process_name";
+  meta["ph"] = "M";
+  meta["pid"] = getpid();
+  meta["args"]["name"] = service_name;
+  fprintf(sink, "[\n%s,\n", meta.dump().c_str());
+  fflush(sink);
+  tracing = true;
+
+  LOG(INFO) << "writing trace spans to " << path;
+}
+
+TraceContext Trace::current() { return current_ctx; }
+void Trace::current(TraceContext c) { current_ctx = c; }
+
+// Span ------------------------------------------------------------------------
+
+Span::Span(string name) : Span(name, Trace::current()) {}
+
+Span::Span(string name, TraceContext parent)
+  : name_{name},
+    ctx_{parent.child()},
+    parent_{parent},
+    prev_{Trace::current()},
+    start_{system_clock::now()}
+{
+  Trace::current(ctx_);
+}
+
+Span::~Span()
+{
+  auto end = system_clock::now();
+  Trace::current(prev_);
+  if(!tracing) return;
+
+  Json e;
+  e["name"] = name_;
+  e["cat"] = service;
+  e["ph"] = "X";
+  e["ts"] = micros(start_);
+  e["dur"] = micros(end) - micros(start_);
+  e["pid"] = getpid();
+  e["tid"] = hash<thread::id>{}(std::this_thread::get_id()) % 100000;
+  e["args"]["trace_id"] = ctx_.traceId();
+  e["args"]["span_id"] = ctx_.spanId();
+  if(parent_.valid()) e["args"]["parent_id"] = parent_.spanId();
+  for(const auto & a : args_) e["args"][a.first] = a.second;
+
+  write(e);
+}
+
+Span & Span::arg(string key, string value)
+{
+  args_.push_back({key, value});
+  return *this;
+}
+
+const TraceContext & Span::context() const { return ctx_; }
@@ -0,0 +1,76 @@
+#ifndef MARINA_COMMON_NET_TRACE
+#define MARINA_COMMON_NET_TRACE
+
+#include <array>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+namespace marina
+{
+  /*
+   * W3C trace-context identifiers carried across marina services in the
+   * `traceparent` http header
+   */
+  struct TraceContext
+  {
+    static const std::string header;
+
+    std::array<uint8_t, 16> trace_id{};
+    uint64_t span_id{0};
+
+    bool valid() const;
+
+    //a new span within this trace, or a new trace if this one is not valid
+    TraceContext child() const;
+
+    std::string traceId() const;
+    std::string spanId() const;
+
+    std::string traceparent() const;
+    static TraceContext fromTraceparent(const std::string &);
+  };
+
+  /*
+   * Process wide tracing state. Spans are written to
+   * $MARINA_TRACE_DIR/<service>-<pid>.trace.json in the chrome trace event
+   * format, which chrome://tracing and perfetto load directly. When the
+   * environment variable is not set context is still propagated but nothing
+   * is written.
+   */
+  struct Trace
+  {
+    static void init(std::string service_name);
+
+    //the context of the innermost active span on this thread
+    static TraceContext current();
+    static void current(TraceContext);
+  };
+
+  /*
+   * A timed region of work. Constructing a span makes it the current span of
+   * the calling thread until it is destroyed.
+   */
+  class Span
+  {
+    public:
+      Span(std::string name);
+      Span(std::string name, TraceContext parent);
+      ~Span();
+
+      Span(const Span &) = delete;
+      Span & operator=(const Span &) = delete;
+
+      Span & arg(std::string key, std::string value);
+      const TraceContext & context() const;
+
+    private:
+      std::string name_;
+      TraceContext ctx_, parent_, prev_;
+      std::chrono::system_clock::time_point start_;
+      std::vector<std::pair<std::string, std::string>> args_;
+  };
+}
+
+#endif
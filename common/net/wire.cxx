@@ -0,0 +1,309 @@
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "wire.hxx"
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+using std::invalid_argument;
+using namespace marina;
+
+const string wire::content_type{"application/x-marina-wire"};
+
+namespace
+{
+  enum Tag : uint8_t
+  {
+    Null, False, True,
+    UInt, NegInt, Double,
+    Str, StrRef,
+    Array, Object,
+    UuidStr, UuidObj
+  };
+
+  const char magic[] = {'M', 'W'};
+
+  //nesting beyond this is not something marina produces, refuse it rather
+  //than run out of stack
+  constexpr size_t max_depth = 256;
+
+  int hexval(char c)
+  {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+
+  //the lower case 8-4-4-4-12 form uuid_unparse produces
+  bool canonicalUuid(const string & s)
+  {
+    if(s.size() != 36) return false;
+    for(size_t i=0; i<36; ++i)
+    {
+      if(i == 8 || i == 13 || i == 18 || i == 23)
+      {
+        if(s[i] != '-') return false;
+      }
+      else if(hexval(s[i]) < 0) return false;
+    }
+    return true;
+  }
+
+  struct Encoder
+  {
+    string out;
+    unordered_map<string, size_t> strings;
+
+    void byte(uint8_t b) { out.push_back(static_cast<char>(b)); }
+
+    void varint(uint64_t x)
+    {
+      while(x >= 0x80)
+      {
+        byte(static_cast<uint8_t>(x) | 0x80);
+        x >>= 7;
+      }
+      byte(static_cast<uint8_t>(x));
+    }
+
+    void str(const string & s)
+    {
+      auto i = strings.find(s);
+      if(i != strings.end())
+      {
+        byte(StrRef);
+        varint(i->second);
+        return;
+      }
+
+      byte(Str);
+      varint(s.size());
+      out += s;
+      strings.emplace(s, strings.size());
+    }
+
+    void uuid(Tag t, const string & s)
+    {
+      byte(t);
+      for(size_t i=0; i<36; )
+      {
+        if(s[i] == '-') { ++i; continue; }
+        byte(static_cast<uint8_t>(hexval(s[i]) << 4 | hexval(s[i+1])));
+        i += 2;
+      }
+    }
+
+    void value(const Json & j)
+    {
+      if(j.is_null()) byte(Null);
+      else if(j.is_boolean()) byte(j.get<bool>() ? True : False);
+      else if(j.is_number_unsigned())
+      {
+        byte(UInt);
+        varint(j.get<uint64_t>());
+      }
+      else if(j.is_number_integer())
+      {
+        int64_t x = j.get<int64_t>();
+        if(x >= 0) { byte(UInt); varint(x); }
+        else { byte(NegInt); varint(static_cast<uint64_t>(-(x+1))); }
+      }
+      else if(j.is_number_float())
+      {
+        double d = j.get<double>();
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        byte(Double);
+        for(size_t i=0; i<8; ++i) byte(static_cast<uint8_t>(bits >> (8*i)));
+      }
+      else if(j.is_string())
+      {
+        const string & s = j.get_ref<const string&>();
+        if(canonicalUuid(s)) uuid(UuidStr, s);
+        else str(s);
+      }
+      else if(j.is_array())
+      {
+        byte(Array);
+        varint(j.size());
+        for(const Json & x : j) value(x);
+      }
+      else if(j.is_object())
+      {
+        auto id = j.find("id");
+        if(j.size() == 1 && id != j.end() && id->is_string() &&
+           canonicalUuid(id->get_ref<const string&>()))
+        {
+          uuid(UuidObj, id->get_ref<const string&>());
+          return;
+        }
+
+        byte(Object);
+        varint(j.size());
+        for(auto i = j.begin(); i != j.end(); ++i)
+        {
+          str(i.key());
+          value(i.value());
+        }
+      }
+      else throw invalid_argument{"wire: cannot encode " + j.dump()};
+    }
+  };
+
+  struct Decoder
+  {
+    const uint8_t *p, *end;
+    vector<string> strings;
+
+    void need(size_t n)
+    {
+      if(static_cast<size_t>(end - p) < n)
+        throw invalid_argument{"wire: truncated document"};
+    }
+
+    uint8_t byte()
+    {
+      need(1);
+      return *p++;
+    }
+
+    uint64_t varint()
+    {
+      uint64_t x{0};
+      for(size_t shift=0; shift<64; shift+=7)
+      {
+        uint8_t b = byte();
+        x |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if(!(b & 0x80)) return x;
+      }
+      throw invalid_argument{"wire: bad varint"};
+    }
+
+    string uuid()
+    {
+      static const char hex[] = "0123456789abcdef";
+      need(16);
+      string s;
+      s.reserve(36);
+      for(size_t i=0; i<16; ++i)
+      {
+        if(i == 4 || i == 6 || i == 8 || i == 10) s += '-';
+        s += hex[p[i] >> 4];
+        s += hex[p[i] & 0xf];
+      }
+      p += 16;
+      return s;
+    }
+
+    string str(uint8_t tag)
+    {
+      if(tag == StrRef)
+      {
+        uint64_t k = varint();
+        if(k >= strings.size()) throw invalid_argument{"wire: bad string ref"};
+        return strings[k];
+      }
+      if(tag != Str) throw invalid_argument{"wire: expected a string"};
+
+      uint64_t n = varint();
+      need(n);
+      strings.emplace_back(reinterpret_cast<const char*>(p), n);
+      p += n;
+      return strings.back();
+    }
+
+    Json value(size_t depth)
+    {
+      if(depth > max_depth) throw invalid_argument{"wire: nested too deep"};
+
+      uint8_t tag = byte();
+      switch(tag)
+      {
+        case Null: return nullptr;
+        case False: return false;
+        case True: return true;
+        case UInt: return varint();
+        case NegInt: return -static_cast<int64_t>(varint()) - 1;
+        case Double:
+        {
+          need(8);
+          uint64_t bits{0};
+          for(size_t i=0; i<8; ++i) bits |= static_cast<uint64_t>(p[i]) << (8*i);
+          p += 8;
+          double d;
+          memcpy(&d, &bits, sizeof(d));
+          return d;
+        }
+        case Str:
+        case StrRef: return str(tag);
+        case UuidStr: return uuid();
+        case UuidObj:
+        {
+          Json j;
+          j["id"] = uuid();
+          return j;
+        }
+        case Array:
+        {
+          uint64_t n = varint();
+          Json j = Json::array();
+          for(uint64_t i=0; i<n; ++i) j.push_back(value(depth+1));
+          return j;
+        }
+        case Object:
+        {
+          uint64_t n = varint();
+          Json j = Json::object();
+          for(uint64_t i=0; i<n; ++i)
+          {
+            string k = str(byte());
+            j[k] = value(depth+1);
+          }
+          return j;
+        }
+        default:
+          throw invalid_argument{"wire: unknown tag " + std::to_string(tag)};
+      }
+    }
+  };
+}
+
+string wire::encode(const Json & j)
+{
+  Encoder e;
+  e.out.append(magic, sizeof(magic));
+  e.byte(version);
+  e.value(j);
+  return e.out;
+}
+
+Json wire::decode(const char *data, size_t size)
+{
+  if(size < 3 || memcmp(data, magic, sizeof(magic)) != 0)
+    throw invalid_argument{"wire: not a wire document"};
+  if(static_cast<uint8_t>(data[2]) != version)
+    throw invalid_argument{
+      "wire: unsupported version " +
+      std::to_string(static_cast<uint8_t>(data[2]))
+    };
+
+  Decoder d;
+  d.p = reinterpret_cast<const uint8_t*>(data) + 3;
+  d.end = reinterpret_cast<const uint8_t*>(data) + size;
+  Json j = d.value(0);
+  if(d.p != d.end) throw invalid_argument{"wire: trailing bytes"};
+  return j;
+}
+
+Json wire::decode(const string & s)
+{
+  return decode(s.data(), s.size());
+}
+
+bool wire::isWire(const string & ct)
+{
+  //ignore parameters, e.g. ; charset=...
+  return ct.compare(0, content_type.size(), content_type) == 0;
+}
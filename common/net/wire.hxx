@@ -0,0 +1,42 @@
+#ifndef MARINA_COMMON_NET_WIRE
+#define MARINA_COMMON_NET_WIRE
+
+#include <string>
+#include <3p/json/src/json.hpp>
+
+namespace marina
+{
+  using Json = nlohmann::json;
+
+  /*
+   * A compact binary encoding of the json documents marina components pass
+   * around. It is self describing like json, so any model type that has a
+   * json() and fromJson() goes over the wire as is, but
+   *
+   *   - integers are varints, doubles are 8 raw bytes
+   *   - uuids, whether bare or as the {"id": ...} objects Uuid::json makes,
+   *     are 16 raw bytes
+   *   - every string after its first appearance is a reference into a table
+   *     both ends build as they go, so object keys cost a byte or two
+   *
+   * A document starts with a magic and a version byte, decoders refuse
+   * versions they do not know. Json stays the encoding for humans, wire is
+   * negotiated through the Content-Type header.
+   */
+  namespace wire
+  {
+    extern const std::string content_type; //application/x-marina-wire
+    constexpr uint8_t version = 1;
+
+    std::string encode(const Json &);
+
+    //throws invalid_argument on a malformed or unknown version document
+    Json decode(const std::string &);
+    Json decode(const char *data, size_t size);
+
+    //whether a Content-Type header value names the wire encoding
+    bool isWire(const std::string & content_type);
+  }
+}
+
+#endif
@@ -12,6 +12,8 @@ static const string not_implemented{R"({"error": "not implemented"})"};
 
 int main()
 {
+  Trace::init("accounts");
+
   SSLContextConfig sslc;
   sslc.setCertificate(
       "/marina/cert.pem",
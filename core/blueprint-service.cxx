@@ -26,6 +26,7 @@ unique_ptr<DB> db{nullptr};
 int main()
 {
   Glog::init("blueprint-service");
+  Trace::init("blueprint");
 
   LOG(INFO) << "blueprint service starting";
   
@@ -4,6 +4,7 @@
 #include <limits>
 #include <vector>
 #include <algorithm>
+#include <mutex>
 #include <experimental/optional>
 #include <fmt/format.h>
 #include <arpa/inet.h>
@@ -17,6 +18,8 @@ using std::out_of_range;
 using std::unordered_map;
 using std::string;
 using std::make_pair;
+using std::make_shared;
+using std::shared_ptr;
 using std::array;
 using std::vector;
 using std::to_string;
@@ -26,6 +29,8 @@ using std::pair;
 using std::find_if;
 using std::remove_if;
 using std::ostream;
+using std::mutex;
+using std::lock_guard;
 using std::experimental::optional;
 using std::experimental::make_optional;
 
@@ -34,6 +39,35 @@ using namespace pipes;
 
 using ull = unsigned long long;
 
+namespace
+{
+  //throws for the first of the required keys of an object that was not seen
+  void required(JsonReader & r, const char *context,
+      std::initializer_list<pair<const char*, bool>> keys)
+  {
+    for(const auto & k : keys) if(!k.second) r.missing(context, k.first);
+  }
+
+  //the {"value": .., "unit": ..} objects of bandwidth, latency and memory
+  pair<size_t, string> readQuantity(JsonReader & r, const char *context)
+  {
+    pair<size_t, string> q;
+    bool value{false}, unit{false};
+
+    r.beginObject();
+    string k;
+    while(r.key(k))
+    {
+      if(k == "value") { q.first = r.uint(); value = true; }
+      else if(k == "unit") { q.second = r.string(); unit = true; }
+      else r.skip();
+    }
+
+    required(r, context, {{"value", value}, {"unit", unit}});
+    return q;
+  }
+}
+
 // internal data structures ----------------------------------------------------
 namespace marina
 {
@@ -50,51 +84,108 @@ namespace marina
     Blueprint::ComputerMap computers;
     Blueprint::NetworkMap networks;
 
-    vector<Link> links;
+    Cow<vector<Link>> links{Cow<vector<Link>>::make()};
+
+    //name -> id, checked against the maps on every lookup and rebuilt when
+    //a node was renamed, removed or added behind their back. Lookups are
+    //const and may come from many threads at once, the index is only
+    //touched under names_mtx
+    unordered_map<string, Uuid> computer_names, network_names;
+    mutex names_mtx;
   };
   
+  //the handle cells are per copy, what they point to is shared between a
+  //model and its clones until either side changes it
   struct Network_
   {
-    Network_(string name) : name{name} {} 
+    struct Data
+    {
+      Data(string name) : name{name} {}
+
+      string name;
+      Bandwidth bandwidth{100_mbps};
+      Latency latency{0_ms};
+      IpV4Address ipv4space{"10.10.0.0", 16};
+      Uuid id;
+      //Network::EmbeddingInfo einfo;
+    };
 
-    string name;
-    Bandwidth bandwidth{100_mbps};
-    Latency latency{0_ms};
-    IpV4Address ipv4space{"10.10.0.0", 16};
-    Uuid id;
-    //Network::EmbeddingInfo einfo;
+    Network_(string name) : d{Cow<Data>::make(name)} {}
+
+    Cow<Data> d;
   };
 
   struct Computer_
   {
-    Computer_(string name) : name{name} {}
+    struct Data
+    {
+      Data(string name) : name{name} {}
+
+      string name;
+      string os{"ubuntu-server-15.10"};
+      Memory memory{4_gb}, disk{10_gb};
+      size_t cores{2};
+      //Computer::EmbeddingInfo embedding;
+      Uuid id;
+    };
 
-    string name;
-    string os{"ubuntu-server-15.10"};
-    Memory memory{4_gb}, disk{10_gb};
-    size_t cores{2};
-    //Computer::EmbeddingInfo embedding;
-    Uuid id;
+    Computer_(string name) : d{Cow<Data>::make(name)} {}
 
+    Cow<Data> d;
     unordered_map<string, Interface> interfaces;
   };
 
   struct Interface_
   {
-    Interface_(string name) 
-      : name{name} 
+    struct Data
     {
-      mac = generate_mac();
-    }
+      Data(string name) 
+        : name{name} 
+      {
+        mac = generate_mac();
+      }
+
+      string name, mac;
+      Latency latency{0_ms};
+      Interface::EmbeddingInfo einfo;
+      Bandwidth capacity{1_gbps};
+    };
+
+    Interface_(string name) : d{Cow<Data>::make(name)} {}
 
-    string name, mac;
-    Latency latency{0_ms};
-    Interface::EmbeddingInfo einfo;
-    Bandwidth capacity{1_gbps};
+    Cow<Data> d;
   };
 
 }
 
+namespace
+{
+  //the node of xs named name, nullptr if there is none
+  template <class Map>
+  typename Map::mapped_type * 
+  byName(Map & xs, unordered_map<string, Uuid> & index, mutex & mtx,
+      const string & name)
+  {
+    lock_guard<mutex> lk{mtx};
+    auto lookup = [&]() -> typename Map::mapped_type *
+    {
+      auto i = index.find(name);
+      if(i == index.end()) return nullptr;
+      auto j = xs.find(i->second);
+      if(j == xs.end() || j->second.name() != name) return nullptr;
+      return &j->second;
+    };
+
+    auto x = lookup();
+    if(x != nullptr) return x;
+
+    index.clear();
+    index.reserve(xs.size());
+    for(const auto & p : xs) index.emplace(p.second.name(), p.first);
+    return lookup();
+  }
+}
+
 // Blueprint -------------------------------------------------------------------
 Blueprint::Blueprint(string name)
   : _{new Blueprint_{name}}
@@ -117,6 +208,13 @@ Blueprint & Blueprint::project(string project)
 */
 
 Uuid Blueprint::id() const { return _->id; }
+void Blueprint::id(const Uuid & id) { _->id = id; }
+
+void Blueprint::link(const Link & l) { _->links.write().push_back(l); }
+void Blueprint::links(vector<Link> ls)
+{
+  _->links = Cow<vector<Link>>::make(std::move(ls));
+}
 
 Network Blueprint::network(string name) 
 { 
@@ -132,6 +230,41 @@ Computer Blueprint::computer(string name)
   return c;
 }
 
+void Blueprint::reserve(size_t computers, size_t networks, size_t links)
+{
+  _->computers.reserve(computers);
+  _->networks.reserve(networks);
+  if(links > _->links->size()) _->links.write().reserve(links);
+}
+
+vector<Computer> 
+Blueprint::addComputers(string prefix, size_t n, const Computer & like)
+{
+  vector<Computer> cs;
+  cs.reserve(n);
+  _->computers.reserve(_->computers.size() + n);
+  for(size_t i=0; i<n; ++i)
+  {
+    cs.push_back(like.copy(prefix + to_string(i)));
+    _->computers.emplace(cs.back().id(), cs.back());
+  }
+  return cs;
+}
+
+vector<Network> 
+Blueprint::addNetworks(string prefix, size_t n, const Network & like)
+{
+  vector<Network> ns;
+  ns.reserve(n);
+  _->networks.reserve(_->networks.size() + n);
+  for(size_t i=0; i<n; ++i)
+  {
+    ns.push_back(like.copy(prefix + to_string(i)));
+    _->networks.emplace(ns.back().id(), ns.back());
+  }
+  return ns;
+}
+
 Blueprint::ComputerMap & Blueprint::computers() const
 {
   return _->computers;
@@ -146,7 +279,7 @@ Blueprint::NetworkMap & Blueprint::networks() const
 vector<Endpoint> Blueprint::neighbors(const Endpoint & e) const
 {
   return
-  _->links
+  *_->links
     | collect([&e](const Link & x)
       {
         if(x.endpoints[0].id == e.id) return make_optional(x.endpoints[1]);
@@ -193,13 +326,8 @@ Blueprint::connectedComputers(const Network n) const
      
 Computer & Blueprint::getComputer(string name) const 
 { 
-  auto i = find_if(_->computers.begin(), _->computers.end(),
-      [&name](const auto & p) 
-      { 
-        return p.second.name() == name; 
-      });
-
-  if(i != _->computers.end()) return i->second;
+  Computer *c = byName(_->computers, _->computer_names, _->names_mtx, name);
+  if(c != nullptr) return *c;
 
   throw out_of_range{
     fmt::format("blueprint {} does not contain a computer named {}",
@@ -211,12 +339,8 @@ Computer & Blueprint::getComputer(string name) const
 
 Network & Blueprint::getNetwork(string name) const 
 { 
-  auto i = find_if(_->networks.begin(), _->networks.end(),
-    [&name](const auto & p)
-    {
-      return p.second.name() == name;
-    });
-  if(i != _->networks.end()) return i->second;
+  Network *n = byName(_->networks, _->network_names, _->names_mtx, name);
+  if(n != nullptr) return *n;
   
   throw out_of_range{
     fmt::format("blueprint {} does not contain a network named {}",
@@ -279,72 +403,93 @@ void Blueprint::removeNetwork(string name)
 
 const vector<Link> & Blueprint::links() const
 {
-  return _->links;
+  return *_->links;
 }
 
 void Blueprint::connect(pair<Computer,Interface> c, Network n)
 {
-  _->links.push_back({c, n});
+  _->links.write().push_back({c, n});
 }
 
 void Blueprint::connect(Network a, Network b)
 {
-  _->links.push_back({a,b});
+  _->links.write().push_back({a,b});
 }
 
-/*
-Blueprint Blueprint::localEmbedding(string host_id)
+void Blueprint::connect(const vector<Computer> & cs, string ifx, Network n)
 {
-  Blueprint b{name()};
-  b._->id = _->id;
-  b._->project = _->project;
+  vector<Link> & ls = _->links.write();
+  ls.reserve(ls.size() + cs.size());
+  for(Computer c : cs) ls.push_back({{c, c.ifx(ifx)}, n});
+}
+
+Blueprint Blueprint::localEmbedding(const ComputerMap & machines) const
+{
+  return localEmbeddings({machines}).front();
+}
 
-  for(Computer c : computers())
+vector<Blueprint> 
+Blueprint::localEmbeddings(const vector<ComputerMap> & parts) const
+{
+  vector<Blueprint> bs;
+  bs.reserve(parts.size());
+
+  //the part each computer went to
+  UuidMap<size_t> where;
+  for(size_t k=0; k<parts.size(); ++k)
   {
-    if(c.embedding().host == host_id)
+    bs.emplace_back(name());
+    Blueprint & b = bs.back();
+    b._->id = _->id;
+
+    for(const auto & m : parts[k])
     {
-      b._->computers.insert_or_assign(c.name(), c);
+      auto i = _->computers.find(m.first);
+      if(i == _->computers.end()) continue;
+      b._->computers.insert_or_assign(i->first, i->second);
+      where.emplace(i->first, k);
+    }
+  }
 
-      for(auto i : c.interfaces())
-      {
-        for(const Link & l : _->links)
-        {
-          if(l.endpoints[0] == i.second.mac())
-          {
-            b._->links.push_back(l);
+  vector<vector<Link>> links(parts.size());
+  for(const Link & l : *_->links)
+  {
+    for(size_t e=0; e<2; ++e)
+    {
+      auto w = where.find(l.endpoints[e].id);
+      if(w == where.end()) continue;
 
-            Network n = getNetworkById(l.endpoints[1]);
-            b._->networks.insert_or_assign(n.name(), n);
-          }
-          if(l.endpoints[1] == i.second.mac())
-          {
-            b._->links.push_back(l);
+      auto n = _->networks.find(l.endpoints[1-e].id);
+      if(n != _->networks.end()) 
+        bs[w->second]._->networks.insert_or_assign(n->first, n->second);
 
-            Network n = getNetworkById(l.endpoints[0]);
-            b._->networks.insert_or_assign(n.name(), n);
-          }
-        }
-      }
+      links[w->second].push_back(l);
     }
   }
 
-  return b;
+  for(size_t k=0; k<bs.size(); ++k) bs[k].links(std::move(links[k]));
+  return bs;
 }
-*/
 
+//a new handle for every node with the node data shared copy on write, a
+//handle may be changed through the original or the clone without the
+//other one seeing it. The node maps are not shared themselves, handles 
+//hand out write access to their node on their own, so a map shared with a
+//clone could not tell when it has to come apart
 Blueprint Blueprint::clone() const
 {
-    string project;
   Blueprint m{name()};
   m._->id = _->id;
   //m._->project = _->project;
-  for(auto x : _->networks)
-    m._->networks.insert_or_assign(x.first, x.second.clone());
+  m._->networks.reserve(_->networks.size());
+  for(const auto & x : _->networks)
+    m._->networks.emplace(x.first, x.second.clone());
 
-  for(auto x : _->computers)
-    m._->computers.insert_or_assign(x.first, x.second.clone());
+  m._->computers.reserve(_->computers.size());
+  for(const auto & x : _->computers)
+    m._->computers.emplace(x.first, x.second.clone());
 
-  m._->links = _->links; //not a pointer based data structure
+  m._->links = _->links;
   return m;
 }
 
@@ -355,7 +500,7 @@ Json Blueprint::json() const
   //j["project"] = project();
   j["networks"] = jtransform(_->networks);
   j["computers"] = jtransform(_->computers);
-  j["links"] = jtransform(_->links);
+  j["links"] = jtransform(*_->links);
   j["id"] = _->id.json();
   return j;
 }
@@ -384,12 +529,80 @@ Blueprint Blueprint::fromJson(Json j)
   for(Json & lj : links)
   {
     Link l = Link::fromJson(lj);
-    bp._->links.push_back(l);
+    bp._->links.write().push_back(l);
   }
 
   return bp;
 }
 
+Blueprint Blueprint::fromJson(JsonReader & r)
+{
+  Blueprint bp{""};
+  bool name{false}, id{false}, computers{false}, networks{false}, links{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "name")
+    {
+      bp._->name = r.string();
+      name = true;
+    }
+    else if(k == "id")
+    {
+      bp._->id = Uuid::fromJson(r);
+      id = true;
+    }
+    else if(k == "computers")
+    {
+      r.beginArray();
+      while(r.element())
+      {
+        Computer c = Computer::fromJson(r);
+        bp._->computers.insert_or_assign(c.id(), c);
+      }
+      computers = true;
+    }
+    else if(k == "networks")
+    {
+      r.beginArray();
+      while(r.element())
+      {
+        Network n = Network::fromJson(r);
+        bp._->networks.insert_or_assign(n.id(), n);
+      }
+      networks = true;
+    }
+    else if(k == "links")
+    {
+      r.beginArray();
+      while(r.element()) bp._->links.write().push_back(Link::fromJson(r));
+      links = true;
+    }
+    else r.skip();
+  }
+
+  required(r, "blueprint", {
+      {"name", name}, {"id", id}, {"computers", computers},
+      {"networks", networks}, {"links", links}
+  });
+  return bp;
+}
+
+Blueprint Blueprint::parse(const char *data, size_t size)
+{
+  JsonReader r{data, size};
+  Blueprint bp = fromJson(r);
+  r.end();
+  return bp;
+}
+
+Blueprint Blueprint::parse(const string & s)
+{
+  return parse(s.data(), s.size());
+}
+
 bool marina::operator== (const Blueprint &a, const Blueprint &b)
 {
   if(a.name() != b.name()) return false;
@@ -452,6 +665,12 @@ Bandwidth Bandwidth::fromJson(Json j)
   return Bandwidth{size, parseUnit(unit)};
 }
 
+Bandwidth Bandwidth::fromJson(JsonReader & r)
+{
+  auto q = readQuantity(r, "bandwidth");
+  return Bandwidth{q.first, parseUnit(q.second)};
+}
+
 Json Bandwidth::json() const
 {
   Json j;
@@ -501,6 +720,12 @@ Latency Latency::fromJson(Json j)
   return Latency(size, parseUnit(unit));
 }
 
+Latency Latency::fromJson(JsonReader & r)
+{
+  auto q = readQuantity(r, "latency");
+  return Latency(q.first, parseUnit(q.second));
+}
+
 Json Latency::json() const
 {
   Json j;
@@ -630,6 +855,24 @@ IpV4Address IpV4Address::fromJson(Json j)
   return a;
 }
 
+IpV4Address IpV4Address::fromJson(JsonReader & r)
+{
+  IpV4Address a;
+  bool addr{false}, mask{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "addr") { a.addr_ = r.uint(); addr = true; }
+    else if(k == "mask") { a.mask_ = r.uint(); mask = true; }
+    else r.skip();
+  }
+
+  required(r, "ipv4address", {{"addr", addr}, {"mask", mask}});
+  return a;
+}
+
 Json IpV4Address::json() const
 {
   Json j;
@@ -646,48 +889,56 @@ Network::Network(string name)
   : _{new Network_{name}}
 { }
 
-string Network::name() const { return _->name; }
+Network::Network(shared_ptr<Network_> x)
+  : _{x}
+{}
+
+string Network::name() const { return _->d->name; }
 Network & Network::name(string name)
 {
-  _-> name = name;
+  _->d.write().name = name;
   return *this;
 }
 
-const Bandwidth Network::capacity() const { return _->bandwidth; }
+const Bandwidth Network::capacity() const { return _->d->bandwidth; }
 Network & Network::capacity(Bandwidth x)
 {
-  _->bandwidth = x;
+  _->d.write().bandwidth = x;
   return *this;
 }
 
 
 const IpV4Address & Network::ipv4() const
 {
-  return _->ipv4space;
+  return _->d->ipv4space;
 }
 
 Network & Network::ipv4(string addr, uint32_t mask)
 {
-  _->ipv4space = IpV4Address{addr, mask};
+  _->d.write().ipv4space = IpV4Address{addr, mask};
   return *this;
 }
 
-const Latency Network::latency() const { return _->latency; }
+void Network::ipv4(const IpV4Address & a) { _->d.write().ipv4space = a; }
+
+const Latency Network::latency() const { return _->d->latency; }
 Network & Network::latency(Latency x)
 {
-  _->latency = x;
+  _->d.write().latency = x;
   return *this;
 }
 
 Uuid Network::id() const
 {
-  return _->id;
+  return _->d->id;
 }
 
+void Network::id(const Uuid & id) { _->d.write().id = id; }
+
 /*
 Network::EmbeddingInfo & Network::einfo() const
 {
-  return _->einfo;
+  return _->d->einfo;
 }
 */
 
@@ -698,25 +949,61 @@ Network Network::fromJson(Json j)
   n.latency(Latency::fromJson(extract(j, "latency", "network")));
   n.capacity(Bandwidth::fromJson(extract(j, "capacity", "network")));
 
-  n._->id = Uuid::fromJson(extract(j, "id", "network"));
+  n._->d.write().id = Uuid::fromJson(extract(j, "id", "network"));
 
   Json ipv4_ = extract(j, "ipv4", "network");
-  n._->ipv4space = IpV4Address::fromJson(ipv4_);
+  n._->d.write().ipv4space = IpV4Address::fromJson(ipv4_);
 
   /*
   Json einfo = extract(j, "einfo", "network");
-  n._->einfo.vni = extract(einfo, "vni", "einfo");
+  n._->d.write().einfo.vni = extract(einfo, "vni", "einfo");
   Json switches = extract(einfo, "switches", "network:einfo");
   for(const Json & sw : switches)
   {
     string s = sw;
-    n._->einfo.switches.insert(s);
+    n._->d.write().einfo.switches.insert(s);
   }
   */
 
   return n;
 }
 
+Network Network::fromJson(JsonReader & r)
+{
+  Network n{""};
+  bool name{false}, latency{false}, capacity{false}, id{false}, ipv4{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "name") { n._->d.write().name = r.string(); name = true; }
+    else if(k == "latency")
+    {
+      n._->d.write().latency = Latency::fromJson(r);
+      latency = true;
+    }
+    else if(k == "capacity")
+    {
+      n._->d.write().bandwidth = Bandwidth::fromJson(r);
+      capacity = true;
+    }
+    else if(k == "id") { n._->d.write().id = Uuid::fromJson(r); id = true; }
+    else if(k == "ipv4")
+    {
+      n._->d.write().ipv4space = IpV4Address::fromJson(r);
+      ipv4 = true;
+    }
+    else r.skip();
+  }
+
+  required(r, "network", {
+      {"name", name}, {"latency", latency}, {"capacity", capacity},
+      {"id", id}, {"ipv4", ipv4}
+  });
+  return n;
+}
+
 Json Network::json() const
 {
   Json j;
@@ -724,19 +1011,23 @@ Json Network::json() const
   j["latency"] = latency().json();
   j["capacity"] = capacity().json();
   j["ipv4"] = ipv4().json();
-  j["id"] = _->id.json();
-  //j["einfo"]["vni"] = _->einfo.vni;
-  //j["einfo"]["switches"] = _->einfo.switches;
+  j["id"] = _->d->id.json();
+  //j["einfo"]["vni"] = _->d->einfo.vni;
+  //j["einfo"]["switches"] = _->d->einfo.switches;
   return j;
 }
 
 Network Network::clone() const
 {
-  Network n{name()};
-  n._->latency = _->latency;
-  n._->bandwidth = _->bandwidth;
-  n._->id = _->id;
-  //n._->einfo = _->einfo;
+  return Network{make_shared<Network_>(*_)};
+}
+
+Network Network::copy(string name) const
+{
+  Network n{make_shared<Network_>(*_)};
+  auto & d = n._->d.write();
+  d.name = name;
+  d.id = Uuid{};
   return n;
 }
   
@@ -768,6 +1059,12 @@ Memory Memory::fromJson(Json j)
   return Memory{size, parseUnit(unit)};
 }
 
+Memory Memory::fromJson(JsonReader & r)
+{
+  auto q = readQuantity(r, "memory");
+  return Memory{q.first, parseUnit(q.second)};
+}
+
 Json Memory::json() const
 {
   Json j;
@@ -866,6 +1163,10 @@ Interface::Interface(string name)
   : _{new Interface_{name}}
 {}
 
+Interface::Interface(shared_ptr<Interface_> x)
+  : _{x}
+{}
+
 Interface Interface::fromJson(Json j)
 {
   string name = extract(j, "name", "interface");
@@ -873,44 +1174,96 @@ Interface Interface::fromJson(Json j)
   ifx.latency(Latency::fromJson(extract(j, "latency", "interface")))
      .capacity(Bandwidth::fromJson(extract(j, "capacity", "interface")));
 
-  ifx._->mac = extract(j, "mac", "interface");
+  ifx._->d.write().mac = extract(j, "mac", "interface");
   
   Json einfo = extract(j, "einfo", "interface");
   Json ipaddr_v4 = extract(einfo, "ipv4", "interface:einfo");
-  ifx.einfo().ipaddr_v4 = IpV4Address::fromJson(ipaddr_v4);
+  ifx.writeEinfo().ipaddr_v4 = IpV4Address::fromJson(ipaddr_v4);
 
   return ifx;
 }
 
-string Interface::name() const { return _->name; }
+Interface Interface::fromJson(JsonReader & r)
+{
+  Interface ifx{""};
+  bool name{false}, latency{false}, capacity{false}, mac{false}, ipv4{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "name") { ifx._->d.write().name = r.string(); name = true; }
+    else if(k == "latency")
+    {
+      ifx._->d.write().latency = Latency::fromJson(r);
+      latency = true;
+    }
+    else if(k == "capacity")
+    {
+      ifx._->d.write().capacity = Bandwidth::fromJson(r);
+      capacity = true;
+    }
+    else if(k == "mac") { ifx._->d.write().mac = r.string(); mac = true; }
+    else if(k == "einfo")
+    {
+      r.beginObject();
+      string ek;
+      while(r.key(ek))
+      {
+        if(ek == "ipv4")
+        {
+          ifx._->d.write().einfo.ipaddr_v4 = IpV4Address::fromJson(r);
+          ipv4 = true;
+        }
+        else r.skip();
+      }
+    }
+    else r.skip();
+  }
+
+  required(r, "interface", {
+      {"name", name}, {"latency", latency}, {"capacity", capacity},
+      {"mac", mac}, {"einfo:ipv4", ipv4}
+  });
+  return ifx;
+}
+
+string Interface::name() const { return _->d->name; }
 Interface & Interface::name(string x)
 {
-  _->name = x;
+  _->d.write().name = x;
   return *this;
 }
 
-const Latency Interface::latency() const { return _->latency; }
+const Latency Interface::latency() const { return _->d->latency; }
 Interface & Interface::latency(Latency x)
 {
-  _->latency = x;
+  _->d.write().latency = x;
   return *this;
 }
 
-const Bandwidth Interface::capacity() const { return _->capacity; }
+const Bandwidth Interface::capacity() const { return _->d->capacity; }
 Interface & Interface::capacity(Bandwidth x)
 {
-  _->capacity = x;
+  _->d.write().capacity = x;
   return *this;
 }
 
 string Interface::mac() const
 {
-  return _->mac;
+  return _->d->mac;
+}
+
+void Interface::mac(const string & m) { _->d.write().mac = m; }
+
+const Interface::EmbeddingInfo & Interface::einfo() const
+{
+  return _->d->einfo;
 }
 
-Interface::EmbeddingInfo & Interface::einfo() const
+Interface::EmbeddingInfo & Interface::writeEinfo()
 {
-  return _->einfo;
+  return _->d.write().einfo;
 }
 
 Json Interface::json() const
@@ -920,17 +1273,13 @@ Json Interface::json() const
   j["latency"] = latency().json();
   j["capacity"] = capacity().json();
   j["mac"] = mac();
-  j["einfo"]["ipv4"] = einfo().ipaddr_v4.json();
+  j["einfo"]["ipv4"] = _->d->einfo.ipaddr_v4.json();
   return j;
 }
 
 Interface Interface::clone() const
 {
-  Interface i{name()};
-  i._->mac = _->mac;
-  i._->latency = _->latency;
-  i._->capacity = _->capacity;
-  return i;
+  return Interface{make_shared<Interface_>(*_)};
 }
 
 bool marina::operator == (const Interface &a, const Interface &b)
@@ -996,7 +1345,12 @@ Computer::Computer(string name)
   add_ifx("cifx", 1_gbps);
 }
 
-const Uuid & Computer::id() const { return _->id; }
+Computer::Computer(shared_ptr<Computer_> x)
+  : _{x}
+{}
+
+const Uuid & Computer::id() const { return _->d->id; }
+void Computer::id(const Uuid & id) { _->d.write().id = id; }
 
 Computer Computer::fromJson(Json j)
 {
@@ -1010,7 +1364,7 @@ Computer Computer::fromJson(Json j)
         extract(j, "embedding", "computer")));
         */
 
-  c._->id = Uuid::fromJson(extract(j, "id", "computer"));
+  c._->d.write().id = Uuid::fromJson(extract(j, "id", "computer"));
 
   Json ifxs = extract(j, "interfaces", "computer");
   for(const Json & ij : ifxs)
@@ -1022,38 +1376,77 @@ Computer Computer::fromJson(Json j)
   return c;
 }
 
-string Computer::name() const { return _->name; }
+Computer Computer::fromJson(JsonReader & r)
+{
+  Computer c{""};
+  bool name{false}, os{false}, memory{false}, cores{false}, id{false},
+       interfaces{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "name") { c._->d.write().name = r.string(); name = true; }
+    else if(k == "os") { c._->d.write().os = r.string(); os = true; }
+    else if(k == "memory")
+    {
+      c._->d.write().memory = Memory::fromJson(r);
+      memory = true;
+    }
+    else if(k == "cores") { c._->d.write().cores = r.uint(); cores = true; }
+    else if(k == "id") { c._->d.write().id = Uuid::fromJson(r); id = true; }
+    else if(k == "interfaces")
+    {
+      r.beginArray();
+      while(r.element())
+      {
+        Interface ifx = Interface::fromJson(r);
+        c._->interfaces.insert_or_assign(ifx.name(), ifx);
+      }
+      interfaces = true;
+    }
+    else r.skip();
+  }
+
+  required(r, "computer", {
+      {"name", name}, {"os", os}, {"memory", memory}, {"cores", cores},
+      {"id", id}, {"interfaces", interfaces}
+  });
+  return c;
+}
+
+string Computer::name() const { return _->d->name; }
 Computer & Computer::name(string x)
 {
-  _->name = x;
+  _->d.write().name = x;
   return *this;
 }
 
-string Computer::os() const { return _->os; }
+string Computer::os() const { return _->d->os; }
 Computer & Computer::os(string x)
 {
-  _->os = x;
+  _->d.write().os = x;
   return *this;
 }
 
-const Memory Computer::memory() const { return _->memory; }
+const Memory Computer::memory() const { return _->d->memory; }
 Computer & Computer::memory(Memory x)
 {
-  _->memory = x;
+  _->d.write().memory = x;
   return *this;
 }
 
-const Memory Computer::disk() const { return _->disk; }
+const Memory Computer::disk() const { return _->d->disk; }
 Computer & Computer::disk(Memory x)
 {
-  _->disk = x;
+  _->d.write().disk = x;
   return *this;
 }
 
-size_t Computer::cores() const { return _->cores; }
+size_t Computer::cores() const { return _->d->cores; }
 Computer & Computer::cores(size_t x)
 {
-  _->cores = x;
+  _->d.write().cores = x;
   return *this;
 }
 
@@ -1084,10 +1477,10 @@ Computer & Computer::remove_ifx(string name)
 }
 
 /*
-Computer::EmbeddingInfo & Computer::embedding() const { return _->embedding; }
+Computer::EmbeddingInfo & Computer::embedding() const { return _->d->embedding; }
 Computer & Computer::embedding(Computer::EmbeddingInfo e)
 {
-  _->embedding = e;
+  _->d.write().embedding = e;
   return *this;
 }
 */
@@ -1120,14 +1513,7 @@ Json Computer::json() const
 
 Computer Computer::clone() const
 {
-  Computer c{name()};
-  c._->os = _->os;
-  c._->memory = _->memory;
-  c._->cores = _->cores;
-  c._->disk = _->disk;
-  //c._->embedding = _->embedding;
-  c._->id = _->id;
-
+  Computer c{make_shared<Computer_>(*_)};
   for(auto & p : _->interfaces)
   { 
     c._->interfaces.insert_or_assign(p.first, p.second.clone()); 
@@ -1136,6 +1522,21 @@ Computer Computer::clone() const
   return c;
 }
 
+Computer Computer::copy(string name) const
+{
+  Computer c{make_shared<Computer_>(*_)};
+  auto & d = c._->d.write();
+  d.name = name;
+  d.id = Uuid{};
+
+  for(auto & p : c._->interfaces)
+  {
+    p.second = p.second.clone();
+    p.second.mac(generate_mac());
+  }
+  return c;
+}
+
 unordered_map<string, Interface> & Computer::interfaces() const 
 { 
   return _->interfaces; 
@@ -1255,6 +1656,34 @@ Link Link::fromJson(Json j)
   return l;
 }
 
+Link Link::fromJson(JsonReader & r)
+{
+  Link l;
+  bool endpoints{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "endpoints")
+    {
+      size_t n{0};
+      r.beginArray();
+      while(r.element())
+      {
+        if(n == 2) r.fail("a link has two endpoints");
+        l.endpoints[n++] = Endpoint::fromJson(r);
+      }
+      if(n != 2) r.fail("a link has two endpoints");
+      endpoints = true;
+    }
+    else r.skip();
+  }
+
+  required(r, "link", {{"endpoints", endpoints}});
+  return l;
+}
+
 Json Link::json() const
 {
   Json j;
@@ -16,6 +16,9 @@ namespace marina
   class Computer;
   class Interface;
   struct Link;
+  class FrozenBlueprint;
+  class FrozenTopology;
+  struct BlueprintDiff;
 
   // Blueprint -----------------------------------------------------------------
   class Blueprint
@@ -40,6 +43,13 @@ namespace marina
       //component creation
       Network network(std::string name);
       Computer computer(std::string name);
+
+      //bulk creation, n copies of a template named <prefix><i>
+      void reserve(size_t computers, size_t networks, size_t links = 0);
+      std::vector<Computer> 
+        addComputers(std::string prefix, size_t n, const Computer & like);
+      std::vector<Network> 
+        addNetworks(std::string prefix, size_t n, const Network & like);
       
       //component removal
       void removeComputer(std::string name);
@@ -49,6 +59,8 @@ namespace marina
       const std::vector<Link> & links() const;
       void connect(std::pair<Computer, Interface>, Network);
       void connect(Network, Network);
+      //the interface named ifx of every computer
+      void connect(const std::vector<Computer> &, std::string ifx, Network);
 
       ComputerMap & computers() const;
       NetworkMap & networks() const;
@@ -66,10 +78,36 @@ namespace marina
       //serialization
       Json json() const;
       static Blueprint fromJson(Json);
-
+      static Blueprint fromJson(JsonReader &);
+
+      //read a json document straight into a blueprint without building a
+      //Json tree first, throws JsonParseError with the line and column of
+      //a syntax error
+      static Blueprint parse(const char *data, size_t size);
+      static Blueprint parse(const std::string &);
+
+      //an independent copy, linear in the number of nodes. Node data and
+      //links are shared copy on write, but every node gets a fresh handle,
+      //handles are references and one held from before the clone must not
+      //write through to the clone
       Blueprint clone() const;
 
+      //the part of this blueprint that involves the given computers
+      Blueprint localEmbedding(const ComputerMap &) const;
+
+      //the local embedding of each set of computers, all of them in a single
+      //pass over the links, a computer belongs to at most one set
+      std::vector<Blueprint> localEmbeddings(
+          const std::vector<ComputerMap> &) const;
+
     private:
+      //for thawing frozen blueprints
+      friend FrozenBlueprint;
+      friend struct BlueprintDiff;
+      void id(const Uuid &);
+      void link(const Link &);
+      void links(std::vector<Link>);
+
       std::shared_ptr<struct Blueprint_> _;
   };
 
@@ -83,6 +121,7 @@ namespace marina
     Link(Network, Network);
 
     static Link fromJson(Json);
+    static Link fromJson(JsonReader &);
 
     Json json() const;
     
@@ -100,6 +139,7 @@ namespace marina
       Bandwidth() = default;
       Bandwidth(size_t, Unit);
       static Bandwidth fromJson(Json);
+      static Bandwidth fromJson(JsonReader &);
       static Unit parseUnit(std::string);
 
       size_t size{0};
@@ -126,6 +166,7 @@ namespace marina
       Latency() = default;
       Latency(size_t, Unit);
       static Latency fromJson(Json);
+      static Latency fromJson(JsonReader &);
       static Unit parseUnit(std::string);
 
       size_t size{0};
@@ -156,6 +197,7 @@ namespace marina
       IpV4Address(IpV4Address &&) = default;
 
       static IpV4Address fromJson(Json);
+      static IpV4Address fromJson(JsonReader &);
       Json json() const;
 
       IpV4Address & operator=(const IpV4Address &) = default;
@@ -199,6 +241,7 @@ namespace marina
 
       Network(std::string);
       static Network fromJson(Json);
+      static Network fromJson(JsonReader &);
 
       //name
       Network & name(std::string);
@@ -223,9 +266,20 @@ namespace marina
       Json json() const;
       Network clone() const;
 
+      //a new network like this one with its own id
+      Network copy(std::string name) const;
+
       friend Blueprint;
 
     private:
+      friend FrozenBlueprint;
+      friend FrozenTopology;
+      friend struct BlueprintDiff;
+      void id(const Uuid &);
+      void ipv4(const IpV4Address &);
+
+      explicit Network(std::shared_ptr<struct Network_>);
+
       std::shared_ptr<struct Network_> _;
   };
 
@@ -240,6 +294,7 @@ namespace marina
       Memory() = default;
       Memory(size_t, Unit);
       static Memory fromJson(Json j);
+      static Memory fromJson(JsonReader &);
       static Unit parseUnit(std::string s);
 
       size_t size{0};
@@ -272,6 +327,7 @@ namespace marina
 
       Interface(std::string name);
       static Interface fromJson(Json);
+      static Interface fromJson(JsonReader &);
 
       //name
       std::string name() const;
@@ -287,13 +343,22 @@ namespace marina
 
       std::string mac() const;
 
-      EmbeddingInfo & einfo() const;
+      const EmbeddingInfo & einfo() const;
+      //the embedding info to fill in, unshares the interface data
+      EmbeddingInfo & writeEinfo();
 
       Json json() const;
 
       Interface clone() const;
 
     private:
+      friend FrozenBlueprint;
+      friend FrozenTopology;
+      friend Computer;
+      void mac(const std::string &);
+
+      explicit Interface(std::shared_ptr<struct Interface_>);
+
       std::shared_ptr<struct Interface_> _;
   };
 
@@ -338,6 +403,7 @@ namespace marina
 
       Computer(std::string name);
       static Computer fromJson(Json);
+      static Computer fromJson(JsonReader &);
       
       //std::string guid() const;
       const Uuid & id() const;
@@ -378,7 +444,17 @@ namespace marina
       Json json() const;
 
       Computer clone() const;
+
+      //a new computer like this one with its own id and interface macs
+      Computer copy(std::string name) const;
     private:
+      friend FrozenBlueprint;
+      friend FrozenTopology;
+      friend class Host;
+      void id(const Uuid &);
+
+      explicit Computer(std::shared_ptr<struct Computer_>);
+
       std::shared_ptr<struct Computer_> _;
   };
 
@@ -12,6 +12,7 @@
 #include "core/util.hxx"
 #include "core/blueprint.hxx"
 #include "core/topo.hxx"
+#include "core/compilation.hxx"
 
 using std::string;
 using std::vector;
@@ -22,6 +23,7 @@ using std::cout;
 using std::cerr;
 using std::endl;
 using std::out_of_range;
+using std::runtime_error;
 using proxygen::HTTPMethod;
 using namespace marina;
 
@@ -168,29 +170,15 @@ void* compileSrc(string src)
     exit(1);
   }
   
-  string home = get_home();
-
-  exec(fmt::format("mkdir -p {}/.marina/cc", home));
-  string lib = fmt::format("{}/.marina/cc/{}.so", home, basename(src.c_str()));
-  CmdResult cr = 
-    exec(
-      fmt::format(
-        "clang++ "
-        "-stdlib=libc++ -std=c++14 -fPIC -shared "
-        "-I{mrsrc} -I/usr/local/include/c++/v1 "
-        "-L/usr/local/lib "
-        "{src} "
-        "-o {out}",
-        fmt::arg("src", src),
-        fmt::arg("out", lib),
-        fmt::arg("mrsrc", mrsrc)
-      )
-    );
-  
-  if(cr.code != 0)
+  //sources that have not changed since they were last compiled come
+  //straight out of the cache
+  ModelCompiler cc{mrsrc, get_home() + "/.marina/cc"};
+  string lib;
+  try { lib = cc.compile(src); }
+  catch(runtime_error &e)
   {
     cerr << "failed to compile " << src << endl;
-    cerr << cr.output << endl;
+    cerr << e.what() << endl;
     exit(1);
   }
   
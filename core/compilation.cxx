@@ -1,7 +1,236 @@
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/format.h>
 #include "compilation.hxx"
 
+using std::string;
+using std::vector;
+using std::ifstream;
+using std::ofstream;
+using std::stringstream;
+using std::runtime_error;
 using namespace marina;
 
+namespace
+{
+  //fnv-1a, folded into h
+  uint64_t hashBytes(uint64_t h, const string & x)
+  {
+    for(unsigned char c : x)
+    {
+      h ^= c;
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  constexpr uint64_t fnv_basis = 14695981039346656037ull;
+
+  string readFile(const string & path)
+  {
+    ifstream ifs{path, std::ios::binary};
+    if(!ifs.good()) throw runtime_error{"cannot read " + path};
+    stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+  }
+
+  bool exists(const string & path)
+  {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+  }
+
+  bool isHeader(const string & name)
+  {
+    for(const char *ext : {".hxx", ".hpp", ".h"})
+    {
+      size_t n = strlen(ext);
+      if(name.size() > n && name.compare(name.size()-n, n, ext) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  //headers under dir in path order, descending into subdirectories if asked
+  void headers(const string & dir, bool recurse, vector<string> & out)
+  {
+    vector<string> entries;
+    DIR *d = opendir(dir.c_str());
+    if(d == nullptr) return;
+    while(dirent *e = readdir(d)) entries.push_back(e->d_name);
+    closedir(d);
+    std::sort(entries.begin(), entries.end());
+
+    for(const string & e : entries)
+    {
+      if(e == "." || e == "..") continue;
+      string path = dir + "/" + e;
+
+      struct stat st;
+      if(stat(path.c_str(), &st) != 0) continue;
+      if(S_ISDIR(st.st_mode)) { if(recurse) headers(path, true, out); }
+      else if(isHeader(e)) out.push_back(path);
+    }
+  }
+
+  string parentDir(const string & path)
+  {
+    size_t i = path.rfind('/');
+    if(i == string::npos) return ".";
+    if(i == 0) return "/";
+    return path.substr(0, i);
+  }
+
+  //run argv, throwing the output of a failure
+  void run(vector<string> argv, const string & what)
+  {
+    CmdResult cr = exec(Command{argv});
+    if(cr.code != 0) throw runtime_error{what + "\n" + cr.output};
+  }
+}
+
+// Diagnostics -----------------------------------------------------------------
+
 Blueprint Diagnostics::blueprint() { return blueprint_; }
 
 Json Diagnostics::source() { return source_; }
+
+// ModelCompiler ---------------------------------------------------------------
+
+ModelCompiler::ModelCompiler(string marina_src, string cache_dir,
+    string compiler)
+  : mrsrc_{marina_src}, dir_{cache_dir}, cxx_{compiler}
+{}
+
+bool ModelCompiler::hit() const { return hit_; }
+
+vector<string> ModelCompiler::flags() const
+{
+  return {
+    "-stdlib=libc++", "-std=c++14", "-fPIC",
+    "-I" + mrsrc_, "-I/usr/local/include/c++/v1"
+  };
+}
+
+const string & ModelCompiler::version()
+{
+  if(!version_.empty()) return version_;
+
+  CmdResult cr = exec(Command{{cxx_, "--version"}});
+  if(cr.code != 0) throw runtime_error{"cannot run " + cxx_ + "\n" + cr.output};
+
+  uint64_t h = hashBytes(fnv_basis, cr.output);
+  for(const string & f : flags()) h = hashBytes(h, f);
+
+  vector<string> hs;
+  for(const char *d : {"core", "common", "3p"})
+    headers(mrsrc_ + "/" + d, true, hs);
+
+  for(const string & x : hs)
+  {
+    h = hashBytes(h, x.substr(mrsrc_.size()));
+    h = hashBytes(h, readFile(x));
+  }
+
+  version_ = fmt::format("{:016x}", h);
+  return version_;
+}
+
+string ModelCompiler::key(const string & src)
+{
+  uint64_t h = hashBytes(fnv_basis, version());
+  h = hashBytes(h, readFile(src));
+
+  //the model's own headers, a source that includes its neighbours is stale
+  //when they change
+  vector<string> hs;
+  headers(parentDir(src), false, hs);
+  for(const string & x : hs)
+  {
+    h = hashBytes(h, x);
+    h = hashBytes(h, readFile(x));
+  }
+
+  return fmt::format("{:016x}", h);
+}
+
+//the precompiled model api, empty if it cannot be built, compiles then just
+//go without
+string ModelCompiler::pch()
+{
+  if(pch_failed_) return "";
+
+  string dir = fmt::format("{}/pch/{}", dir_, version());
+  string pch = dir + "/model.hxx.pch";
+  if(exists(pch)) return pch;
+
+  try
+  {
+    run({"mkdir", "-p", dir}, "failed to create " + dir);
+    ofstream{dir + "/model.hxx"}
+      << "#include \"core/blueprint.hxx\"\n"
+      << "#include \"core/topo.hxx\"\n";
+
+    string tmp = fmt::format("{}.{}", pch, getpid());
+    vector<string> argv{cxx_};
+    for(const string & f : flags()) argv.push_back(f);
+    argv.insert(argv.end(), 
+        {"-x", "c++-header", dir + "/model.hxx", "-o", tmp});
+
+    run(argv, "failed to precompile the model headers");
+    if(rename(tmp.c_str(), pch.c_str()) != 0)
+      throw runtime_error{"failed to move " + tmp};
+    return pch;
+  }
+  catch(runtime_error &)
+  {
+    pch_failed_ = true;
+    return "";
+  }
+}
+
+string ModelCompiler::compile(const string & src)
+{
+  string out = fmt::format("{}/obj/{}.so", dir_, key(src));
+  hit_ = exists(out);
+  if(hit_) return out;
+
+  run({"mkdir", "-p", dir_ + "/obj"}, "failed to create " + dir_ + "/obj");
+
+  //a concurrent compile of the same source never sees half an object
+  string tmp = fmt::format("{}.{}", out, getpid());
+
+  auto build = [this, &src, &tmp](const string & h)
+  {
+    vector<string> argv{cxx_};
+    for(const string & f : flags()) argv.push_back(f);
+    if(!h.empty()) { argv.push_back("-include-pch"); argv.push_back(h); }
+    argv.insert(argv.end(), {"-shared", "-L/usr/local/lib", src, "-o", tmp});
+    run(argv, "failed to compile " + src);
+  };
+
+  string h = pch();
+  try { build(h); }
+  catch(runtime_error &e)
+  {
+    //clang turns a pch away once a header it was built from has a new mtime
+    //or size, even when the content and so the version did not change, the
+    //pch is then rebuilt and the compile tried once more
+    if(h.empty() || string{e.what()}.find(h) == string::npos) throw;
+    std::remove(h.c_str());
+    build(pch());
+  }
+
+  if(rename(tmp.c_str(), out.c_str()) != 0)
+    throw runtime_error{"failed to move " + tmp};
+
+  return out;
+}
@@ -1,6 +1,8 @@
 #ifndef MARINATB_CORE_COMPILATION_HXX
 #define MARINATB_CORE_COMPILATION_HXX
 
+#include <string>
+#include <vector>
 #include "blueprint.hxx"
 
 namespace marina
@@ -15,6 +17,42 @@ namespace marina
       Blueprint blueprint_;
       Json source_;
   };
+
+  /*
+   * Compiles model sources into shared objects through a content addressed
+   * cache. An object is keyed by the source, the headers next to it, the
+   * marina headers and the compiler with its flags, so a source that has not
+   * changed is never compiled twice. The model api headers are precompiled
+   * once per marina header version and handed to every compile, a pch the
+   * compiler turns away as out of date is built again.
+   *
+   *   <cache>/obj/<key>.so
+   *   <cache>/pch/<version>/model.hxx.pch
+   */
+  class ModelCompiler
+  {
+    public:
+      ModelCompiler(std::string marina_src, std::string cache_dir,
+                    std::string compiler = "clang++");
+
+      //the shared object of a model source, throws runtime_error carrying
+      //the compiler output if it does not compile
+      std::string compile(const std::string & src);
+
+      //whether the last compile was answered from the cache
+      bool hit() const;
+
+      //the compiler, its flags and the marina headers, hashed
+      const std::string & version();
+
+    private:
+      std::vector<std::string> flags() const;
+      std::string key(const std::string & src);
+      std::string pch();
+
+      std::string mrsrc_, dir_, cxx_, version_;
+      bool hit_{false}, pch_failed_{false};
+  };
 }
 
 #endif
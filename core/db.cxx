@@ -6,6 +6,7 @@
 #include <fmt/format.h>
 #include "util.hxx"
 #include "core/db.hxx"
+#include "common/net/trace.hxx"
 
 using std::string;
 using std::vector;
@@ -53,6 +54,7 @@ void DB::connect()
 
 string DB::saveBlueprint(string project, Json src)
 {
+  Span span{"db.saveBlueprint"};
   string s{"'"+src.dump()+"'"},
          p{"'"+project+"'"};
 
@@ -86,6 +88,7 @@ string DB::saveBlueprint(string project, Json src)
 
 Blueprint DB::fetchBlueprint(string project, string bp_name)
 {
+  Span span{"db.fetchBlueprint"};
   stringstream ss;
   ss << "SELECT doc FROM blueprints where " 
      << "project = " 
@@ -111,16 +114,16 @@ Blueprint DB::fetchBlueprint(string project, string bp_name)
     throw out_of_range{"("+project+", "+bp_name+") not found"};
   }
 
-  string j{PQgetvalue(res, 0, 0)};
-
-  auto json = Json::parse(j);
+  Blueprint bp =
+    Blueprint::parse(PQgetvalue(res, 0, 0), PQgetlength(res, 0, 0));
 
   PQclear(res);
-  return Blueprint::fromJson(json);
+  return bp;
 }
 
 vector<Blueprint> DB::fetchBlueprints(string project)
 {
+  Span span{"db.fetchBlueprints"};
   string q = fmt::format(
     "SELECT doc FROM blueprints where project = "
       "(SELECT id FROM projects WHERE name = '{pname}')",
@@ -141,9 +144,8 @@ vector<Blueprint> DB::fetchBlueprints(string project)
   size_t n = PQntuples(res);
   for(size_t i=0; i<n; ++i)
   {
-    string j{PQgetvalue(res, i, 0)};
-    auto js = Json::parse(j);
-    result.push_back(Blueprint::fromJson(js)); 
+    result.push_back(
+        Blueprint::parse(PQgetvalue(res, i, 0), PQgetlength(res, i, 0)));
   }
 
   return result;
@@ -152,6 +154,7 @@ vector<Blueprint> DB::fetchBlueprints(string project)
 
 void DB::deleteBlueprint(string project, string bp_name)
 {
+  Span span{"db.deleteBlueprint"};
  
   //if we can get a materialization without error
   try
@@ -188,6 +191,7 @@ void DB::deleteBlueprint(string project, string bp_name)
 
 string DB::saveMaterialization(string project, string bpid, Json mzn)
 {
+  Span span{"db.saveMaterialization"};
   string s{"'"+mzn.dump()+"'"},
          p{"'"+project+"'"},
          b{"'"+bpid+"'"};
@@ -224,6 +228,7 @@ string DB::saveMaterialization(string project, string bpid, Json mzn)
 
 Blueprint DB::fetchMaterialization(string project, string bpid)
 {
+  Span span{"db.fetchMaterialization"};
   string p{"'"+project+"'"},
          b{"'"+bpid+"'"};
 
@@ -256,16 +261,61 @@ Blueprint DB::fetchMaterialization(string project, string bpid)
     throw out_of_range{"materialization for ("+project+", "+bpid+") not found"};
   }
 
-  Json j = Json::parse(string{PQgetvalue(res, 0, 0)});
+  Blueprint bp =
+    Blueprint::parse(PQgetvalue(res, 0, 0), PQgetlength(res, 0, 0));
 
   LOG(INFO) << "fetched materialization";
 
   PQclear(res);
-  return Blueprint::fromJson(j);
+  return bp;
+}
+
+Json DB::fetchPlacement(string project, string bpid)
+{
+  Span span{"db.fetchPlacement"};
+  string p{"'"+project+"'"},
+         b{"'"+bpid+"'"};
+
+  stringstream ss;
+  ss
+    << "SELECT doc->'placement' FROM materializations "
+    << "WHERE "
+      << "blueprint = "
+        << "(SELECT id FROM blueprints WHERE "
+          << "(doc->>'name') = "+b
+          << " AND "
+          << "project = (SELECT id FROM projects WHERE name = "+p+")"
+        << ")";
+
+  string q = ss.str();
+
+  connect();
+  PGresult *res = PQexec(conn_, q.c_str());
+  
+  if(PQresultStatus(res) != PGRES_TUPLES_OK)
+  {
+    LOG(ERROR) << "fetch placement failed";
+    LOG(ERROR) << PQerrorMessage(conn_);
+    PQclear(res);
+    throw runtime_error{"pq query failure"};
+  }
+
+  if(PQntuples(res) == 0)
+  {
+    PQclear(res);
+    throw out_of_range{"materialization for ("+project+", "+bpid+") not found"};
+  }
+
+  Json j;
+  if(!PQgetisnull(res, 0, 0)) j = Json::parse(PQgetvalue(res, 0, 0));
+
+  PQclear(res);
+  return j;
 }
 
 vector<Blueprint> DB::fetchMaterializations(string project)
 {
+  Span span{"db.fetchMaterializations"};
   string q = fmt::format(
     "SELECT doc FROM materializations where blueprint IN "
       "(SELECT id FROM blueprints WHERE project = "
@@ -288,9 +338,8 @@ vector<Blueprint> DB::fetchMaterializations(string project)
   size_t n = PQntuples(res);
   for(size_t i=0; i<n; ++i)
   {
-    string j{PQgetvalue(res, i, 0)};
-    auto js = Json::parse(j);
-    result.push_back(Blueprint::fromJson(js)); 
+    result.push_back(
+        Blueprint::parse(PQgetvalue(res, i, 0), PQgetlength(res, i, 0)));
   }
 
   return result;
@@ -298,6 +347,7 @@ vector<Blueprint> DB::fetchMaterializations(string project)
 
 void DB::deleteMaterialization(string project, string bpid)
 {
+  Span span{"db.deleteMaterialization"};
   string p{"'"+project+"'"},
          b{"'"+bpid+"'"};
 
@@ -332,6 +382,7 @@ void DB::deleteMaterialization(string project, string bpid)
       
 void DB::setHwTopo(Json topo)
 {
+  Span span{"db.setHwTopo"};
   string t{"'"+topo.dump()+"'"};
 
   stringstream ss;
@@ -358,6 +409,7 @@ void DB::setHwTopo(Json topo)
 
 TestbedTopology DB::fetchHwTopo()
 {
+  Span span{"db.fetchHwTopo"};
   string q{"SELECT doc FROM hw_topology"};
   
   connect();
@@ -393,6 +445,7 @@ void DB::deleteHwTopo()
 
 size_t DB::newVxlanVni(string netid)
 {
+  Span span{"db.newVxlanVni"};
   string q = fmt::format(
     "INSERT INTO vxlan (netid) values('{}') RETURNING vni",
     netid
@@ -416,6 +469,7 @@ size_t DB::newVxlanVni(string netid)
 
 void DB::freeVxlanVni(string netid)
 {
+  Span span{"db.freeVxlanVni"};
   string q = fmt::format(
     "DELETE FROM vxlan WHERE netid = '{}'",
     netid
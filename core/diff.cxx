@@ -0,0 +1,419 @@
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "core/diff.hxx"
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+using std::unordered_set;
+using std::out_of_range;
+using std::invalid_argument;
+using std::experimental::optional;
+using namespace marina;
+
+namespace
+{
+  //fnv-1a, folded into h
+  size_t hashBytes(size_t h, const void *data, size_t length)
+  {
+    const unsigned char *p = static_cast<const unsigned char*>(data);
+    for(size_t i=0; i<length; ++i)
+    {
+      h ^= p[i];
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  struct LinkHash
+  {
+    size_t operator()(const Link & l) const
+    {
+      size_t h = 14695981039346656037ull;
+      for(const Endpoint & e : l.endpoints)
+      {
+        h = hashBytes(h, e.id.id, sizeof(uuid_t));
+        if(e.mac) h = hashBytes(h, e.mac->data(), e.mac->size());
+      }
+      return h;
+    }
+  };
+
+  struct LinkEq
+  {
+    bool operator()(const Link & a, const Link & b) const
+    {
+      return a.endpoints[0] == b.endpoints[0] &&
+             a.endpoints[1] == b.endpoints[1];
+    }
+  };
+
+  //link -> number of times it appears
+  using LinkCount = unordered_map<Link, size_t, LinkHash, LinkEq>;
+
+  LinkCount count(const vector<Link> & links)
+  {
+    LinkCount c;
+    c.reserve(links.size());
+    for(const Link & l : links) ++c[l];
+    return c;
+  }
+
+  bool same(const IpV4Address & a, const IpV4Address & b)
+  {
+    return a.addr() == b.addr() && a.mask() == b.mask();
+  }
+
+  //embedding info is materializer state and not part of what is compared
+  bool same(const Interface & a, const Interface & b)
+  {
+    return a == b && a.mac() == b.mac();
+  }
+
+  ComputerDelta compare(const Computer & a, const Computer & b)
+  {
+    ComputerDelta d{a.id()};
+    if(a.name() != b.name()) d.name = b.name();
+    if(a.os() != b.os()) d.os = b.os();
+    if(a.memory() != b.memory()) d.memory = b.memory();
+    if(a.disk() != b.disk()) d.disk = b.disk();
+    if(a.cores() != b.cores()) d.cores = b.cores();
+
+    for(const auto & i : b.interfaces())
+    {
+      auto j = a.interfaces().find(i.first);
+      if(j == a.interfaces().end() || !same(j->second, i.second))
+        d.interfaces.push_back(i.second.clone());
+    }
+
+    for(const auto & i : a.interfaces())
+      if(b.interfaces().find(i.first) == b.interfaces().end())
+        d.removed_interfaces.push_back(i.first);
+
+    return d;
+  }
+
+  NetworkDelta compare(const Network & a, const Network & b)
+  {
+    NetworkDelta d{a.id()};
+    if(a.name() != b.name()) d.name = b.name();
+    if(a.capacity() != b.capacity()) d.capacity = b.capacity();
+    if(a.latency() != b.latency()) d.latency = b.latency();
+    if(!same(a.ipv4(), b.ipv4())) d.ipv4 = b.ipv4();
+    return d;
+  }
+
+  //adds key to j if xs has anything in it
+  template <class C>
+  void put(Json & j, const char *key, const C & xs)
+  {
+    if(!xs.empty()) j[key] = jtransform(xs);
+  }
+
+  template <class T>
+  vector<T> take(const Json & j, const char *key)
+  {
+    vector<T> xs;
+    auto i = j.find(key);
+    if(i == j.end()) return xs;
+
+    xs.reserve(i->size());
+    for(const Json & x : *i) xs.push_back(T::fromJson(x));
+    return xs;
+  }
+}
+
+// ComputerDelta ---------------------------------------------------------------
+
+bool ComputerDelta::empty() const
+{
+  return !name && !os && !memory && !disk && !cores &&
+         interfaces.empty() && removed_interfaces.empty();
+}
+
+Json ComputerDelta::json() const
+{
+  Json j;
+  j["id"] = id.json();
+  if(name) j["name"] = *name;
+  if(os) j["os"] = *os;
+  if(memory) j["memory"] = memory->json();
+  if(disk) j["disk"] = disk->json();
+  if(cores) j["cores"] = *cores;
+  put(j, "interfaces", interfaces);
+  if(!removed_interfaces.empty()) j["removed_interfaces"] = removed_interfaces;
+  return j;
+}
+
+ComputerDelta ComputerDelta::fromJson(Json j)
+{
+  ComputerDelta d{Uuid::fromJson(extract(j, "id", "computer-delta"))};
+
+  auto i = j.find("name");
+  if(i != j.end()) d.name = i->get<string>();
+  if((i = j.find("os")) != j.end()) d.os = i->get<string>();
+  if((i = j.find("memory")) != j.end()) d.memory = Memory::fromJson(*i);
+  if((i = j.find("disk")) != j.end()) d.disk = Memory::fromJson(*i);
+  if((i = j.find("cores")) != j.end()) d.cores = i->get<size_t>();
+
+  d.interfaces = take<Interface>(j, "interfaces");
+  if((i = j.find("removed_interfaces")) != j.end())
+    d.removed_interfaces = i->get<vector<string>>();
+
+  return d;
+}
+
+// NetworkDelta ----------------------------------------------------------------
+
+bool NetworkDelta::empty() const
+{
+  return !name && !capacity && !latency && !ipv4;
+}
+
+Json NetworkDelta::json() const
+{
+  Json j;
+  j["id"] = id.json();
+  if(name) j["name"] = *name;
+  if(capacity) j["capacity"] = capacity->json();
+  if(latency) j["latency"] = latency->json();
+  if(ipv4) j["ipv4"] = ipv4->json();
+  return j;
+}
+
+NetworkDelta NetworkDelta::fromJson(Json j)
+{
+  NetworkDelta d{Uuid::fromJson(extract(j, "id", "network-delta"))};
+
+  auto i = j.find("name");
+  if(i != j.end()) d.name = i->get<string>();
+  if((i = j.find("capacity")) != j.end()) d.capacity = Bandwidth::fromJson(*i);
+  if((i = j.find("latency")) != j.end()) d.latency = Latency::fromJson(*i);
+  if((i = j.find("ipv4")) != j.end()) d.ipv4 = IpV4Address::fromJson(*i);
+
+  return d;
+}
+
+// BlueprintDiff ---------------------------------------------------------------
+
+BlueprintDiff marina::diff(const Blueprint & from, const Blueprint & to)
+{
+  BlueprintDiff d;
+  if(from.name() != to.name()) d.name = to.name();
+
+  for(const auto & c : to.computers())
+  {
+    auto i = from.computers().find(c.first);
+    if(i == from.computers().end())
+    {
+      d.added_computers.push_back(c.second.clone());
+      continue;
+    }
+    ComputerDelta cd = compare(i->second, c.second);
+    if(!cd.empty()) d.changed_computers.push_back(cd);
+  }
+  for(const auto & c : from.computers())
+    if(to.computers().find(c.first) == to.computers().end())
+      d.removed_computers.push_back(c.first);
+
+  for(const auto & n : to.networks())
+  {
+    auto i = from.networks().find(n.first);
+    if(i == from.networks().end())
+    {
+      d.added_networks.push_back(n.second.clone());
+      continue;
+    }
+    NetworkDelta nd = compare(i->second, n.second);
+    if(!nd.empty()) d.changed_networks.push_back(nd);
+  }
+  for(const auto & n : from.networks())
+    if(to.networks().find(n.first) == to.networks().end())
+      d.removed_networks.push_back(n.first);
+
+  //whatever is left over on either side after matching up the counts
+  LinkCount links = count(from.links());
+  for(const Link & l : to.links())
+  {
+    auto i = links.find(l);
+    if(i != links.end() && i->second > 0) --i->second;
+    else d.added_links.push_back(l);
+  }
+  for(const Link & l : from.links())
+  {
+    auto i = links.find(l);
+    if(i->second > 0)
+    {
+      --i->second;
+      d.removed_links.push_back(l);
+    }
+  }
+
+  return d;
+}
+
+bool BlueprintDiff::empty() const
+{
+  return !name &&
+    added_computers.empty() && changed_computers.empty() &&
+    removed_computers.empty() &&
+    added_networks.empty() && changed_networks.empty() &&
+    removed_networks.empty() &&
+    added_links.empty() && removed_links.empty();
+}
+
+void BlueprintDiff::apply(Blueprint & bp) const
+{
+  auto & computers = bp.computers();
+  auto & networks = bp.networks();
+
+  auto computer = [&computers](const Uuid & id) -> Computer &
+  {
+    auto i = computers.find(id);
+    if(i == computers.end())
+      throw out_of_range{"patch: no computer with id " + id.str()};
+    return i->second;
+  };
+
+  auto network = [&networks](const Uuid & id) -> Network &
+  {
+    auto i = networks.find(id);
+    if(i == networks.end())
+      throw out_of_range{"patch: no network with id " + id.str()};
+    return i->second;
+  };
+
+  //check everything first so a failed patch leaves the blueprint alone
+  for(const Uuid & id : removed_computers) computer(id);
+  for(const ComputerDelta & c : changed_computers) computer(c.id);
+  for(const Uuid & id : removed_networks) network(id);
+  for(const NetworkDelta & n : changed_networks) network(n.id);
+
+  //an added node must not clash with one the patch leaves in place
+  auto kept = [](const vector<Uuid> & removed, const Uuid & id)
+  {
+    return std::find(removed.begin(), removed.end(), id) == removed.end();
+  };
+  for(const Computer & c : added_computers)
+    if(computers.count(c.id()) && kept(removed_computers, c.id()))
+      throw invalid_argument{"patch: already a computer with id " + 
+          c.id().str()};
+  for(const Network & n : added_networks)
+    if(networks.count(n.id()) && kept(removed_networks, n.id()))
+      throw invalid_argument{"patch: already a network with id " + 
+          n.id().str()};
+
+  //every removed link must be there, as often as it is removed
+  LinkCount gone = count(removed_links);
+  if(!gone.empty())
+  {
+    LinkCount there = count(bp.links());
+    for(const auto & g : gone)
+    {
+      auto i = there.find(g.first);
+      if(i == there.end() || i->second < g.second)
+        throw out_of_range{"patch: no link " + g.first.json().dump()};
+    }
+  }
+
+  if(name) bp.name(*name);
+
+  for(const Uuid & id : removed_computers) computers.erase(id);
+  for(const Computer & c : added_computers)
+    computers.insert_or_assign(c.id(), c.clone());
+
+  for(const ComputerDelta & cd : changed_computers)
+  {
+    Computer & c = computer(cd.id);
+    if(cd.name) c.name(*cd.name);
+    if(cd.os) c.os(*cd.os);
+    if(cd.memory) c.memory(*cd.memory);
+    if(cd.disk) c.disk(*cd.disk);
+    if(cd.cores) c.cores(*cd.cores);
+    for(const string & x : cd.removed_interfaces) c.interfaces().erase(x);
+    for(const Interface & x : cd.interfaces)
+      c.interfaces().insert_or_assign(x.name(), x.clone());
+  }
+
+  for(const Uuid & id : removed_networks) networks.erase(id);
+  for(const Network & n : added_networks)
+    networks.insert_or_assign(n.id(), n.clone());
+
+  for(const NetworkDelta & nd : changed_networks)
+  {
+    Network & n = network(nd.id);
+    if(nd.name) n.name(*nd.name);
+    if(nd.capacity) n.capacity(*nd.capacity);
+    if(nd.latency) n.latency(*nd.latency);
+    if(nd.ipv4) n.ipv4(*nd.ipv4);
+  }
+
+  if(removed_links.empty() && added_links.empty()) return;
+
+  vector<Link> links;
+  links.reserve(bp.links().size() + added_links.size());
+  for(const Link & l : bp.links())
+  {
+    auto i = gone.find(l);
+    if(i != gone.end() && i->second > 0) --i->second;
+    else links.push_back(l);
+  }
+  links.insert(links.end(), added_links.begin(), added_links.end());
+  bp.links(std::move(links));
+}
+
+Json BlueprintDiff::json() const
+{
+  Json j = Json::object();
+  if(name) j["name"] = *name;
+
+  Json cs = Json::object();
+  put(cs, "added", added_computers);
+  put(cs, "changed", changed_computers);
+  put(cs, "removed", removed_computers);
+  if(!cs.empty()) j["computers"] = cs;
+
+  Json ns = Json::object();
+  put(ns, "added", added_networks);
+  put(ns, "changed", changed_networks);
+  put(ns, "removed", removed_networks);
+  if(!ns.empty()) j["networks"] = ns;
+
+  Json ls = Json::object();
+  put(ls, "added", added_links);
+  put(ls, "removed", removed_links);
+  if(!ls.empty()) j["links"] = ls;
+
+  return j;
+}
+
+BlueprintDiff BlueprintDiff::fromJson(Json j)
+{
+  BlueprintDiff d;
+  auto i = j.find("name");
+  if(i != j.end()) d.name = i->get<string>();
+
+  if((i = j.find("computers")) != j.end())
+  {
+    d.added_computers = take<Computer>(*i, "added");
+    d.changed_computers = take<ComputerDelta>(*i, "changed");
+    d.removed_computers = take<Uuid>(*i, "removed");
+  }
+
+  if((i = j.find("networks")) != j.end())
+  {
+    d.added_networks = take<Network>(*i, "added");
+    d.changed_networks = take<NetworkDelta>(*i, "changed");
+    d.removed_networks = take<Uuid>(*i, "removed");
+  }
+
+  if((i = j.find("links")) != j.end())
+  {
+    d.added_links = take<Link>(*i, "added");
+    d.removed_links = take<Link>(*i, "removed");
+  }
+
+  return d;
+}
@@ -0,0 +1,96 @@
+#ifndef MARINA_CORE_DIFF_HXX
+#define MARINA_CORE_DIFF_HXX
+
+#include <vector>
+#include <string>
+#include <experimental/optional>
+#include "core/blueprint.hxx"
+
+/*
+ * Structured deltas between two versions of a blueprint.
+ *
+ * Computers and networks are matched by id, interfaces by name within their
+ * computer and links by their endpoints, all through hash tables so a diff
+ * is linear in the size of the two blueprints. Added nodes are carried
+ * whole, changed ones only carry the fields that differ. A diff serializes
+ * to a json patch that leaves out everything that did not change, and
+ * applying it to the blueprint it was taken from yields the other one.
+ */
+
+namespace marina
+{
+  // ComputerDelta -------------------------------------------------------------
+
+  //the fields of a computer that differ, unset ones are the same on both sides
+  struct ComputerDelta
+  {
+    ComputerDelta() = default;
+    ComputerDelta(Uuid id) : id{id} {}
+
+    Uuid id;
+    std::experimental::optional<std::string> name, os;
+    std::experimental::optional<Memory> memory, disk;
+    std::experimental::optional<size_t> cores;
+
+    //added or changed interfaces are carried whole
+    std::vector<Interface> interfaces;
+    std::vector<std::string> removed_interfaces;
+
+    bool empty() const;
+
+    Json json() const;
+    static ComputerDelta fromJson(Json);
+  };
+
+  // NetworkDelta --------------------------------------------------------------
+
+  struct NetworkDelta
+  {
+    NetworkDelta() = default;
+    NetworkDelta(Uuid id) : id{id} {}
+
+    Uuid id;
+    std::experimental::optional<std::string> name;
+    std::experimental::optional<Bandwidth> capacity;
+    std::experimental::optional<Latency> latency;
+    std::experimental::optional<IpV4Address> ipv4;
+
+    bool empty() const;
+
+    Json json() const;
+    static NetworkDelta fromJson(Json);
+  };
+
+  // BlueprintDiff -------------------------------------------------------------
+
+  struct BlueprintDiff
+  {
+    std::experimental::optional<std::string> name;
+
+    std::vector<Computer> added_computers;
+    std::vector<ComputerDelta> changed_computers;
+    std::vector<Uuid> removed_computers;
+
+    std::vector<Network> added_networks;
+    std::vector<NetworkDelta> changed_networks;
+    std::vector<Uuid> removed_networks;
+
+    //links are a multiset, a link that appears twice is added twice
+    std::vector<Link> added_links, removed_links;
+
+    bool empty() const;
+
+    //turns the blueprint the diff was taken from into the one it was taken
+    //to, throws out_of_range if a node or link the diff changes or removes
+    //is not there and invalid_argument if a node it adds already is
+    void apply(Blueprint &) const;
+
+    Json json() const;
+    static BlueprintDiff fromJson(Json);
+  };
+
+  //what it takes to turn from into to
+  BlueprintDiff diff(const Blueprint & from, const Blueprint & to);
+}
+
+#endif
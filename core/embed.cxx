@@ -1,7 +1,9 @@
 #include "embed.hxx"
 #include "topo.hxx"
+#include "frozen.hxx"
 #include "3p/pipes/pipes.hxx"
 #include "common/net/glog.hxx"
+#include "common/net/trace.hxx"
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
@@ -10,6 +12,7 @@
 using std::vector;
 using std::sort;
 using std::make_pair;
+using std::pair;
 using std::unordered_map;
 using std::string;
 using std::runtime_error;
@@ -139,6 +142,7 @@ LoadVector HostEmbedding::load() const
     | reduce(plus);
 
   v.mem.total = host.memory().megabytes();
+  if(!numa_free_mb.empty()) v.mem.total = numa_free_mb | reduce(plus);
   v.mem.used = machines
     | map<vector>([](auto x){ return x.second.memory().megabytes(); })
     | reduce(plus);
@@ -158,6 +162,29 @@ LoadVector HostEmbedding::load() const
   return v;
 }
 
+bool HostEmbedding::fits() const
+{
+  if(load().overloaded()) return false;
+  if(numa_free_mb.empty()) return true;
+
+  //largest machines first, each onto the node it fills up the most
+  auto mems = machines
+    | map<vector>([](const auto & x){ return x.second.memory().megabytes(); })
+    | sort([](size_t x, size_t y){ return x > y; });
+
+  vector<size_t> free = numa_free_mb;
+  for(size_t m : mems)
+  {
+    auto best = free.end();
+    for(auto i = free.begin(); i != free.end(); ++i)
+      if(*i >= m && (best == free.end() || *i < *best)) best = i;
+
+    if(best == free.end()) return false;
+    *best -= m;
+  }
+  return true;
+}
+
 HostEmbedding HostEmbedding::operator+(Computer c)
 {
   HostEmbedding x = *this;
@@ -246,7 +273,7 @@ void pack(HostEmbedding & he, vector<Computer> & cs)
   while(!cs.empty())
   {
     he = he + cs.back();
-    if(he.load().overloaded()) 
+    if(!he.fits()) 
     {
       he = he - cs.back();
       break;
@@ -257,31 +284,35 @@ void pack(HostEmbedding & he, vector<Computer> & cs)
 
 EChart marina::embed(Blueprint b, EChart e, TestbedTopology tt)
 {
+  Span span{"embed"};
+  span.arg("blueprint", b.name());
+
+  //the blueprint and topology are walked by index rather than through the
+  //handle maps
+  FrozenBlueprint fb{b};
+  FrozenTopology ft{tt};
 
   //sort the networks from largest to smallest
-  auto nets = b.networks()
-    | map<vector>([b](const auto &x)
-      { 
-        return make_pair(x.second, b.connectedComputers(x.second)); 
-      })
-    | sort([b](const auto & x, const auto & y)
+  vector<pair<uint32_t, vector<pair<uint32_t, uint32_t>>>> nets;
+  for(uint32_t i=0; i<fb.networks().size(); ++i)
+    nets.push_back(make_pair(i, fb.connectedComputers(i)));
+
+  sort(nets.begin(), nets.end(),
+      [](const auto & x, const auto & y)
       { 
         return x.second.size() > y.second.size();
       });
 
   //create a vector of computers in the above network sorted order
   vector<Computer> cs;
+  vector<bool> taken(fb.computers().size());
   for(const auto & n : nets)
   {
     for(const auto & c : n.second)
     {
-      auto i = find_if(cs.begin(), cs.end(),
-          [c](const auto & ix)
-          {
-            return ix.id() == c.first.id();
-          });
-
-      if(i == cs.end()) cs.push_back(c.first);
+      if(taken[c.first]) continue;
+      taken[c.first] = true;
+      cs.push_back(b.computers().at(fb.computers()[c.first].id));
     }
   }
 
@@ -325,9 +356,13 @@ EChart marina::embed(Blueprint b, EChart e, TestbedTopology tt)
   {
     while(!cs.empty())
     {
+      //hosts that reported where their tunnels end go first, networks
+      //can only span those
       sort(p.second.begin(), p.second.end(),
         [](const auto & x, const auto & y) 
         { 
+          bool tx = !x.tunnel_addr.empty(), ty = !y.tunnel_addr.empty();
+          if(tx != ty) return tx;
           return x.load().free_norm() > y.load().free_norm();
         });
 
@@ -342,16 +377,29 @@ EChart marina::embed(Blueprint b, EChart e, TestbedTopology tt)
 
   if(!cs.empty()) throw runtime_error{"embedding failed"};
 
-  for(auto nw : b.networks())
+  //the host each computer landed on
+  UuidMap<Uuid> placed;
+  for(const auto & h : e.hmap)
+    for(const auto & m : h.second.machines) placed[m.first] = h.first;
+
+  for(uint32_t ni=0; ni<fb.networks().size(); ++ni)
   {
+    const Network & nw = b.networks().at(fb.networks()[ni].id);
+
     unordered_map<Uuid, size_t, UuidHash, UuidCmp> swc;
-    auto cxs = b.connectedComputers(nw.second);
-    for(const auto & p : cxs)
+    for(const auto & p : fb.connectedComputers(ni))
     {
-      const Computer & c = p.first;
-      auto he = e.getEmbedding(c);
-      auto sws = tt.connectedSwitches(he.host);
-      for(auto s : sws) swc[s.id()]++;
+      const FrozenComputer & c = fb.computers()[p.first];
+      auto h = placed.find(c.id);
+      if(h == placed.end())
+        throw out_of_range{
+          fb.str(c.name)+"("+c.id.str()+") not found in echart"
+        };
+
+      Vertex v = ft.vertex(h->second);
+      if(v == no_vertex) continue;
+      for(uint32_t s : ft.connectedSwitches(ft.hostIndex(v)))
+        swc[ft.switches()[s].id]++;
     }
 
     for(auto p : swc)
@@ -363,7 +411,7 @@ EChart marina::embed(Blueprint b, EChart e, TestbedTopology tt)
           throw runtime_error{"unknown switch id: " + p.first.str()};
 
         SwitchEmbedding swe = i->second;
-        swe.networks.insert_or_assign(nw.second.id(), nw.second);
+        swe.networks.insert_or_assign(nw.id(), nw);
         e.smap.insert_or_assign(swe.sw.id(), swe);
       }
     }
@@ -374,6 +422,9 @@ EChart marina::embed(Blueprint b, EChart e, TestbedTopology tt)
 
 EChart marina::unembed(Blueprint bp, EChart ec)
 {
+  Span span{"unembed"};
+  span.arg("blueprint", bp.name());
+
   for(const auto & c : bp.computers())
   {
     auto e = ec.getEmbedding(c.second);
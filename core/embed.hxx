@@ -34,7 +34,19 @@ struct HostEmbedding
   Host host;
   std::unordered_map<Uuid, Computer, UuidHash, UuidCmp> machines;
 
+  //hugepage memory the host reports free on each of its numa nodes, empty
+  //if the host has not reported and its declared memory is all there is
+  std::vector<size_t> numa_free_mb;
+
+  //the data plane address vxlan tunnels to the host end at, empty if the
+  //host has not reported it
+  std::string tunnel_addr;
+
   LoadVector load() const;
+
+  //not overloaded, and the memory of every machine fits on a single node
+  bool fits() const;
+
   HostEmbedding operator+(Computer);
   HostEmbedding operator-(Computer);
 };
@@ -0,0 +1,566 @@
+#include <spawn.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "core/exec.hxx"
+#include "common/net/trace.hxx"
+
+extern char **environ;
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::shared_ptr;
+using std::make_shared;
+using std::promise;
+using std::future;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::thread;
+using std::runtime_error;
+using std::pair;
+using namespace std::chrono;
+using namespace marina;
+
+// Command ---------------------------------------------------------------------
+
+Command Command::shell(string script, milliseconds timeout)
+{
+  return Command{{"/bin/sh", "-c", script}, timeout};
+}
+
+string Command::program() const
+{
+  if(argv.empty()) return "";
+
+  //for shell commands the interesting program is the first one in the script
+  string p = argv[0];
+  if(argv.size() == 3 && p == "/bin/sh" && argv[1] == "-c")
+  {
+    string s = argv[2];
+    size_t b = s.find_first_not_of(" \t\n");
+    if(b == string::npos) return "sh";
+    p = s.substr(b, s.find_first_of(" \t\n;|&", b) - b);
+  }
+  return p.substr(p.find_last_of('/') + 1);
+}
+
+string Command::str() const
+{
+  if(argv.size() == 3 && argv[0] == "/bin/sh" && argv[1] == "-c")
+    return argv[2];
+
+  string s;
+  for(const string & a : argv) s += (s.empty() ? "" : " ") + a;
+  return s;
+}
+
+// SpawnBackend ----------------------------------------------------------------
+
+struct SpawnBackend::Child
+{
+  pid_t pid;
+  Done done;
+  string output;
+  steady_clock::time_point start, deadline;
+  bool has_deadline{false}, timed_out{false};
+
+  //the output is closed and the child is waited for through its pidfd, or
+  //polled if there is none
+  bool closed{false};
+};
+
+namespace
+{
+  //-1 where the kernel has no pidfds
+  int pidfdOpen(pid_t pid)
+  {
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+  }
+
+  //reaps a child without blocking, false while it is still running
+  bool reaped(pid_t pid, int & status)
+  {
+    pid_t r;
+    while((r = waitpid(pid, &status, WNOHANG)) < 0 && errno == EINTR);
+    if(r < 0) status = 0;
+    return r != 0;
+  }
+}
+
+SpawnBackend::SpawnBackend()
+{
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  wakefd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if(epfd_ < 0 || wakefd_ < 0)
+    throw runtime_error{"exec: unable to create event loop"};
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = wakefd_;
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev);
+
+  loop_ = thread{[this](){ loop(); }};
+}
+
+SpawnBackend::~SpawnBackend()
+{
+  {
+    lock_guard<mutex> lk{mtx_};
+    stop_ = true;
+  }
+  uint64_t one{1};
+  (void)write(wakefd_, &one, sizeof(one));
+  loop_.join();
+
+  for(auto & c : children_)
+  {
+    kill(-c.second->pid, SIGKILL);
+    waitpid(c.second->pid, nullptr, 0);
+    close(c.first);
+    c.second->done(CmdResult{"exec: executor shut down", -1});
+  }
+  for(auto & c : exiting_)
+  {
+    kill(-c->pid, SIGKILL);
+    waitpid(c->pid, nullptr, 0);
+    c->done(CmdResult{"exec: executor shut down", -1});
+  }
+
+  close(wakefd_);
+  close(epfd_);
+}
+
+void SpawnBackend::start(const Command & cmd, Done done)
+{
+  if(cmd.argv.empty())
+  {
+    done(CmdResult{"exec: empty command", 127});
+    return;
+  }
+
+  int fds[2];
+  if(pipe2(fds, O_CLOEXEC) < 0)
+  {
+    done(CmdResult{"exec: pipe: " + string{strerror(errno)}, 127});
+    return;
+  }
+
+  //stdout and stderr both go to the pipe, stdin is empty
+  posix_spawn_file_actions_t fa;
+  posix_spawn_file_actions_init(&fa);
+  posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2(&fa, fds[1], 1);
+  posix_spawn_file_actions_adddup2(&fa, fds[1], 2);
+
+  //each child leads its own process group so a timeout takes out the whole
+  //tree, and starts off with default signal handling
+  posix_spawnattr_t at;
+  posix_spawnattr_init(&at);
+  sigset_t none, all;
+  sigemptyset(&none);
+  sigfillset(&all);
+  posix_spawnattr_setsigmask(&at, &none);
+  posix_spawnattr_setsigdefault(&at, &all);
+  posix_spawnattr_setpgroup(&at, 0);
+  posix_spawnattr_setflags(&at,
+      POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  vector<char*> argv;
+  for(const string & a : cmd.argv) argv.push_back(const_cast<char*>(a.c_str()));
+  argv.push_back(nullptr);
+
+  auto child = unique_ptr<Child>{new Child};
+  child->done = done;
+  child->start = steady_clock::now();
+  if(cmd.timeout.count() > 0)
+  {
+    child->has_deadline = true;
+    child->deadline = child->start + cmd.timeout;
+  }
+
+  int rc = posix_spawnp(&child->pid, argv[0], &fa, &at, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&fa);
+  posix_spawnattr_destroy(&at);
+  close(fds[1]);
+
+  if(rc != 0)
+  {
+    close(fds[0]);
+    done(CmdResult{"exec: " + cmd.argv[0] + ": " + strerror(rc), 127});
+    return;
+  }
+
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+  {
+    lock_guard<mutex> lk{mtx_};
+    children_[fds[0]] = std::move(child);
+  }
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fds[0];
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, fds[0], &ev);
+
+  //the loop may need to pick up a new deadline
+  uint64_t one{1};
+  (void)write(wakefd_, &one, sizeof(one));
+}
+
+void SpawnBackend::finish(unique_ptr<Child> c, int status)
+{
+  CmdResult result;
+  result.output = std::move(c->output);
+  result.timed_out = c->timed_out;
+  result.code = WIFEXITED(status) ? WEXITSTATUS(status) :
+                                    128 + WTERMSIG(status);
+  result.duration =
+    duration_cast<microseconds>(steady_clock::now() - c->start);
+  c->done(std::move(result));
+}
+
+unique_ptr<SpawnBackend::Child> SpawnBackend::take(int fd)
+{
+  lock_guard<mutex> lk{mtx_};
+  auto it = children_.find(fd);
+  unique_ptr<Child> c = std::move(it->second);
+  children_.erase(it);
+  return c;
+}
+
+void SpawnBackend::loop()
+{
+  epoll_event evs[64];
+  char buf[65536];
+
+  for(;;)
+  {
+    int timeout{-1};
+    {
+      lock_guard<mutex> lk{mtx_};
+      if(stop_) return;
+
+      auto now = steady_clock::now();
+      auto upto = [&timeout, now](const Child & c)
+      {
+        if(!c.has_deadline || c.timed_out) return;
+        int ms = std::max<int64_t>(0,
+            duration_cast<milliseconds>(c.deadline - now).count() + 1);
+        timeout = timeout < 0 ? ms : std::min(timeout, ms);
+      };
+      for(const auto & c : children_) upto(*c.second);
+      for(const auto & c : exiting_) upto(*c);
+
+      //children without a pidfd are polled for their exit
+      if(!exiting_.empty()) timeout = timeout < 0 ? 10 : std::min(timeout, 10);
+    }
+
+    int n = epoll_wait(epfd_, evs, 64, timeout);
+    if(n < 0 && errno != EINTR) return;
+
+    for(int i=0; i<n; ++i)
+    {
+      int fd = evs[i].data.fd;
+      if(fd == wakefd_)
+      {
+        uint64_t x;
+        (void)read(wakefd_, &x, sizeof(x));
+        continue;
+      }
+
+      //only this thread takes children out, the pointer stays good
+      Child *ch{nullptr};
+      {
+        lock_guard<mutex> lk{mtx_};
+        auto it = children_.find(fd);
+        if(it != children_.end()) ch = it->second.get();
+      }
+      if(ch == nullptr) continue;
+
+      int status{0};
+
+      //the pidfd of a child that closed its output earlier, it has exited
+      if(ch->closed)
+      {
+        if(!reaped(ch->pid, status)) continue;
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        finish(take(fd), status);
+        continue;
+      }
+
+      //drain whatever is there, the child is done once its output closes
+      bool eof{false};
+      for(;;)
+      {
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if(r > 0) { ch->output.append(buf, r); continue; }
+        if(r < 0 && errno == EINTR) continue;
+        eof = r == 0 || errno != EAGAIN;
+        break;
+      }
+      if(!eof) continue;
+
+      epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+      close(fd);
+      unique_ptr<Child> c = take(fd);
+
+      if(reaped(c->pid, status)) { finish(std::move(c), status); continue; }
+
+      //a child that handed off its output and kept running is waited for
+      //without holding up everything else this thread services
+      c->closed = true;
+      int pidfd = pidfdOpen(c->pid);
+      lock_guard<mutex> lk{mtx_};
+      if(pidfd < 0) { exiting_.push_back(std::move(c)); continue; }
+
+      children_[pidfd] = std::move(c);
+      epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.fd = pidfd;
+      epoll_ctl(epfd_, EPOLL_CTL_ADD, pidfd, &ev);
+    }
+
+    vector<pair<unique_ptr<Child>, int>> exited;
+    {
+      lock_guard<mutex> lk{mtx_};
+      for(auto it = exiting_.begin(); it != exiting_.end(); )
+      {
+        int status{0};
+        if(!reaped((*it)->pid, status)) { ++it; continue; }
+        exited.emplace_back(std::move(*it), status);
+        it = exiting_.erase(it);
+      }
+
+      //anything past its deadline gets killed, its pipe closes or it exits
+      //shortly after
+      auto now = steady_clock::now();
+      auto expire = [now](Child & ch)
+      {
+        if(ch.has_deadline && !ch.timed_out && ch.deadline <= now)
+        {
+          kill(-ch.pid, SIGKILL);
+          ch.timed_out = true;
+        }
+      };
+      for(auto & c : children_) expire(*c.second);
+      for(auto & c : exiting_) expire(*c);
+    }
+    for(auto & x : exited) finish(std::move(x.first), x.second);
+  }
+}
+
+// FakeBackend -----------------------------------------------------------------
+
+struct FakeBackend::Pending
+{
+  CmdResult result;
+  Done done;
+};
+
+FakeBackend::FakeBackend(Handler handler, microseconds latency)
+  : handler_{handler},
+    latency_{latency}
+{
+  timer_ = thread{[this]()
+  {
+    unique_lock<mutex> lk{mtx_};
+    for(;;)
+    {
+      if(stop_) return;
+      if(pending_.empty()) { cv_.wait(lk); continue; }
+
+      auto due = pending_.begin()->first;
+      if(steady_clock::now() < due) { cv_.wait_until(lk, due); continue; }
+
+      Pending p = std::move(pending_.begin()->second);
+      pending_.erase(pending_.begin());
+      lk.unlock();
+      p.done(std::move(p.result));
+      lk.lock();
+    }
+  }};
+}
+
+FakeBackend::~FakeBackend()
+{
+  {
+    lock_guard<mutex> lk{mtx_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  timer_.join();
+}
+
+void FakeBackend::start(const Command & cmd, Done done)
+{
+  CmdResult r = handler_ ? handler_(cmd) : CmdResult{};
+  r.duration = latency_;
+
+  {
+    lock_guard<mutex> lk{mtx_};
+    pending_.emplace(steady_clock::now() + latency_, Pending{r, done});
+  }
+  cv_.notify_all();
+}
+
+// Executor --------------------------------------------------------------------
+
+Executor::Executor(unique_ptr<ExecBackend> backend, size_t max_in_flight)
+  : max_in_flight_{std::max<size_t>(max_in_flight, 1)},
+    backend_{backend ? std::move(backend) : 
+                       unique_ptr<ExecBackend>{new SpawnBackend}}
+{}
+
+Executor & Executor::global()
+{
+  static Executor e;
+  return e;
+}
+
+void Executor::maxInFlight(size_t n)
+{
+  lock_guard<mutex> lk{mtx_};
+  max_in_flight_ = std::max<size_t>(n, 1);
+}
+
+void Executor::backend(unique_ptr<ExecBackend> b)
+{
+  //meant for startup, commands in flight on the old backend are cut short
+  auto fresh = shared_ptr<ExecBackend>{
+    b ? std::move(b) : unique_ptr<ExecBackend>{new SpawnBackend}};
+
+  lock_guard<mutex> lk{mtx_};
+  backend_ = fresh;
+}
+
+future<CmdResult> Executor::submit(Command cmd)
+{
+  Queued q{cmd, make_shared<promise<CmdResult>>(), steady_clock::now()};
+  auto f = q.result->get_future();
+
+  {
+    lock_guard<mutex> lk{mtx_};
+    if(in_flight_ >= max_in_flight_)
+    {
+      queue_.push_back(std::move(q));
+      return f;
+    }
+    in_flight_++;
+  }
+
+  launch(std::move(q));
+  return f;
+}
+
+CmdResult Executor::run(Command cmd)
+{
+  return submit(cmd).get();
+}
+
+void Executor::launch(Queued q)
+{
+  queue_wait_.record(
+      duration_cast<microseconds>(steady_clock::now() - q.queued).count());
+
+  shared_ptr<ExecBackend> be;
+  {
+    lock_guard<mutex> lk{mtx_};
+    be = backend_;
+  }
+
+  Command cmd = q.cmd;
+  auto result = q.result;
+  be->start(cmd, [this, cmd, result](CmdResult r)
+  {
+    finished(cmd, r);
+    result->set_value(std::move(r));
+
+    //hand the slot straight to the next command in line
+    Queued next;
+    {
+      lock_guard<mutex> lk{mtx_};
+      if(queue_.empty())
+      {
+        in_flight_--;
+        return;
+      }
+      next = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    launch(std::move(next));
+  });
+}
+
+void Executor::finished(const Command & cmd, const CmdResult & r)
+{
+  lock_guard<mutex> lk{mtx_};
+  auto & s = stats_[cmd.program()];
+  if(!s) s.reset(new ProgramStats);
+  s->duration.record(r.duration.count());
+  if(r.code != 0) s->failures++;
+  if(r.timed_out) s->timeouts++;
+}
+
+Json Executor::stats()
+{
+  lock_guard<mutex> lk{mtx_};
+
+  Json j;
+  j["in_flight"] = in_flight_;
+  j["queued"] = queue_.size();
+  j["max_in_flight"] = max_in_flight_;
+  j["queue_wait_p99_ms"] = queue_wait_.percentile(99) / 1e3;
+
+  j["programs"] = Json::object();
+  for(const auto & p : stats_)
+  {
+    const ProgramStats & s = *p.second;
+    Json x;
+    x["count"] = s.duration.count();
+    x["failures"] = s.failures;
+    x["timeouts"] = s.timeouts;
+    x["total_ms"] = s.duration.sum() / 1e3;
+    x["p50_ms"] = s.duration.percentile(50) / 1e3;
+    x["p99_ms"] = s.duration.percentile(99) / 1e3;
+    x["max_ms"] = s.duration.max() / 1e3;
+    j["programs"][p.first] = x;
+  }
+  return j;
+}
+
+// exec ------------------------------------------------------------------------
+
+CmdResult marina::exec(Command cmd)
+{
+  Span span{"exec"};
+  span.arg("cmd", cmd.str());
+
+  CmdResult result = Executor::global().run(cmd);
+
+  span.arg("code", std::to_string(result.code));
+  if(result.timed_out) span.arg("timed_out", "true");
+  return result;
+}
+
+CmdResult marina::exec(string cmd)
+{
+  return exec(Command::shell(cmd));
+}
@@ -0,0 +1,174 @@
+#ifndef MARINA_CORE_EXEC_HXX
+#define MARINA_CORE_EXEC_HXX
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include "3p/json/src/json.hpp"
+#include "common/net/metrics.hxx"
+
+namespace marina
+{
+  using Json = nlohmann::json;
+
+  struct CmdResult
+  {
+    std::string output;
+    int code{0};
+    bool timed_out{false};
+    std::chrono::microseconds duration{0};
+  };
+
+  /*
+   * A command to run. Commands are argv vectors run directly, a shell is only
+   * involved when explicitly asked for.
+   */
+  struct Command
+  {
+    std::vector<std::string> argv;
+
+    //0 means no timeout, a command that runs over is killed
+    std::chrono::milliseconds timeout{0};
+
+    static Command shell(std::string script,
+                         std::chrono::milliseconds timeout = {});
+
+    //the program name used to group metrics
+    std::string program() const;
+    std::string str() const;
+  };
+
+  /*
+   * Something that can run commands. start returns immediately and calls
+   * done exactly once from a backend thread when the command completes.
+   */
+  class ExecBackend
+  {
+    public:
+      using Done = std::function<void(CmdResult)>;
+
+      virtual ~ExecBackend() {}
+      virtual void start(const Command &, Done) = 0;
+  };
+
+  /*
+   * Runs commands with posix_spawn, no fork of the calling process and no
+   * shell. Output pipes, exits and timeouts are serviced by a single epoll
+   * thread that never blocks on a child, a child that closes its output but
+   * keeps running is waited for through its pidfd.
+   */
+  class SpawnBackend : public ExecBackend
+  {
+    public:
+      SpawnBackend();
+      ~SpawnBackend() override;
+
+      void start(const Command &, Done) override;
+
+    private:
+      struct Child;
+
+      void loop();
+      void finish(std::unique_ptr<Child>, int status);
+      std::unique_ptr<Child> take(int fd);
+
+      //keyed by output fd, or by pidfd once the output closed
+      std::map<int, std::unique_ptr<Child>> children_;
+      //closed their output with no pidfd to wait on, polled
+      std::vector<std::unique_ptr<Child>> exiting_;
+      std::mutex mtx_;
+      int epfd_{-1}, wakefd_{-1};
+      bool stop_{false};
+      std::thread loop_;
+  };
+
+  /*
+   * Answers commands from a function after a simulated latency, for tests and
+   * benchmarks of code that runs commands
+   */
+  class FakeBackend : public ExecBackend
+  {
+    public:
+      using Handler = std::function<CmdResult(const Command &)>;
+
+      FakeBackend(Handler, std::chrono::microseconds latency = {});
+      ~FakeBackend() override;
+
+      void start(const Command &, Done) override;
+
+    private:
+      struct Pending;
+      Handler handler_;
+      std::chrono::microseconds latency_;
+      std::multimap<std::chrono::steady_clock::time_point, Pending> pending_;
+      std::mutex mtx_;
+      std::condition_variable cv_;
+      bool stop_{false};
+      std::thread timer_;
+  };
+
+  /*
+   * Runs commands on a backend with a bound on how many are in flight at
+   * once, commands beyond the bound queue up. Exit status and duration of
+   * every command are accounted per program.
+   */
+  class Executor
+  {
+    public:
+      Executor(std::unique_ptr<ExecBackend> backend = nullptr,
+               size_t max_in_flight = 64);
+
+      std::future<CmdResult> submit(Command);
+      CmdResult run(Command);
+
+      void maxInFlight(size_t);
+      void backend(std::unique_ptr<ExecBackend>);
+
+      Json stats();
+
+      //the executor behind marina::exec
+      static Executor & global();
+
+    private:
+      struct Queued
+      {
+        Command cmd;
+        std::shared_ptr<std::promise<CmdResult>> result;
+        std::chrono::steady_clock::time_point queued;
+      };
+
+      struct ProgramStats
+      {
+        uint64_t failures{0}, timeouts{0};
+        Histogram duration;
+      };
+
+      void launch(Queued);
+      void finished(const Command &, const CmdResult &);
+
+      size_t max_in_flight_, in_flight_{0};
+      std::deque<Queued> queue_;
+      std::map<std::string, std::unique_ptr<ProgramStats>> stats_;
+      Histogram queue_wait_;
+      std::mutex mtx_;
+
+      //last so it goes first, completions may still arrive while it stops
+      std::shared_ptr<ExecBackend> backend_;
+  };
+
+  //run a command through the global executor
+  CmdResult exec(Command);
+
+  //run a shell command line through the global executor
+  CmdResult exec(std::string cmd);
+}
+
+#endif
@@ -0,0 +1,793 @@
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "core/frozen.hxx"
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::max;
+using std::sort;
+using std::iota;
+using std::lower_bound;
+using std::runtime_error;
+using std::invalid_argument;
+using namespace marina;
+
+namespace
+{
+  constexpr Symbol free_slot = ~Symbol{0};
+
+  //fnv-1a
+  size_t hashBytes(const char *data, size_t length)
+  {
+    uint64_t h = 14695981039346656037ull;
+    for(size_t i=0; i<length; ++i)
+    {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  int hexval(char c)
+  {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  bool uuidLess(const Uuid & a, const Uuid & b)
+  {
+    return uuid_compare(a.id, b.id) < 0;
+  }
+
+  //vertices sorted by the uuid of the node they stand for
+  template <class F>
+  vector<Vertex> sortById(size_t n, F id)
+  {
+    vector<Vertex> vs(n);
+    iota(vs.begin(), vs.end(), 0);
+    sort(vs.begin(), vs.end(),
+        [&id](Vertex a, Vertex b){ return uuidLess(id(a), id(b)); });
+    return vs;
+  }
+
+  template <class F>
+  Vertex findId(const vector<Vertex> & by_id, const Uuid & u, F id)
+  {
+    auto i = lower_bound(by_id.begin(), by_id.end(), u,
+        [&id](Vertex v, const Uuid & x){ return uuidLess(id(v), x); });
+    if(i == by_id.end() || id(*i) != u) return no_vertex;
+    return *i;
+  }
+
+  template <class T>
+  size_t bytesOf(const vector<T> & xs) { return xs.capacity() * sizeof(T); }
+
+  // freezing ..................................................................
+
+  FrozenInterface freeze(const Interface & x, SymbolTable & symbols)
+  {
+    return FrozenInterface{
+      symbols.intern(x.name()),
+      packMac(x.mac()),
+      x.latency(),
+      x.capacity(),
+      x.einfo().ipaddr_v4
+    };
+  }
+
+  FrozenNetwork freeze(const Network & x, SymbolTable & symbols)
+  {
+    return FrozenNetwork{
+      x.id(),
+      symbols.intern(x.name()),
+      x.capacity(),
+      x.latency(),
+      x.ipv4()
+    };
+  }
+
+  //the interfaces of a computer go to the end of ifxs
+  template <class C>
+  FrozenComputer freeze(const C & x, const string & os, SymbolTable & symbols,
+      vector<FrozenInterface> & ifxs)
+  {
+    FrozenComputer c{
+      x.id(),
+      symbols.intern(x.name()),
+      symbols.intern(os),
+      x.memory(),
+      x.disk(),
+      x.cores(),
+      static_cast<uint32_t>(ifxs.size()),
+      0
+    };
+    for(const auto & p : x.interfaces())
+      ifxs.push_back(freeze(p.second, symbols));
+    c.ifx_end = ifxs.size();
+    return c;
+  }
+
+  //resolve a link end against the nodes of a frozen model, the interface is
+  //looked up among the interfaces of the node the end lands on
+  template <class V, class I>
+  FrozenEndpoint freeze(const Endpoint & e, V vertex, I ifxRange,
+      const vector<FrozenInterface> & ifxs)
+  {
+    FrozenEndpoint x;
+    x.id = e.id;
+    if(e.mac) x.mac = packMac(*e.mac);
+    x.vertex = vertex(e.id);
+
+    if(x.vertex != no_vertex && x.mac != no_mac)
+    {
+      pair<uint32_t, uint32_t> r = ifxRange(x.vertex);
+      for(uint32_t i=r.first; i<r.second; ++i)
+        if(ifxs[i].mac == x.mac) { x.ifx = i; break; }
+    }
+    return x;
+  }
+
+  // thawing ...................................................................
+
+  Interface thaw(const FrozenInterface & x, const SymbolTable & symbols)
+  {
+    Interface i{symbols.str(x.name)};
+    i.latency(x.latency).capacity(x.capacity);
+    i.writeEinfo().ipaddr_v4 = x.ipv4;
+    return i;
+  }
+
+  // json ......................................................................
+
+  Json json(const FrozenInterface & x, const SymbolTable & symbols)
+  {
+    Json j;
+    j["name"] = symbols.str(x.name);
+    j["latency"] = x.latency.json();
+    j["capacity"] = x.capacity.json();
+    j["mac"] = unpackMac(x.mac);
+    j["einfo"]["ipv4"] = x.ipv4.json();
+    return j;
+  }
+
+  Json json(const FrozenNetwork & x, const SymbolTable & symbols)
+  {
+    Json j;
+    j["name"] = symbols.str(x.name);
+    j["latency"] = x.latency.json();
+    j["capacity"] = x.capacity.json();
+    j["ipv4"] = x.ipv4.json();
+    j["id"] = x.id.json();
+    return j;
+  }
+
+  Json interfacesJson(const FrozenComputer & x,
+      const vector<FrozenInterface> & ifxs, const SymbolTable & symbols)
+  {
+    Json j = Json::array();
+    for(uint32_t i=x.ifx_begin; i<x.ifx_end; ++i)
+      j.push_back(json(ifxs[i], symbols));
+    return j;
+  }
+
+  Json json(const FrozenComputer & x, const vector<FrozenInterface> & ifxs,
+      const SymbolTable & symbols)
+  {
+    Json j;
+    j["name"] = symbols.str(x.name);
+    j["os"] = symbols.str(x.os);
+    j["memory"] = x.memory.json();
+    j["cores"] = x.cores;
+    j["interfaces"] = interfacesJson(x, ifxs, symbols);
+    j["id"] = x.id.json();
+    return j;
+  }
+}
+
+// Arena -----------------------------------------------------------------------
+
+Arena::Arena(size_t block_size)
+  : block_size_{block_size}
+{}
+
+void *Arena::allocate(size_t size, size_t align)
+{
+  auto aligned = [align](char *p)
+  {
+    uintptr_t x = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char*>((x + align - 1) & ~(uintptr_t)(align - 1));
+  };
+
+  char *p = aligned(p_);
+  if(p_ == nullptr || p + size > end_)
+  {
+    //oversized requests get a block of their own
+    size_t n = max(block_size_, size + align);
+    blocks_.emplace_back(new char[n]);
+    bytes_ += n;
+    p_ = blocks_.back().get();
+    end_ = p_ + n;
+    p = aligned(p_);
+  }
+
+  p_ = p + size;
+  return p;
+}
+
+size_t Arena::bytes() const { return bytes_; }
+
+// SymbolTable -----------------------------------------------------------------
+
+SymbolTable::SymbolTable()
+  : slots_(64, free_slot)
+{}
+
+size_t SymbolTable::slot(const char *data, size_t length) const
+{
+  size_t mask = slots_.size() - 1;
+  for(size_t i = hashBytes(data, length) & mask; ; i = (i + 1) & mask)
+  {
+    Symbol s = slots_[i];
+    if(s == free_slot) return i;
+    const Entry & e = entries_[s];
+    if(e.length == length && memcmp(e.data, data, length) == 0) return i;
+  }
+}
+
+void SymbolTable::grow()
+{
+  slots_.assign(slots_.size() * 2, free_slot);
+  for(Symbol s=0; s<entries_.size(); ++s)
+    slots_[slot(entries_[s].data, entries_[s].length)] = s;
+}
+
+Symbol SymbolTable::intern(const string & x)
+{
+  size_t i = slot(x.data(), x.size());
+  if(slots_[i] != free_slot) return slots_[i];
+
+  char *data = static_cast<char*>(arena_.allocate(x.size(), 1));
+  memcpy(data, x.data(), x.size());
+
+  Symbol s = entries_.size();
+  entries_.push_back({data, static_cast<uint32_t>(x.size())});
+  slots_[i] = s;
+
+  //keep the index at most half full
+  if(entries_.size() * 2 > slots_.size()) grow();
+  return s;
+}
+
+string SymbolTable::str(Symbol s) const
+{
+  return string(entries_.at(s).data, entries_.at(s).length);
+}
+
+const char *SymbolTable::data(Symbol s) const { return entries_.at(s).data; }
+size_t SymbolTable::length(Symbol s) const { return entries_.at(s).length; }
+size_t SymbolTable::size() const { return entries_.size(); }
+
+size_t SymbolTable::bytes() const
+{
+  return arena_.bytes() + bytesOf(entries_) + bytesOf(slots_);
+}
+
+// macs ------------------------------------------------------------------------
+
+uint64_t marina::packMac(const string & s)
+{
+  if(s.size() != 17) throw invalid_argument{"bad mac " + s};
+
+  uint64_t x{0};
+  for(size_t i=0; i<17; i+=3)
+  {
+    int hi = hexval(s[i]), lo = hexval(s[i+1]);
+    if(hi < 0 || lo < 0 || (i < 15 && s[i+2] != ':'))
+      throw invalid_argument{"bad mac " + s};
+    x = x << 8 | static_cast<uint64_t>(hi << 4 | lo);
+  }
+  return x;
+}
+
+string marina::unpackMac(uint64_t x)
+{
+  return fmt::format("{:02x}:{:02x}:{:02x}:{:02x}:{:02x}:{:02x}",
+      x >> 40 & 0xff, x >> 32 & 0xff, x >> 24 & 0xff,
+      x >> 16 & 0xff, x >> 8 & 0xff, x & 0xff);
+}
+
+// FrozenEndpoint --------------------------------------------------------------
+
+Endpoint FrozenEndpoint::endpoint() const
+{
+  if(mac == no_mac) return Endpoint{id};
+  return Endpoint{id, unpackMac(mac)};
+}
+
+// LinkTable -------------------------------------------------------------------
+
+void LinkTable::build(const vector<FrozenLink> & links, size_t vertices)
+{
+  //links with an end outside of the model are left out
+  auto resolved = [](const FrozenLink & l)
+  {
+    return
+      l.endpoints[0].vertex != no_vertex &&
+      l.endpoints[1].vertex != no_vertex;
+  };
+
+  offsets.assign(vertices + 1, 0);
+  for(const FrozenLink & l : links)
+  {
+    if(!resolved(l)) continue;
+    ++offsets[l.endpoints[0].vertex + 1];
+    ++offsets[l.endpoints[1].vertex + 1];
+  }
+  for(size_t v=0; v<vertices; ++v) offsets[v+1] += offsets[v];
+
+  ends.resize(offsets[vertices]);
+  vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for(uint32_t i=0; i<links.size(); ++i)
+  {
+    if(!resolved(links[i])) continue;
+    ends[fill[links[i].endpoints[0].vertex]++] = 2*i + 1;
+    ends[fill[links[i].endpoints[1].vertex]++] = 2*i;
+  }
+}
+
+// FrozenBlueprint -------------------------------------------------------------
+
+FrozenBlueprint::FrozenBlueprint(const Blueprint & bp)
+  : name_{bp.name()},
+    id_{bp.id()}
+{
+  networks_.reserve(bp.networks().size());
+  for(const auto & p : bp.networks())
+    networks_.push_back(freeze(p.second, symbols_));
+
+  computers_.reserve(bp.computers().size());
+  for(const auto & p : bp.computers())
+    computers_.push_back(
+        freeze(p.second, p.second.os(), symbols_, interfaces_));
+
+  size_t n = networks_.size() + computers_.size();
+  auto id = [this](Vertex v) -> const Uuid &
+  {
+    return isNetwork(v) ? networks_[v].id : computers_[computerIndex(v)].id;
+  };
+  by_id_ = sortById(n, id);
+
+  auto vertex = [this](const Uuid & u){ return this->vertex(u); };
+  auto ifxRange = [this](Vertex v)
+  {
+    if(isNetwork(v)) return pair<uint32_t, uint32_t>{0, 0};
+    const FrozenComputer & c = computers_[computerIndex(v)];
+    return pair<uint32_t, uint32_t>{c.ifx_begin, c.ifx_end};
+  };
+
+  links_.reserve(bp.links().size());
+  for(const Link & l : bp.links())
+  {
+    FrozenLink x;
+    for(size_t k=0; k<2; ++k)
+      x.endpoints[k] = freeze(l.endpoints[k], vertex, ifxRange, interfaces_);
+    links_.push_back(x);
+  }
+
+  table_.build(links_, n);
+}
+
+Blueprint FrozenBlueprint::thaw() const
+{
+  Blueprint bp{name_};
+  bp.id(id_);
+
+  for(const FrozenNetwork & x : networks_)
+  {
+    Network n{symbols_.str(x.name)};
+    n.capacity(x.capacity).latency(x.latency);
+    n.ipv4(x.ipv4);
+    n.id(x.id);
+    bp.networks().insert_or_assign(x.id, n);
+  }
+
+  for(const FrozenComputer & x : computers_)
+  {
+    Computer c{symbols_.str(x.name)};
+    c.os(symbols_.str(x.os)).memory(x.memory).disk(x.disk).cores(x.cores);
+    c.id(x.id);
+
+    c.interfaces().clear();
+    for(uint32_t i=x.ifx_begin; i<x.ifx_end; ++i)
+    {
+      Interface ifx = ::thaw(interfaces_[i], symbols_);
+      ifx.mac(unpackMac(interfaces_[i].mac));
+      c.interfaces().insert_or_assign(ifx.name(), ifx);
+    }
+    bp.computers().insert_or_assign(x.id, c);
+  }
+
+  for(const FrozenLink & x : links_)
+  {
+    Link l;
+    l.endpoints = {{x.endpoints[0].endpoint(), x.endpoints[1].endpoint()}};
+    bp.link(l);
+  }
+
+  return bp;
+}
+
+Json FrozenBlueprint::json() const
+{
+  Json nets = Json::array(),
+       comps = Json::array(),
+       links = Json::array();
+
+  for(const FrozenNetwork & x : networks_) nets.push_back(::json(x, symbols_));
+  for(const FrozenComputer & x : computers_)
+    comps.push_back(::json(x, interfaces_, symbols_));
+  for(const FrozenLink & x : links_)
+  {
+    Json l;
+    l["endpoints"] = {
+      x.endpoints[0].endpoint().json(),
+      x.endpoints[1].endpoint().json()
+    };
+    links.push_back(l);
+  }
+
+  Json j;
+  j["name"] = name_;
+  j["networks"] = nets;
+  j["computers"] = comps;
+  j["links"] = links;
+  j["id"] = id_.json();
+  return j;
+}
+
+const vector<FrozenComputer> & FrozenBlueprint::computers() const
+{
+  return computers_;
+}
+
+const vector<FrozenNetwork> & FrozenBlueprint::networks() const
+{
+  return networks_;
+}
+
+const vector<FrozenInterface> & FrozenBlueprint::interfaces() const
+{
+  return interfaces_;
+}
+
+const vector<FrozenLink> & FrozenBlueprint::links() const { return links_; }
+const LinkTable & FrozenBlueprint::table() const { return table_; }
+
+Vertex FrozenBlueprint::vertex(const Uuid & u) const
+{
+  return findId(by_id_, u, [this](Vertex v) -> const Uuid &
+  {
+    return isNetwork(v) ? networks_[v].id : computers_[computerIndex(v)].id;
+  });
+}
+
+Vertex FrozenBlueprint::computerVertex(uint32_t computer) const
+{
+  return networks_.size() + computer;
+}
+
+uint32_t FrozenBlueprint::computerIndex(Vertex v) const
+{
+  return v - networks_.size();
+}
+
+vector<pair<uint32_t, uint32_t>>
+FrozenBlueprint::connectedComputers(uint32_t network) const
+{
+  vector<pair<uint32_t, uint32_t>> cs;
+  Vertex v = networkVertex(network);
+  for(const uint32_t *i = table_.begin(v); i != table_.end(v); ++i)
+  {
+    const FrozenEndpoint & e = links_[*i / 2].endpoints[*i % 2];
+    if(isNetwork(e.vertex)) continue;
+
+    if(e.ifx == no_vertex)
+      throw runtime_error{
+        "link between computer and network does not name an interface of "
+        "computer id: " + e.id.str()
+      };
+    cs.push_back({computerIndex(e.vertex), e.ifx});
+  }
+  return cs;
+}
+
+vector<uint32_t> FrozenBlueprint::connectedNetworks(uint32_t computer) const
+{
+  vector<uint32_t> ns;
+  Vertex v = computerVertex(computer);
+  for(const uint32_t *i = table_.begin(v); i != table_.end(v); ++i)
+  {
+    const FrozenEndpoint & e = links_[*i / 2].endpoints[*i % 2];
+    if(isNetwork(e.vertex)) ns.push_back(e.vertex);
+  }
+  return ns;
+}
+
+size_t FrozenBlueprint::bytes() const
+{
+  return
+    sizeof(*this) + name_.capacity() + symbols_.bytes() +
+    bytesOf(computers_) + bytesOf(networks_) + bytesOf(interfaces_) +
+    bytesOf(links_) + bytesOf(table_.offsets) + bytesOf(table_.ends) +
+    bytesOf(by_id_);
+}
+
+// FrozenTopology --------------------------------------------------------------
+
+FrozenTopology::FrozenTopology(const TestbedTopology & tt)
+  : name_{tt.name()}
+{
+  switches_.reserve(tt.switches().size());
+  for(const auto & p : tt.switches())
+  {
+    const marina::Switch & s = p.second;
+    Switch x{
+      s.id(),
+      symbols_.intern(s.name()),
+      s.backplane(),
+      static_cast<uint32_t>(networks_.size()),
+      0
+    };
+    for(const Network & n : s.networks())
+      networks_.push_back(freeze(n, symbols_));
+    x.network_end = networks_.size();
+    switches_.push_back(x);
+  }
+
+  hosts_.reserve(tt.hosts().size());
+  for(const auto & p : tt.hosts())
+  {
+    const marina::Host & h = p.second;
+    Host x{
+      freeze(h, "", symbols_, interfaces_),
+      static_cast<uint32_t>(machines_.size()),
+      0
+    };
+    for(const Computer & c : h.machines())
+      machines_.push_back(freeze(c, c.os(), symbols_, interfaces_));
+    x.machine_end = machines_.size();
+    hosts_.push_back(x);
+  }
+
+  size_t n = switches_.size() + hosts_.size();
+  auto id = [this](Vertex v) -> const Uuid &
+  {
+    return isSwitch(v) ? switches_[v].id : hosts_[hostIndex(v)].node.id;
+  };
+  by_id_ = sortById(n, id);
+
+  auto vertex = [this](const Uuid & u){ return this->vertex(u); };
+  auto ifxRange = [this](Vertex v)
+  {
+    if(isSwitch(v)) return pair<uint32_t, uint32_t>{0, 0};
+    const FrozenComputer & c = hosts_[hostIndex(v)].node;
+    return pair<uint32_t, uint32_t>{c.ifx_begin, c.ifx_end};
+  };
+
+  tt.forEachLink([&](const Endpoint & a, const Endpoint & b, Bandwidth bw)
+  {
+    FrozenLink x;
+    x.endpoints[0] = freeze(a, vertex, ifxRange, interfaces_);
+    x.endpoints[1] = freeze(b, vertex, ifxRange, interfaces_);
+    x.capacity = bw;
+    links_.push_back(x);
+  });
+
+  table_.build(links_, n);
+}
+
+TestbedTopology FrozenTopology::thaw() const
+{
+  TestbedTopology tt{name_};
+
+  auto thawComputer = [this](const FrozenComputer & x, auto & c)
+  {
+    c.memory(x.memory).disk(x.disk).cores(x.cores);
+    c.id(x.id);
+
+    c.interfaces().clear();
+    for(uint32_t i=x.ifx_begin; i<x.ifx_end; ++i)
+    {
+      Interface ifx = ::thaw(interfaces_[i], symbols_);
+      ifx.mac(unpackMac(interfaces_[i].mac));
+      c.interfaces().insert_or_assign(ifx.name(), ifx);
+    }
+  };
+
+  for(const Switch & x : switches_)
+  {
+    marina::Switch s{symbols_.str(x.name)};
+    s.backplane(x.backplane);
+    s.id(x.id);
+    for(uint32_t i=x.network_begin; i<x.network_end; ++i)
+    {
+      const FrozenNetwork & fn = networks_[i];
+      Network n{symbols_.str(fn.name)};
+      n.capacity(fn.capacity).latency(fn.latency);
+      n.ipv4(fn.ipv4);
+      n.id(fn.id);
+      s.networks().push_back(n);
+    }
+    tt.switches().insert_or_assign(x.id, s);
+  }
+
+  for(const Host & x : hosts_)
+  {
+    marina::Host h{symbols_.str(x.node.name)};
+    thawComputer(x.node, h);
+    for(uint32_t i=x.machine_begin; i<x.machine_end; ++i)
+    {
+      Computer c{symbols_.str(machines_[i].name)};
+      c.os(symbols_.str(machines_[i].os));
+      thawComputer(machines_[i], c);
+      h.machines().push_back(c);
+    }
+    tt.hosts().insert_or_assign(x.node.id, h);
+  }
+
+  for(const FrozenLink & x : links_)
+    tt.link(x.endpoints[0].endpoint(), x.endpoints[1].endpoint(), x.capacity);
+
+  return tt;
+}
+
+Json FrozenTopology::json() const
+{
+  Json sws = Json::array(),
+       hs = Json::array(),
+       links = Json::array();
+
+  for(const Switch & x : switches_)
+  {
+    size_t allocated{0};
+    Json nets = Json::array();
+    for(uint32_t i=x.network_begin; i<x.network_end; ++i)
+    {
+      nets.push_back(::json(networks_[i], symbols_));
+      allocated += networks_[i].capacity.megabits();
+    }
+
+    Json s;
+    s["name"] = symbols_.str(x.name);
+    s["backplane"] = x.backplane.json();
+    s["allocated-backplane"] =
+      Bandwidth{allocated, Bandwidth::Unit::MBPS}.json();
+    s["networks"] = nets;
+    sws.push_back(s);
+  }
+
+  for(const Host & x : hosts_)
+  {
+    Json machines = Json::array();
+    for(uint32_t i=x.machine_begin; i<x.machine_end; ++i)
+      machines.push_back(::json(machines_[i], interfaces_, symbols_));
+
+    Json h;
+    h["name"] = symbols_.str(x.node.name);
+    h["cores"] = x.node.cores;
+    h["memory"] = x.node.memory.json();
+    h["disk"] = x.node.disk.json();
+    h["machines"] = machines;
+    h["interfaces"] = interfacesJson(x.node, interfaces_, symbols_);
+    hs.push_back(h);
+  }
+
+  for(const FrozenLink & x : links_)
+  {
+    Json l;
+    l["endpoints"] = {
+      x.endpoints[0].endpoint().json(),
+      x.endpoints[1].endpoint().json()
+    };
+    l["capacity"] = x.capacity.json();
+    links.push_back(l);
+  }
+
+  Json j;
+  j["name"] = name_;
+  j["switches"] = sws;
+  j["hosts"] = hs;
+  j["links"] = links;
+  return j;
+}
+
+const vector<FrozenTopology::Host> & FrozenTopology::hosts() const
+{
+  return hosts_;
+}
+
+const vector<FrozenTopology::Switch> & FrozenTopology::switches() const
+{
+  return switches_;
+}
+
+const vector<FrozenComputer> & FrozenTopology::machines() const
+{
+  return machines_;
+}
+
+const vector<FrozenNetwork> & FrozenTopology::networks() const
+{
+  return networks_;
+}
+
+const vector<FrozenInterface> & FrozenTopology::interfaces() const
+{
+  return interfaces_;
+}
+
+const vector<FrozenLink> & FrozenTopology::links() const { return links_; }
+const LinkTable & FrozenTopology::table() const { return table_; }
+
+Vertex FrozenTopology::vertex(const Uuid & u) const
+{
+  return findId(by_id_, u, [this](Vertex v) -> const Uuid &
+  {
+    return isSwitch(v) ? switches_[v].id : hosts_[hostIndex(v)].node.id;
+  });
+}
+
+Vertex FrozenTopology::hostVertex(uint32_t host) const
+{
+  return switches_.size() + host;
+}
+
+uint32_t FrozenTopology::hostIndex(Vertex v) const
+{
+  return v - switches_.size();
+}
+
+vector<uint32_t> FrozenTopology::connectedHosts(uint32_t sw) const
+{
+  vector<uint32_t> hs;
+  vector<bool> seen(hosts_.size());
+  Vertex v = switchVertex(sw);
+  for(const uint32_t *i = table_.begin(v); i != table_.end(v); ++i)
+  {
+    const FrozenEndpoint & e = links_[*i / 2].endpoints[*i % 2];
+    if(isSwitch(e.vertex) || seen[hostIndex(e.vertex)]) continue;
+    seen[hostIndex(e.vertex)] = true;
+    hs.push_back(hostIndex(e.vertex));
+  }
+  return hs;
+}
+
+vector<uint32_t> FrozenTopology::connectedSwitches(uint32_t host) const
+{
+  vector<uint32_t> ss;
+  vector<bool> seen(switches_.size());
+  Vertex v = hostVertex(host);
+  for(const uint32_t *i = table_.begin(v); i != table_.end(v); ++i)
+  {
+    const FrozenEndpoint & e = links_[*i / 2].endpoints[*i % 2];
+    if(!isSwitch(e.vertex) || seen[e.vertex]) continue;
+    seen[e.vertex] = true;
+    ss.push_back(e.vertex);
+  }
+  return ss;
+}
+
+size_t FrozenTopology::bytes() const
+{
+  return
+    sizeof(*this) + name_.capacity() + symbols_.bytes() +
+    bytesOf(hosts_) + bytesOf(switches_) + bytesOf(machines_) +
+    bytesOf(networks_) + bytesOf(interfaces_) + bytesOf(links_) +
+    bytesOf(table_.offsets) + bytesOf(table_.ends) + bytesOf(by_id_);
+}
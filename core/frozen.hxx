@@ -0,0 +1,282 @@
+#ifndef MARINA_CORE_FROZEN_HXX
+#define MARINA_CORE_FROZEN_HXX
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <string>
+#include "core/blueprint.hxx"
+#include "core/topo.hxx"
+
+/*
+ * Immutable, flat forms of Blueprint and TestbedTopology.
+ *
+ * The handle models are graphs of shared_ptr pimpls in hash maps, which is
+ * what makes them easy to build and edit, and slow to walk and copy once
+ * they are large. A frozen model holds the same information in dense
+ * vectors addressed by index: names are interned once into an arena, macs
+ * are 48 bit integers and links are resolved to node indices with a
+ * compressed sparse row adjacency table next to them. Freeze a model to
+ * read it many times over, thaw it to get handles back.
+ */
+
+namespace marina
+{
+  // Arena ---------------------------------------------------------------------
+
+  //bump allocator, everything it hands out is released with the arena
+  class Arena
+  {
+    public:
+      explicit Arena(size_t block_size = 64 << 10);
+
+      Arena(Arena &&) = default;
+      Arena & operator=(Arena &&) = default;
+
+      void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+      //bytes reserved from the system so far
+      size_t bytes() const;
+
+    private:
+      std::vector<std::unique_ptr<char[]>> blocks_;
+      char *p_{nullptr}, *end_{nullptr};
+      size_t block_size_, bytes_{0};
+  };
+
+  // SymbolTable ---------------------------------------------------------------
+
+  using Symbol = uint32_t;
+
+  //interned strings, each distinct string is stored once in an arena
+  class SymbolTable
+  {
+    public:
+      SymbolTable();
+
+      Symbol intern(const std::string &);
+
+      std::string str(Symbol) const;
+      const char *data(Symbol) const;
+      size_t length(Symbol) const;
+
+      //number of distinct strings
+      size_t size() const;
+      size_t bytes() const;
+
+    private:
+      struct Entry { const char *data; uint32_t length; };
+
+      size_t slot(const char *data, size_t length) const;
+      void grow();
+
+      Arena arena_;
+      std::vector<Entry> entries_;
+      //open addressed index into entries_, ~0 marks a free slot
+      std::vector<Symbol> slots_;
+  };
+
+  // macs ----------------------------------------------------------------------
+
+  //no interface has this, a mac is at most 48 bits
+  constexpr uint64_t no_mac = ~uint64_t{0};
+
+  //aa:bb:cc:dd:ee:ff, throws invalid_argument for anything else
+  uint64_t packMac(const std::string &);
+  std::string unpackMac(uint64_t);
+
+  // shared records ------------------------------------------------------------
+
+  //a node index in the link graph of a frozen model
+  using Vertex = uint32_t;
+  constexpr Vertex no_vertex = ~Vertex{0};
+
+  struct FrozenInterface
+  {
+    Symbol name;
+    uint64_t mac;
+    Latency latency;
+    Bandwidth capacity;
+    IpV4Address ipv4;
+  };
+
+  struct FrozenComputer
+  {
+    Uuid id;
+    Symbol name, os;
+    Memory memory, disk;
+    size_t cores;
+    //range of the interfaces of the computer
+    uint32_t ifx_begin, ifx_end;
+  };
+
+  struct FrozenNetwork
+  {
+    Uuid id;
+    Symbol name;
+    Bandwidth capacity;
+    Latency latency;
+    IpV4Address ipv4;
+  };
+
+  //a link end as it was written, and the vertex and interface it resolved
+  //to, which are no_vertex when the link points outside of the model
+  struct FrozenEndpoint
+  {
+    Uuid id;
+    uint64_t mac{no_mac};
+    Vertex vertex{no_vertex};
+    uint32_t ifx{no_vertex};
+
+    Endpoint endpoint() const;
+  };
+
+  struct FrozenLink
+  {
+    std::array<FrozenEndpoint, 2> endpoints;
+    //only used by testbed topologies
+    Bandwidth capacity;
+  };
+
+  //the links of a model in compressed sparse row form, the link ends
+  //adjacent to vertex v are ends[offsets[v]] .. ends[offsets[v+1]], each
+  //one a link index times two plus the side of the far end
+  struct LinkTable
+  {
+    void build(const std::vector<FrozenLink> &, size_t vertices);
+
+    const uint32_t *begin(Vertex v) const { return &ends[offsets[v]]; }
+    const uint32_t *end(Vertex v) const { return &ends[offsets[v+1]]; }
+
+    std::vector<uint32_t> offsets, ends;
+  };
+
+  // FrozenBlueprint -----------------------------------------------------------
+
+  /*
+   * Vertices are the networks [0, networks) followed by the computers.
+   */
+  class FrozenBlueprint
+  {
+    public:
+      explicit FrozenBlueprint(const Blueprint &);
+
+      FrozenBlueprint(FrozenBlueprint &&) = default;
+      FrozenBlueprint & operator=(FrozenBlueprint &&) = default;
+
+      Blueprint thaw() const;
+      Json json() const;
+
+      const std::string & name() const { return name_; }
+      const Uuid & id() const { return id_; }
+
+      const std::vector<FrozenComputer> & computers() const;
+      const std::vector<FrozenNetwork> & networks() const;
+      const std::vector<FrozenInterface> & interfaces() const;
+      const std::vector<FrozenLink> & links() const;
+      const LinkTable & table() const;
+
+      std::string str(Symbol s) const { return symbols_.str(s); }
+
+      Vertex vertex(const Uuid &) const;
+      Vertex networkVertex(uint32_t network) const { return network; }
+      Vertex computerVertex(uint32_t computer) const;
+      bool isNetwork(Vertex v) const { return v < networks_.size(); }
+      uint32_t computerIndex(Vertex v) const;
+
+      //the (computer, interface) index pairs linked to a network, in link
+      //order, like Blueprint::connectedComputers
+      std::vector<std::pair<uint32_t, uint32_t>>
+      connectedComputers(uint32_t network) const;
+
+      //the networks linked to a computer
+      std::vector<uint32_t> connectedNetworks(uint32_t computer) const;
+
+      //memory held by the frozen model
+      size_t bytes() const;
+
+    private:
+      std::string name_;
+      Uuid id_;
+      SymbolTable symbols_;
+      std::vector<FrozenComputer> computers_;
+      std::vector<FrozenNetwork> networks_;
+      std::vector<FrozenInterface> interfaces_;
+      std::vector<FrozenLink> links_;
+      LinkTable table_;
+
+      //vertices ordered by uuid for lookups
+      std::vector<Vertex> by_id_;
+  };
+
+  // FrozenTopology ------------------------------------------------------------
+
+  /*
+   * Vertices are the switches [0, switches) followed by the hosts.
+   */
+  class FrozenTopology
+  {
+    public:
+      struct Host
+      {
+        FrozenComputer node;
+        //range of the machines embedded on the host
+        uint32_t machine_begin, machine_end;
+      };
+
+      struct Switch
+      {
+        Uuid id;
+        Symbol name;
+        Bandwidth backplane;
+        //range of the networks embedded on the switch
+        uint32_t network_begin, network_end;
+      };
+
+      explicit FrozenTopology(const TestbedTopology &);
+
+      FrozenTopology(FrozenTopology &&) = default;
+      FrozenTopology & operator=(FrozenTopology &&) = default;
+
+      TestbedTopology thaw() const;
+      Json json() const;
+
+      const std::string & name() const { return name_; }
+
+      const std::vector<Host> & hosts() const;
+      const std::vector<Switch> & switches() const;
+      const std::vector<FrozenComputer> & machines() const;
+      const std::vector<FrozenNetwork> & networks() const;
+      const std::vector<FrozenInterface> & interfaces() const;
+      const std::vector<FrozenLink> & links() const;
+      const LinkTable & table() const;
+
+      std::string str(Symbol s) const { return symbols_.str(s); }
+
+      Vertex vertex(const Uuid &) const;
+      Vertex switchVertex(uint32_t sw) const { return sw; }
+      Vertex hostVertex(uint32_t host) const;
+      bool isSwitch(Vertex v) const { return v < switches_.size(); }
+      uint32_t hostIndex(Vertex v) const;
+
+      //each host or switch once, in link order
+      std::vector<uint32_t> connectedHosts(uint32_t sw) const;
+      std::vector<uint32_t> connectedSwitches(uint32_t host) const;
+
+      size_t bytes() const;
+
+    private:
+      std::string name_;
+      SymbolTable symbols_;
+      std::vector<Host> hosts_;
+      std::vector<Switch> switches_;
+      std::vector<FrozenComputer> machines_;
+      std::vector<FrozenNetwork> networks_;
+      std::vector<FrozenInterface> interfaces_;
+      std::vector<FrozenLink> links_;
+      LinkTable table_;
+      std::vector<Vertex> by_id_;
+  };
+}
+
+#endif
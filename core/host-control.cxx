@@ -4,16 +4,38 @@
 
 #include <cstdlib>
 #include <thread>
+#include <atomic>
 #include <mutex>
 #include <fstream>
 #include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <sstream>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
 #include <fmt/format.h>
 #include <gflags/gflags.h>
 #include "3p/pipes/pipes.hxx"
 #include "common/net/http_server.hxx"
+#include "common/net/wire.hxx"
 #include "core/blueprint.hxx"
 #include "core/util.hxx"
 #include "core/db.hxx"
+#include "core/materialization.hxx"
+#include "core/ovsdb.hxx"
+#include "core/pipeline.hxx"
+#include "core/qmp.hxx"
+#include "core/exec.hxx"
+#include "core/jobs.hxx"
+#include "core/netlink.hxx"
+#include "core/numa.hxx"
 
 using std::string;
 using std::to_string;
@@ -23,24 +45,52 @@ using std::vector;
 using std::ofstream;
 using std::endl;
 using std::thread;
+using std::atomic;
+using std::this_thread::sleep_for;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
 using std::mutex;
 using std::unique_lock;
+using std::lock_guard;
+using std::condition_variable;
+using std::promise;
+using std::shared_future;
+using std::current_exception;
+using std::shared_ptr;
+using std::make_shared;
+using std::deque;
+using std::pair;
 using std::defer_lock_t;
 using std::runtime_error;
 using std::out_of_range;
+using std::invalid_argument;
 using std::exception;
+using std::experimental::optional;
 using wangle::SSLContextConfig;
 using namespace pipes;
 using namespace marina;
 
-http::Response construct(Json);
+http::Response construct(http::Message);
 http::Response destruct(Json);
 http::Response info(Json);
 http::Response list(Json);
+http::Response launchReport(Json);
+http::Response poolStatus(http::Message);
+http::Response execStats(http::Message);
+http::Response jobStatus(http::Message);
+http::Response cpuStatus(http::Message);
+http::Response capacity(http::Message);
+http::Response cancel(Json);
 
 void execFail(const CmdResult &, string);
+pid_t qemuPid(string);
 void initOvs();
 void initQemuKvm();
+void initBudgets();
+void initNuma();
+void initGuestFiles();
+void initWarmPool();
 
 /*
  *    local volatile runtime state
@@ -62,10 +112,73 @@ LinearIdCacheMap<string, size_t> qkId, vhostId;
  */
 
 unordered_map<Uuid, Blueprint, UuidHash, UuidCmp> live_blueprints;
+unordered_map<Uuid, PipelineReport, UuidHash, UuidCmp> launch_reports;
 mutex lb_mtx;
 unique_lock<mutex> lb_lk{lb_mtx, defer_lock_t{}};
 
 unique_ptr<DB> db{nullptr};
+unique_ptr<OvsDb> ovs{nullptr};
+unique_ptr<LinkCache> links{nullptr};
+
+/*
+ * materializations in progress and recently finished, keyed by blueprint id
+ */
+unique_ptr<JobScheduler> jobs{nullptr};
+
+/*
+ * which host cpus and numa node each vm runs on, keyed by vmKey
+ */
+unique_ptr<CpuPlacer> placer{nullptr};
+
+/*
+ * host resource budgets the launch pipeline works within, held only while a
+ * launch step runs, the hugepages a vm holds for as long as it is up are kept
+ * apart in the HugepageLedger of the numa placement
+ */
+unique_ptr<Budget> cpu_budget, io_budget;
+
+/*
+ * nbd devices for working on guest images, each device has a private mount 
+ * point so any number of images can be worked on at once
+ */
+class NbdPool
+{
+  public:
+    void init(size_t n)
+    {
+      lock_guard<mutex> lk{mtx_};
+      free_.assign(n, true);
+    }
+
+    size_t acquire()
+    {
+      unique_lock<mutex> lk{mtx_};
+      size_t i;
+      cv_.wait(lk, [this,&i](){
+        auto it = std::find(free_.begin(), free_.end(), true);
+        i = it - free_.begin();
+        return it != free_.end();
+      });
+      free_[i] = false;
+      return i;
+    }
+
+    void release(size_t i)
+    {
+      {
+        lock_guard<mutex> lk{mtx_};
+        free_[i] = true;
+      }
+      cv_.notify_one();
+    }
+
+  private:
+    vector<bool> free_;
+    mutex mtx_;
+    condition_variable cv_;
+};
+
+NbdPool nbd_pool;
 
 /*
  *    command line flags
@@ -82,15 +195,127 @@ DEFINE_string(
   "the physical dpdk bridge ip address to use"
 );
 
+DEFINE_string(
+  ovsdb_sock,
+  "/var/run/openvswitch/db.sock",
+  "the ovsdb-server unix socket to configure openvswitch through"
+);
+
 DEFINE_string(
   remote_addr,
   "192.168.247.2",
   "remote vxlan address"
 );
 
+DEFINE_int32(
+  launch_workers,
+  8,
+  "the number of vms that may be moving through the launch pipeline at once"
+);
+
+DEFINE_int32(
+  launch_io,
+  4,
+  "the number of disk heavy launch steps that may run at once"
+);
+
+DEFINE_int32(
+  launch_cpus,
+  0,
+  "the number of cores booting vms may claim at once, 0 for all host cores"
+);
+
+DEFINE_int32(
+  hugepage_mb,
+  0,
+  "hugepage memory available to vms, split evenly across numa nodes, 0 to "
+  "read it from the kernel"
+);
+
+DEFINE_string(
+  host_cpus,
+  "0",
+  "cpus kept for the host, vms only run their emulator threads here"
+);
+
+DEFINE_string(
+  pmd_cpus,
+  "",
+  "cpus for the ovs-dpdk pmd threads, vms are placed on the numa nodes "
+  "these are on"
+);
+
+DEFINE_bool(
+  cpu_pinning,
+  true,
+  "pin vcpus and qemu emulator threads to the cpus vms are placed on"
+);
+
+DEFINE_int32(
+  nbd_devices,
+  16,
+  "the number of nbd devices available for working on guest images"
+);
+
+DEFINE_string(
+  host_pkg,
+  "/home/murphy/host-pkg",
+  "the marina guest packages installed into vm images"
+);
+
+DEFINE_string(
+  warm_pool,
+  "",
+  "pre-booted vms to keep on standby as os:cores:memory_mb=count[,...]"
+);
+
+DEFINE_int32(
+  warm_pool_settle_s,
+  90,
+  "how long a standby vm is given to boot before it is paused"
+);
+
+DEFINE_int32(
+  construct_workers,
+  2,
+  "number of materializations carried out at once"
+);
+
+DEFINE_int32(
+  construct_queue,
+  32,
+  "number of materializations that may wait for a worker before new ones "
+  "are turned away"
+);
+
+DEFINE_int32(
+  teardown_grace_ms,
+  5000,
+  "how long vms get to shut down when signaled before they are killed"
+);
+
+DEFINE_int32(
+  exec_max_in_flight,
+  32,
+  "maximum number of commands run at once, further commands queue up"
+);
+
+DEFINE_bool(
+  dry_run,
+  false,
+  "stub out command execution and ovsdb, for benchmarking the control path"
+);
+
+DEFINE_int32(
+  dry_run_exec_ms,
+  0,
+  "simulated duration of a stubbed out command in a dry run"
+);
+
 int main(int argc, char **argv)
 {
   Glog::init("host-control");
+  Trace::init("host-control");
   LOG(INFO) << "host-control starting";
 
 
@@ -98,8 +323,29 @@ int main(int argc, char **argv)
       "usage: host-control -pbr_mac <mac> -pbr_addr <addr>");
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
+  Executor::global().maxInFlight(FLAGS_exec_max_in_flight);
+  if(FLAGS_dry_run)
+  {
+    LOG(INFO) << "dry run: commands will not be executed";
+    Executor::global().backend(unique_ptr<ExecBackend>{
+      new FakeBackend{
+        [](const Command &){ return CmdResult{}; },
+        milliseconds{FLAGS_dry_run_exec_ms}
+      }
+    });
+  }
+
+  initBudgets();
   initQemuKvm();
+  initGuestFiles();
   initOvs();
+  initNuma();
+  initWarmPool();
+
+  jobs.reset(new JobScheduler{
+      static_cast<size_t>(FLAGS_construct_workers),
+      static_cast<size_t>(FLAGS_construct_queue)
+  });
   
   SSLContextConfig sslc;
   sslc.setCertificate(
@@ -112,10 +358,17 @@ int main(int argc, char **argv)
   
   HttpsServer srv("0.0.0.0", 443, sslc);
   
-  srv.onPost("/construct", jsonIn(construct));
+  srv.onPost("/construct", construct);
   srv.onPost("/destruct", jsonIn(destruct));
   srv.onPost("/info", jsonIn(info));
   srv.onPost("/list", jsonIn(list));
+  srv.onPost("/launch-report", jsonIn(launchReport));
+  srv.onGet("/pool", poolStatus);
+  srv.onGet("/exec", execStats);
+  srv.onGet("/jobs", jobStatus);
+  srv.onGet("/cpus", cpuStatus);
+  srv.onGet("/capacity", capacity);
+  srv.onPost("/cancel", jsonIn(cancel));
 
   LOG(INFO) << "ready";
 
@@ -130,6 +383,18 @@ void execFail(const CmdResult & cr, string msg)
   throw runtime_error{msg};
 }
 
+//commit a change to ovsdb, there is no ovsdb to talk to in a dry run
+void ovsCommit(const OvsTxn & txn, string what)
+{
+  if(FLAGS_dry_run) return;
+  try { ovs->commit(txn); }
+  catch(exception &e)
+  {
+    LOG(ERROR) << e.what();
+    throw runtime_error{"failed to " + what};
+  }
+}
+
 void initOvs()
 {
   LOG(INFO) << "wiping any old ovs config";
@@ -140,38 +405,35 @@ void initOvs()
   CmdResult cr = exec("service openvswitch-switch start");
   if(cr.code != 0) execFail(cr, "failed to clean start openvswitch");
 
-  // create the physical experiment bridge
-  LOG(INFO) << "setting up physical bridge";
-  cr = exec(
-    fmt::format(
-      "ovs-vsctl add-br mrtb-pbr "
-      "-- set bridge mrtb-pbr datapath_type=netdev "
-      "other_config:hwaddr={pmac}",
-      fmt::arg("pmac", FLAGS_pbr_mac) 
-    )
-  );
-  if(cr.code != 0) execFail(cr, "failed to create physical bridge");
+  ovs.reset(new OvsDb{FLAGS_ovsdb_sock});
 
-  // hook up dpdk
-  cr = exec(
-    "ovs-vsctl add-port mrtb-pbr dpdk0 -- set Interface dpdk0 type=dpdk"
-  );
-  if(cr.code != 0) 
-    execFail(cr, "failed to add dpdk interface to physical bridge");
-
-  // give the bridge an address
-  cr = exec(
-    fmt::format(
-      "ip addr add {paddr} dev mrtb-pbr",
-      fmt::arg("paddr", FLAGS_pbr_addr)
-    )
+  // create the physical experiment bridge and hook up dpdk
+  LOG(INFO) << "setting up physical bridge";
+  OvsTxn txn;
+  if(!FLAGS_pmd_cpus.empty())
+    txn.setOtherConfig({
+        {"pmd-cpu-mask", cpuMask(parseCpuList(FLAGS_pmd_cpus))}
+    });
+  ovsCommit(
+    txn
+      .addBridge("mrtb-pbr", "netdev", {{"hwaddr", FLAGS_pbr_mac}})
+      .addPort("mrtb-pbr", "dpdk0", "dpdk"),
+    "create physical bridge"
   );
-  if(cr.code != 0) 
-    execFail(cr, "failed to give physical bridge an ip address");
 
-  // bring physical bridge up
-  cr = exec("ip link set mrtb-pbr up");
-  if(cr.code != 0) execFail(cr, "failed to bring physical bridge up");
+  //ovs brings up the bridge device in its own time
+  if(!FLAGS_dry_run)
+  {
+    links.reset(new LinkCache);
+    auto pbr = links->waitForName("mrtb-pbr", seconds{10});
+    if(!pbr) throw runtime_error{"physical bridge device did not show up"};
+
+    // give the bridge an address and bring it up
+    LinkBatch{}
+      .addAddress(pbr->index, FLAGS_pbr_addr)
+      .setUp(pbr->index)
+      .commit();
+  }
 
   // flush iptables
   cr = exec("iptables -F");
@@ -180,122 +442,169 @@ void initOvs()
   LOG(INFO) << "ovs ready";
 }
 
-void initQemuKvm()
+void initBudgets()
 {
-  LOG(INFO) << "clobbering any existing qemu-system instances";
+  size_t cpus = FLAGS_launch_cpus > 0 ? 
+    FLAGS_launch_cpus : std::max(thread::hardware_concurrency(), 1u);
 
-  CmdResult cr = exec("pkill qemu-system");
-  LOG(INFO) << "qemu-kvm ready";
+  cpu_budget.reset(new Budget{"cpu", cpus});
+  io_budget.reset(new Budget{"io", static_cast<size_t>(FLAGS_launch_io)});
+
+  LOG(INFO) << fmt::format("launch budgets: {} cpus, {} io",
+      cpus, FLAGS_launch_io);
 }
 
-inline string xpdir(const Blueprint & bp)
+/*
+ * Runs once ovs-dpdk has taken its hugepages and with no vms around, so the
+ * hugepage memory that is free at this point is what vms get.
+ */
+void initNuma()
 {
-  return fmt::format("/space/xp/{}", bp.id().str());
+  vector<NumaNode> nodes = NumaTopology::detect().nodes();
+  for(NumaNode & n : nodes)
+  {
+    n.hugepage_mb = n.hugepage_free_mb;
+    if(FLAGS_hugepage_mb > 0) n.hugepage_mb = FLAGS_hugepage_mb / nodes.size();
+    else if(n.hugepage_mb == 0 && FLAGS_dry_run) 
+      n.hugepage_mb = std::numeric_limits<uint32_t>::max();
+  }
+  NumaTopology topo{nodes};
+
+  placer.reset(new CpuPlacer{
+      topo, 
+      parseCpuList(FLAGS_host_cpus), 
+      parseCpuList(FLAGS_pmd_cpus)
+  });
+
+  for(const NumaNode & n : topo.nodes())
+    LOG(INFO) << fmt::format("numa node {}: cpus {}, {}MB hugepages for vms", 
+        n.id, cpuList(n.cpus), n.hugepage_mb);
+  LOG(INFO) << fmt::format("host cpus: {}, pmd cpus: {}",
+      FLAGS_host_cpus, FLAGS_pmd_cpus.empty() ? "-" : FLAGS_pmd_cpus);
 }
 
-void plopLinuxConfig(const Computer & c, string dst, string img)
+//the key a vm is known to the cpu placer by
+string vmKey(const Blueprint & bp, const Computer & c)
 {
-  //create network init script for linux
-  string initscript = fmt::format("{}/{}-netup", dst, c.name());
-  ofstream ofs{ initscript };
-
-  ofs << "#!/bin/bash"
-      << endl
-      << endl;
-  
-  ofs << "ldconfig" 
-      << endl
-      << endl;
-
-  ofs << "m2i=mac2ifname"
-      << endl
-      << endl;
-
-  ofs << "hostname " << c.name()
-      << endl
-      << endl;
+  return bp.id().str() + "/" + c.name();
+}
 
-  for(const auto & i : c.interfaces())
+/*
+ * The cpus and hugepage memory of every vm of a blueprint are reserved up
+ * front, a blueprint that does not fit is turned away before any of its
+ * disks or networks are set up. Throws InsufficientHugepages.
+ */
+void placeComputers(const Blueprint & bp)
+{
+  vector<string> placed;
+  try
   {
-    Interface ifx = i.second;
-    string dev_name = fmt::format("`$m2i {}`", ifx.mac());
-
-    if(ifx.name() == "cifx")
-    {
-      ofs << fmt::format("# control interface", dev_name) << endl;
-      ofs << fmt::format("ip link set up dev {}", dev_name) << endl;
-      ofs << fmt::format("dhclient {}", dev_name) << endl;
-      ofs << endl;
-    }
-    else
+    for(const auto & c : bp.computers())
     {
-      string addr = ifx.einfo().ipaddr_v4.cidr();
-
-      ofs << fmt::format("# {}", ifx.name()) << endl;
-      ofs << fmt::format("ip addr add {} dev {}", addr, dev_name) << endl;
-      ofs << fmt::format("ip link set up dev {}", dev_name) << endl;
-      ofs << endl;
+      const Computer & x = c.second;
+      placer->place(vmKey(bp, x), x.cores(), x.memory().megabytes());
+      placed.push_back(vmKey(bp, x));
     }
   }
-  ofs.close();
-  exec(fmt::format("chmod +x {}", initscript));
+  catch(...)
+  {
+    for(const string & k : placed) placer->release(k);
+    throw;
+  }
+}
 
-  exec("modprobe nbd max_part=8");
+void releaseComputers(const Blueprint & bp)
+{
+  for(const auto & c : bp.computers()) placer->release(vmKey(bp, c.second));
+}
 
-  //copy the network init script to the guest drive image
-  //unmount and disconnect anything that is already hooked up
-  exec("umount /space/tmount");
-  exec("qemu-nbd --disconnect /dev/nbd0"); 
-  CmdResult cr = exec(fmt::format("qemu-nbd --connect=/dev/nbd0 {}", img));
-  if(cr.code != 0) 
-    execFail(cr, "failed to create network boodtdisk for qeumu image " + img);
+//hugepage backed guest memory bound to the numa node the vm is placed on
+string memoryBackend(size_t mem, const CpuAssignment & cpu)
+{
+  return fmt::format(
+      "memory-backend-file,id=mem0,size={}M,mem-path=/dev/hugepages,share=on,"
+      "host-nodes={},policy=bind,prealloc=on",
+      mem, cpu.node);
+}
 
-  cr = exec("mount /dev/nbd0p1 /space/tmount");
-  if(cr.code != 0)
-  {
-    exec("qemu-nbd --disconnect /dev/nbd0");
-    execFail(cr, "failed to mount qemu network boot disk partition 1");
+/*
+ * Pin each vcpu thread of a running qemu to its host cpu and every other
+ * thread of the process to the emulator cpus. Vcpu thread ids come from
+ * qmp, query-cpus-fast does not interrupt the guest but is only there as of
+ * qemu 2.12.
+ */
+void pinVm(string qmp_sock, string pidfile, const CpuAssignment & cpu)
+{
+  if(FLAGS_dry_run || !FLAGS_cpu_pinning) return;
+
+  Qmp qmp{qmp_sock};
+  Json cpus;
+  bool fast{true};
+  try { cpus = qmp.execute("query-cpus-fast"); }
+  catch(runtime_error &) 
+  { 
+    cpus = qmp.execute("query-cpus"); 
+    fast = false;
   }
 
-  cr = exec("mkdir -p /space/tmount/marina");
-  if(cr.code != 0)
+  vector<pid_t> vcpus(cpu.vcpus.size(), 0);
+  for(const Json & x : cpus)
   {
-    exec("umount /space/tmount");
-    exec("qemu-nbd --disconnect /dev/nbd0");
-    execFail(cr, "failed to create marina root dir on node {}" + c.name());
+    size_t i = x.at(fast ? "cpu-index" : "CPU");
+    if(i < vcpus.size()) vcpus[i] = x.at(fast ? "thread-id" : "thread_id");
   }
 
-  cr = exec(fmt::format("cp {} {}", initscript, "/space/tmount/marina/init"));  
-  if(cr.code != 0)
-  {
-    exec("umount /space/tmount");
-    exec("qemu-nbd --disconnect /dev/nbd0");
-    execFail(cr, "failed to plop initscript into " + c.name());
-  }
+  pid_t pid = qemuPid(pidfile);
+  if(pid <= 0) throw runtime_error{"no qemu pid in " + pidfile};
 
-  cr = exec("cp /home/murphy/host-pkg/libs/* /space/tmount/usr/local/lib/");
-  if(cr.code != 0)
-  {
-    exec("umount /space/tmount");
-    exec("qemu-nbd --disconnect /dev/nbd0");
-    execFail(cr, "failed to plop libs into " + c.name());
-  }
-  
-  cr = exec("cp /home/murphy/host-pkg/bin/* /space/tmount/usr/local/bin/");
-  if(cr.code != 0)
+  //threads qemu starts later on inherit the affinity of the main thread
+  for(pid_t tid : processThreads(pid))
   {
-    exec("umount /space/tmount");
-    exec("qemu-nbd --disconnect /dev/nbd0");
-    execFail(cr, "failed to plop bins into " + c.name());
+    if(std::find(vcpus.begin(), vcpus.end(), tid) != vcpus.end()) continue;
+    pinThread(tid, cpu.emulator);
   }
-  
-  ofs = ofstream{"/space/tmount/etc/ld.so.conf.d/local.conf"};
-  ofs << "/usr/local/lib" << endl;
-  ofs.close();
+  for(size_t i=0; i<vcpus.size(); ++i)
+    if(vcpus[i] > 0) pinThread(vcpus[i], {cpu.vcpus[i]});
+}
 
-  string svc{"/space/tmount/lib/systemd/system/marina.service"};
-  ofs = ofstream{svc};
+void initQemuKvm()
+{
+  LOG(INFO) << "clobbering any existing qemu-system instances";
 
+  CmdResult cr = exec(Command{{"pkill", "qemu-system"}});
+
+  exec(Command{{"modprobe", "-r", "nbd"}});
+  cr = exec(Command{{"modprobe", "nbd", "max_part=8", 
+        fmt::format("nbds_max={}", FLAGS_nbd_devices)}});
+  if(cr.code != 0) execFail(cr, "failed to load the nbd module");
+  nbd_pool.init(FLAGS_nbd_devices);
+
+  LOG(INFO) << "qemu-kvm ready";
+}
+
+const string guest_dir{"/space/marina/guest"};
+
+/*
+ * The files installed into every guest image. At boot marina.service runs
+ * /marina/init which picks up the per-vm configuration from the vfat config
+ * disk labeled MARINA that is attached to the vm.
+ */
+void initGuestFiles()
+{
+  CmdResult cr = exec(Command{{"mkdir", "-p", guest_dir}});
+  if(cr.code != 0) execFail(cr, "failed to create guest file directory");
+
+  ofstream ofs{guest_dir + "/init"};
+  ofs << "#!/bin/sh" << endl
+      << endl
+      << "mkdir -p /marina/config" << endl
+      << "mount -o ro LABEL=MARINA /marina/config || exit 1" << endl
+      << "ldconfig" << endl
+      << "exec /usr/local/bin/marina-netup /marina/config/net.json" << endl;
+  ofs.close();
+  exec(Command{{"chmod", "+x", guest_dir + "/init"}});
+
+  ofs = ofstream{guest_dir + "/marina.service"};
   ofs << "[Unit]" << endl
       << "Description=Init this computer as a part of a marinatb experiment" 
       << endl
@@ -309,36 +618,134 @@ void plopLinuxConfig(const Computer & c, string dst, string img)
       << "[Install]" << endl
       << "WantedBy=multi-user.target" << endl
       << endl;
+  ofs.close();
 
+  //standby vms get their config disk hot plugged long after boot
+  ofs = ofstream{guest_dir + "/99-marina.rules"};
+  ofs << "ACTION==\"add\", SUBSYSTEM==\"block\", ENV{ID_FS_LABEL}==\"MARINA\", "
+      << "RUN+=\"/bin/systemctl --no-block restart marina.service\""
+      << endl;
   ofs.close();
-  
-  string svclink{
-    "/space/tmount/etc/systemd/system/multi-user.target.wants/marina.service"};
 
-  exec(fmt::format("ln -s /lib/systemd/system/marina.service {}", svclink));
-    
-  exec("umount /space/tmount");
-  exec("qemu-nbd --disconnect /dev/nbd0");
+  ofs = ofstream{guest_dir + "/local.conf"};
+  ofs << "/usr/local/lib" << endl;
+  ofs.close();
+}
 
+inline string xpdir(const Blueprint & bp)
+{
+  return fmt::format("/space/xp/{}", bp.id().str());
 }
 
-void launchVm(const Computer & c, const Blueprint & bp)
+//the network plan marina-netup applies in a linux computer, returns its path
+string writeLinuxNetPlan(const Computer & c, string dst)
 {
-  size_t qk_id = qkId.create(c.interfaces().at("cifx").mac());
+  string path = fmt::format("{}/{}-net.json", dst, c.name());
 
-  string arch{"IvyBridge"};
+  Json plan;
+  plan["hostname"] = c.name();
+  plan["interfaces"] = Json::array();
+
+  for(const auto & i : c.interfaces())
+  {
+    const Interface & ifx = i.second;
+
+    Json x;
+    x["name"] = ifx.name();
+    x["mac"] = ifx.mac();
+
+    //the control interface gets its address from the testbed
+    if(ifx.name() == "cifx") x["dhcp"] = true;
+    else x["addrs"] = Json::array({ifx.einfo().ipaddr_v4.cidr()});
+
+    plan["interfaces"].push_back(x);
+  }
+
+  ofstream ofs{path};
+  ofs << plan.dump(2) << endl;
+  ofs.close();
+
+  return path;
+}
+
+//install the marina host packages and boot unit into a guest image
+void installHostPkg(string img)
+{
+  size_t k = nbd_pool.acquire();
+
+  //everything happens in one shell so a failure at any point still unmounts
+  //and disconnects the device
+  Command cmd = Command::shell(fmt::format(
+    "set -e; "
+    "dev=/dev/nbd{k}; mnt=/space/tmount/nbd{k}; "
+    "cleanup() {{ umount \"$mnt\" 2>/dev/null || true; "
+      "qemu-nbd --disconnect \"$dev\" > /dev/null; }}; "
+    "mkdir -p \"$mnt\"; "
+    "qemu-nbd --connect=\"$dev\" {img}; "
+    "trap cleanup EXIT; "
+    "for i in $(seq 50); do [ -b \"${{dev}}p1\" ] && break; sleep 0.1; done; "
+    "mount \"${{dev}}p1\" \"$mnt\"; "
+    "mkdir -p \"$mnt/marina\"; "
+    "cp {pkg}/libs/* \"$mnt/usr/local/lib/\"; "
+    "cp {pkg}/bin/* \"$mnt/usr/local/bin/\"; "
+    "cp {guest}/local.conf \"$mnt/etc/ld.so.conf.d/local.conf\"; "
+    "cp {guest}/init \"$mnt/marina/init\"; "
+    "cp {guest}/marina.service \"$mnt/lib/systemd/system/marina.service\"; "
+    "cp {guest}/99-marina.rules \"$mnt/etc/udev/rules.d/99-marina.rules\"; "
+    "ln -sf /lib/systemd/system/marina.service "
+      "\"$mnt/etc/systemd/system/multi-user.target.wants/marina.service\"",
+    fmt::arg("k", k),
+    fmt::arg("img", img),
+    fmt::arg("pkg", FLAGS_host_pkg),
+    fmt::arg("guest", guest_dir)
+  ), seconds{300});
+
+  CmdResult cr = exec(cmd);
+  nbd_pool.release(k);
+  if(cr.code != 0) execFail(cr, "failed to install host packages into " + img);
+}
+
+//a small vfat disk holding the per-vm configuration, attached to the vm as is
+void makeConfigDisk(string netplan, string cfg)
+{
+  CmdResult cr = exec(Command::shell(fmt::format(
+    "set -e; "
+    "rm -f {cfg}; "
+    "mkfs.vfat -C -n MARINA {cfg} 1024 > /dev/null; "
+    "mcopy -i {cfg} {netplan} ::net.json",
+    fmt::arg("cfg", cfg),
+    fmt::arg("netplan", netplan)
+  ), seconds{30}));
+  if(cr.code != 0) execFail(cr, "failed to create config disk " + cfg);
+}
+
+/*
+ * the state of a single vm as it moves through the launch pipeline
+ */
+struct VmLaunch
+{
+  Computer c;
+  string img, cfg, netblk, ctlmac;
+  size_t qk_id;
+
+  //(mac, vhost-user port id) of each experiment interface
+  vector<pair<string, size_t>> nics{};
+};
+
+VmLaunch prepareVm(const Computer & c, const Blueprint & bp)
+{
+  VmLaunch vm{c, "", "", "", "", 0};
+  vm.qk_id = qkId.create(c.interfaces().at("cifx").mac());
 
   //create qemu interfaces
   size_t k{0};
-  string netblk;
-  string ctlmac;
   for(const auto & i : c.interfaces())
   {
     Interface ifx = i.second;
 
     if(i.first == "cifx") 
     {
-      ctlmac = ifx.mac();
+      vm.ctlmac = ifx.mac();
       continue;
     }
     
@@ -354,111 +761,561 @@ void launchVm(const Computer & c, const Blueprint & bp)
         fmt::arg("k", k)
       );
 
-    netblk += blk;
+    vm.netblk += blk;
+    vm.nics.push_back({ifx.mac(), vhid});
 
     ++k;
   }
 
-  //create the disk image
-  string img_src = fmt::format("/space/images/std/{}.qcow2", c.os());
-  string img = fmt::format("{}/{}.qcow2", xpdir(bp), c.name());
-  string cmd = fmt::format(
-      "qemu-img create -f qcow2 -o backing_file={src} {tgt}",
-      fmt::arg("src", img_src),
-      fmt::arg("tgt", img)
-  );
-  CmdResult cr = exec(cmd);
+  vm.img = fmt::format("{}/{}.qcow2", xpdir(bp), c.name());
+  vm.cfg = fmt::format("{}/{}-config.img", xpdir(bp), c.name());
+  return vm;
+}
+
+/*
+ * Guest layers: an intermediate qcow2 image per (os image, host-pkg content 
+ * hash) with the host packages and boot unit already installed. Vm disks are
+ * thin overlays on top of the layer for their os. Layers are built the first 
+ * time they are needed and a change to host-pkg yields a new hash, and thereby
+ * a new layer, rather than modifying one that running vms may depend on.
+ */
+const string layer_dir{"/space/images/layers"};
+unordered_map<string, shared_future<string>> layers;
+mutex layer_mtx;
+
+//content hash of everything that gets installed into guest images
+string hostPkgHash()
+{
+  CmdResult cr = exec(Command::shell(fmt::format(
+    "find {pkg} {guest} -type f | LC_ALL=C sort | xargs sha256sum | sha256sum",
+    fmt::arg("pkg", FLAGS_host_pkg),
+    fmt::arg("guest", guest_dir)
+  )));
+  if(cr.code != 0) execFail(cr, "failed to hash host packages");
+  return cr.output.substr(0, 16);
+}
+
+void buildGuestLayer(string os, string path)
+{
+  Span span{"guest-layer"};
+  span.arg("layer", path);
+  LOG(INFO) << "building guest layer " << path;
+
+  string tmp = path + ".tmp";
+  CmdResult cr = exec(fmt::format(
+    "mkdir -p {dir} && rm -f {tmp} && "
+    "qemu-img create -f qcow2 "
+      "-o backing_file=/space/images/std/{os}.qcow2,backing_fmt=qcow2 {tmp}",
+    fmt::arg("dir", layer_dir),
+    fmt::arg("os", os),
+    fmt::arg("tmp", tmp)
+  ));
+  if(cr.code != 0) execFail(cr, "failed to create guest layer " + path);
+
+  installHostPkg(tmp);
+
+  //only complete layers ever show up under their final name
+  cr = exec(Command{{"mv", tmp, path}});
+  if(cr.code != 0) execFail(cr, "failed to publish guest layer " + path);
+}
+
+//the guest layer for an os, building it if need be
+string guestLayer(string os, string pkg_hash)
+{
+  string path = fmt::format("{}/{}-{}.qcow2", layer_dir, os, pkg_hash);
+
+  promise<string> built;
+  shared_future<string> pending;
+  {
+    lock_guard<mutex> lk{layer_mtx};
+    auto i = layers.find(path);
+    if(i != layers.end()) pending = i->second;
+    else layers[path] = built.get_future().share();
+  }
+
+  //another launch is already on it
+  if(pending.valid()) return pending.get();
+
+  try
+  {
+    //a layer left behind by an earlier run of host-control is good as is
+    if(access(path.c_str(), F_OK) != 0) buildGuestLayer(os, path);
+    built.set_value(path);
+  }
+  catch(...)
+  {
+    //let the next launch have another go at it
+    built.set_exception(current_exception());
+    lock_guard<mutex> lk{layer_mtx};
+    layers.erase(path);
+    throw;
+  }
+
+  return path;
+}
+
+void createVmDisk(const VmLaunch & vm, string pkg_hash)
+{
+  string img_src = isLinux(vm.c) ? 
+    guestLayer(vm.c.os(), pkg_hash) :
+    fmt::format("/space/images/std/{}.qcow2", vm.c.os());
+
+  CmdResult cr = exec(Command{
+    {"qemu-img", "create", "-f", "qcow2", 
+     "-o", fmt::format("backing_file={},backing_fmt=qcow2", img_src), vm.img},
+    seconds{60}
+  });
   if(cr.code != 0) execFail(cr, "failed to create disk image for vm");
+}
 
-  LOG(INFO) << fmt::format("{name}.qemu = /tmp/mrtb-qk{id}-pid",
-      fmt::arg("name", c.name()),
-      fmt::arg("id", qk_id) 
-    );
-  
-  if(isLinux(c))
+void configureVm(const VmLaunch & vm, const Blueprint & bp)
+{
+  if(isLinux(vm.c))
   {
-    plopLinuxConfig(c, xpdir(bp), img);
+    makeConfigDisk(writeLinuxNetPlan(vm.c, xpdir(bp)), vm.cfg);
   }
   else
   {
-    throw "tomatoes";
+    throw runtime_error{"unsupported os " + vm.c.os()};
   }
+}
 
-  cmd = fmt::format(
+void bootVm(const VmLaunch & vm, const Blueprint & bp)
+{
+  const Computer & c = vm.c;
+  string arch{"IvyBridge"};
+
+  //the vm keeps its cpus and hugepages until it is terminated, they have
+  //normally been reserved when the blueprint was admitted
+  size_t mem = c.memory().megabytes();
+  CpuAssignment cpu = placer->place(vmKey(bp, c), c.cores(), mem);
+
+  LOG(INFO) << fmt::format("{name}.qemu = /tmp/mrtb-qk{id}-pid",
+      fmt::arg("name", c.name()),
+      fmt::arg("id", vm.qk_id) 
+    );
+  LOG(INFO) << fmt::format("{} on node {} cpus {}", 
+      c.name(), cpu.node, cpuList(cpu.vcpus));
+
+  string cmd = fmt::format(
     "qemu-system-x86_64 "
       "--enable-kvm "
       "-cpu {arch} -smp {cores},sockets=1,cores={cores},threads=1 "
-      "-m {mem} -mem-path /dev/hugepages -mem-prealloc "
-      "-object "
-      " memory-backend-file,id=mem0,size={mem}M,mem-path=/dev/hugepages,share=on "
-      "-numa node,memdev=mem0 -mem-prealloc "
+      "-m {mem} "
+      "-object {membackend} "
+      "-numa node,memdev=mem0 "
       "-hda {img} "
+      "-drive file={cfg},format=raw,if=virtio,readonly=on "
       "{netblk} "
       "-vnc 0.0.0.0:{qkid} "
       "-D /{xpdir}/{name}-qlog "
       "-net nic,vlan={qkid},macaddr={ctlmac} "
       "-net user,vlan={qkid},hostfwd=tcp::220{qkid}-:22 "
+      "-qmp unix:/{xpdir}/{name}-qmp,server,nowait "
       "-daemonize "
       "-pidfile /{xpdir}/{name}-qpid",
       fmt::arg("arch", arch),
       fmt::arg("cores", c.cores()),
-      fmt::arg("mem", c.memory().megabytes()),
-      fmt::arg("img", img),
-      fmt::arg("ctlmac", ctlmac),
-      fmt::arg("qkid", qk_id),
-      fmt::arg("netblk", netblk),
+      fmt::arg("mem", mem),
+      fmt::arg("membackend", memoryBackend(mem, cpu)),
+      fmt::arg("img", vm.img),
+      fmt::arg("cfg", vm.cfg),
+      fmt::arg("ctlmac", vm.ctlmac),
+      fmt::arg("qkid", vm.qk_id),
+      fmt::arg("netblk", vm.netblk),
       fmt::arg("xpdir", xpdir(bp)),
       fmt::arg("name", c.name())
   );
 
-  cr = exec(cmd);
+  CmdResult cr = exec(cmd);
 
-  if(cr.code != 0) execFail(cr, "failed to create virtual machine");
+  if(cr.code != 0) 
+  {
+    placer->release(vmKey(bp, c));
+    execFail(cr, "failed to create virtual machine");
+  }
+
+  //an unpinned vm still works, it just does not perform as well
+  string base = fmt::format("/{}/{}", xpdir(bp), c.name());
+  try { pinVm(base + "-qmp", base + "-qpid", cpu); }
+  catch(exception &e) 
+  { 
+    LOG(WARNING) << fmt::format("failed to pin {}: {}", c.name(), e.what());
+  }
 }
 
+/*
+ * Warm pool: pre-booted standby vms for the (os, cores, memory) shapes named
+ * by -warm_pool. A standby vm boots off the guest layer with no experiment
+ * interfaces and is paused once it has settled. A launch that finds a
+ * standby vm of its shape claims it once it gets to boot, hot plugs its 
+ * interfaces and config disk over qmp and resumes it, the udev rule baked 
+ * into the guest layer picks up the config disk. Claimed vms are replaced in 
+ * the background.
+ */
+struct WarmVm
+{
+  size_t id, qk_id;
+  string dir;
+};
 
-void createNetworkBridge(const Network & n)
+class WarmPool
+{
+  public:
+    struct Shape
+    {
+      string os;
+      size_t cores, mem, target;
+
+      deque<shared_ptr<WarmVm>> ready{};
+      size_t booting{0}, hits{0}, misses{0}, failures{0};
+    };
+
+    void init(string spec);
+
+    //the shape of c if a standby vm of it is ready now, nothing is taken
+    //from the pool, a miss is counted otherwise
+    Shape * expect(const Computer & c);
+
+    //a standby vm of the shape, nullptr if there is none left
+    shared_ptr<WarmVm> claim(Shape &);
+
+    //boot standby vms until the shape is back at its target
+    void fill(Shape &);
+
+    Json stats();
+
+  private:
+    void boot(Shape &);
+
+    //deque so shapes stay put as the pool is built up
+    deque<Shape> shapes_;
+    size_t next_id_{0};
+    mutex mtx_;
+};
+
+WarmPool warm_pool;
+
+void WarmPool::init(string spec)
+{
+  std::stringstream ss{spec};
+  string entry;
+  while(std::getline(ss, entry, ','))
+  {
+    Shape s;
+    char c1, eq;
+    std::stringstream es{entry};
+    if(!std::getline(es, s.os, ':') ||
+       !(es >> s.cores >> c1 >> s.mem >> eq >> s.target) || c1 != ':' || eq != '=')
+    {
+      throw runtime_error{"bad warm pool entry `" + entry + "`"};
+    }
+    shapes_.push_back(s);
+  }
+
+  for(Shape & s : shapes_) 
+  {
+    LOG(INFO) << fmt::format("warm pool: keeping {} {}:{}:{} vms on standby",
+        s.target, s.os, s.cores, s.mem);
+    fill(s);
+  }
+}
+
+WarmPool::Shape * WarmPool::expect(const Computer & c)
+{
+  lock_guard<mutex> lk{mtx_};
+  for(Shape & s : shapes_)
+  {
+    if(s.os != c.os() || s.cores != c.cores() || s.mem != c.memory().megabytes())
+      continue;
+
+    if(!s.ready.empty()) return &s;
+    s.misses++;
+    return nullptr;
+  }
+  return nullptr;
+}
+
+shared_ptr<WarmVm> WarmPool::claim(Shape & s)
+{
+  lock_guard<mutex> lk{mtx_};
+  if(s.ready.empty()) 
+  {
+    s.misses++;
+    return nullptr;
+  }
+  s.hits++;
+  auto vm = s.ready.front();
+  s.ready.pop_front();
+  return vm;
+}
+
+void WarmPool::fill(Shape & s)
+{
+  size_t n;
+  {
+    lock_guard<mutex> lk{mtx_};
+    size_t have = s.ready.size() + s.booting;
+    n = have < s.target ? s.target - have : 0;
+    s.booting += n;
+  }
+
+  for(size_t i=0; i<n; ++i) thread{[this,&s](){ boot(s); }}.detach();
+}
+
+void WarmPool::boot(Shape & s)
+{
+  auto vm = make_shared<WarmVm>();
+  {
+    lock_guard<mutex> lk{mtx_};
+    vm->id = next_id_++;
+  }
+  vm->dir = fmt::format("/space/warm/{}", vm->id);
+  vm->qk_id = qkId.create(fmt::format("warm-{}", vm->id));
+
+  Span span{"warm-boot"};
+  span.arg("shape", fmt::format("{}:{}:{}", s.os, s.cores, s.mem));
+
+  string key = fmt::format("warm/{}", vm->id);
+  try
+  {
+    string layer = guestLayer(s.os, hostPkgHash());
+    CpuAssignment cpu = placer->place(key, s.cores, s.mem);
+
+    CmdResult cr = exec(fmt::format(
+      "mkdir -p {dir} && "
+      "qemu-img create -f qcow2 -o backing_file={layer},backing_fmt=qcow2 "
+        "{dir}/disk.qcow2",
+      fmt::arg("dir", vm->dir),
+      fmt::arg("layer", layer)
+    ));
+    if(cr.code != 0) execFail(cr, "failed to create standby vm disk");
+
+    cr = exec(fmt::format(
+      "qemu-system-x86_64 "
+        "--enable-kvm "
+        "-cpu IvyBridge -smp {cores},sockets=1,cores={cores},threads=1 "
+        "-m {mem} "
+        "-object {membackend} "
+        "-numa node,memdev=mem0 "
+        "-hda {dir}/disk.qcow2 "
+        "-net none "
+        "-vnc 0.0.0.0:{qkid} "
+        "-D {dir}/qlog "
+        "-qmp unix:{dir}/qmp,server,nowait "
+        "-daemonize "
+        "-pidfile {dir}/qpid",
+        fmt::arg("cores", s.cores),
+        fmt::arg("mem", s.mem),
+        fmt::arg("membackend", memoryBackend(s.mem, cpu)),
+        fmt::arg("dir", vm->dir),
+        fmt::arg("qkid", vm->qk_id)
+    ));
+    if(cr.code != 0) execFail(cr, "failed to boot standby vm");
+    pinVm(vm->dir + "/qmp", vm->dir + "/qpid", cpu);
+
+    //let the guest come all the way up, then stop burning cpu on it, in a
+    //dry run there is no guest to wait for
+    if(!FLAGS_dry_run)
+    {
+      std::this_thread::sleep_for(
+          std::chrono::seconds{FLAGS_warm_pool_settle_s});
+      Qmp{vm->dir + "/qmp"}.execute("stop");
+    }
+
+    lock_guard<mutex> lk{mtx_};
+    s.booting--;
+    s.ready.push_back(vm);
+  }
+  catch(exception &e)
+  {
+    LOG(ERROR) << "warm pool: standby vm " << vm->id << ": " << e.what();
+    qkId.erase(fmt::format("warm-{}", vm->id));
+    exec(fmt::format("kill `cat {dir}/qpid`; rm -rf {dir}", 
+          fmt::arg("dir", vm->dir)));
+    placer->release(key);
+
+    lock_guard<mutex> lk{mtx_};
+    s.booting--;
+    s.failures++;
+  }
+}
+
+Json WarmPool::stats()
+{
+  lock_guard<mutex> lk{mtx_};
+
+  Json j;
+  size_t hits{0}, misses{0};
+  vector<Json> shapes;
+  for(const Shape & s : shapes_)
+  {
+    Json x;
+    x["os"] = s.os;
+    x["cores"] = s.cores;
+    x["memory_mb"] = s.mem;
+    x["target"] = s.target;
+    x["ready"] = s.ready.size();
+    x["booting"] = s.booting;
+    x["hits"] = s.hits;
+    x["misses"] = s.misses;
+    x["failures"] = s.failures;
+    shapes.push_back(x);
+    hits += s.hits;
+    misses += s.misses;
+  }
+  j["shapes"] = shapes;
+  j["hits"] = hits;
+  j["misses"] = misses;
+  j["hit_rate"] = hits + misses > 0 ? double(hits) / (hits + misses) : 0.0;
+  return j;
+}
+
+void initWarmPool()
+{
+  exec(Command{{"rm", "-rf", "/space/warm"}});
+  if(FLAGS_warm_pool.empty()) return;
+  warm_pool.init(FLAGS_warm_pool);
+}
+
+//plug the interfaces and config disk of vm into a standby vm and resume it
+void hotplugWarmVm(const VmLaunch & vm, string qmp_sock)
+{
+  Qmp qmp{qmp_sock};
+
+  Json ctl;
+  ctl["type"] = "user";
+  ctl["id"] = "ctl";
+  ctl["hostfwd"] = fmt::format("tcp::220{}-:22", vm.qk_id);
+  qmp.execute("netdev_add", ctl);
+  qmp.execute("device_add", 
+      {{"driver", "virtio-net-pci"}, {"netdev", "ctl"}, {"mac", vm.ctlmac}});
+
+  for(size_t k=0; k<vm.nics.size(); ++k)
+  {
+    Json chr;
+    chr["id"] = fmt::format("chr{}", k);
+    chr["backend"]["type"] = "socket";
+    chr["backend"]["data"]["server"] = false;
+    chr["backend"]["data"]["addr"]["type"] = "unix";
+    chr["backend"]["data"]["addr"]["data"]["path"] = 
+      fmt::format("/var/run/openvswitch/mrtb-vhu-{}", vm.nics[k].second);
+    qmp.execute("chardev-add", chr);
+
+    Json net;
+    net["type"] = "vhost-user";
+    net["id"] = fmt::format("net{}", k);
+    net["chardev"] = fmt::format("chr{}", k);
+    net["vhostforce"] = true;
+    qmp.execute("netdev_add", net);
+
+    qmp.execute("device_add", {
+        {"driver", "virtio-net-pci"}, 
+        {"netdev", fmt::format("net{}", k)}, 
+        {"mac", vm.nics[k].first}
+    });
+  }
+
+  Json cfg;
+  cfg["driver"] = "raw";
+  cfg["node-name"] = "cfg";
+  cfg["read-only"] = true;
+  cfg["file"]["driver"] = "file";
+  cfg["file"]["filename"] = vm.cfg;
+  qmp.execute("blockdev-add", cfg);
+  qmp.execute("device_add", {{"driver", "virtio-blk-pci"}, {"drive", "cfg"}});
+
+  qmp.execute("cont");
+}
+
+//turn a standby vm into vm
+void attachWarmVm(const VmLaunch & vm, const WarmVm & w, const Blueprint & bp)
+{
+  const Computer & c = vm.c;
+  string base = fmt::format("/{}/{}", xpdir(bp), c.name());
+
+  //from here on the vm is managed like any other vm of the blueprint
+  CmdResult cr = exec(Command::shell(fmt::format(
+    "set -e; "
+    "mv \"{dir}/disk.qcow2\" \"{img}\"; mv \"{dir}/qpid\" \"{base}-qpid\"; "
+    "mv \"{dir}/qmp\" \"{base}-qmp\"; mv \"{dir}/qlog\" \"{base}-qlog\"; "
+    "rmdir \"{dir}\"",
+    fmt::arg("dir", w.dir),
+    fmt::arg("img", vm.img),
+    fmt::arg("base", base)
+  )));
+  if(cr.code != 0) 
+  {
+    //a standby that could not be adopted is of no use, wherever its pidfile
+    //got to it is taken down along with its reservation
+    exec(Command::shell(fmt::format(
+      "kill $(cat \"{dir}/qpid\" \"{base}-qpid\" 2>/dev/null); "
+      "rm -rf \"{dir}\"",
+      fmt::arg("dir", w.dir),
+      fmt::arg("base", base)
+    )));
+    placer->release(fmt::format("warm/{}", w.id));
+    execFail(cr, "failed to adopt standby vm for " + c.name());
+  }
+
+  //the standby vm is already pinned, its cpus and memory carry over and
+  //what was reserved for the vm when it was admitted is given back
+  placer->rename(fmt::format("warm/{}", w.id), vmKey(bp, c));
+
+  LOG(INFO) << fmt::format("{} <- standby vm {}", c.name(), w.id);
+  if(FLAGS_dry_run) return;
+
+  try { hotplugWarmVm(vm, base + "-qmp"); }
+  catch(...)
+  {
+    //a half plugged vm is of no use to anyone
+    exec(fmt::format("kill `cat {}-qpid`", base));
+    placer->release(vmKey(bp, c));
+    throw;
+  }
+}
+
+http::Response poolStatus(http::Message)
+{
+  return http::Response{ http::Status::OK(), warm_pool.stats().dump(2) };
+}
+
+http::Response cpuStatus(http::Message)
+{
+  return http::Response{ http::Status::OK(), placer->json().dump(2) };
+}
+
+//what is left on this host for new vms, the materialization service embeds
+//blueprints against this
+http::Response capacity(http::Message)
+{
+  Json j = placer->capacity();
+  j["cores"] = std::max(thread::hardware_concurrency(), 1u);
+  j["tunnel_addr"] = FLAGS_pbr_addr.substr(0, FLAGS_pbr_addr.find('/'));
+  return http::Response{ http::Status::OK(), j.dump(2) };
+}
+
+void createNetworkBridge(OvsTxn & txn, const Network & n, 
+    const NetworkMzInfo & z)
 {
   //create a bridge for the network
   size_t net_id = bridgeId.create(n.id());
 
   string br_id = fmt::format("mrtb-vbr-{}", net_id);
-
-  string cmd = fmt::format(
-    "ovs-vsctl add-br {id} -- set bridge {id} datapath_type=netdev", 
-    fmt::arg("id", br_id)
-  );
+  txn.addBridge(br_id, "netdev");
   LOG(INFO) << fmt::format("{}.net-bridge = {}", n.name(), br_id);
 
-  CmdResult cr = exec(cmd);
-  if(cr.code != 0) execFail(cr, "failed to create network bridge");
-
-  //TODO we only need to setup vxlan on the network if it has remote
-  //elements (likely) and we should be figuring out the addresses of
-  //the remotes with the embedding info
-  //string remote_ip{"192.168.247.2"};
-  string remote_ip = FLAGS_remote_addr;
-
-  string vx_id = fmt::format("vxlan{}", net_id);
-
-  //hook experiment-vxlan up to the network-bridge
-  cmd = fmt::format(
-    "ovs-vsctl add-port {id} {vxid} "
-    "-- set Interface {vxid} type=vxlan "
-    "options:remote_ip={ip} options:key={vni}",
-    fmt::arg("id", br_id),
-    fmt::arg("vxid", vx_id),
-    fmt::arg("ip", remote_ip)
-    //fmt::arg("vni", n.einfo().vni) TODO oldmuffins
-  );
-
-  cr = exec(cmd);
-  if(cr.code != 0) execFail(cr, "failed to setup vxlan for network " + n.name());
-
-  LOG(INFO) << fmt::format("{}.vxlan = {}", br_id, vx_id);
+  //one tunnel to the data plane address of each host that shares the
+  //network, materializations that do not say which hosts those are go
+  //through the configured remote
+  addTunnels(txn, br_id, net_id, z, FLAGS_remote_addr);
+  if(z.remotes.empty())
+    LOG(INFO) << fmt::format("{}.vxlan -> {}", br_id, FLAGS_remote_addr);
+  for(const string & r : z.remotes)
+    LOG(INFO) << fmt::format("{}.vxlan -> {}", br_id, r);
 }
 
-void createComputerPort(const Network & n, string mac)
+void createComputerPort(OvsTxn & txn, const Network & n, string mac)
 {
   string br_id = fmt::format("mrtb-vbr-{}", bridgeId.get(n.id()));
 
@@ -466,24 +1323,15 @@ void createComputerPort(const Network & n, string mac)
   string po_id = fmt::format("mrtb-vhu-{}", vhost_id);
 
   LOG(INFO) << fmt::format("{}.uplink = {}", mac, po_id);
- 
-  string cmd = fmt::format(
-    "ovs-vsctl add-port {bid} {pid} -- set Interface {pid} type=dpdkvhostuser",
-    fmt::arg("bid", br_id),
-    fmt::arg("pid", po_id)
-  );
-
   LOG(INFO) << fmt::format("{} -- {}", br_id, po_id);
 
-  CmdResult cr = exec(cmd);
-
-  if(cr.code != 0) execFail(cr, "failed to create computer port");
+  txn.addPort(br_id, po_id, "dpdkvhostuser");
 }
 
 void initXpDir(const Blueprint & bp)
 {
-  exec(fmt::format("rm -rf {}", xpdir(bp)));
-  CmdResult cr = exec(fmt::format("mkdir -p {}", xpdir(bp)));
+  exec(Command{{"rm", "-rf", xpdir(bp)}});
+  CmdResult cr = exec(Command{{"mkdir", "-p", xpdir(bp)}});
   if(cr.code != 0) execFail(cr, "failed to create experiment directory");
 
   {
@@ -493,130 +1341,345 @@ void initXpDir(const Blueprint & bp)
   }
 }
 
-void launchNetworks(const Blueprint & bp)
+void launchNetworks(const HostMaterialization & hm)
 {
+  //all of the bridges and ports go to ovsdb as a single transaction
+  OvsTxn txn;
+  const Blueprint & bp = hm.blueprint;
   for(const auto & p : bp.networks()) 
   {
     const Network & n = p.second;
-    createNetworkBridge(n);
+    createNetworkBridge(txn, n, hm.networks.at(n.id()));
     for(auto & p : bp.connectedComputers(n))
     {
-      createComputerPort(n, p.second.mac());
+      createComputerPort(txn, n, p.second.mac());
     }
   }
+
+  ovsCommit(txn, "create network bridges");
 }
 
-void launchComputers(Blueprint & bp)
+PipelineReport launchComputers(Blueprint & bp, JobProgress & progress)
 {
-  //TODO with EChart
-  /*
-  using LS = Computer::EmbeddingInfo::LaunchState;
-  for(const auto & c : bp.computers())
-  {
-    c.second.embedding().launch_state = LS::Queued;
-  }
-  */
-
   //TODO need to do this more granularly, e.g. just update the launch state
   //because this is an overwriting race between the host controllers
   //db->saveMaterialization(bp.project(), bp.name(), bp.json());
 
+  //vm disks, guest configuration and qemu boots overlap across vms
+  Pipeline pipeline{
+    {
+      {"disk", static_cast<size_t>(FLAGS_launch_io)},
+      {"config", static_cast<size_t>(FLAGS_launch_io)},
+      {"boot", static_cast<size_t>(FLAGS_launch_workers)}
+    },
+    static_cast<size_t>(FLAGS_launch_workers)
+  };
+
+  string pkg_hash = hostPkgHash();
+
+  size_t n = bp.computers().size();
+  progress.begin("disks", n);
+  progress.begin("config", n);
+  progress.begin("boot", n);
+
+  //each step stops short if the materialization has been cancelled
+  JobProgress *p = &progress;
+  auto step = [p](string stage, std::function<void()> f)
+  {
+    return [p,stage,f](){ p->check(); f(); p->advance(stage); };
+  };
+
+  vector<Pipeline::Job> jobs;
   for(const auto & c : bp.computers())
   {
-    //TODO with EChart
-    //c.second.embedding().launch_state = LS::Launching;
-    launchVm(c.second, bp);
-    //TODO with EChart
-    //c.second.embedding().launch_state = LS::Up;
+    auto vm = std::make_shared<VmLaunch>(prepareVm(c.second, bp));
+    size_t cores = std::min<size_t>(c.second.cores(), cpu_budget->capacity());
+
+    //the standby vm is only claimed once the computer gets to boot, one
+    //claimed any earlier would be stranded by a failed or cancelled step,
+    //if the pool has run dry by then the computer boots cold after all
+    WarmPool::Shape *shape = warm_pool.expect(c.second);
+    if(shape != nullptr)
+    {
+      jobs.push_back({
+        c.second.name(),
+        {
+          {step("disks", [](){})},
+          {step("config", [vm,&bp](){ configureVm(*vm, bp); }), 
+            {{io_budget.get(), 1}}},
+          {step("boot", [vm,shape,pkg_hash,&bp]()
+          {
+            auto warm = warm_pool.claim(*shape);
+            if(!warm)
+            {
+              createVmDisk(*vm, pkg_hash);
+              bootVm(*vm, bp);
+              return;
+            }
+            warm_pool.fill(*shape);
+
+            //the standby vm keeps the qk id its vnc and ssh ports were set 
+            //up with, from now on it is kept under the computer and freed 
+            //with it
+            qkId.rename(fmt::format("warm-{}", warm->id), vm->ctlmac);
+            vm->qk_id = warm->qk_id;
+            attachWarmVm(*vm, *warm, bp);
+          })}
+        }
+      });
+      continue;
+    }
+
+    jobs.push_back({
+      c.second.name(),
+      {
+        {step("disks", [vm,pkg_hash](){ createVmDisk(*vm, pkg_hash); }), 
+          {{io_budget.get(), 1}}},
+        {step("config", [vm,&bp](){ configureVm(*vm, bp); }), 
+          {{io_budget.get(), 1}}},
+        {step("boot", [vm,&bp](){ bootVm(*vm, bp); }), 
+          {{cpu_budget.get(), cores}}}
+      }
+    });
   }
+
+  PipelineReport report = pipeline.run(jobs);
+  LOG(INFO) << "launch " << bp.name() << ": " << report.summary();
+
+  for(const auto & e : report.errors)
+    LOG(ERROR) << "failed to launch " << e.first << ": " << e.second;
+
+  return report;
 }
 
-http::Response construct(Json j)
+http::Response construct(http::Message m)
 {
   LOG(INFO) << "construct request";
-  LOG(INFO) << j.dump(2);
 
-  thread t{[j](){
-    try
-    {
-      auto bp = Blueprint::fromJson(j); 
+  //error reports carry the document, it is only built as a tree on that path
+  auto doc = [&m]() -> Json
+  {
+    try { return m.bodyAsJson(); }
+    catch(invalid_argument &) { return m.bodyAsString(); }
+  };
 
-      lb_lk.lock();
-      live_blueprints.insert_or_assign(bp.id(), bp);
-      lb_lk.unlock();
+  //json bodies are read straight into the materialization, wire bodies are
+  //compact already and go through the decoder
+  shared_ptr<HostMaterialization> hm;
+  try
+  {
+    string body = m.bodyAsString();
+    hm = make_shared<HostMaterialization>(
+        m.encoding() == http::Encoding::Wire ?
+          HostMaterialization::fromJson(wire::decode(body)) :
+          HostMaterialization::parse(body.data(), body.size()));
+  }
+  catch(invalid_argument &e)
+  {
+    LOG(ERROR) << "invalid json: " << e.what();
+    return http::Response{ http::Status::BadRequest(), "invalid json" };
+  }
+  catch(out_of_range &e) { return badRequest("construct", doc(), e); }
+  LOG(INFO) << "construct " << hm->blueprint.name();
 
-      LOG(INFO) 
-        << "materializaing " 
-        << bp.computers().size()  << " computers"
-        << " across "
-        << bp.networks().size() << " networks";
+  try
+  {
+    const Blueprint & bp = hm->blueprint;
 
-      initXpDir(bp);
-      launchNetworks(bp);
-      launchComputers(bp);
+    try { placeComputers(bp); }
+    catch(InsufficientHugepages &e)
+    {
+      LOG(WARNING) << "turning away " << bp.name() << ": " << e.what();
+      Json r;
+      r["status"] = "insufficient hugepages";
+      r["error"] = e.what();
+      r["capacity"] = placer->capacity();
+      return http::Response{ http::Status::ServiceUnavailable(), r.dump() };
+    }
 
-      LOG(INFO) << fmt::format("{name}({id}) has been materialized",
-            fmt::arg("name", bp.name()),
-            fmt::arg("id", bp.id().str())
-          );
+    //the materialization outlives this request, carry its trace along
+    TraceContext ctx = Trace::current();
+
+    auto admission = jobs->submit(
+      bp.id().str(), 
+      bp.name(),
+      {"dir", "networks", "disks", "config", "boot"},
+      [hm,ctx](JobProgress & progress)
+      {
+        Span span{"materialize", ctx};
+        Blueprint & bp = hm->blueprint;
+
+        lb_lk.lock();
+        live_blueprints.insert_or_assign(bp.id(), bp);
+        lb_lk.unlock();
+
+        LOG(INFO) 
+          << "materializaing " 
+          << bp.computers().size()  << " computers"
+          << " across "
+          << bp.networks().size() << " networks";
+
+        progress.begin("dir");
+        initXpDir(bp);
+        progress.advance("dir");
+
+        progress.begin("networks");
+        launchNetworks(*hm);
+        progress.advance("networks");
+
+        PipelineReport report = launchComputers(bp, progress);
+
+        lb_lk.lock();
+        launch_reports.insert_or_assign(bp.id(), report);
+        lb_lk.unlock();
+
+        progress.check();
+        if(!report.errors.empty())
+          throw runtime_error{fmt::format("{} of {} computers failed to launch",
+              report.errors.size(), bp.computers().size())};
+
+        LOG(INFO) << fmt::format("{name}({id}) has been materialized",
+              fmt::arg("name", bp.name()),
+              fmt::arg("id", bp.id().str())
+            );
+      }
+    );
 
+    Json r;
+    switch(admission)
+    {
+      case JobScheduler::Admission::Accepted:
+        r["status"] = "materializing";
+        return http::Response{ http::Status::OK(), r.dump() };
+
+      case JobScheduler::Admission::Duplicate:
+        r["status"] = "already materializing";
+        return http::Response{ http::Status::Conflict(), r.dump() };
+
+      case JobScheduler::Admission::Busy:
+        LOG(WARNING) << "construct queue full, turning away " << bp.name();
+        releaseComputers(bp);
+        r["status"] = "busy";
+        return http::Response{ http::Status::ServiceUnavailable(), r.dump() };
     }
-    catch(out_of_range &e) { badRequest("construct", j, e); }
-    catch(exception &e) { unexpectedFailure("construct", j, e); }
-  }};
+  }
+  catch(out_of_range &e) { return badRequest("construct", doc(), e); }
+  catch(exception &e) { return unexpectedFailure("construct", doc(), e); }
+
+  throw runtime_error{"unreachable"};
+}
 
-  //TODO perhaps the better thing to do here would be to create a
-  //thread pointer and put it in a map that is keyed on the blueprint
-  //id that is being materialized, that way we could support things
-  //like cancellation and possibly better progress reporting
-  t.detach();
+/*
+ * The experiment directory holds the vm disk overlays which can take a good
+ * while to delete, so it is moved out of the way and removed in the 
+ * background. Once moved a blueprint can be materialized again right away.
+ */
+void delXpDir(const Blueprint &bp, vector<string> & errors)
+{
+  static atomic<size_t> n{0};
+  string dir = xpdir(bp);
+  string trash = fmt::format("{}.trash.{}", dir, n++);
 
-  Json r;
-  r["status"] = "materializing";
-  return http::Response{ http::Status::OK(), r.dump() };
+  if(rename(dir.c_str(), trash.c_str()) != 0)
+  {
+    if(errno != ENOENT) 
+      errors.push_back(fmt::format("move {}: {}", dir, strerror(errno)));
+    return;
+  }
 
+  Executor::global().submit(Command{{"rm", "-rf", trash}});
 }
 
-void delXpDir(const Blueprint &bp)
+//the pid a qemu instance left behind, 0 if there is none
+pid_t qemuPid(string pidfile)
 {
-  exec(fmt::format("rm -rf {}", xpdir(bp)));
+  std::ifstream ifs{pidfile};
+  pid_t pid{0};
+  if(!(ifs >> pid)) return 0;
+  return pid;
 }
 
-void terminateComputers(const Blueprint & bp)
+/*
+ * All vms are signaled at once and then waited on together, any that are
+ * still around when the grace period runs out are killed. Vms that have no
+ * pid file are already gone.
+ */
+void terminateComputers(const Blueprint & bp, vector<string> & errors)
 {
+  vector<pair<string, pid_t>> live;
   for(const auto & c : bp.computers())
   {
-    string cmd = 
-      fmt::format("kill `cat /{xpdir}/{name}-qpid`",
-        fmt::arg("xpdir", xpdir(bp)),
-        fmt::arg("name", c.second.name())
-      );
-    CmdResult cr = exec(cmd);
-    if(cr.code != 0) 
-      execFail(cr, 
-          fmt::format("failed to terminate computer {}/{}", 
-            bp.id().str(), 
-            c.second.name())
-      );
+    const Computer & x = c.second;
+
+    //the qk id goes whether or not the vm ever got as far as a pidfile
+    qkId.erase(x.interfaces().at("cifx").mac());
+
+    pid_t pid = qemuPid(fmt::format("{}/{}-qpid", xpdir(bp), x.name()));
+    if(pid <= 0) continue;
+
+    if(kill(pid, SIGTERM) == 0) live.push_back({x.name(), pid});
+    else if(errno != ESRCH)
+      errors.push_back(fmt::format("signal {}({}): {}", 
+            x.name(), pid, strerror(errno)));
+  }
 
-    qkId.erase(c.second.interfaces().at("cifx").mac());
-   
+  //including vms that never made it as far as booting
+  releaseComputers(bp);
+
+  auto deadline = steady_clock::now() + milliseconds{FLAGS_teardown_grace_ms};
+  while(!live.empty())
+  {
+    live.erase(
+      std::remove_if(live.begin(), live.end(), [](const auto & x){
+        return kill(x.second, 0) != 0 && errno == ESRCH;
+      }),
+      live.end()
+    );
+    if(live.empty()) break;
+
+    if(steady_clock::now() >= deadline)
+    {
+      for(const auto & x : live)
+      {
+        LOG(WARNING) << fmt::format("{}({}) did not shut down in time, killing",
+            x.first, x.second);
+        kill(x.second, SIGKILL);
+      }
+      break;
+    }
+    sleep_for(milliseconds{10});
   }
 }
 
-void terminateNetworks(const Blueprint & bp)
+/*
+ * All bridges go in one ovs transaction. Networks this host no longer knows
+ * about have been torn down already.
+ */
+void terminateNetworks(const Blueprint & bp, vector<string> & errors)
 {
+  OvsTxn txn;
+  vector<const Network*> nets;
   for(const auto & p : bp.networks())
   {
     const Network & n = p.second;
-    string br_id = fmt::format("mrtb-vbr-{}", bridgeId.get(n.id()));
-    string cmd = fmt::format("ovs-vsctl del-br {}", br_id);
-    CmdResult cr = exec(cmd);
-    if(cr.code != 0) execFail(cr, "failed to terminate network bridge "+br_id);
+    if(!bridgeId.has(n.id())) continue;
+    txn.delBridge(fmt::format("mrtb-vbr-{}", bridgeId.get(n.id())));
+    nets.push_back(&n);
+  }
 
-    bridgeId.erase(n.id());
+  try { ovsCommit(txn, "terminate network bridges"); }
+  catch(exception &e)
+  {
+    //keep the ids around so a retry can have another go at the bridges
+    errors.push_back(e.what());
+    return;
+  }
+
+  for(const Network *n : nets)
+  {
+    bridgeId.erase(n->id());
     
-    for(auto & p : bp.connectedComputers(n))
+    for(auto & p : bp.connectedComputers(*n))
     {
       vhostId.erase(p.second.mac());
     }
@@ -632,16 +1695,38 @@ http::Response destruct(Json j)
   {
     auto bp = Blueprint::fromJson(j);
 
-    terminateComputers(bp);
-    terminateNetworks(bp);
-    delXpDir(bp);
+    //a materialization still in progress is stopped before tearing down
+    if(jobs->cancel(bp.id().str()))
+      LOG(INFO) << "cancelled materialization of " << bp.name();
+    jobs->wait(bp.id().str());
+
+    //every part of the teardown is attempted, failures are collected
+    vector<string> errors;
+    terminateComputers(bp, errors);
+    terminateNetworks(bp, errors);
+    delXpDir(bp, errors);
+
+    lb_lk.lock();
+    live_blueprints.erase(bp.id());
+    launch_reports.erase(bp.id());
+    lb_lk.unlock();
+
+    Json r;
+    if(!errors.empty())
+    {
+      for(const string & e : errors) 
+        LOG(ERROR) << "destruct " << bp.name() << ": " << e;
+
+      r["status"] = "incomplete";
+      r["errors"] = errors;
+      return http::Response{ http::Status::InternalServerError(), r.dump() };
+    }
     
     LOG(INFO) << fmt::format("{name}({guid}) has been dematerialized",
           fmt::arg("name", bp.name()),
           fmt::arg("guid", bp.id().str())
         );
 
-    Json r;
     r["status"] = "ok";
     return http::Response{ http::Status::OK(), r.dump() };
   }
@@ -665,10 +1750,18 @@ http::Response info(Json j)
 
   try
   {
-    return http::Response{ 
-      http::Status::OK(), 
-      live_blueprints.at(bpid).json().dump(2)
-    };
+    const Blueprint & bp = live_blueprints.at(bpid);
+    Json r = bp.json();
+
+    Json placement = Json::object();
+    for(const auto & c : bp.computers())
+    {
+      auto a = placer->assignment(vmKey(bp, c.second));
+      if(a) placement[c.second.name()] = a->json();
+    }
+    r["placement"] = placement;
+
+    return http::Response{ http::Status::OK(), r.dump(2) };
   }
   catch(out_of_range)
   {
@@ -684,6 +1777,57 @@ http::Response info(Json j)
   catch(exception &e) { return unexpectedFailure("list", j, e); }
 }
 
+http::Response jobStatus(http::Message)
+{
+  return http::Response{ http::Status::OK(), jobs->json().dump(2) };
+}
+
+http::Response cancel(Json j)
+{
+  try
+  {
+    string id = Uuid::fromJson(extract(j, "bpid", "cancel-request")).str();
+
+    Json r;
+    r["status"] = jobs->cancel(id) ? "cancelling" : "not materializing";
+    return http::Response{ http::Status::OK(), r.dump() };
+  }
+  catch(out_of_range &e) { return badRequest("cancel", j, e); }
+  catch(exception &e) { return unexpectedFailure("cancel", j, e); }
+}
+
+http::Response execStats(http::Message)
+{
+  Json j = Executor::global().stats();
+  return http::Response{ http::Status::OK(), j.dump(2) };
+}
+
+http::Response launchReport(Json j)
+{
+  LOG(INFO) << "launch-report request";
+
+  Uuid bpid;
+  try
+  {
+    bpid = Uuid::fromJson(extract(j, "bpid", "launch-report-request"));
+  }
+  catch(out_of_range &e) { return badRequest("launch-report", j, e); }
+
+  lb_lk.lock();
+  auto i = launch_reports.find(bpid);
+  Json r = i == launch_reports.end() ? Json{} : i->second.json();
+  lb_lk.unlock();
+
+  if(r.is_null())
+  {
+    Json msg;
+    msg["error"] = "bpid "+bpid.str()+" has not been launched here";
+    return http::Response{ http::Status::BadRequest(), msg.dump(2) };
+  }
+
+  return http::Response{ http::Status::OK(), r.dump(2) };
+}
+
 http::Response list(Json)
 {
   throw runtime_error{"not implemented"};
@@ -0,0 +1,292 @@
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "core/jobs.hxx"
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using std::make_shared;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::atomic;
+using std::exception;
+using std::out_of_range;
+using std::runtime_error;
+using namespace std::chrono;
+using namespace marina;
+
+struct JobProgress::Job
+{
+  struct Stage
+  {
+    string name, state{"pending"};
+    size_t done{0}, total{0};
+  };
+
+  string id, name, state{"queued"}, error;
+  vector<Stage> stages;
+  JobScheduler::Work work;
+  atomic<bool> cancel{false};
+  steady_clock::time_point submitted, started, finished;
+
+  bool active() const { return state == "queued" || state == "running"; }
+
+  Stage & stage(const string & name)
+  {
+    for(auto & s : stages) if(s.name == name) return s;
+    stages.push_back(Stage{name});
+    return stages.back();
+  }
+
+  //settle the stages once the job is over one way or another
+  void close(string outcome)
+  {
+    state = outcome;
+    finished = steady_clock::now();
+    for(auto & s : stages)
+    {
+      if(s.state == "pending") s.state = "skipped";
+      else if(s.state == "running") s.state = outcome;
+    }
+  }
+};
+
+JobCancelled::JobCancelled(string id)
+  : runtime_error{"job " + id + " cancelled"}
+{}
+
+// JobProgress -----------------------------------------------------------------
+
+JobProgress::JobProgress(shared_ptr<Job> job, mutex & mtx)
+  : job_{job},
+    mtx_{mtx}
+{}
+
+void JobProgress::begin(const string & stage, size_t total)
+{
+  check();
+
+  lock_guard<mutex> lk{mtx_};
+  auto & s = job_->stage(stage);
+  s.total = total;
+  if(s.state == "pending") s.state = s.done >= total ? "done" : "running";
+}
+
+void JobProgress::advance(const string & stage, size_t n)
+{
+  lock_guard<mutex> lk{mtx_};
+  auto & s = job_->stage(stage);
+  s.done += n;
+  if(s.done >= s.total) s.state = "done";
+}
+
+bool JobProgress::cancelled() const { return job_->cancel; }
+
+void JobProgress::check() const
+{
+  if(job_->cancel) throw JobCancelled{job_->id};
+}
+
+// JobScheduler ----------------------------------------------------------------
+
+JobScheduler::JobScheduler(size_t workers, size_t queue_limit, size_t history)
+  : queue_limit_{queue_limit},
+    history_{history}
+{
+  for(size_t i=0; i<std::max<size_t>(workers, 1); ++i)
+    workers_.emplace_back([this](){ work(); });
+}
+
+JobScheduler::~JobScheduler()
+{
+  {
+    lock_guard<mutex> lk{mtx_};
+    stop_ = true;
+    for(auto & j : queue_)
+    {
+      j->close("cancelled");
+      retire(j);
+    }
+    queue_.clear();
+    for(auto & j : jobs_) j.second->cancel = true;
+  }
+  cv_.notify_all();
+  idle_.notify_all();
+
+  for(auto & w : workers_) w.join();
+}
+
+JobScheduler::Admission
+JobScheduler::submit(string id, string name, vector<string> stages, Work work)
+{
+  lock_guard<mutex> lk{mtx_};
+
+  auto i = jobs_.find(id);
+  if(i != jobs_.end() && i->second->active()) return Admission::Duplicate;
+  if(stop_ || queue_.size() >= queue_limit_) return Admission::Busy;
+
+  auto job = make_shared<Job>();
+  job->id = id;
+  job->name = name;
+  job->work = work;
+  job->submitted = steady_clock::now();
+  for(const string & s : stages) job->stages.push_back(Job::Stage{s});
+
+  jobs_[id] = job;
+  queue_.push_back(job);
+  cv_.notify_one();
+  return Admission::Accepted;
+}
+
+bool JobScheduler::cancel(const string & id)
+{
+  lock_guard<mutex> lk{mtx_};
+
+  auto i = jobs_.find(id);
+  if(i == jobs_.end() || !i->second->active()) return false;
+  auto job = i->second;
+
+  job->cancel = true;
+  if(job->state == "queued")
+  {
+    queue_.erase(std::find(queue_.begin(), queue_.end(), job));
+    job->close("cancelled");
+    retire(job);
+    idle_.notify_all();
+  }
+  return true;
+}
+
+void JobScheduler::wait(const string & id)
+{
+  unique_lock<mutex> lk{mtx_};
+  idle_.wait(lk, [this,&id](){
+    auto i = jobs_.find(id);
+    return i == jobs_.end() || !i->second->active();
+  });
+}
+
+void JobScheduler::work()
+{
+  for(;;)
+  {
+    shared_ptr<Job> job;
+    {
+      unique_lock<mutex> lk{mtx_};
+      cv_.wait(lk, [this](){ return stop_ || !queue_.empty(); });
+      if(queue_.empty()) return;
+
+      job = queue_.front();
+      queue_.pop_front();
+      job->state = "running";
+      job->started = steady_clock::now();
+      running_++;
+    }
+
+    string outcome{"done"}, error;
+    try
+    {
+      JobProgress progress{job, mtx_};
+      job->work(progress);
+    }
+    catch(JobCancelled &) { outcome = "cancelled"; }
+    catch(exception &e)
+    {
+      outcome = "failed";
+      error = e.what();
+    }
+
+    {
+      lock_guard<mutex> lk{mtx_};
+      job->error = error;
+      job->close(outcome);
+      job->work = nullptr;
+      running_--;
+      retire(job);
+    }
+    idle_.notify_all();
+  }
+}
+
+//keep a bounded number of finished jobs around for lookups
+void JobScheduler::retire(shared_ptr<Job> job)
+{
+  done_.push_back(job);
+  while(done_.size() > history_)
+  {
+    auto old = done_.front();
+    done_.pop_front();
+
+    auto i = jobs_.find(old->id);
+    if(i != jobs_.end() && i->second == old) jobs_.erase(i);
+  }
+}
+
+Json JobScheduler::jobJson(const Job & job) const
+{
+  auto now = steady_clock::now();
+  auto ms = [](steady_clock::duration d){
+    return duration_cast<microseconds>(d).count() / 1e3;
+  };
+
+  Json j;
+  j["id"] = job.id;
+  j["name"] = job.name;
+  j["state"] = job.state;
+  if(!job.error.empty()) j["error"] = job.error;
+
+  //jobs cancelled while queued never start
+  bool started = job.started != steady_clock::time_point{};
+  auto end = job.active() ? now : job.finished;
+  j["queued_ms"] = ms((started ? job.started : end) - job.submitted);
+  if(started) j["run_ms"] = ms(end - job.started);
+
+  vector<Json> stages;
+  for(const auto & s : job.stages)
+  {
+    Json js;
+    js["name"] = s.name;
+    js["state"] = s.state;
+    js["done"] = s.done;
+    js["total"] = s.total;
+    stages.push_back(js);
+  }
+  j["stages"] = stages;
+
+  return j;
+}
+
+Json JobScheduler::json(const string & id) const
+{
+  lock_guard<mutex> lk{mtx_};
+  auto i = jobs_.find(id);
+  if(i == jobs_.end()) throw out_of_range{"no job " + id};
+  return jobJson(*i->second);
+}
+
+Json JobScheduler::json() const
+{
+  lock_guard<mutex> lk{mtx_};
+
+  //most recently submitted first
+  vector<shared_ptr<Job>> js;
+  for(const auto & j : jobs_) js.push_back(j.second);
+  std::sort(js.begin(), js.end(), [](const auto & a, const auto & b){
+    return a->submitted > b->submitted;
+  });
+
+  Json j;
+  j["workers"] = workers_.size();
+  j["running"] = running_;
+  j["queued"] = queue_.size();
+  j["queue_limit"] = queue_limit_;
+
+  vector<Json> jobs;
+  for(const auto & x : js) jobs.push_back(jobJson(*x));
+  j["jobs"] = jobs;
+
+  return j;
+}
@@ -0,0 +1,105 @@
+#ifndef MARINA_CORE_JOBS_HXX
+#define MARINA_CORE_JOBS_HXX
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+#include "3p/json/src/json.hpp"
+
+namespace marina
+{
+  using Json = nlohmann::json;
+
+  //thrown out of a job that has been asked to stop
+  struct JobCancelled : public std::runtime_error
+  {
+    JobCancelled(std::string id);
+  };
+
+  /*
+   * The view a running job has of itself. Stages are declared up front and
+   * the work reports its way through them, several stages may be in progress
+   * at once. Entering a stage is where a cancelled job stops.
+   */
+  class JobProgress
+  {
+    public:
+      //mark a stage as started with this many units of work in it
+      void begin(const std::string & stage, size_t total = 1);
+
+      //n more units of a stage are done, the stage is done once all are
+      void advance(const std::string & stage, size_t n = 1);
+
+      bool cancelled() const;
+
+      //throws JobCancelled if the job has been cancelled
+      void check() const;
+
+    private:
+      friend class JobScheduler;
+      struct Job;
+      JobProgress(std::shared_ptr<Job>, std::mutex &);
+
+      std::shared_ptr<Job> job_;
+      std::mutex & mtx_;
+  };
+
+  /*
+   * Runs long lived jobs, e.g. materializations, on a fixed pool of workers.
+   * At most one job per id is active at a time and jobs that do not fit in
+   * the admission queue are turned away instead of piling up. Finished jobs
+   * are remembered for a while so their outcome can be looked up.
+   */
+  class JobScheduler
+  {
+    public:
+      using Work = std::function<void(JobProgress &)>;
+
+      enum class Admission { Accepted, Busy, Duplicate };
+
+      JobScheduler(size_t workers, size_t queue_limit, size_t history = 64);
+      ~JobScheduler();
+
+      JobScheduler(const JobScheduler &) = delete;
+      JobScheduler & operator=(const JobScheduler &) = delete;
+
+      Admission submit(std::string id, std::string name,
+                       std::vector<std::string> stages, Work);
+
+      //a queued job is dropped, a running one is told to stop, returns false
+      //if there is no active job with this id
+      bool cancel(const std::string & id);
+
+      //block until the job with this id, if any, is no longer active
+      void wait(const std::string & id);
+
+      //throws out_of_range for an unknown id
+      Json json(const std::string & id) const;
+      Json json() const;
+
+    private:
+      using Job = JobProgress::Job;
+
+      void work();
+      void retire(std::shared_ptr<Job>);
+      Json jobJson(const Job &) const;
+
+      size_t queue_limit_, history_;
+      std::unordered_map<std::string, std::shared_ptr<Job>> jobs_;
+      std::deque<std::shared_ptr<Job>> queue_, done_;
+      size_t running_{0};
+      bool stop_{false};
+      mutable std::mutex mtx_;
+      std::condition_variable cv_, idle_;
+      std::vector<std::thread> workers_;
+  };
+}
+
+#endif
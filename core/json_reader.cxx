@@ -0,0 +1,360 @@
+#include <cstdlib>
+#include <limits>
+#include "core/json_reader.hxx"
+
+using std::to_string;
+using std::out_of_range;
+using namespace marina;
+
+namespace
+{
+  //deeper than anything marina writes, keeps skip() off the end of the stack
+  constexpr size_t max_depth = 512;
+
+  bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+  int hexval(char c)
+  {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  void utf8(std::string & s, uint32_t cp)
+  {
+    if(cp < 0x80) s += static_cast<char>(cp);
+    else if(cp < 0x800)
+    {
+      s += static_cast<char>(0xc0 | cp >> 6);
+      s += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else if(cp < 0x10000)
+    {
+      s += static_cast<char>(0xe0 | cp >> 12);
+      s += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+      s += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else
+    {
+      s += static_cast<char>(0xf0 | cp >> 18);
+      s += static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+      s += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+      s += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+  }
+}
+
+JsonParseError::JsonParseError(
+    const std::string & what, size_t line, size_t column)
+  : invalid_argument{
+      "json " + to_string(line) + ":" + to_string(column) + ": " + what
+    },
+    line{line},
+    column{column}
+{}
+
+JsonReader::JsonReader(const char *data, size_t size)
+  : begin_{data},
+    p_{data},
+    end_{data + size}
+{}
+
+// position --------------------------------------------------------------------
+
+size_t JsonReader::line() const
+{
+  size_t n{1};
+  for(const char *c = begin_; c < p_; ++c) if(*c == '\n') ++n;
+  return n;
+}
+
+size_t JsonReader::column() const
+{
+  const char *c = p_;
+  while(c > begin_ && *(c-1) != '\n') --c;
+  return p_ - c + 1;
+}
+
+void JsonReader::fail(const std::string & what) const
+{
+  throw JsonParseError{what, line(), column()};
+}
+
+void JsonReader::missing(
+    const std::string & context, const std::string & key) const
+{
+  throw out_of_range{
+    "error extracting " + context + ":" + key + " (object ending at " +
+    to_string(line()) + ":" + to_string(column()) + ")"
+  };
+}
+
+// scanning --------------------------------------------------------------------
+
+void JsonReader::ws()
+{
+  while(p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\t' || *p_ == '\r'))
+    ++p_;
+}
+
+char JsonReader::next()
+{
+  if(p_ == end_) fail("unexpected end of document");
+  return *p_++;
+}
+
+void JsonReader::expect(char c)
+{
+  ws();
+  if(p_ == end_)
+    fail(std::string{"expected '"} + c + "' but the document ended");
+  if(*p_ != c)
+    fail(std::string{"expected '"} + c + "' but found '" + *p_ + "'");
+  ++p_;
+}
+
+JsonReader::Type JsonReader::peek()
+{
+  ws();
+  if(p_ == end_) fail("unexpected end of document");
+  switch(*p_)
+  {
+    case '{': return Type::Object;
+    case '[': return Type::Array;
+    case '"': return Type::String;
+    case 't':
+    case 'f': return Type::Bool;
+    case 'n': return Type::Null;
+    default:
+      if(*p_ == '-' || isDigit(*p_)) return Type::Number;
+      fail(std::string{"unexpected '"} + *p_ + "'");
+  }
+}
+
+void JsonReader::end()
+{
+  ws();
+  if(p_ != end_) fail("trailing characters after the document");
+}
+
+// structure -------------------------------------------------------------------
+
+void JsonReader::beginObject()
+{
+  expect('{');
+  first_.push_back(true);
+}
+
+void JsonReader::beginArray()
+{
+  expect('[');
+  first_.push_back(true);
+}
+
+bool JsonReader::more(char close)
+{
+  ws();
+  if(p_ < end_ && *p_ == close)
+  {
+    ++p_;
+    first_.pop_back();
+    return false;
+  }
+  if(!first_.back()) expect(',');
+  first_.back() = false;
+  return true;
+}
+
+bool JsonReader::key(std::string & k)
+{
+  if(!more('}')) return false;
+  k = string();
+  expect(':');
+  return true;
+}
+
+bool JsonReader::element()
+{
+  return more(']');
+}
+
+void JsonReader::skip()
+{
+  switch(peek())
+  {
+    case Type::Null: null(); return;
+    case Type::Bool: boolean(); return;
+    case Type::Number: numberText(); return;
+    case Type::String: string(); return;
+    case Type::Array:
+      if(first_.size() >= max_depth) fail("nested too deep");
+      beginArray();
+      while(element()) skip();
+      return;
+    case Type::Object:
+    {
+      if(first_.size() >= max_depth) fail("nested too deep");
+      beginObject();
+      std::string k;
+      while(key(k)) skip();
+      return;
+    }
+  }
+}
+
+// scalars ---------------------------------------------------------------------
+
+std::string JsonReader::string()
+{
+  expect('"');
+
+  std::string s;
+  for(;;)
+  {
+    const char *run = p_;
+    while(p_ < end_ && *p_ != '"' && *p_ != '\\' &&
+          static_cast<unsigned char>(*p_) >= 0x20) ++p_;
+    s.append(run, p_);
+
+    char c = next();
+    if(c == '"') return s;
+    if(c != '\\')
+    {
+      --p_;
+      fail("control character in string");
+    }
+
+    switch(next())
+    {
+      case '"': s += '"'; break;
+      case '\\': s += '\\'; break;
+      case '/': s += '/'; break;
+      case 'b': s += '\b'; break;
+      case 'f': s += '\f'; break;
+      case 'n': s += '\n'; break;
+      case 'r': s += '\r'; break;
+      case 't': s += '\t'; break;
+      case 'u':
+      {
+        auto hex4 = [this]()
+        {
+          uint32_t x{0};
+          for(size_t i=0; i<4; ++i)
+          {
+            int h = hexval(next());
+            if(h < 0) { --p_; fail("bad \\u escape"); }
+            x = x << 4 | h;
+          }
+          return x;
+        };
+
+        uint32_t cp = hex4();
+        if(cp >= 0xd800 && cp <= 0xdbff)
+        {
+          if(next() != '\\' || next() != 'u') fail("unpaired surrogate");
+          uint32_t lo = hex4();
+          if(lo < 0xdc00 || lo > 0xdfff) fail("unpaired surrogate");
+          cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+        }
+        utf8(s, cp);
+        break;
+      }
+      default:
+        --p_;
+        fail("bad escape");
+    }
+  }
+}
+
+//the text of the next number, checked against the json number grammar
+std::string JsonReader::numberText()
+{
+  ws();
+  const char *start = p_;
+
+  auto digits = [this]()
+  {
+    if(p_ == end_ || !isDigit(*p_)) fail("expected a digit");
+    while(p_ < end_ && isDigit(*p_)) ++p_;
+  };
+
+  if(p_ < end_ && *p_ == '-') ++p_;
+  if(p_ < end_ && *p_ == '0') ++p_;
+  else digits();
+
+  if(p_ < end_ && *p_ == '.')
+  {
+    ++p_;
+    digits();
+  }
+  if(p_ < end_ && (*p_ == 'e' || *p_ == 'E'))
+  {
+    ++p_;
+    if(p_ < end_ && (*p_ == '+' || *p_ == '-')) ++p_;
+    digits();
+  }
+
+  return std::string(start, p_);
+}
+
+uint64_t JsonReader::uint()
+{
+  std::string s = numberText();
+  uint64_t x{0};
+  for(char c : s)
+  {
+    if(!isDigit(c)) fail("expected an unsigned integer, found " + s);
+    if(x > (std::numeric_limits<uint64_t>::max() - (c - '0')) / 10)
+      fail("integer out of range " + s);
+    x = x*10 + (c - '0');
+  }
+  return x;
+}
+
+int64_t JsonReader::integer()
+{
+  ws();
+  bool neg = p_ < end_ && *p_ == '-';
+  if(neg) ++p_;
+  uint64_t x = uint();
+
+  uint64_t limit = neg ?
+    uint64_t(std::numeric_limits<int64_t>::max()) + 1 :
+    uint64_t(std::numeric_limits<int64_t>::max());
+  if(x > limit) fail("integer out of range");
+  return neg ? -static_cast<int64_t>(x - 1) - 1 : static_cast<int64_t>(x);
+}
+
+double JsonReader::number()
+{
+  return std::strtod(numberText().c_str(), nullptr);
+}
+
+bool JsonReader::boolean()
+{
+  ws();
+  auto word = [this](const char *w, size_t n)
+  {
+    if(size_t(end_ - p_) >= n && std::string(p_, n) == w)
+    {
+      p_ += n;
+      return true;
+    }
+    return false;
+  };
+  if(word("true", 4)) return true;
+  if(word("false", 5)) return false;
+  fail("expected true or false");
+}
+
+void JsonReader::null()
+{
+  ws();
+  if(size_t(end_ - p_) >= 4 && std::string(p_, 4) == "null")
+  {
+    p_ += 4;
+    return;
+  }
+  fail("expected null");
+}
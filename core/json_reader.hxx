@@ -0,0 +1,86 @@
+#ifndef MARINA_CORE_JSON_READER_HXX
+#define MARINA_CORE_JSON_READER_HXX
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace marina
+{
+  //a syntax error, the message carries the line and column it was found at
+  struct JsonParseError : public std::invalid_argument
+  {
+    JsonParseError(const std::string & what, size_t line, size_t column);
+
+    size_t line, column;
+  };
+
+  /*
+   * A pull parser over a json document held in a char buffer. Model types
+   * read themselves straight out of the document with it, so no Json tree is
+   * built in between. The buffer is not copied and has to outlive the
+   * reader. Objects and arrays are walked like
+   *
+   *   r.beginObject();
+   *   std::string k;
+   *   while(r.key(k))
+   *   {
+   *     if(k == "name") name = r.string();
+   *     else r.skip();
+   *   }
+   *
+   * Syntax errors throw JsonParseError, a required key an object turns out
+   * not to have is reported through missing() which throws out_of_range
+   * like extract() does.
+   */
+  class JsonReader
+  {
+    public:
+      enum class Type { Null, Bool, Number, String, Array, Object };
+
+      JsonReader(const char *data, size_t size);
+
+      //the type of the next value
+      Type peek();
+
+      void beginObject();
+      //the next key of the innermost object, false once it is done
+      bool key(std::string &);
+
+      void beginArray();
+      //whether the innermost array has another element
+      bool element();
+
+      std::string string();
+      uint64_t uint();
+      int64_t integer();
+      double number();
+      bool boolean();
+      void null();
+
+      //step over the next value whatever it is
+      void skip();
+
+      //nothing but whitespace may follow the document
+      void end();
+
+      [[noreturn]] void fail(const std::string & what) const;
+      [[noreturn]] void missing(const std::string & context,
+                                const std::string & key) const;
+
+      size_t line() const;
+      size_t column() const;
+
+    private:
+      void ws();
+      char next();
+      void expect(char c);
+      bool more(char close);
+      std::string numberText();
+
+      const char *begin_, *p_, *end_;
+      std::vector<bool> first_;
+  };
+}
+
+#endif
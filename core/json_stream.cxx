@@ -0,0 +1,125 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include "core/json_stream.hxx"
+
+using std::string;
+using std::runtime_error;
+using std::chrono::milliseconds;
+using namespace marina;
+
+size_t marina::jsonValueLength(const string & s)
+{
+  size_t i{0};
+  while(i < s.size() && isspace(s[i])) ++i;
+  if(i == s.size()) return 0;
+  if(s[i] != '{' && s[i] != '[')
+    throw runtime_error{"json stream: unexpected framing"};
+
+  size_t depth{0};
+  bool in_string{false}, escaped{false};
+  for(; i < s.size(); ++i)
+  {
+    char c = s[i];
+    if(in_string)
+    {
+      if(escaped) escaped = false;
+      else if(c == '\\') escaped = true;
+      else if(c == '"') in_string = false;
+      continue;
+    }
+    switch(c)
+    {
+      case '"': in_string = true; break;
+      case '{': case '[': ++depth; break;
+      case '}': case ']': if(--depth == 0) return i+1; break;
+    }
+  }
+  return 0;
+}
+
+JsonStream::JsonStream(string socket_path)
+  : path_{socket_path}
+{}
+
+JsonStream::~JsonStream() { close(); }
+
+void JsonStream::connect()
+{
+  close();
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd_ < 0) throw runtime_error{"socket: " + string{strerror(errno)}};
+
+  sockaddr_un sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strncpy(sa.sun_path, path_.c_str(), sizeof(sa.sun_path)-1);
+
+  if(::connect(fd_, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0)
+  {
+    string err = strerror(errno);
+    close();
+    throw runtime_error{"connect " + path_ + ": " + err};
+  }
+}
+
+bool JsonStream::connected() const { return fd_ >= 0; }
+
+void JsonStream::close()
+{
+  if(fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+  rxbuf_.clear();
+}
+
+const string & JsonStream::path() const { return path_; }
+
+void JsonStream::send(const Json & j)
+{
+  string s = j.dump();
+  size_t sent{0};
+  while(sent < s.size())
+  {
+    ssize_t n = ::send(fd_, s.data()+sent, s.size()-sent, MSG_NOSIGNAL);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0)
+    {
+      close();
+      throw runtime_error{path_ + ": send failed"};
+    }
+    sent += n;
+  }
+}
+
+Json JsonStream::receive(milliseconds timeout)
+{
+  char buf[65536];
+  for(;;)
+  {
+    size_t n = jsonValueLength(rxbuf_);
+    if(n > 0)
+    {
+      Json j = Json::parse(rxbuf_.substr(0, n));
+      rxbuf_.erase(0, n);
+      return j;
+    }
+
+    pollfd pfd{fd_, POLLIN, 0};
+    int pr = poll(&pfd, 1, timeout.count());
+    if(pr < 0 && errno == EINTR) continue;
+    if(pr == 0) throw runtime_error{path_ + ": timed out waiting for reply"};
+
+    ssize_t r = recv(fd_, buf, sizeof(buf), 0);
+    if(r < 0 && errno == EINTR) continue;
+    if(r <= 0)
+    {
+      close();
+      throw runtime_error{path_ + ": connection closed"};
+    }
+    rxbuf_.append(buf, r);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef MARINA_CORE_JSON_STREAM_HXX
+#define MARINA_CORE_JSON_STREAM_HXX
+
+#include <string>
+#include <chrono>
+#include "3p/json/src/json.hpp"
+
+namespace marina
+{
+  using Json = nlohmann::json;
+
+  /*
+   * A unix stream socket carrying back to back json values with no other
+   * framing, as spoken by ovsdb-server and the qemu monitor protocol
+   */
+  class JsonStream
+  {
+    public:
+      JsonStream(std::string socket_path);
+      ~JsonStream();
+
+      JsonStream(const JsonStream &) = delete;
+      JsonStream & operator=(const JsonStream &) = delete;
+
+      void connect();
+      bool connected() const;
+      void close();
+
+      void send(const Json &);
+
+      //the next json value, throws if none arrives within the timeout
+      Json receive(std::chrono::milliseconds timeout);
+
+      const std::string & path() const;
+
+    private:
+      std::string path_;
+      int fd_{-1};
+      std::string rxbuf_;
+  };
+
+  //the length of the first complete json value in s, 0 if there is none yet
+  size_t jsonValueLength(const std::string & s);
+}
+
+#endif
@@ -1,32 +1,54 @@
 /*******************************************************************************
  *
- *  mac_2_ifname: given a mac address return the corresponding interface name
+ *  mac_2_ifname: given mac addresses return the corresponding interface names
  *
- *  usage: mac2ifname <mac>
+ *  usage: mac2ifname <mac> [<mac> ...]
  *
- *  build: c++ -std=c++14 mac2ifname.cxx -o mac2ifname
+ *  prints one interface name per line in the order the macs were given, all
+ *  of them resolved from a single dump of the link table
+ *
+ *  build: c++ -std=c++14 mac2ifname.cxx netlink.cxx -o mac2ifname
  *
  ******************************************************************************/
 
-#include "core/util.hxx"
+#include <iostream>
+#include <net/if_arp.h>
+#include "core/netlink.hxx"
 
 using std::cerr;
 using std::cout;
 using std::endl;
-using std::out_of_range;
 using std::string;
+using std::exception;
 using namespace marina;
 
 int main(int argc, char **argv)
 {
-  if(argc != 2)
+  if(argc < 2)
   {
-    cerr << "usage: mac2ifname <mac>" << endl;
+    cerr << "usage: mac2ifname <mac> [<mac> ...]" << endl;
     return 1;
   }
-  try { cout << mac_2_ifname(string{argv[1]}) << endl; }
-  catch(out_of_range &e) 
-  { 
+
+  try
+  {
+    LinkCache links{false};
+
+    int missing{0};
+    for(int i=1; i<argc; ++i)
+    {
+      auto l = links.byMac(argv[i]);
+      if(l && l->type == ARPHRD_ETHER) cout << l->name << endl;
+      else
+      {
+        cerr << argv[i] << " not found" << endl;
+        missing++;
+      }
+    }
+    return missing ? 1 : 0;
+  }
+  catch(exception &e)
+  {
     cerr << e.what() << endl;
     return 1;
   }
@@ -0,0 +1,99 @@
+/*******************************************************************************
+ *
+ *  marina-netup: bring up the network of a marina guest from a plan
+ *
+ *  usage: marina-netup <plan.json>
+ *
+ *  the plan names the computer and lists its interfaces by mac
+ *
+ *    {
+ *      "hostname": "a",
+ *      "interfaces": [
+ *        { "name": "cifx", "mac": "02:..", "dhcp": true },
+ *        { "name": "ifx0", "mac": "02:..", "addrs": ["10.47.0.2/24"] }
+ *      ]
+ *    }
+ *
+ *  all interfaces are resolved from one link table and configured in a single
+ *  netlink batch, interfaces that use dhcp are then handed to dhclient
+ *
+ ******************************************************************************/
+
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include "3p/json/src/json.hpp"
+#include "core/netlink.hxx"
+
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using std::string;
+using std::vector;
+using std::exception;
+using std::chrono::seconds;
+using Json = nlohmann::json;
+using namespace marina;
+
+int main(int argc, char **argv)
+{
+  if(argc != 2)
+  {
+    cerr << "usage: marina-netup <plan.json>" << endl;
+    return 1;
+  }
+
+  try
+  {
+    Json plan;
+    ifstream{argv[1]} >> plan;
+
+    string hostname = plan.at("hostname");
+    if(sethostname(hostname.c_str(), hostname.size()) != 0)
+      cerr << "failed to set hostname " << hostname << endl;
+
+    //nics may still be coming up, hot plugged ones in particular
+    LinkCache links;
+    LinkBatch batch;
+    vector<string> dhcp;
+
+    for(const Json & ifx : plan.at("interfaces"))
+    {
+      string mac = ifx.at("mac");
+      auto link = links.waitForMac(mac, seconds{10});
+      if(!link)
+      {
+        cerr << "no interface with mac " << mac << endl;
+        return 1;
+      }
+
+      if(ifx.count("addrs"))
+        for(const Json & a : ifx.at("addrs"))
+          batch.addAddress(link->index, a.get<string>());
+      batch.setUp(link->index);
+
+      if(ifx.value("dhcp", false)) dhcp.push_back(link->name);
+    }
+
+    batch.commit();
+
+    if(!dhcp.empty())
+    {
+      vector<char*> args{const_cast<char*>("dhclient")};
+      for(string & d : dhcp) args.push_back(&d[0]);
+      args.push_back(nullptr);
+      execvp("dhclient", args.data());
+
+      cerr << "failed to run dhclient" << endl;
+      return 1;
+    }
+  }
+  catch(exception &e)
+  {
+    cerr << e.what() << endl;
+    return 1;
+  }
+}
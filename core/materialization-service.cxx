@@ -10,14 +10,26 @@
 #include "core/util.hxx"
 #include "core/materialization.hxx"
 #include "3p/pipes/pipes.hxx"
+#include <gflags/gflags.h>
+#include <future>
+#include <thread>
+#include <chrono>
 
 using std::string;
 using std::unique_ptr;
-using std::unordered_set;
+using std::unordered_map;
 using std::future;
+using std::promise;
+using std::shared_ptr;
+using std::make_shared;
+using std::thread;
+using std::future_status;
+using std::chrono::steady_clock;
+using std::chrono::seconds;
 using std::vector;
 using std::exception;
 using std::out_of_range;
+using std::runtime_error;
 using std::endl;
 using std::lock_guard;
 using std::mutex;
@@ -28,6 +40,9 @@ using proxygen::HTTPMethod;
 using namespace marina;
 using namespace pipes;
 
+DEFINE_int32(capacity_timeout, 5,
+    "seconds to wait for the capacity reports of the hosts");
+
 static const string not_implemented{R"({"error": "not implemented"})"};
 
 http::Response construct(Json);
@@ -40,9 +55,12 @@ http::Response status(Json);
 static unique_ptr<DB> db{nullptr};
 static MzMap mzm;
 
+void fetchCapacity(EChart &);
+
 int main(int argc, char **argv)
 {
   Glog::init("mzn-service");
+  Trace::init("materialization");
   LOG(INFO) << "materialization service starting";
 
   gflags::SetUsageMessage("usage: materialization");
@@ -91,6 +109,7 @@ http::Response construct(Json j)
     lock_guard<mutex> lk{mzn.mtx};
     TestbedTopology topo = db->fetchHwTopo();
     EChart ec{topo};
+    fetchCapacity(ec);
 
     // compute the materialization embedding
     // --
@@ -98,6 +117,7 @@ http::Response construct(Json j)
     // of topo that bas bp emedded inside
 
     auto embedding = embed(bp, ec, topo);
+    Placement placement = Placement::of(embedding);
     
     //TODO vxlan.vni: this is a centralized database attribute for now
     //however in the future this should be a distributed agreement variable
@@ -105,86 +125,136 @@ http::Response construct(Json j)
     //care about such a materialization implementation detail. Maybehapps
     //this could be a place to use riak/redis/memcached @ the host-controller 
     //level
-    for(auto & p : bp.networks())
+    assignAddresses(bp, mzn.networks, [](const Network & n)
     {
-      Network & n = p.second;
-      //setup vxlan virtual network identifier
-      mzn.networks[n.id()].vni = db->newVxlanVni(n.id().str());
-
-      //set interface ip addresses
-      IpV4Address a = n.ipv4();
-
-      for( auto & c : bp.connectedComputers(n) )
-      {
-        if(a.netZero()) a++;
-        Interface & ifx = c.second;
-        ifx.einfo().ipaddr_v4 = a;
-        a++;
-      }
+      return db->newVxlanVni(n.id().str());
+    });
+
+    //the embedding keeps networks off hosts that never said where their
+    //tunnels end as far as it can, a network that spans one anyway cannot 
+    //be built and the vnis taken out for the blueprint go back
+    unordered_map<string, HostMaterialization> parts;
+    try { parts = partition(bp, placement, mzn.networks); }
+    catch(runtime_error &e)
+    {
+      for(const auto & n : bp.networks())
+        db->freeVxlanVni(n.second.id().str());
+      LOG(ERROR) << "construct " << bp.name() << ": " << e.what();
+      return http::Response{ http::Status::ServiceUnavailable(), e.what() };
     }
 
     //call out to all of the selected materialization hosts asking them to 
-    //materialize their portion of the blueprint
-    vector<future<http::Message>> replys;
+    //materialize their portion of the blueprint, each host gets a single
+    //request holding everything it needs and the hosts are driven 
+    //concurrently
+    vector<pair<string, future<http::Message>>> replys;
+    TraceContext ctx = Trace::current();
+
+    for(const auto & p : parts)
+    {
+      string host = p.first;
+      replys.push_back(make_pair(host, std::async(std::launch::async,
+        [ctx, host, rq = p.second.json()]()
+        {
+          Trace::current(ctx);
+          HttpRequest req{HTTPMethod::POST, "https://"+host+"/construct", rq,
+            http::Encoding::Wire};
+          return req.response().get();
+        }
+      )));
+    }
 
-    //TODO: need to get a subset of hosts specific to this blueprint
-    //as it is now all hosts will get embedding commands
-    for(const auto & p : embedding.hmap)
+    vector<string> failed;
+    for(auto & r : replys)
     {
-      const auto & h = p.second;
-      //vector<pair<Computer, ComputerMzInfo>> host_mz_info;
-      vector<Json> host_mz_info;
-      for(const auto & m : h.machines)
+      try
       {
-        const auto & z = mzn.machines.at(m.first);
-        //host_mz_info.push_back(make_pair(m.second, z));
-        Json j;
-        j["computer"] = m.second.json();
-        j["mz-info"] = z.json();
-        host_mz_info.push_back(j);
+        http::Message m = r.second.get();
+        if(m.msg == nullptr || m.msg->getStatusCode() != 200)
+          throw runtime_error{m.bodyAsString()};
       }
-
-      for(const auto & j : host_mz_info)
+      catch(exception &e)
       {
-        replys.push_back(
-          HttpRequest
-          {
-            HTTPMethod::POST,
-            "https://"+h.host.name()+"/construct",
-            j.dump()
-          }
-          .response()
-        );
+        LOG(ERROR) << "construct on " << r.first << " failed: " << e.what();
+        failed.push_back(r.first);
       }
-
-      //TODO with new embedding code ^^^ -- in theory done above
-      /*
-      Blueprint lbp = bp.localEmbedding(h.host.name());
-
-      replys.push_back(
-        HttpRequest
-        {
-          HTTPMethod::POST,
-          "https://"+h.host.name()+"/construct",
-          //rq.dump()
-          lbp.json().dump()
-        }
-        .response()
-      );
-      */
     }
 
-    // save the embedding to the database
-    db->saveMaterialization(project, bpid, bp.json());
+    // save the embedding to the database, along with the hosts it went to so
+    // that it can be torn down on them
+    Json doc = bp.json();
+    doc["placement"] = placement.json();
+    db->saveMaterialization(project, bpid, doc);
     //db->setHwTopo(embedding.json());
 
     // return result to caller
     j["action"] = "constructed";
+    j["hosts"] = replys.size();
+    if(!failed.empty()) j["failed"] = failed;
     return http::Response{ http::Status::OK(), j.dump() };
   }
   catch(exception &e) { return unexpectedFailure("construct", j, e); }
 }
 
+/*
+ * Ask every host for the hugepage memory it has left on each numa node so the
+ * embedding only puts vms where they can be backed, and for the data plane
+ * address its vxlan tunnels end at. Hosts that do not answer are embedded 
+ * against their declared memory, and networks cannot span them, the
+ * embedding fills the hosts that did answer first.
+ */
+void fetchCapacity(EChart & ec)
+{
+  vector<pair<Uuid, future<http::Message>>> replys;
+  TraceContext ctx = Trace::current();
+
+  //the requests run detached, a host that never answers is given up on at
+  //the deadline without holding up the embedding until it does
+  for(const auto & p : ec.hmap)
+  {
+    string host = p.second.host.name();
+    auto reply = make_shared<promise<http::Message>>();
+    replys.push_back(make_pair(p.first, reply->get_future()));
+    thread([ctx, host, reply]()
+    {
+      Trace::current(ctx);
+      try
+      {
+        HttpRequest req{HTTPMethod::GET, "https://"+host+"/capacity"};
+        reply->set_value(req.response().get());
+      }
+      catch(...) { reply->set_exception(std::current_exception()); }
+    }).detach();
+  }
+
+  auto deadline = steady_clock::now() + seconds{FLAGS_capacity_timeout};
+  for(auto & r : replys)
+  {
+    HostEmbedding & he = ec.hmap.at(r.first);
+    try
+    {
+      if(r.second.wait_until(deadline) != future_status::ready)
+        throw runtime_error{"timed out"};
+
+      http::Message m = r.second.get();
+      if(m.msg == nullptr || m.msg->getStatusCode() != 200)
+        throw runtime_error{m.bodyAsString()};
+
+      Json c = m.bodyAsJson();
+      vector<size_t> free;
+      for(const Json & n : c.at("nodes"))
+        free.push_back(n.at("hugepage_available_mb"));
+      he.numa_free_mb = free;
+      he.tunnel_addr = c.value("tunnel_addr", string{});
+    }
+    catch(exception &e)
+    {
+      LOG(WARNING) << "no capacity report from " << he.host.name() << ": " 
+                   << e.what();
+    }
+  }
+}
+
 http::Response info(Json j)
 {
   //extract request parameters
@@ -225,73 +295,87 @@ http::Response destruct(Json j)
     Blueprint bp = db->fetchMaterialization(project, bpid);
     TestbedTopology topo = db->fetchHwTopo();
 
-    EChart ec{topo}; // = db->fetchEChart();
-    
-    //compute the set of hosts containing computers in this blueprint
-    unordered_set<string> hosts;
-    for(const auto & c : bp.computers()) 
+    //the share of this blueprint on each host it was built on, a
+    //materialization saved without its placement is torn down everywhere
+    Placement placement;
+    Json pj = db->fetchPlacement(project, bpid);
+    if(!pj.is_null()) placement = Placement::fromJson(pj);
+    else
     {
-      for(const auto & p : ec.hmap)
-      {
-        const auto & h = p.second;
-        if(h.machines.find(c.second.id()) != h.machines.end()) 
-          hosts.insert(h.host.name());
-      }
+      LOG(WARNING) << "no placement saved for " << bp.name() 
+                   << ", destructing on every host";
+      for(const auto & h : topo.hosts())
+        for(const auto & c : bp.computers())
+          placement.hosts[h.second.name()].computers.push_back(c.first);
     }
-    /*
-    for(const auto & c : bp.computers()) 
+    auto hosts = partition(bp, placement);
+   
+    //each host is asked to tear down its portion of the blueprint, all hosts
+    //at once
+    vector<pair<string, future<http::Message>>> replys;
+    TraceContext ctx = Trace::current();
+
+    for(const auto & h : hosts)
     {
-      hosts.insert(c.second.embedding().host);
+      LOG(INFO) << "destructing " << bp.name() << " on " << h.first;
+
+      string host = h.first;
+      replys.push_back(make_pair(host, std::async(std::launch::async,
+        [ctx, host, rq = h.second.blueprint.json()]()
+        {
+          Trace::current(ctx);
+          HttpRequest req{HTTPMethod::POST, "https://"+host+"/destruct", rq,
+            http::Encoding::Wire};
+          return req.response().get();
+        }
+      )));
     }
-    */
 
-    for(const auto & n : bp.networks())
+    vector<string> failed;
+    for(auto & r : replys)
     {
-      db->freeVxlanVni(n.second.id().str());
+      try
+      {
+        http::Message m = r.second.get();
+        if(m.msg == nullptr || m.msg->getStatusCode() != 200)
+          throw runtime_error{m.bodyAsString()};
+      }
+      catch(exception &e)
+      {
+        LOG(ERROR) << "destruct on " << r.first << " failed: " << e.what();
+        failed.push_back(r.first);
+      }
     }
-   
-    //async command to remove computers and networks from relevant hosts
-    vector<future<http::Message>> replys;
-    for(const string & h : hosts)
-    {
-      LOG(INFO) << "destructing " << bp.name() << " on " << h;
-
-      auto hosts = bp.computers()
-        | map<vector>([](const auto & x) { return x.first.str(); });
+    
+    Json r;
+    r["project"] = project;
+    r["bpid"] = bpid;
+    r["hosts"] = replys.size();
 
-      auto nets = bp.networks()
-        | map<vector>([](const auto & x) { return x.first.str(); });
+    //until every host has torn down its share the materialization stays, 
+    //placed on just the hosts that have not, and its networks keep their 
+    //vnis so nothing new gets tunneled onto bridges that are still up, 
+    //another destruct picks up where this one left off
+    if(!failed.empty())
+    {
+      Placement remaining;
+      for(const string & h : failed) 
+        remaining.hosts[h] = placement.hosts[h];
 
-      Json j;
+      Json doc = bp.json();
+      doc["placement"] = remaining.json();
+      db->saveMaterialization(project, bpid, doc);
 
-      j["hosts"] = hosts;
-      j["nets"] = nets;
+      r["action"] = "partially deconstructed";
+      r["failed"] = failed;
+      return http::Response{ http::Status::OK(), r.dump() };
+    }
 
-      replys.push_back(
-        HttpRequest
-        {
-          HTTPMethod::POST,
-          "https://"+h+"/destruct",
-          j.dump()
-        }
-        .response()
-      );
-
-      //TODO with new embedding structure ^^ -- in theory done above
-      /*
-      Blueprint lbp = bp.localEmbedding(h);  
-      replys.push_back(
-        HttpRequest
-        {
-          HTTPMethod::POST,
-          "https://"+h+"/destruct",
-          lbp.json().dump()
-        }
-        .response()
-      );
-      */
+    for(const auto & n : bp.networks())
+    {
+      db->freeVxlanVni(n.second.id().str());
     }
-    
+
     //TODO: xxx
     //TestbedTopology topo_ = unembed(bp, topo);
     TestbedTopology topo_ = topo;
@@ -299,9 +383,6 @@ http::Response destruct(Json j)
     db->deleteMaterialization(project, bpid);
     db->setHwTopo(topo_.json());
 
-    Json r;
-    r["project"] = project;
-    r["bpid"] = bpid;
     r["action"] = "deconstructed"; //d.dump
 
     return http::Response{ http::Status::OK(), r.dump() };
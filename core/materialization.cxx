@@ -1,12 +1,17 @@
 #include <stdexcept>
+#include <fmt/format.h>
 #include "core/materialization.hxx"
+#include "core/embed.hxx"
+#include "core/ovsdb.hxx"
 
 using namespace marina;
 using std::string;
 using std::vector;
+using std::unordered_map;
 using std::lock_guard;
 using std::mutex;
 using std::runtime_error;
+using std::function;
 
 // MzMap -----------------------------------------------------------------------
 
@@ -77,3 +82,290 @@ ComputerMzInfo ComputerMzInfo::fromJson(Json j)
 
   return x;
 }
+
+// NetworkMzInfo ---------------------------------------------------------------
+
+Json NetworkMzInfo::json() const
+{
+  Json j;
+  j["vni"] = vni;
+  if(!remotes.empty()) j["remotes"] = remotes;
+  return j;
+}
+
+NetworkMzInfo NetworkMzInfo::fromJson(Json j)
+{
+  NetworkMzInfo x;
+  x.vni = extract(j, "vni", "NetworkMzInfo");
+
+  auto i = j.find("remotes");
+  if(i != j.end()) x.remotes = i->get<vector<string>>();
+  return x;
+}
+
+NetworkMzInfo NetworkMzInfo::fromJson(JsonReader & r)
+{
+  NetworkMzInfo x;
+  bool vni{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "vni") { x.vni = r.uint(); vni = true; }
+    else if(k == "remotes")
+    {
+      r.beginArray();
+      while(r.element()) x.remotes.push_back(r.string());
+    }
+    else r.skip();
+  }
+
+  if(!vni) r.missing("NetworkMzInfo", "vni");
+  return x;
+}
+
+// HostMaterialization ---------------------------------------------------------
+
+HostMaterialization::HostMaterialization(Blueprint bp)
+  : blueprint{bp}
+{}
+
+Json HostMaterialization::json() const
+{
+  Json j;
+  j["blueprint"] = blueprint.json();
+
+  vector<Json> nets;
+  for(const auto & p : networks)
+  {
+    Json x;
+    x["id"] = p.first.json();
+    x["info"] = p.second.json();
+    nets.push_back(x);
+  }
+  j["networks"] = nets;
+  return j;
+}
+
+HostMaterialization HostMaterialization::fromJson(Json j)
+{
+  HostMaterialization x{
+    Blueprint::fromJson(extract(j, "blueprint", "HostMaterialization"))
+  };
+
+  Json nets = extract(j, "networks", "HostMaterialization");
+  for(const Json & nj : nets)
+  {
+    Uuid id = Uuid::fromJson(extract(nj, "id", "NetworkMzInfo"));
+    x.networks[id] = 
+      NetworkMzInfo::fromJson(extract(nj, "info", "NetworkMzInfo"));
+  }
+
+  return x;
+}
+
+HostMaterialization HostMaterialization::fromJson(JsonReader & r)
+{
+  HostMaterialization x{Blueprint{""}};
+  bool blueprint{false}, networks{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "blueprint")
+    {
+      x.blueprint = Blueprint::fromJson(r);
+      blueprint = true;
+    }
+    else if(k == "networks")
+    {
+      r.beginArray();
+      while(r.element())
+      {
+        Uuid id;
+        NetworkMzInfo info;
+        bool has_id{false}, has_info{false};
+
+        r.beginObject();
+        string nk;
+        while(r.key(nk))
+        {
+          if(nk == "id") { id = Uuid::fromJson(r); has_id = true; }
+          else if(nk == "info")
+          {
+            info = NetworkMzInfo::fromJson(r);
+            has_info = true;
+          }
+          else r.skip();
+        }
+        if(!has_id) r.missing("NetworkMzInfo", "id");
+        if(!has_info) r.missing("NetworkMzInfo", "info");
+
+        x.networks[id] = info;
+      }
+      networks = true;
+    }
+    else r.skip();
+  }
+
+  if(!blueprint) r.missing("HostMaterialization", "blueprint");
+  if(!networks) r.missing("HostMaterialization", "networks");
+  return x;
+}
+
+HostMaterialization HostMaterialization::parse(const char *data, size_t size)
+{
+  JsonReader r{data, size};
+  HostMaterialization x = fromJson(r);
+  r.end();
+  return x;
+}
+
+// Placement -------------------------------------------------------------------
+
+Placement Placement::of(const EChart & ec)
+{
+  Placement x;
+  for(const auto & p : ec.hmap)
+  {
+    const HostEmbedding & he = p.second;
+    if(he.machines.empty()) continue;
+
+    Share & s = x.hosts[he.host.name()];
+    s.tunnel_addr = he.tunnel_addr;
+    for(const auto & m : he.machines) s.computers.push_back(m.first);
+  }
+  return x;
+}
+
+Json Placement::json() const
+{
+  Json j = Json::object();
+  for(const auto & h : hosts)
+  {
+    Json cs = Json::array();
+    for(const Uuid & id : h.second.computers) cs.push_back(id.json());
+    j[h.first]["tunnel_addr"] = h.second.tunnel_addr;
+    j[h.first]["computers"] = cs;
+  }
+  return j;
+}
+
+Placement Placement::fromJson(Json j)
+{
+  Placement x;
+  for(auto i = j.begin(); i != j.end(); ++i)
+  {
+    Share & s = x.hosts[i.key()];
+    s.tunnel_addr =
+      extract(i.value(), "tunnel_addr", "placement").get<string>();
+    for(const Json & id : extract(i.value(), "computers", "placement"))
+      s.computers.push_back(Uuid::fromJson(id));
+  }
+  return x;
+}
+
+// partition -------------------------------------------------------------------
+
+unordered_map<string, HostMaterialization> 
+marina::partition(const Blueprint & bp, const EChart & ec, 
+    const UuidMap<NetworkMzInfo> & mz)
+{
+  return partition(bp, Placement::of(ec), mz);
+}
+
+unordered_map<string, HostMaterialization> 
+marina::partition(const Blueprint & bp, const Placement & pl, 
+    const UuidMap<NetworkMzInfo> & mz)
+{
+  vector<string> hosts, tunnels;
+  vector<Blueprint::ComputerMap> machines;
+  for(const auto & h : pl.hosts)
+  {
+    Blueprint::ComputerMap m;
+    for(const Uuid & id : h.second.computers)
+    {
+      auto c = bp.computers().find(id);
+      if(c != bp.computers().end()) m.insert(*c);
+    }
+    if(m.empty()) continue;
+
+    hosts.push_back(h.first);
+    tunnels.push_back(h.second.tunnel_addr);
+    machines.push_back(std::move(m));
+  }
+
+  vector<Blueprint> shares = bp.localEmbeddings(machines);
+
+  //the shares each network shows up in
+  UuidMap<vector<size_t>> spans;
+  for(size_t k=0; k<shares.size(); ++k)
+    for(const auto & n : shares[k].networks()) spans[n.first].push_back(k);
+
+  unordered_map<string, HostMaterialization> parts;
+  parts.reserve(shares.size());
+  for(size_t k=0; k<shares.size(); ++k)
+  {
+    HostMaterialization hm{shares[k]};
+    for(const auto & n : shares[k].networks())
+    {
+      auto z = mz.find(n.first);
+      if(z == mz.end()) continue;
+
+      NetworkMzInfo info = z->second;
+      info.remotes.clear();
+      for(size_t r : spans.at(n.first)) 
+      {
+        if(r == k) continue;
+        if(tunnels[r].empty())
+          throw runtime_error{"no tunnel address for host " + hosts[r]};
+        info.remotes.push_back(tunnels[r]);
+      }
+      hm.networks[n.first] = info;
+    }
+    parts.emplace(hosts[k], hm);
+  }
+
+  return parts;
+}
+
+// assignAddresses -------------------------------------------------------------
+
+void marina::assignAddresses(Blueprint & bp, UuidMap<NetworkMzInfo> & mz,
+    function<size_t(const Network &)> newVni)
+{
+  for(auto & p : bp.networks())
+  {
+    Network & n = p.second;
+    mz[n.id()].vni = newVni(n);
+
+    IpV4Address a = n.ipv4();
+    for(auto & c : bp.connectedComputers(n))
+    {
+      if(a.netZero()) a++;
+      Interface & ifx = c.second;
+      ifx.writeEinfo().ipaddr_v4 = a;
+      a++;
+    }
+  }
+}
+
+// addTunnels ------------------------------------------------------------------
+
+void marina::addTunnels(OvsTxn & txn, string bridge, size_t net_id, 
+    const NetworkMzInfo & z, string fallback)
+{
+  string key = std::to_string(z.vni);
+  if(z.remotes.empty())
+  {
+    txn.addPort(bridge, "vxlan" + std::to_string(net_id), "vxlan",
+        {{"remote_ip", fallback}, {"key", key}}, true);
+    return;
+  }
+
+  for(size_t k=0; k<z.remotes.size(); ++k)
+    txn.addPort(bridge, fmt::format("vxlan{}-{}", net_id, k), "vxlan",
+        {{"remote_ip", z.remotes[k]}, {"key", key}}, true);
+}
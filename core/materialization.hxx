@@ -2,7 +2,10 @@
 #define MARINATB_MZN_HXX
 
 #include <unordered_map>
+#include <functional>
 #include <mutex>
+#include <vector>
+#include <string>
 #include "core/util.hxx"
 #include "core/blueprint.hxx"
 
@@ -14,6 +17,10 @@ namespace marina
   struct InterfaceMzInfo;
   struct ComputerMzInfo;
   struct NetworkMzInfo;
+  struct HostMaterialization;
+  class OvsTxn;
+  struct Placement;
+  struct EChart;
 
 
   struct Materialization
@@ -55,8 +62,94 @@ namespace marina
   struct NetworkMzInfo
   {
     size_t vni;
+
+    //the data plane addresses of the other hosts with computers on the
+    //network, the vxlan tunnels of the network go to them
+    std::vector<std::string> remotes;
+
+    Json json() const;
+    static NetworkMzInfo fromJson(Json);
+    static NetworkMzInfo fromJson(JsonReader &);
   };
 
+  /*
+   * Everything a host-controller needs to materialize its share of a 
+   * blueprint in one go: the sub-blueprint of the computers placed on the 
+   * host (with interface addresses filled in), the networks that touch them 
+   * and the network materialization info of those networks.
+   */
+  struct HostMaterialization
+  {
+    HostMaterialization(Blueprint);
+
+    Blueprint blueprint;
+    UuidMap<NetworkMzInfo> networks;
+
+    Json json() const;
+    static HostMaterialization fromJson(Json);
+    static HostMaterialization fromJson(JsonReader &);
+
+    //like Blueprint::parse, no Json tree is built along the way
+    static HostMaterialization parse(const char *data, size_t size);
+  };
+
+  /*
+   * Which computers of a blueprint an embedding put on which host, keyed by
+   * host name, along with the data plane address the vxlan tunnels to each
+   * host end at. It is saved with the materialization so the blueprint can
+   * be torn down on the hosts it was built on.
+   */
+  struct Placement
+  {
+    struct Share
+    {
+      std::string tunnel_addr;
+      std::vector<Uuid> computers;
+    };
+
+    std::unordered_map<std::string, Share> hosts;
+
+    //the hosts of an embedding that have computers on them
+    static Placement of(const EChart &);
+
+    Json json() const;
+    static Placement fromJson(Json);
+  };
+
+  /*
+   * The share of every host of a placement, keyed by host name. One pass 
+   * over the computers and links of the blueprint, networks get their info 
+   * from mz where it has any and the remotes of each network are filled in 
+   * from the tunnel addresses of the other shares. Throws runtime_error if 
+   * a network spans a host whose tunnel address is not known.
+   */
+  std::unordered_map<std::string, HostMaterialization> 
+  partition(const Blueprint &, const Placement &, 
+      const UuidMap<NetworkMzInfo> & mz = {});
+
+  std::unordered_map<std::string, HostMaterialization> 
+  partition(const Blueprint &, const EChart &, 
+      const UuidMap<NetworkMzInfo> & mz = {});
+
+  /*
+   * Gives every network of a blueprint a vni from newVni and every interface
+   * on the network the next address of its ipv4 space, skipping the network
+   * address itself.
+   */
+  void assignAddresses(Blueprint &, UuidMap<NetworkMzInfo> & mz,
+      std::function<size_t(const Network &)> newVni);
+
+  /*
+   * The vxlan ports of the bridge of a network, one to each of its remotes
+   * or one to fallback if it has none. The hosts of a network are a full 
+   * mesh, a frame that came in over a tunnel has been sent to every other 
+   * host already, so the tunnel ports are isolated from one another and 
+   * only forward to local ports. Without that a network on 3 or more hosts 
+   * loops broadcasts around the mesh.
+   */
+  void addTunnels(OvsTxn &, std::string bridge, size_t net_id, 
+      const NetworkMzInfo &, std::string fallback);
+
 }
 
 #endif
@@ -1,106 +1,517 @@
 #include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <net/if.h>
 #include <net/if_arp.h>
+#include <poll.h>
+#include <arpa/inet.h>
 #include <unistd.h>
+#include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <cctype>
+#include <atomic>
 #include <string>
-#include <iostream>
-#include "core/util.hxx"
+#include <stdexcept>
+#include "core/netlink.hxx"
 
 using std::string;
-using std::endl;
+using std::vector;
+using std::atomic;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::thread;
+using std::function;
 using std::out_of_range;
+using std::runtime_error;
+using std::invalid_argument;
+using std::to_string;
+using std::experimental::optional;
+using std::experimental::nullopt;
+using namespace std::chrono;
 using namespace marina;
 
+namespace
+{
+  atomic<uint32_t> seq_num{0};
+
+  string lower(string s)
+  {
+    for(char & c : s) c = std::tolower(c);
+    return s;
+  }
+
+  LinkInfo parseLink(nlmsghdr *nh)
+  {
+    ifinfomsg *msg = (ifinfomsg*)NLMSG_DATA(nh);
+
+    LinkInfo l;
+    l.index = msg->ifi_index;
+    l.flags = msg->ifi_flags;
+    l.type = msg->ifi_type;
+
+    rtattr *rta = IFLA_RTA(msg);
+    int alen = IFLA_PAYLOAD(nh);
+    for(; RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen))
+    {
+      //grab the mac address attribute, only ethernet style addresses count
+      if(rta->rta_type == IFLA_ADDRESS && RTA_PAYLOAD(rta) == 6)
+      {
+        char addr_buf[64];
+        unsigned char * c = (unsigned char*)RTA_DATA(rta);
+
+        snprintf(addr_buf, 64, "%02x:%02x:%02x:%02x:%02x:%02x",
+            c[0], c[1], c[2], c[3], c[4], c[5]);
+
+        l.mac = string{addr_buf};
+      }
+
+      //grab the interface name attribute
+      if(rta->rta_type == IFLA_IFNAME)
+      {
+        l.name = string{(char*)RTA_DATA(rta)};
+      }
+    }
+
+    return l;
+  }
+}
+
+bool LinkInfo::up() const { return flags & IFF_UP; }
+
+// NlSocket --------------------------------------------------------------------
+
+namespace
+{
+struct NlSocket
+{
+  NlSocket(unsigned groups = 0)
+  {
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if(fd < 0)
+      throw runtime_error{"netlink socket: " + string{strerror(errno)}};
+
+    sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = groups;
+    if(bind(fd, (sockaddr*)&sa, sizeof(sa)) < 0)
+    {
+      close(fd);
+      throw runtime_error{"netlink bind: " + string{strerror(errno)}};
+    }
+  }
+
+  ~NlSocket() { close(fd); }
+
+  //the next datagram in full, the buffer grows to fit however many links
+  //the kernel packs into it
+  int recv(vector<char> & buf, int flags = 0)
+  {
+    for(;;)
+    {
+      ssize_t n = 
+        ::recv(fd, buf.data(), buf.size(), flags | MSG_PEEK | MSG_TRUNC);
+      if(n < 0 && errno == EINTR) continue;
+      if(n < 0) return -1;
+      if(static_cast<size_t>(n) > buf.size())
+      {
+        buf.resize(n);
+        continue;
+      }
+      return ::recv(fd, buf.data(), buf.size(), flags);
+    }
+  }
+
+  vector<LinkInfo> dump()
+  {
+    RtReq req;
+    memset(&req, 0, sizeof(req));
+    req.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.header.nlmsg_type = RTM_GETLINK;
+    req.header.nlmsg_seq = ++seq_num;
+    req.msg.ifi_family = AF_UNSPEC;
+
+    sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    ssize_t sent = 
+      sendto(fd, &req, req.header.nlmsg_len, 0, (sockaddr*)&sa, sizeof(sa));
+    if(sent < 0)
+      throw runtime_error{"netlink send: " + string{strerror(errno)}};
+
+    vector<LinkInfo> links;
+    vector<char> buf(32768);
+    for(;;)
+    {
+      int len = recv(buf);
+      if(len < 0)
+        throw runtime_error{"netlink recv: " + string{strerror(errno)}};
+
+      nlmsghdr *nh = (nlmsghdr*)buf.data();
+      for(; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+      {
+        if(nh->nlmsg_seq != req.header.nlmsg_seq) continue;
+        if(nh->nlmsg_type == NLMSG_DONE) return links;
+        if(nh->nlmsg_type == NLMSG_ERROR)
+        {
+          nlmsgerr *e = (nlmsgerr*)NLMSG_DATA(nh);
+          throw runtime_error{
+            "netlink link dump: " + string{strerror(-e->error)}
+          };
+        }
+        if(nh->nlmsg_type == RTM_NEWLINK) links.push_back(parseLink(nh));
+      }
+    }
+  }
+
+  int fd;
+};
+}
+
+struct LinkCache::Socket : public NlSocket
+{
+  using NlSocket::NlSocket;
+};
+
+vector<LinkInfo> marina::dumpLinks()
+{
+  return NlSocket{}.dump();
+}
+
 string marina::mac_2_ifname(string mac)
 {
-  static size_t seq_num{0};
-
-  /*
-    * send netlink request
-    */
-
-  //prepare request
-  RtReq req;
-  memset(&req, 0, sizeof(req));
-  req.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
-  req.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_ROOT;
-  req.header.nlmsg_type = RTM_GETLINK;
-  req.header.nlmsg_seq = ++seq_num;
-  req.msg.ifi_family = AF_UNSPEC;
-  req.msg.ifi_change = 0xffffffff;
-  
-  //prepare message
+  mac = lower(mac);
+  for(const LinkInfo & l : dumpLinks())
+  {
+    if(l.type == ARPHRD_ETHER && l.mac == mac) return l.name;
+  }
+  throw out_of_range{mac + " not found"};
+}
+
+// LinkBatch -------------------------------------------------------------------
+
+namespace
+{
+  template <class Body>
+  vector<char> request(unsigned short type, unsigned short flags, const Body & b)
+  {
+    vector<char> buf(NLMSG_SPACE(sizeof(Body)), 0);
+    nlmsghdr *nh = (nlmsghdr*)buf.data();
+    nh->nlmsg_len = NLMSG_LENGTH(sizeof(Body));
+    nh->nlmsg_type = type;
+    nh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    memcpy(NLMSG_DATA(nh), &b, sizeof(Body));
+    return buf;
+  }
+
+  void addAttr(vector<char> & buf, unsigned short type, const void *data,
+      size_t len)
+  {
+    size_t off = NLMSG_ALIGN(buf.size());
+    buf.resize(off + RTA_SPACE(len), 0);
+    rtattr *rta = (rtattr*)(buf.data() + off);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+    ((nlmsghdr*)buf.data())->nlmsg_len = buf.size();
+  }
+}
+
+LinkBatch & LinkBatch::addAddress(int ifindex, const string & cidr)
+{
+  size_t slash = cidr.find('/');
+  in_addr a;
+  if(slash == string::npos ||
+     inet_pton(AF_INET, cidr.substr(0, slash).c_str(), &a) != 1)
+    throw invalid_argument{"bad ipv4 address " + cidr};
+
+  int len = std::stoi(cidr.substr(slash + 1));
+  if(len < 0 || len > 32) throw invalid_argument{"bad prefix length " + cidr};
+
+  ifaddrmsg m;
+  memset(&m, 0, sizeof(m));
+  m.ifa_family = AF_INET;
+  m.ifa_prefixlen = len;
+  m.ifa_scope = RT_SCOPE_UNIVERSE;
+  m.ifa_index = ifindex;
+
+  auto msg = request(RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL, m);
+  addAttr(msg, IFA_LOCAL, &a, sizeof(a));
+  addAttr(msg, IFA_ADDRESS, &a, sizeof(a));
+
+  ops_.push_back({msg, "add " + cidr + " to link " + to_string(ifindex), true});
+  return *this;
+}
+
+LinkBatch & LinkBatch::setUp(int ifindex, bool up)
+{
+  ifinfomsg m;
+  memset(&m, 0, sizeof(m));
+  m.ifi_family = AF_UNSPEC;
+  m.ifi_index = ifindex;
+  m.ifi_flags = up ? IFF_UP : 0;
+  m.ifi_change = IFF_UP;
+
+  ops_.push_back({
+    request(RTM_NEWLINK, 0, m),
+    string{up ? "up" : "down"} + " link " + to_string(ifindex),
+    false
+  });
+  return *this;
+}
+
+LinkBatch & LinkBatch::setMtu(int ifindex, unsigned mtu)
+{
+  ifinfomsg m;
+  memset(&m, 0, sizeof(m));
+  m.ifi_family = AF_UNSPEC;
+  m.ifi_index = ifindex;
+
+  auto msg = request(RTM_NEWLINK, 0, m);
+  uint32_t v = mtu;
+  addAttr(msg, IFLA_MTU, &v, sizeof(v));
+
+  ops_.push_back({msg, "mtu " + to_string(mtu) + " on link " + 
+      to_string(ifindex), false});
+  return *this;
+}
+
+size_t LinkBatch::size() const { return ops_.size(); }
+bool LinkBatch::empty() const { return ops_.empty(); }
+
+void LinkBatch::commit()
+{
+  if(ops_.empty()) return;
+
+  //every change in one datagram, told apart by sequence number
+  uint32_t first = (seq_num += ops_.size()) - ops_.size() + 1;
+  vector<char> buf;
+  for(size_t i=0; i<ops_.size(); ++i)
+  {
+    vector<char> & m = ops_[i].msg;
+    ((nlmsghdr*)m.data())->nlmsg_seq = first + i;
+
+    size_t off = NLMSG_ALIGN(buf.size());
+    buf.resize(off + m.size(), 0);
+    memcpy(buf.data() + off, m.data(), m.size());
+  }
+
+  NlSocket s;
   sockaddr_nl sa;
-  iovec iov = {&req, req.header.nlmsg_len};
-  msghdr msg = {&sa, sizeof(sa), &iov, 1, nullptr, 0, 0};
   memset(&sa, 0, sizeof(sa));
   sa.nl_family = AF_NETLINK;
+  if(sendto(s.fd, buf.data(), buf.size(), 0, (sockaddr*)&sa, sizeof(sa)) < 0)
+    throw runtime_error{"netlink send: " + string{strerror(errno)}};
+
+  //the kernel carries on past a failed change, so there is one ack for each
+  vector<string> errors;
+  size_t acked{0};
+  while(acked < ops_.size())
+  {
+    int len = s.recv(buf);
+    if(len < 0)
+      throw runtime_error{"netlink recv: " + string{strerror(errno)}};
+
+    nlmsghdr *nh = (nlmsghdr*)buf.data();
+    for(; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+    {
+      if(nh->nlmsg_type != NLMSG_ERROR) continue;
+      uint32_t i = nh->nlmsg_seq - first;
+      if(i >= ops_.size()) continue;
+      acked++;
+
+      int err = -((nlmsgerr*)NLMSG_DATA(nh))->error;
+      if(err == 0 || (err == EEXIST && ops_[i].exists_ok)) continue;
+      errors.push_back(ops_[i].what + ": " + strerror(err));
+    }
+  }
+  ops_.clear();
+
+  if(!errors.empty())
+  {
+    string msg{"netlink changes failed"};
+    for(const string & e : errors) msg += "\n  " + e;
+    throw runtime_error{msg};
+  }
+}
 
-  //open socket
-  int fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+// LinkCache -------------------------------------------------------------------
+
+LinkCache::LinkCache(bool follow)
+{
+  //subscribe ahead of the dump so no change slips through in between
+  if(follow) events_.reset(new Socket{RTMGRP_LINK});
+
+  refresh();
+
+  if(follow)
+  {
+    stopfd_ = eventfd(0, EFD_CLOEXEC);
+    follower_ = thread{[this](){ this->follow(); }};
+  }
+}
+
+LinkCache::~LinkCache()
+{
+  if(follower_.joinable())
+  {
+    uint64_t one{1};
+    (void)write(stopfd_, &one, sizeof(one));
+    follower_.join();
+    close(stopfd_);
+  }
+}
+
+void LinkCache::refresh()
+{
+  vector<LinkInfo> links = NlSocket{}.dump();
+
+  {
+    lock_guard<mutex> lk{mtx_};
+    links_.clear();
+    by_mac_.clear();
+    by_name_.clear();
+    for(const LinkInfo & l : links) apply(l, false);
+  }
+  changed_.notify_all();
+}
+
+//called with mtx_ held
+void LinkCache::apply(const LinkInfo & l, bool removed)
+{
+  auto i = links_.find(l.index);
+  if(i != links_.end())
+  {
+    const LinkInfo & old = i->second;
+    auto m = by_mac_.find(old.mac);
+    if(m != by_mac_.end())
+    {
+      m->second.erase(old.index);
+      if(m->second.empty()) by_mac_.erase(m);
+    }
+    auto n = by_name_.find(old.name);
+    if(n != by_name_.end() && n->second == old.index) by_name_.erase(n);
+    links_.erase(i);
+  }
 
-  //send message
-  sendmsg(fd, &msg, 0);
+  if(removed) return;
 
-  /*
-    * get netlink response
-    */
+  links_[l.index] = l;
+  if(!l.mac.empty()) by_mac_[l.mac].insert(l.index);
+  if(!l.name.empty()) by_name_[l.name] = l.index;
+}
 
-  char buf[16192];
-  iov = {buf, sizeof(buf) };
-  msg = {&sa, sizeof(sa), &iov, 1, nullptr, 0, 0};
-  nlmsghdr *nh;
+void LinkCache::follow()
+{
+  vector<char> buf(32768);
+  pollfd fds[2] = { {events_->fd, POLLIN, 0}, {stopfd_, POLLIN, 0} };
 
-  bool over{false};
-  while(!over)
+  for(;;)
   {
-    size_t len = recvmsg(fd, &msg, 0);
-    for(nh = (nlmsghdr*)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+    if(poll(fds, 2, -1) < 0 && errno != EINTR) return;
+    if(fds[1].revents) return;
+    if(!fds[0].revents) continue;
+
+    int len = events_->recv(buf, MSG_DONTWAIT);
+    if(len < 0)
     {
-      if(nh->nlmsg_type == NLMSG_DONE) 
+      //the kernel dropped notifications on the floor, start over
+      if(errno == ENOBUFS) refresh();
+      continue;
+    }
+
+    {
+      lock_guard<mutex> lk{mtx_};
+      nlmsghdr *nh = (nlmsghdr*)buf.data();
+      for(; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
       {
-        over = true;
-        break;
+        if(nh->nlmsg_type == RTM_NEWLINK) apply(parseLink(nh), false);
+        if(nh->nlmsg_type == RTM_DELLINK) apply(parseLink(nh), true);
       }
+    }
+    changed_.notify_all();
+  }
+}
 
-      if(nh->nlmsg_type != RTM_BASE) continue;
+optional<LinkInfo> LinkCache::findMac(const string & mac) const
+{
+  auto m = by_mac_.find(mac);
+  if(m == by_mac_.end()) return nullopt;
 
-      // get message payload
-      ifinfomsg *msg = (ifinfomsg*)NLMSG_DATA(nh);
-      if(msg->ifi_type != ARPHRD_ETHER) continue;
+  for(int i : m->second)
+  {
+    const LinkInfo & l = links_.at(i);
+    if(l.type == ARPHRD_ETHER) return l;
+  }
+  return links_.at(*m->second.begin());
+}
 
-      //get message attributes
-      rtattr *rta = IFLA_RTA(msg);
-      int alen = nh->nlmsg_len - NLMSG_LENGTH(sizeof(*msg));
+optional<LinkInfo> LinkCache::findName(const string & name) const
+{
+  auto n = by_name_.find(name);
+  if(n == by_name_.end()) return nullopt;
+  return links_.at(n->second);
+}
 
-      //store the interface name and mac addr here
-      string name, addr;
+optional<LinkInfo> LinkCache::byMac(string mac) const
+{
+  lock_guard<mutex> lk{mtx_};
+  return findMac(lower(mac));
+}
 
-      //iterate through attributes
-      for(; RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen))
-      {
-        //grab the mac address attribute
-        if(rta->rta_type == IFLA_ADDRESS)
-        {
-          char addr_buf[64];
-          unsigned char * c = (unsigned char*)RTA_DATA(rta);
+optional<LinkInfo> LinkCache::byName(const string & name) const
+{
+  lock_guard<mutex> lk{mtx_};
+  return findName(name);
+}
 
-          snprintf(addr_buf, 64, "%02x:%02x:%02x:%02x:%02x:%02x", 
-              c[0], c[1], c[2], c[3], c[4], c[5]);
+optional<LinkInfo> LinkCache::byIndex(int index) const
+{
+  lock_guard<mutex> lk{mtx_};
+  auto i = links_.find(index);
+  if(i == links_.end()) return nullopt;
+  return i->second;
+}
 
-          addr = string{addr_buf};
-        }
+vector<LinkInfo> LinkCache::links() const
+{
+  lock_guard<mutex> lk{mtx_};
+  vector<LinkInfo> ls;
+  for(const auto & l : links_) ls.push_back(l.second);
+  return ls;
+}
 
-        //grab the interface name attribute
-        if(rta->rta_type == IFLA_IFNAME)
-        {
-          name = string{(char*)RTA_DATA(rta)};
-        }
-      }
-      if(mac == addr) return name;
+//without notifications coming in the table is polled for changes
+optional<LinkInfo> LinkCache::waitFor(function<optional<LinkInfo>()> find,
+    milliseconds timeout)
+{
+  auto deadline = steady_clock::now() + timeout;
+  unique_lock<mutex> lk{mtx_};
+  for(;;)
+  {
+    auto l = find();
+    if(l || steady_clock::now() >= deadline) return l;
+
+    if(follower_.joinable()) changed_.wait_until(lk, deadline);
+    else
+    {
+      lk.unlock();
+      std::this_thread::sleep_for(milliseconds{50});
+      refresh();
+      lk.lock();
     }
   }
-  throw out_of_range{mac + " not found"};
 }
 
+optional<LinkInfo> LinkCache::waitForMac(string mac, milliseconds timeout)
+{
+  mac = lower(mac);
+  return waitFor([this,&mac](){ return findMac(mac); }, timeout);
+}
+
+optional<LinkInfo> LinkCache::waitForName(const string & name, milliseconds timeout)
+{
+  return waitFor([this,&name](){ return findName(name); }, timeout);
+}
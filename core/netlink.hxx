@@ -0,0 +1,128 @@
+#ifndef MARINA_CORE_NETLINK_HXX
+#define MARINA_CORE_NETLINK_HXX
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <experimental/optional>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+namespace marina
+{
+  struct RtReq
+  {
+    nlmsghdr header;
+    ifinfomsg msg;
+  };
+
+  //a network interface as the kernel link table has it
+  struct LinkInfo
+  {
+    int index{0};
+    std::string name, mac;
+    unsigned flags{0};
+    unsigned short type{0};
+
+    bool up() const;
+  };
+
+  //a single dump of the kernel link table
+  std::vector<LinkInfo> dumpLinks();
+
+  //the name of the interface with the given mac, throws out_of_range
+  std::string mac_2_ifname(std::string mac);
+
+  /*
+   * Interface configuration changes that go to the kernel as a single batch
+   * of netlink messages on one socket, each change is acknowledged on its
+   * own. Adding an address that is already there is not an error so a batch
+   * can safely be applied again.
+   */
+  class LinkBatch
+  {
+    public:
+      //an ipv4 address in cidr notation, e.g. 10.47.0.1/24
+      LinkBatch & addAddress(int ifindex, const std::string & cidr);
+      LinkBatch & setUp(int ifindex, bool up = true);
+      LinkBatch & setMtu(int ifindex, unsigned mtu);
+
+      size_t size() const;
+      bool empty() const;
+
+      //throws runtime_error listing every change the kernel refused
+      void commit();
+
+    private:
+      struct Op
+      {
+        std::vector<char> msg;
+        std::string what;
+        bool exists_ok;
+      };
+      std::vector<Op> ops_;
+  };
+
+  /*
+   * The kernel link table indexed by mac, name and ifindex. The table is
+   * dumped once up front, when following it is then kept up to date from
+   * RTM_NEWLINK/RTM_DELLINK notifications on a background thread. Macs are
+   * matched case insensitively, when several links share a mac the ethernet
+   * link with the lowest index wins.
+   */
+  class LinkCache
+  {
+    public:
+      explicit LinkCache(bool follow = true);
+      ~LinkCache();
+
+      LinkCache(const LinkCache &) = delete;
+      LinkCache & operator=(const LinkCache &) = delete;
+
+      std::experimental::optional<LinkInfo> byMac(std::string mac) const;
+      std::experimental::optional<LinkInfo> byName(const std::string &) const;
+      std::experimental::optional<LinkInfo> byIndex(int) const;
+      std::vector<LinkInfo> links() const;
+
+      //block until a link shows up, e.g. a port ovs creates asynchronously
+      std::experimental::optional<LinkInfo>
+      waitForMac(std::string mac, std::chrono::milliseconds timeout);
+
+      std::experimental::optional<LinkInfo>
+      waitForName(const std::string &, std::chrono::milliseconds timeout);
+
+      //throw away the table and dump it again
+      void refresh();
+
+    private:
+      struct Socket;
+
+      void apply(const LinkInfo &, bool removed);
+      void follow();
+      std::experimental::optional<LinkInfo> findMac(const std::string &) const;
+      std::experimental::optional<LinkInfo> findName(const std::string &) const;
+      std::experimental::optional<LinkInfo> waitFor(
+          std::function<std::experimental::optional<LinkInfo>()> find,
+          std::chrono::milliseconds timeout);
+
+      std::map<int, LinkInfo> links_;
+      std::unordered_map<std::string, std::set<int>> by_mac_;
+      std::unordered_map<std::string, int> by_name_;
+      mutable std::mutex mtx_;
+      std::condition_variable changed_;
+
+      std::unique_ptr<Socket> events_;
+      int stopfd_{-1};
+      std::thread follower_;
+  };
+}
+
+#endif
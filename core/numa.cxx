@@ -0,0 +1,502 @@
+#include <sched.h>
+#include <dirent.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include "core/numa.hxx"
+
+using std::string;
+using std::vector;
+using std::ifstream;
+using std::stringstream;
+using std::lock_guard;
+using std::mutex;
+using std::out_of_range;
+using std::runtime_error;
+using std::invalid_argument;
+using std::experimental::optional;
+using std::experimental::nullopt;
+using namespace marina;
+
+// cpu lists -------------------------------------------------------------------
+
+vector<size_t> marina::parseCpuList(const string & s)
+{
+  vector<size_t> cpus;
+  stringstream ss{s};
+  string range;
+  while(std::getline(ss, range, ','))
+  {
+    range.erase(std::remove_if(range.begin(), range.end(), ::isspace),
+        range.end());
+    if(range.empty()) continue;
+
+    size_t dash = range.find('-');
+    try
+    {
+      size_t lo = std::stoul(range.substr(0, dash));
+      size_t hi = dash == string::npos ? lo : std::stoul(range.substr(dash+1));
+      if(hi < lo) throw invalid_argument{range};
+      for(size_t c=lo; c<=hi; ++c) cpus.push_back(c);
+    }
+    catch(std::logic_error &)
+    {
+      throw invalid_argument{"bad cpu list `" + s + "`"};
+    }
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+string marina::cpuList(const vector<size_t> & cpus)
+{
+  vector<size_t> cs{cpus};
+  std::sort(cs.begin(), cs.end());
+
+  string s;
+  for(size_t i=0; i<cs.size(); )
+  {
+    size_t j = i;
+    while(j+1 < cs.size() && cs[j+1] == cs[j]+1) ++j;
+
+    if(!s.empty()) s += ",";
+    s += std::to_string(cs[i]);
+    if(j > i) s += "-" + std::to_string(cs[j]);
+    i = j+1;
+  }
+  return s;
+}
+
+string marina::cpuMask(const vector<size_t> & cpus)
+{
+  vector<unsigned> nibbles;
+  for(size_t c : cpus)
+  {
+    if(nibbles.size() <= c/4) nibbles.resize(c/4 + 1, 0);
+    nibbles[c/4] |= 1u << (c%4);
+  }
+  if(nibbles.empty()) return "0";
+
+  string s;
+  for(auto i = nibbles.rbegin(); i != nibbles.rend(); ++i)
+    s += "0123456789abcdef"[*i];
+  return s;
+}
+
+// NumaTopology ----------------------------------------------------------------
+
+namespace
+{
+  vector<string> listDir(const string & path)
+  {
+    vector<string> entries;
+    DIR *d = opendir(path.c_str());
+    if(d == nullptr) return entries;
+    while(dirent *e = readdir(d)) entries.push_back(e->d_name);
+    closedir(d);
+    std::sort(entries.begin(), entries.end());
+    return entries;
+  }
+
+  string readLine(const string & path)
+  {
+    ifstream ifs{path};
+    string s;
+    std::getline(ifs, s);
+    return s;
+  }
+
+  //hugepage memory of all sizes under a hugepages-<size>kB directory tree,
+  //counting either nr_hugepages or free_hugepages
+  size_t hugepageMb(const string & dir, const string & count = "nr_hugepages")
+  {
+    size_t kb{0};
+    for(const string & e : listDir(dir))
+    {
+      if(e.find("hugepages-") != 0) continue;
+      size_t size_kb = std::strtoul(e.c_str() + 10, nullptr, 10);
+      size_t n = std::strtoul(readLine(dir+"/"+e+"/"+count).c_str(),
+          nullptr, 10);
+      kb += size_kb * n;
+    }
+    return kb / 1024;
+  }
+}
+
+NumaTopology::NumaTopology(vector<NumaNode> nodes)
+  : nodes_{nodes}
+{
+  std::sort(nodes_.begin(), nodes_.end(),
+      [](const auto & a, const auto & b){ return a.id < b.id; });
+}
+
+NumaTopology NumaTopology::detect(string sysfs)
+{
+  vector<NumaNode> nodes;
+
+  string nd = sysfs + "/devices/system/node";
+  for(const string & e : listDir(nd))
+  {
+    if(e.find("node") != 0 || e.size() < 5 || !isdigit(e[4])) continue;
+
+    NumaNode n;
+    n.id = std::stoul(e.substr(4));
+    n.cpus = parseCpuList(readLine(nd+"/"+e+"/cpulist"));
+    n.hugepage_mb = hugepageMb(nd+"/"+e+"/hugepages");
+    n.hugepage_free_mb = hugepageMb(nd+"/"+e+"/hugepages", "free_hugepages");
+    nodes.push_back(n);
+  }
+
+  //kernels built without numa support show no nodes, it is all one node
+  if(nodes.empty())
+  {
+    NumaNode n;
+    n.id = 0;
+    n.cpus = parseCpuList(readLine(sysfs + "/devices/system/cpu/online"));
+    n.hugepage_mb = hugepageMb(sysfs + "/kernel/mm/hugepages");
+    n.hugepage_free_mb = 
+      hugepageMb(sysfs + "/kernel/mm/hugepages", "free_hugepages");
+    nodes.push_back(n);
+  }
+
+  return NumaTopology{nodes};
+}
+
+const vector<NumaNode> & NumaTopology::nodes() const { return nodes_; }
+
+const NumaNode & NumaTopology::node(size_t id) const
+{
+  for(const auto & n : nodes_) if(n.id == id) return n;
+  throw out_of_range{"no numa node " + std::to_string(id)};
+}
+
+size_t NumaTopology::nodeOf(size_t cpu) const
+{
+  for(const auto & n : nodes_)
+    if(std::binary_search(n.cpus.begin(), n.cpus.end(), cpu)) return n.id;
+  throw out_of_range{"no cpu " + std::to_string(cpu)};
+}
+
+Json NumaTopology::json() const
+{
+  vector<Json> nodes;
+  for(const auto & n : nodes_)
+  {
+    Json j;
+    j["id"] = n.id;
+    j["cpus"] = cpuList(n.cpus);
+    j["hugepage_mb"] = n.hugepage_mb;
+    j["hugepage_free_mb"] = n.hugepage_free_mb;
+    nodes.push_back(j);
+  }
+  Json j;
+  j["nodes"] = nodes;
+  return j;
+}
+
+// HugepageLedger --------------------------------------------------------------
+
+HugepageLedger::HugepageLedger(const NumaTopology & topo)
+{
+  for(const auto & n : topo.nodes())
+  {
+    capacity_[n.id] = n.hugepage_mb;
+    reserved_[n.id] = 0;
+  }
+}
+
+bool HugepageLedger::reserve(const string & owner, size_t node, size_t mb)
+{
+  if(owners_.count(owner)) return false;
+  if(available(node) < mb) return false;
+
+  reserved_[node] += mb;
+  owners_[owner] = Reservation{node, mb};
+  return true;
+}
+
+void HugepageLedger::release(const string & owner)
+{
+  auto i = owners_.find(owner);
+  if(i == owners_.end()) return;
+
+  reserved_[i->second.node] -= i->second.mb;
+  owners_.erase(i);
+}
+
+void HugepageLedger::rename(const string & from, const string & to)
+{
+  auto i = owners_.find(from);
+  if(i == owners_.end()) return;
+
+  Reservation r = i->second;
+  owners_.erase(i);
+  release(to);
+  owners_[to] = r;
+}
+
+size_t HugepageLedger::capacity(size_t node) const
+{
+  auto i = capacity_.find(node);
+  return i == capacity_.end() ? 0 : i->second;
+}
+
+size_t HugepageLedger::available(size_t node) const
+{
+  auto r = reserved_.find(node);
+  return capacity(node) - (r == reserved_.end() ? 0 : r->second);
+}
+
+size_t HugepageLedger::available() const
+{
+  size_t mb{0};
+  for(const auto & c : capacity_) mb += available(c.first);
+  return mb;
+}
+
+size_t HugepageLedger::largestAvailable() const
+{
+  size_t mb{0};
+  for(const auto & c : capacity_) mb = std::max(mb, available(c.first));
+  return mb;
+}
+
+// CpuPlacer -------------------------------------------------------------------
+
+InsufficientHugepages::InsufficientHugepages(
+    const string & vm, size_t mb, size_t largest)
+  : runtime_error{
+      "not enough hugepage memory for " + vm + ": " + std::to_string(mb) +
+      "MB requested, at most " + std::to_string(largest) + 
+      "MB free on any numa node"
+    }
+{}
+
+Json CpuAssignment::json() const
+{
+  Json j;
+  j["node"] = node;
+  j["memory_mb"] = memory_mb;
+  j["vcpus"] = vcpus;
+  j["emulator"] = cpuList(emulator);
+  return j;
+}
+
+CpuPlacer::CpuPlacer(NumaTopology topo, vector<size_t> reserved,
+    vector<size_t> pmd)
+  : topo_{topo},
+    reserved_{reserved.begin(), reserved.end()},
+    pmd_{pmd.begin(), pmd.end()},
+    hugepages_{topo_}
+{
+  reserved_.insert(pmd_.begin(), pmd_.end());
+}
+
+vector<size_t> CpuPlacer::usable(const NumaNode & n) const
+{
+  vector<size_t> cpus;
+  for(size_t c : n.cpus) if(reserved_.count(c) == 0) cpus.push_back(c);
+  return cpus;
+}
+
+size_t CpuPlacer::freeCpus(const NumaNode & n) const
+{
+  size_t k{0};
+  for(size_t c : usable(n))
+  {
+    auto l = load_.find(c);
+    if(l == load_.end() || l->second == 0) ++k;
+  }
+  return k;
+}
+
+CpuAssignment CpuPlacer::place(const string & vm, size_t vcpus, 
+    size_t memory_mb)
+{
+  lock_guard<mutex> lk{mtx_};
+
+  auto existing = vms_.find(vm);
+  if(existing != vms_.end()) return existing->second;
+
+  vector<const NumaNode*> all, preferred;
+  for(const auto & n : topo_.nodes())
+  {
+    if(usable(n).empty()) continue;
+    if(hugepages_.available(n.id) < memory_mb) continue;
+    all.push_back(&n);
+    for(size_t c : n.cpus)
+      if(pmd_.count(c)) { preferred.push_back(&n); break; }
+  }
+  if(all.empty())
+  {
+    if(memory_mb > 0) 
+      throw InsufficientHugepages{vm, memory_mb, hugepages_.largestAvailable()};
+    throw runtime_error{"no cpus left to place vms on"};
+  }
+  if(preferred.empty()) preferred = all;
+
+  //the node with the most free cpus that still fits the whole vm
+  auto roomiest = [this,vcpus](const vector<const NumaNode*> & ns){
+    const NumaNode *best{nullptr};
+    for(const NumaNode *n : ns)
+    {
+      size_t f = freeCpus(*n);
+      if(f >= vcpus && (!best || f > freeCpus(*best))) best = n;
+    }
+    return best;
+  };
+
+  //rather a node without pmd threads than doubling up
+  const NumaNode *node = roomiest(preferred);
+  if(!node) node = roomiest(all);
+
+  //everything is taken, go where the load is lightest
+  if(!node)
+  {
+    double lightest{0};
+    for(const NumaNode *n : preferred)
+    {
+      auto cpus = usable(*n);
+      double l{0};
+      for(size_t c : cpus) l += load_[c];
+      l /= cpus.size();
+      if(!node || l < lightest) { node = n; lightest = l; }
+    }
+  }
+
+  vector<size_t> cpus = usable(*node);
+  std::stable_sort(cpus.begin(), cpus.end(),
+      [this](size_t a, size_t b){ return load_[a] < load_[b]; });
+
+  CpuAssignment a;
+  a.node = node->id;
+  a.memory_mb = memory_mb;
+  hugepages_.reserve(vm, node->id, memory_mb);
+  for(size_t i=0; i<vcpus; ++i)
+  {
+    size_t c = cpus[i % cpus.size()];
+    a.vcpus.push_back(c);
+    load_[c]++;
+  }
+
+  for(size_t c : node->cpus)
+    if(reserved_.count(c) && !pmd_.count(c)) a.emulator.push_back(c);
+  if(a.emulator.empty()) a.emulator = usable(*node);
+
+  vms_[vm] = a;
+  return a;
+}
+
+void CpuPlacer::release(const string & vm)
+{
+  lock_guard<mutex> lk{mtx_};
+  auto i = vms_.find(vm);
+  if(i == vms_.end()) return;
+
+  for(size_t c : i->second.vcpus) if(load_[c] > 0) load_[c]--;
+  vms_.erase(i);
+  hugepages_.release(vm);
+}
+
+void CpuPlacer::rename(const string & from, const string & to)
+{
+  {
+    lock_guard<mutex> lk{mtx_};
+    if(vms_.find(from) == vms_.end()) return;
+  }
+  release(to);
+
+  lock_guard<mutex> lk{mtx_};
+  auto i = vms_.find(from);
+  if(i == vms_.end()) return;
+
+  vms_[to] = i->second;
+  vms_.erase(i);
+  hugepages_.rename(from, to);
+}
+
+optional<CpuAssignment> CpuPlacer::assignment(const string & vm) const
+{
+  lock_guard<mutex> lk{mtx_};
+  auto i = vms_.find(vm);
+  if(i == vms_.end()) return nullopt;
+  return i->second;
+}
+
+const NumaTopology & CpuPlacer::topology() const { return topo_; }
+
+Json CpuPlacer::json() const
+{
+  lock_guard<mutex> lk{mtx_};
+
+  Json j = topo_.json();
+  j["reserved"] = cpuList({reserved_.begin(), reserved_.end()});
+  j["pmd"] = cpuList({pmd_.begin(), pmd_.end()});
+
+  for(auto & n : j["nodes"])
+  {
+    size_t vcpus{0};
+    for(size_t c : topo_.node(n["id"]).cpus)
+    {
+      auto l = load_.find(c);
+      if(l != load_.end()) vcpus += l->second;
+    }
+    n["vcpus"] = vcpus;
+    n["hugepage_available_mb"] = hugepages_.available(n["id"]);
+  }
+
+  j["vms"] = vms_.size();
+  return j;
+}
+
+Json CpuPlacer::capacity() const
+{
+  lock_guard<mutex> lk{mtx_};
+
+  vector<Json> nodes;
+  size_t total{0};
+  for(const auto & n : topo_.nodes())
+  {
+    Json x;
+    x["id"] = n.id;
+    x["hugepage_mb"] = hugepages_.capacity(n.id);
+    x["hugepage_available_mb"] = hugepages_.available(n.id);
+    nodes.push_back(x);
+    total += hugepages_.capacity(n.id);
+  }
+
+  Json j;
+  j["nodes"] = nodes;
+  j["hugepage_mb"] = total;
+  j["hugepage_available_mb"] = hugepages_.available();
+  j["hugepage_largest_available_mb"] = hugepages_.largestAvailable();
+  return j;
+}
+
+// pinning ---------------------------------------------------------------------
+
+void marina::pinThread(pid_t tid, const vector<size_t> & cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(size_t c : cpus) CPU_SET(c, &set);
+
+  if(sched_setaffinity(tid, sizeof(set), &set) != 0)
+    throw runtime_error{
+      "pin " + std::to_string(tid) + " to " + cpuList(cpus) + ": " +
+      strerror(errno)
+    };
+}
+
+vector<pid_t> marina::processThreads(pid_t pid, string proc)
+{
+  vector<pid_t> tids;
+  for(const string & e : listDir(proc + "/" + std::to_string(pid) + "/task"))
+    if(!e.empty() && isdigit(e[0])) tids.push_back(std::stoi(e));
+  return tids;
+}
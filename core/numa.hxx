@@ -0,0 +1,161 @@
+#ifndef MARINA_CORE_NUMA_HXX
+#define MARINA_CORE_NUMA_HXX
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <stdexcept>
+#include <experimental/optional>
+#include <sys/types.h>
+#include "3p/json/src/json.hpp"
+
+namespace marina
+{
+  using Json = nlohmann::json;
+
+  //kernel cpu lists, e.g. 0-3,8,10-11
+  std::vector<size_t> parseCpuList(const std::string &);
+  std::string cpuList(const std::vector<size_t> &);
+
+  //a cpu set as a hex mask, e.g. for the ovs pmd-cpu-mask
+  std::string cpuMask(const std::vector<size_t> &);
+
+  struct NumaNode
+  {
+    size_t id;
+    std::vector<size_t> cpus;
+    size_t hugepage_mb{0}, hugepage_free_mb{0};
+  };
+
+  /*
+   * The numa nodes of a host, the cpus on each and the hugepage memory that
+   * has been set aside on each, along with how much of it is not in use
+   */
+  class NumaTopology
+  {
+    public:
+      NumaTopology(std::vector<NumaNode>);
+
+      //read from sysfs, a root other than /sys is for tests
+      static NumaTopology detect(std::string sysfs = "/sys");
+
+      const std::vector<NumaNode> & nodes() const;
+
+      //throws out_of_range for an unknown node or cpu
+      const NumaNode & node(size_t id) const;
+      size_t nodeOf(size_t cpu) const;
+
+      Json json() const;
+
+    private:
+      std::vector<NumaNode> nodes_;
+  };
+
+  /*
+   * Hugepage memory reserved on each numa node. Guest memory is bound to a
+   * single node so a vm fits only if one node has room for all of it, the
+   * sum across nodes says little. Not thread safe, the CpuPlacer that owns it
+   * serializes access.
+   */
+  class HugepageLedger
+  {
+    public:
+      //the hugepage memory of each node is what the ledger hands out
+      explicit HugepageLedger(const NumaTopology &);
+
+      //false if the node does not have mb left, owners hold one reservation
+      bool reserve(const std::string & owner, size_t node, size_t mb);
+      void release(const std::string & owner);
+      void rename(const std::string & from, const std::string & to);
+
+      size_t capacity(size_t node) const;
+      size_t available(size_t node) const;
+      size_t available() const;
+
+      //the most any one vm can get right now
+      size_t largestAvailable() const;
+
+    private:
+      struct Reservation
+      {
+        size_t node, mb;
+      };
+
+      std::map<size_t, size_t> capacity_, reserved_;
+      std::unordered_map<std::string, Reservation> owners_;
+  };
+
+  //thrown when no numa node has room for the memory of a vm
+  struct InsufficientHugepages : public std::runtime_error
+  {
+    InsufficientHugepages(const std::string & vm, size_t mb, size_t largest);
+  };
+
+  //where the threads and memory of a vm live
+  struct CpuAssignment
+  {
+    size_t node;
+    size_t memory_mb{0};
+    std::vector<size_t> vcpus; //the host cpu of each vcpu
+    std::vector<size_t> emulator; //host cpus for the rest of qemu's threads
+
+    Json json() const;
+  };
+
+  /*
+   * Hands out host cpus to vms. A vm is kept to one numa node, its memory is
+   * to be bound to that same node. Nodes that run ovs pmd threads come first
+   * since vhost-user queues are served from the node the guest memory is on.
+   * Reserved cpus, i.e. the ones the host and pmd threads run on, never get
+   * vcpus. Emulator threads share the reserved non-pmd cpus of their node.
+   * Cpus are handed out least loaded first, so once every cpu of a node is
+   * taken vcpus start doubling up. Hugepage memory on the other hand is never
+   * overcommitted, a vm only goes to a node whose ledger has room for it.
+   */
+  class CpuPlacer
+  {
+    public:
+      CpuPlacer(NumaTopology,
+                std::vector<size_t> reserved = {},
+                std::vector<size_t> pmd = {});
+
+      //throws InsufficientHugepages, placing a vm again returns what it has
+      CpuAssignment place(const std::string & vm, size_t vcpus, 
+                          size_t memory_mb = 0);
+      void release(const std::string & vm);
+
+      //an existing placement of `to` is released
+      void rename(const std::string & from, const std::string & to);
+
+      std::experimental::optional<CpuAssignment>
+      assignment(const std::string & vm) const;
+
+      const NumaTopology & topology() const;
+      Json json() const;
+
+      //hugepage memory per node, total and still available
+      Json capacity() const;
+
+    private:
+      std::vector<size_t> usable(const NumaNode &) const;
+      size_t freeCpus(const NumaNode &) const;
+
+      NumaTopology topo_;
+      std::set<size_t> reserved_, pmd_;
+      std::map<size_t, size_t> load_; //vcpus on each host cpu
+      std::unordered_map<std::string, CpuAssignment> vms_;
+      HugepageLedger hugepages_;
+      mutable std::mutex mtx_;
+  };
+
+  //restrict a thread, or a process's main thread, to a set of host cpus
+  void pinThread(pid_t tid, const std::vector<size_t> & cpus);
+
+  //the thread ids of a process, from /proc/<pid>/task
+  std::vector<pid_t> processThreads(pid_t pid, std::string proc = "/proc");
+}
+
+#endif
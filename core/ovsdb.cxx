@@ -0,0 +1,344 @@
+#include <stdexcept>
+#include <fmt/format.h>
+#include "core/ovsdb.hxx"
+#include "common/net/glog.hxx"
+#include "common/net/trace.hxx"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::to_string;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using namespace marina;
+
+namespace
+{
+  Json ovsMap(const OvsTxn::Options & m)
+  {
+    Json kvs = Json::array();
+    for(const auto & p : m) kvs.push_back(Json::array({p.first, p.second}));
+    return Json::array({"map", kvs});
+  }
+
+  Json ovsSet(const vector<Json> & xs)
+  {
+    return Json::array({"set", xs});
+  }
+
+  Json namedUuid(string name)
+  {
+    return Json::array({"named-uuid", name});
+  }
+
+  //an Interface and a Port row for a port, returns the named-uuid of the port
+  Json insertPort(Json & ops, string name, string type,
+                  const OvsTxn::Options & options, bool isolated, string tag)
+  {
+    Json ifx;
+    ifx["op"] = "insert";
+    ifx["table"] = "Interface";
+    ifx["uuid-name"] = "ifx" + tag;
+    ifx["row"]["name"] = name;
+    ifx["row"]["type"] = type;
+    ifx["row"]["options"] = ovsMap(options);
+    ops.push_back(ifx);
+
+    Json port;
+    port["op"] = "insert";
+    port["table"] = "Port";
+    port["uuid-name"] = "port" + tag;
+    port["row"]["name"] = name;
+    port["row"]["interfaces"] = namedUuid("ifx" + tag);
+    if(isolated) port["row"]["protected"] = true;
+    ops.push_back(port);
+
+    return namedUuid("port" + tag);
+  }
+}
+
+// OvsTxn ----------------------------------------------------------------------
+
+OvsTxn & OvsTxn::addBridge(string name, string datapath_type,
+                           Options other_config)
+{
+  add_bridges_.push_back({name, datapath_type, other_config});
+  return *this;
+}
+
+OvsTxn & OvsTxn::addPort(string bridge, string name, string type,
+                         Options options, bool isolated)
+{
+  add_ports_.push_back({bridge, name, type, options, isolated});
+  return *this;
+}
+
+OvsTxn & OvsTxn::delBridge(string name)
+{
+  del_bridges_.push_back(name);
+  return *this;
+}
+
+OvsTxn & OvsTxn::setOtherConfig(Options other_config)
+{
+  for(const auto & p : other_config) other_config_[p.first] = p.second;
+  return *this;
+}
+
+bool OvsTxn::empty() const
+{
+  return add_bridges_.empty() && add_ports_.empty() && del_bridges_.empty() &&
+         other_config_.empty();
+}
+
+// OvsDb -----------------------------------------------------------------------
+
+OvsDb::OvsDb(string socket_path, milliseconds timeout)
+  : stream_{socket_path},
+    timeout_{timeout}
+{}
+
+OvsDb::~OvsDb() {}
+
+Json OvsDb::call(string method, Json params)
+{
+  lock_guard<mutex> lk{mtx_};
+  if(!stream_.connected()) 
+  {
+    try { stream_.connect(); }
+    catch(runtime_error &e) { throw runtime_error{"ovsdb: " + string{e.what()}}; }
+  }
+
+  uint64_t id = next_id_++;
+  Json rq;
+  rq["method"] = method;
+  rq["params"] = params;
+  rq["id"] = id;
+  stream_.send(rq);
+
+  for(;;)
+  {
+    //give the server a chance to time out a wait operation first
+    Json m = stream_.receive(timeout_ + std::chrono::seconds{5});
+
+    //the server may probe us with echo requests at any time
+    if(m.count("method"))
+    {
+      if(m["method"] == "echo")
+      {
+        Json r;
+        r["id"] = m["id"];
+        r["result"] = m["params"];
+        r["error"] = nullptr;
+        stream_.send(r);
+      }
+      continue;
+    }
+
+    if(m.count("id") == 0 || m["id"] != id) continue;
+
+    if(m.count("error") && !m["error"].is_null())
+      throw runtime_error{"ovsdb: " + method + ": " + m["error"].dump()};
+
+    return m["result"];
+  }
+}
+
+Json OvsDb::transact(Json ops)
+{
+  Json params = Json::array({"Open_vSwitch"});
+  for(const auto & op : ops) params.push_back(op);
+
+  Json result = call("transact", params);
+
+  for(const auto & r : result)
+  {
+    if(r.is_object() && r.count("error"))
+    {
+      string details = r.count("details") ? r["details"].get<string>() : "";
+      throw runtime_error{
+        fmt::format("ovsdb: transaction failed: {} {}",
+            r["error"].get<string>(), details)
+      };
+    }
+  }
+
+  return result;
+}
+
+vector<Json> OvsDb::uuidsOf(const vector<string> & bridges)
+{
+  Json ops = Json::array();
+  for(const string & b : bridges)
+  {
+    Json op;
+    op["op"] = "select";
+    op["table"] = "Bridge";
+    op["where"] = Json::array({Json::array({"name", "==", b})});
+    op["columns"] = Json::array({"_uuid"});
+    ops.push_back(op);
+  }
+
+  vector<Json> uuids;
+  for(const auto & r : transact(ops))
+    for(const auto & row : r["rows"])
+      uuids.push_back(row["_uuid"]);
+
+  return uuids;
+}
+
+void OvsDb::commit(const OvsTxn & txn, bool wait_reconfigure)
+{
+  if(txn.empty()) return;
+
+  Span span{"ovsdb.commit"};
+  span.arg("bridges", to_string(txn.add_bridges_.size()))
+      .arg("ports", to_string(txn.add_ports_.size()))
+      .arg("deleted", to_string(txn.del_bridges_.size()));
+
+  Json ops = Json::array();
+  size_t tag{0};
+
+  //bridges going away, missing bridges are not an error
+  vector<Json> dead;
+  if(!txn.del_bridges_.empty()) dead = uuidsOf(txn.del_bridges_);
+
+  if(!dead.empty())
+  {
+    Json op;
+    op["op"] = "mutate";
+    op["table"] = "Open_vSwitch";
+    op["where"] = Json::array();
+    op["mutations"] =
+      Json::array({Json::array({"bridges", "delete", ovsSet(dead)})});
+    ops.push_back(op);
+  }
+
+  //ports grouped by the bridge they land on
+  map<string, vector<Json>> ports;
+  for(const auto & p : txn.add_ports_)
+    ports[p.bridge].push_back(
+        insertPort(ops, p.name, p.type, p.options, p.isolated, 
+          to_string(tag++)));
+
+  //new bridges carry their ports with them
+  vector<Json> bridges;
+  for(const auto & b : txn.add_bridges_)
+  {
+    string t = to_string(tag++);
+    vector<Json> bports = ports[b.name];
+    bports.push_back(insertPort(ops, b.name, "internal", {}, false, t));
+    ports.erase(b.name);
+
+    Json op;
+    op["op"] = "insert";
+    op["table"] = "Bridge";
+    op["uuid-name"] = "br" + t;
+    op["row"]["name"] = b.name;
+    op["row"]["datapath_type"] = b.datapath_type;
+    op["row"]["other_config"] = ovsMap(b.other_config);
+    op["row"]["ports"] = ovsSet(bports);
+    ops.push_back(op);
+
+    bridges.push_back(namedUuid("br" + t));
+  }
+
+  if(!bridges.empty())
+  {
+    Json op;
+    op["op"] = "mutate";
+    op["table"] = "Open_vSwitch";
+    op["where"] = Json::array();
+    op["mutations"] =
+      Json::array({Json::array({"bridges", "insert", ovsSet(bridges)})});
+    ops.push_back(op);
+  }
+
+  //ports on bridges that already exist
+  for(const auto & p : ports)
+  {
+    Json op;
+    op["op"] = "mutate";
+    op["table"] = "Bridge";
+    op["where"] = Json::array({Json::array({"name", "==", p.first})});
+    op["mutations"] =
+      Json::array({Json::array({"ports", "insert", ovsSet(p.second)})});
+    ops.push_back(op);
+  }
+
+  //map mutations only insert keys that are not there yet, so out with the old
+  if(!txn.other_config_.empty())
+  {
+    vector<Json> keys;
+    for(const auto & p : txn.other_config_) keys.push_back(p.first);
+
+    Json op;
+    op["op"] = "mutate";
+    op["table"] = "Open_vSwitch";
+    op["where"] = Json::array();
+    op["mutations"] = Json::array({
+      Json::array({"other_config", "delete", ovsSet(keys)}),
+      Json::array({"other_config", "insert", ovsMap(txn.other_config_)})
+    });
+    ops.push_back(op);
+  }
+
+  //ask vswitchd to reconfigure and find out which sequence number to wait on
+  if(wait_reconfigure)
+  {
+    Json bump;
+    bump["op"] = "mutate";
+    bump["table"] = "Open_vSwitch";
+    bump["where"] = Json::array();
+    bump["mutations"] = Json::array({Json::array({"next_cfg", "+=", 1})});
+    ops.push_back(bump);
+
+    Json sel;
+    sel["op"] = "select";
+    sel["table"] = "Open_vSwitch";
+    sel["where"] = Json::array();
+    sel["columns"] = Json::array({"next_cfg", "cur_cfg"});
+    ops.push_back(sel);
+  }
+
+  Json result = transact(ops);
+  if(!wait_reconfigure) return;
+
+  const Json & row = result.at(ops.size()-1).at("rows").at(0);
+  int64_t next_cfg = row.at("next_cfg"), cur_cfg = row.at("cur_cfg");
+
+  //vswitchd may apply several commits in one pass and skip past next_cfg, so
+  //like ovs-vsctl wait for any change of cur_cfg until it has caught up
+  auto deadline = steady_clock::now() + timeout_;
+  while(cur_cfg < next_cfg)
+  {
+    auto left = duration_cast<milliseconds>(deadline - steady_clock::now());
+    if(left.count() <= 0)
+      throw runtime_error{fmt::format(
+          "ovsdb: vswitchd did not reach cfg {} (at {})", next_cfg, cur_cfg)};
+
+    Json wait;
+    wait["op"] = "wait";
+    wait["table"] = "Open_vSwitch";
+    wait["where"] = Json::array();
+    wait["timeout"] = left.count();
+    wait["columns"] = Json::array({"cur_cfg"});
+    wait["until"] = "!=";
+    Json was;
+    was["cur_cfg"] = cur_cfg;
+    wait["rows"] = Json::array({was});
+
+    Json sel;
+    sel["op"] = "select";
+    sel["table"] = "Open_vSwitch";
+    sel["where"] = Json::array();
+    sel["columns"] = Json::array({"cur_cfg"});
+
+    Json r = transact(Json::array({wait, sel}));
+    cur_cfg = r.at(1).at("rows").at(0).at("cur_cfg");
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef MARINA_CORE_OVSDB_HXX
+#define MARINA_CORE_OVSDB_HXX
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include "core/json_stream.hxx"
+
+namespace marina
+{
+  /*
+   * A set of bridge and port changes to be applied to the Open_vSwitch
+   * database as a single transaction
+   */
+  class OvsTxn
+  {
+    public:
+      using Options = std::map<std::string, std::string>;
+
+      //a bridge along with its internal port, like `ovs-vsctl add-br`
+      OvsTxn & addBridge(std::string name,
+                         std::string datapath_type = "netdev",
+                         Options other_config = {});
+
+      //a port on a bridge that either already exists or is added by this
+      //same transaction, like `ovs-vsctl add-port`. Isolated ports do not
+      //forward to one another, the Port protected column
+      OvsTxn & addPort(std::string bridge,
+                       std::string name,
+                       std::string type,
+                       Options options = {},
+                       bool isolated = false);
+
+      //a bridge along with all of its ports, like `ovs-vsctl del-br`
+      OvsTxn & delBridge(std::string name);
+
+      //switch wide settings, like `ovs-vsctl set Open_vSwitch . other_config:k=v`
+      OvsTxn & setOtherConfig(Options other_config);
+
+      bool empty() const;
+
+    private:
+      friend class OvsDb;
+
+      struct Bridge { std::string name, datapath_type; Options other_config; };
+      struct Port 
+      { 
+        std::string bridge, name, type; 
+        Options options; 
+        bool isolated; 
+      };
+
+      std::vector<Bridge> add_bridges_;
+      std::vector<Port> add_ports_;
+      std::vector<std::string> del_bridges_;
+      Options other_config_;
+  };
+
+  /*
+   * A minimal OVSDB (RFC 7047) JSON-RPC client that talks to ovsdb-server
+   * over its unix socket in place of shelling out to ovs-vsctl. Each commit
+   * is one database transaction, after which the client waits for
+   * ovs-vswitchd to catch up with the new configuration.
+   */
+  class OvsDb
+  {
+    public:
+      OvsDb(std::string socket_path = "/var/run/openvswitch/db.sock",
+            std::chrono::milliseconds timeout = std::chrono::seconds{30});
+      ~OvsDb();
+
+      OvsDb(const OvsDb &) = delete;
+      OvsDb & operator=(const OvsDb &) = delete;
+
+      //apply the transaction, waiting for vswitchd to reconfigure if asked
+      void commit(const OvsTxn &, bool wait_reconfigure = true);
+
+      //a raw `transact` on the Open_vSwitch database
+      Json transact(Json ops);
+
+      //a raw json-rpc call
+      Json call(std::string method, Json params);
+
+    private:
+      std::vector<Json> uuidsOf(const std::vector<std::string> & bridges);
+
+      JsonStream stream_;
+      std::chrono::milliseconds timeout_;
+      uint64_t next_id_{0};
+      std::mutex mtx_;
+  };
+}
+
+#endif
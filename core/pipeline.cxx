@@ -0,0 +1,223 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "core/pipeline.hxx"
+#include "common/net/trace.hxx"
+
+using std::string;
+using std::vector;
+using std::thread;
+using std::atomic;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::unique_ptr;
+using std::exception;
+using std::runtime_error;
+using std::invalid_argument;
+using std::sort;
+using namespace std::chrono;
+using namespace marina;
+
+// Budget ----------------------------------------------------------------------
+
+Budget::Budget(string name, size_t capacity)
+  : name_{name},
+    capacity_{capacity},
+    available_{capacity}
+{}
+
+void Budget::acquire(size_t n)
+{
+  if(n > capacity_)
+    throw runtime_error{
+      fmt::format("{} budget: {} requested but capacity is {}",
+          name_, n, capacity_)
+    };
+
+  unique_lock<mutex> lk{mtx_};
+  cv_.wait(lk, [this,n](){ return available_ >= n; });
+  available_ -= n;
+}
+
+bool Budget::tryAcquire(size_t n)
+{
+  lock_guard<mutex> lk{mtx_};
+  if(available_ < n) return false;
+  available_ -= n;
+  return true;
+}
+
+void Budget::release(size_t n)
+{
+  {
+    lock_guard<mutex> lk{mtx_};
+    available_ = std::min(capacity_, available_ + n);
+  }
+  cv_.notify_all();
+}
+
+const string & Budget::name() const { return name_; }
+size_t Budget::capacity() const { return capacity_; }
+
+size_t Budget::available() const
+{
+  lock_guard<mutex> lk{mtx_};
+  return available_;
+}
+
+// PipelineReport --------------------------------------------------------------
+
+Json PipelineReport::json() const
+{
+  Json j;
+  j["wall_ms"] = wall_ms;
+
+  vector<Json> ts;
+  for(const auto & t : timings)
+  {
+    Json x;
+    x["job"] = t.job;
+    x["stage"] = t.stage;
+    x["wait_ms"] = t.wait_ms;
+    x["run_ms"] = t.run_ms;
+    ts.push_back(x);
+  }
+  j["timings"] = ts;
+
+  j["errors"] = Json::object();
+  for(const auto & e : errors) j["errors"][e.first] = e.second;
+
+  return j;
+}
+
+string PipelineReport::summary() const
+{
+  //stages in the order they first show up
+  vector<string> order;
+  struct Agg { size_t n{0}; double run{0}, wait{0}, max{0}; };
+  std::unordered_map<string, Agg> agg;
+  for(const auto & t : timings)
+  {
+    if(agg.find(t.stage) == agg.end()) order.push_back(t.stage);
+    Agg & a = agg[t.stage];
+    a.n++;
+    a.run += t.run_ms;
+    a.wait += t.wait_ms;
+    a.max = std::max(a.max, t.run_ms);
+  }
+
+  string s = fmt::format("wall {:.1f}ms, {} errors", wall_ms, errors.size());
+  for(const string & stage : order)
+  {
+    const Agg & a = agg[stage];
+    s += fmt::format("\n  {}: n={} run avg {:.1f}ms max {:.1f}ms, wait avg {:.1f}ms",
+        stage, a.n, a.run/a.n, a.max, a.wait/a.n);
+  }
+  return s;
+}
+
+// Pipeline --------------------------------------------------------------------
+
+Pipeline::Pipeline(vector<Stage> stages, size_t workers)
+  : stages_{stages},
+    workers_{std::max<size_t>(workers, 1)}
+{}
+
+PipelineReport Pipeline::run(vector<Job> jobs)
+{
+  for(const Job & j : jobs)
+  {
+    if(j.steps.size() != stages_.size())
+      throw invalid_argument{
+        fmt::format("pipeline job {} has {} steps for {} stages",
+            j.name, j.steps.size(), stages_.size())
+      };
+  }
+
+  vector<unique_ptr<Budget>> slots;
+  for(const Stage & s : stages_)
+    slots.emplace_back(new Budget{s.name, std::max<size_t>(s.concurrency, 1)});
+
+  PipelineReport report;
+  mutex report_mtx;
+  atomic<size_t> next{0};
+  TraceContext ctx = Trace::current();
+  auto start = steady_clock::now();
+
+  auto ms = [](auto d){ return duration<double, std::milli>(d).count(); };
+
+  auto worker = [&]()
+  {
+    Trace::current(ctx);
+    for(size_t i = next++; i < jobs.size(); i = next++)
+    {
+      Job & job = jobs[i];
+      for(size_t k=0; k<stages_.size(); ++k)
+      {
+        Step & step = job.steps[k];
+
+        //a fixed acquisition order keeps jobs from deadlocking on budgets
+        sort(step.claims.begin(), step.claims.end(),
+            [](const Claim & a, const Claim & b){ return a.budget < b.budget; });
+
+        auto t0 = steady_clock::now();
+        try
+        {
+          slots[k]->acquire(1);
+          size_t held{0};
+          try
+          {
+            for(; held < step.claims.size(); ++held)
+              step.claims[held].budget->acquire(step.claims[held].amount);
+
+            auto t1 = steady_clock::now();
+            {
+              Span span{stages_[k].name};
+              span.arg("job", job.name);
+              step.work();
+            }
+            auto t2 = steady_clock::now();
+
+            lock_guard<mutex> lk{report_mtx};
+            report.timings.push_back(
+                {job.name, stages_[k].name, ms(t1-t0), ms(t2-t1)});
+          }
+          catch(...)
+          {
+            for(size_t c=0; c<held; ++c)
+              step.claims[c].budget->release(step.claims[c].amount);
+            slots[k]->release(1);
+            throw;
+          }
+          for(const Claim & c : step.claims) c.budget->release(c.amount);
+          slots[k]->release(1);
+        }
+        catch(exception &e)
+        {
+          lock_guard<mutex> lk{report_mtx};
+          report.errors[job.name] = stages_[k].name + ": " + e.what();
+          break;
+        }
+        catch(...)
+        {
+          lock_guard<mutex> lk{report_mtx};
+          report.errors[job.name] = stages_[k].name + ": unknown failure";
+          break;
+        }
+      }
+    }
+  };
+
+  vector<thread> pool;
+  for(size_t i=0; i<std::min(workers_, jobs.size()); ++i)
+    pool.emplace_back(worker);
+  for(auto & t : pool) t.join();
+
+  report.wall_ms = ms(steady_clock::now() - start);
+  return report;
+}
@@ -0,0 +1,107 @@
+#ifndef MARINA_CORE_PIPELINE_HXX
+#define MARINA_CORE_PIPELINE_HXX
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "3p/json/src/json.hpp"
+
+namespace marina
+{
+  using Json = nlohmann::json;
+
+  /*
+   * A weighted counting semaphore standing in for a finite host resource,
+   * e.g. cpu cores, concurrent disk io or hugepage memory
+   */
+  class Budget
+  {
+    public:
+      Budget(std::string name, size_t capacity);
+
+      //blocks until n units are available, throws if n exceeds capacity
+      void acquire(size_t n);
+      bool tryAcquire(size_t n);
+      void release(size_t n);
+
+      const std::string & name() const;
+      size_t capacity() const;
+      size_t available() const;
+
+    private:
+      std::string name_;
+      size_t capacity_, available_;
+      mutable std::mutex mtx_;
+      std::condition_variable cv_;
+  };
+
+  //an amount of a budget claimed for the duration of a pipeline step
+  struct Claim
+  {
+    Budget *budget;
+    size_t amount;
+  };
+
+  /*
+   * Per job, per stage wall clock numbers of a pipeline run. Wait time is the
+   * time spent blocked on stage concurrency and budgets, run time is the time
+   * spent doing the work.
+   */
+  struct PipelineReport
+  {
+    struct Timing
+    {
+      std::string job, stage;
+      double wait_ms, run_ms;
+    };
+
+    std::vector<Timing> timings;
+    std::unordered_map<std::string, std::string> errors;
+    double wall_ms{0};
+
+    Json json() const;
+    std::string summary() const;
+  };
+
+  /*
+   * Runs a set of jobs through a fixed sequence of stages. Jobs are picked up
+   * by a pool of workers so different jobs overlap in different stages, each
+   * stage has its own concurrency limit and each step may additionally claim
+   * shared budgets. A job that fails skips its remaining stages, the other
+   * jobs carry on.
+   */
+  class Pipeline
+  {
+    public:
+      struct Stage
+      {
+        std::string name;
+        size_t concurrency;
+      };
+
+      struct Step
+      {
+        std::function<void()> work;
+        std::vector<Claim> claims{};
+      };
+
+      struct Job
+      {
+        std::string name;
+        std::vector<Step> steps; //one per stage
+      };
+
+      Pipeline(std::vector<Stage> stages, size_t workers);
+
+      PipelineReport run(std::vector<Job> jobs);
+
+    private:
+      std::vector<Stage> stages_;
+      size_t workers_;
+  };
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include <stdexcept>
+#include "core/qmp.hxx"
+#include "common/net/trace.hxx"
+
+using std::string;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::chrono::milliseconds;
+using namespace marina;
+
+Qmp::Qmp(string socket_path, milliseconds timeout)
+  : stream_{socket_path},
+    timeout_{timeout}
+{}
+
+void Qmp::handshake()
+{
+  stream_.connect();
+
+  //the server opens with a greeting, then wants capabilities negotiated
+  Json greeting = stream_.receive(timeout_);
+  if(greeting.count("QMP") == 0)
+    throw runtime_error{"qmp " + stream_.path() + ": unexpected greeting"};
+
+  Json rq;
+  rq["execute"] = "qmp_capabilities";
+  stream_.send(rq);
+
+  for(;;)
+  {
+    Json m = stream_.receive(timeout_);
+    if(m.count("return")) return;
+    if(m.count("error"))
+      throw runtime_error{"qmp " + stream_.path() + ": " + m["error"].dump()};
+  }
+}
+
+Json Qmp::execute(string command, Json arguments)
+{
+  Span span{"qmp." + command};
+  lock_guard<mutex> lk{mtx_};
+
+  try
+  {
+    if(!stream_.connected()) handshake();
+
+    uint64_t id = next_id_++;
+    Json rq;
+    rq["execute"] = command;
+    if(!arguments.empty()) rq["arguments"] = arguments;
+    rq["id"] = id;
+    stream_.send(rq);
+
+    for(;;)
+    {
+      Json m = stream_.receive(timeout_);
+      if(m.count("event")) continue;
+      if(m.count("id") && m["id"] != id) continue;
+
+      if(m.count("error"))
+      {
+        string desc = m["error"].count("desc") ?
+          m["error"]["desc"].get<string>() : m["error"].dump();
+        throw runtime_error{"qmp " + command + ": " + desc};
+      }
+
+      return m["return"];
+    }
+  }
+  catch(runtime_error &)
+  {
+    span.arg("error", "true");
+    throw;
+  }
+}
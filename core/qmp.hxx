@@ -0,0 +1,35 @@
+#ifndef MARINA_CORE_QMP_HXX
+#define MARINA_CORE_QMP_HXX
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include "core/json_stream.hxx"
+
+namespace marina
+{
+  /*
+   * A client for the qemu machine protocol on a monitor unix socket, e.g.
+   * `-qmp unix:<path>,server,nowait`. Asynchronous events that arrive while
+   * waiting for a command to return are skipped.
+   */
+  class Qmp
+  {
+    public:
+      Qmp(std::string socket_path,
+          std::chrono::milliseconds timeout = std::chrono::seconds{10});
+
+      //run a command and return its result, throws on a qmp error
+      Json execute(std::string command, Json arguments = Json::object());
+
+    private:
+      void handshake();
+
+      JsonStream stream_;
+      std::chrono::milliseconds timeout_;
+      uint64_t next_id_{0};
+      std::mutex mtx_;
+  };
+}
+
+#endif
@@ -17,8 +17,12 @@ using std::array;
 using std::set_difference;
 using std::inserter;
 using std::pair;
+using std::make_pair;
+using std::to_string;
 using std::unordered_map;
 using std::remove_if;
+using std::make_shared;
+using std::shared_ptr;
 using std::endl;
 using namespace marina;
 using namespace pipes;
@@ -194,19 +198,26 @@ namespace marina
     TestbedTopology::SwitchMap switches;
 
     TestbedTopology::HostMap hosts;
-    vector<TbLink> links;
+    Cow<vector<TbLink>> links{Cow<vector<TbLink>>::make()};
 
     void removeEndpointLink(const Endpoint &);
   };
 
   struct Switch_
   {
-    Switch_(string name) : name{name} {} 
+    struct Data
+    {
+      Data(string name) : name{name} {}
 
-    Uuid id;
-    string name;
-    Bandwidth backplane;
+      Uuid id;
+      string name;
+      Bandwidth backplane;
+    };
 
+    Switch_(string name) : d{Cow<Data>::make(name)} {} 
+
+    //shared with clones until written, see Blueprint::clone
+    Cow<Data> d;
     vector<Network> networks;
   };
 
@@ -253,7 +264,7 @@ TestbedTopology TestbedTopology::fromJson(Json j)
   for(Json & lj : links)
   {
     TbLink l = TbLink::fromJson(lj);
-    t._->links.push_back(l);
+    t._->links.write().push_back(l);
   }
 
   return t;
@@ -309,12 +320,33 @@ Host TestbedTopology::host(string name)
   return c;
 }
 
+void TestbedTopology::reserve(size_t hosts, size_t switches, size_t links)
+{
+  _->hosts.reserve(hosts);
+  _->switches.reserve(switches);
+  if(links > _->links->size()) _->links.write().reserve(links);
+}
+
+vector<Host> 
+TestbedTopology::addHosts(string prefix, size_t n, const Host & like)
+{
+  vector<Host> hs;
+  hs.reserve(n);
+  _->hosts.reserve(_->hosts.size() + n);
+  for(size_t i=0; i<n; ++i)
+  {
+    hs.push_back(like.copy(prefix + to_string(i)));
+    _->hosts.emplace(hs.back().id(), hs.back());
+  }
+  return hs;
+}
+
 TestbedTopology::HostSet TestbedTopology::connectedHosts(const Switch s) const
 {
   TestbedTopology::HostSet hs;
   Endpoint e{s.id()};
 
-  for(TbLink & l : _->links)
+  for(const TbLink & l : *_->links)
   {
     //if(l.endpoints[0].name == s.name() && 
     //   l.endpoints[1].kind == Endpoint::Kind::Host)
@@ -346,7 +378,7 @@ TestbedTopology::SwitchSet TestbedTopology::connectedSwitches(const Host h) cons
 {
   TestbedTopology::SwitchSet sws;
 
-  for(TbLink & l : _->links)
+  for(const TbLink & l : *_->links)
   {
     if(l.endpoints[0].id == h.id())
     {
@@ -362,14 +394,32 @@ TestbedTopology::SwitchSet TestbedTopology::connectedSwitches(const Host h) cons
   return sws;
 }
 
+void TestbedTopology::forEachLink(const LinkVisitor & f) const
+{
+  for(const TbLink & l : *_->links) f(l.endpoints[0], l.endpoints[1], l.capacity);
+}
+
+void TestbedTopology::link(Endpoint a, Endpoint b, Bandwidth bw)
+{
+  _->links.write().push_back({a, b, bw});
+}
+
 void TestbedTopology::connect(Switch a, Switch b, Bandwidth bw)
 {
-  _->links.push_back({a, b, bw});
+  _->links.write().push_back({a, b, bw});
 }
 
 void TestbedTopology::connect(pair<Host, Interface> a, Switch b, Bandwidth bw)
 {
-  _->links.push_back({a, b, bw});
+  _->links.write().push_back({a, b, bw});
+}
+
+void TestbedTopology::connect(const vector<Host> & hs, string ifx, Switch s, 
+    Bandwidth bw)
+{
+  vector<TbLink> & ls = _->links.write();
+  ls.reserve(ls.size() + hs.size());
+  for(Host h : hs) ls.emplace_back(make_pair(h, h.ifx(ifx)), s, bw);
 }
 
 Json TestbedTopology::json() const
@@ -378,22 +428,23 @@ Json TestbedTopology::json() const
   j["name"] = name();
   j["switches"] = jtransform(_->switches);
   j["hosts"] = jtransform(_->hosts);
-  j["links"] = jtransform(_->links);
+  j["links"] = jtransform(*_->links);
   return j;
 }
 
 //void TestbedTopology_::removeEndpointLink(Endpoint::Kind kind, string name)
 void TestbedTopology_::removeEndpointLink(const Endpoint & e)
 {
-  links.erase(
-    remove_if(links.begin(), links.end(),
+  vector<TbLink> & ls = links.write();
+  ls.erase(
+    remove_if(ls.begin(), ls.end(),
       [&e](const TbLink & l){ 
         Endpoint a = l.endpoints[0],
                  b = l.endpoints[1];
         return a == e || b == e;
         //(a.kind == kind && a.name == name) ||
         //(b.kind == kind && b.name == name) ;
-    }), links.end()
+    }), ls.end()
   );
 
 }
@@ -427,12 +478,15 @@ TestbedTopology TestbedTopology::clone() const
 {
   TestbedTopology t{name()};
 
+  t._->hosts.reserve(_->hosts.size());
   for(auto & h : _->hosts) 
-    t._->hosts.insert_or_assign(h.first, h.second.clone());
+    t._->hosts.emplace(h.first, h.second.clone());
 
+  t._->switches.reserve(_->switches.size());
   for(auto & s : _->switches) 
-    t._->switches.insert_or_assign(s.first, s.second.clone());
+    t._->switches.emplace(s.first, s.second.clone());
 
+  t._->links = _->links;
   return t;
 }
 
@@ -470,12 +524,17 @@ Switch::Switch(string name)
   : _{new Switch_{name}}
 {}
 
-const Uuid & Switch::id() const { return _->id; }
+Switch::Switch(shared_ptr<Switch_> x)
+  : _{x}
+{}
+
+const Uuid & Switch::id() const { return _->d->id; }
+void Switch::id(const Uuid & id) { _->d.write().id = id; }
 
-string Switch::name() const { return _->name; }
+string Switch::name() const { return _->d->name; }
 Switch & Switch::name(string name)
 {
-  _->name = name;
+  _->d.write().name = name;
   return *this;
 }
 
@@ -497,10 +556,10 @@ void Switch::removeNetwork(Uuid id)
   );
 }
 
-Bandwidth Switch::backplane() const { return _->backplane; }
+Bandwidth Switch::backplane() const { return _->d->backplane; }
 Switch & Switch::backplane(Bandwidth b)
 {
-  _->backplane = b;
+  _->d.write().backplane = b;
   return *this;
 }
 
@@ -542,8 +601,7 @@ Json Switch::json() const
 
 Switch Switch::clone() const
 {
-  Switch s{_->name};
-  s._->backplane = _->backplane;
+  Switch s{make_shared<Switch_>(*_)};
   s._->networks = _->networks
     | map([](auto x){ return x.clone(); });
 
@@ -556,7 +614,12 @@ Host::Host(string name)
   : _{new Host_{name}}
 {}
 
+Host::Host(shared_ptr<Host_> x)
+  : _{x}
+{}
+
 const Uuid & Host::id() const { return _->host_comp.id(); }
+void Host::id(const Uuid & id) { _->host_comp.id(id); }
 
 string Host::name() const { return _->host_comp.name(); }
 Host & Host::name(string name)
@@ -665,12 +728,17 @@ Json Host::json() const
 
 Host Host::clone() const
 {
-  Host h{name()};
+  Host h{make_shared<Host_>(*_)};
   h._->host_comp = _->host_comp.clone();
-  for(auto & c : _->machines)
-  { 
-    h._->machines.push_back(c.clone()); 
-  }
+  for(auto & c : h._->machines) c = c.clone();
+  return h;
+}
+
+Host Host::copy(string name) const
+{
+  Host h{make_shared<Host_>(*_)};
+  h._->host_comp = _->host_comp.copy(name);
+  h._->machines.clear();
   return h;
 }
 
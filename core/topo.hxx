@@ -77,6 +77,10 @@ namespace marina {
       Switch sw(std::string);
       Host host(std::string);
 
+      //bulk creation, n copies of a template named <prefix><i>
+      void reserve(size_t hosts, size_t switches, size_t links = 0);
+      std::vector<Host> addHosts(std::string prefix, size_t n, const Host &);
+
       HostSet connectedHosts(const Switch s) const;
       SwitchSet connectedSwitches(const Host h) const;
 
@@ -88,11 +92,23 @@ namespace marina {
 
       void connect(Switch, Switch, Bandwidth);
       void connect(std::pair<Host, Interface>, Switch, Bandwidth);
+      //the interface named ifx of every host
+      void connect(const std::vector<Host> &, std::string ifx, Switch, 
+          Bandwidth);
 
       Json json() const;
 
+      //an independent copy, a fresh handle per node with the node data
+      //shared copy on write, as for Blueprint::clone
       TestbedTopology clone() const;
     private:
+      //for freezing and thawing
+      friend FrozenTopology;
+      using LinkVisitor =
+        std::function<void(const Endpoint &, const Endpoint &, Bandwidth)>;
+      void forEachLink(const LinkVisitor &) const;
+      void link(Endpoint, Endpoint, Bandwidth);
+
       std::shared_ptr<struct TestbedTopology_> _;
   };
 
@@ -131,7 +147,11 @@ namespace marina {
 
     private:
       friend TestbedTopology;
+      friend FrozenTopology;
       void connect(Host, Switch, Bandwidth);
+      void id(const Uuid &);
+      explicit Switch(std::shared_ptr<struct Switch_>);
+
       std::shared_ptr<struct Switch_> _;
   };
 
@@ -177,7 +197,14 @@ namespace marina {
       Json json() const;
       Host clone() const;
 
+      //a new host like this one with its own id and macs and no machines
+      Host copy(std::string name) const;
+
     private:
+      friend FrozenTopology;
+      void id(const Uuid &);
+      explicit Host(std::shared_ptr<struct Host_>);
+
       std::shared_ptr<struct Host_> _;
   };
 
@@ -25,8 +25,8 @@ using namespace marina;
 string marina::generate_mac()
 {
   stringstream ss;
-  random_device r;
-  default_random_engine gen(r());
+  //seeding from the random device is a syscall, do it once per thread
+  thread_local default_random_engine gen{random_device{}()};
   uniform_int_distribution<int> dist(0,255);
   ss << setfill('0') << setw(2) << hex << 2;
 
@@ -65,6 +65,28 @@ Uuid Uuid::fromJson(const Json &j)
   return u;
 }
 
+Uuid Uuid::fromJson(JsonReader & r)
+{
+  Uuid u;
+  bool id{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "id")
+    {
+      string s = r.string();
+      if(uuid_parse(s.c_str(), u.id) != 0) r.fail("bad uuid " + s);
+      id = true;
+    }
+    else r.skip();
+  }
+
+  if(!id) r.missing("uuid", "id");
+  return u;
+}
+
 bool marina::operator==(const Uuid & a, const Uuid & b)
 {
   return uuid_compare(a.id, b.id) == 0;
@@ -106,6 +128,28 @@ Endpoint Endpoint::fromJson(const Json &j)
   return e;
 }
 
+Endpoint Endpoint::fromJson(JsonReader & r)
+{
+  Endpoint e;
+  bool id{false};
+
+  r.beginObject();
+  string k;
+  while(r.key(k))
+  {
+    if(k == "id")
+    {
+      e.id = Uuid::fromJson(r);
+      id = true;
+    }
+    else if(k == "mac") e.mac = r.string();
+    else r.skip();
+  }
+
+  if(!id) r.missing("endpoint", "id");
+  return e;
+}
+
 bool marina::operator==(const Endpoint & a, const Endpoint & b)
 {
   if(a.id != b.id) return false;
@@ -159,25 +203,3 @@ marina::unexpectedFailure(string path, const Json & j, exception &e)
   return http::Response{ http::Status::InternalServerError(), "" };
 }
 
-CmdResult marina::exec(string cmd)
-{
-  CmdResult result;
-  char buffer[1024];
-  //TODO: ghetto redirect, should do something better
-  FILE *pipe = popen((cmd + " 2>&1").c_str(), "r");
-  if(pipe == nullptr) 
-  {
-    LOG(ERROR) << "exec popen failed for `" << cmd << "`";
-    throw runtime_error{"exec: popen failed"};
-  }
-  while(!feof(pipe))
-  {
-    if(fgets(buffer, 1024, pipe) != nullptr)
-      result.output += buffer;
-  }
-
-  int pexit = pclose(pipe);
-  result.code = WEXITSTATUS(pexit);
-  return result;
-}
-
@@ -2,17 +2,19 @@
 #define LIBDNA_ENV_UTIL
 
 #include <unordered_map>
+#include <memory>
 #include <vector>
 #include <string>
 #include <mutex>
 #include <functional>
+#include <cstring>
 #include <experimental/optional>
-#include <linux/netlink.h>
-#include <linux/rtnetlink.h>
 #include <uuid/uuid.h>
 #include "3p/json/src/json.hpp"
 #include "common/net/proto.hxx"
 #include "common/net/http_server.hxx"
+#include "core/exec.hxx"
+#include "core/json_reader.hxx"
 
 namespace marina {
 
@@ -25,6 +27,7 @@ struct Uuid
   std::string str() const;
   Json json() const;
   static Uuid fromJson(const Json &j);
+  static Uuid fromJson(JsonReader &);
   
   uuid_t id;
   
@@ -35,9 +38,14 @@ bool operator!=(const Uuid &, const Uuid &);
 
 struct UuidHash
 {
+  //the bytes of a uuid are mostly random already, formatting them as a
+  //string to hash that is wasted work
   size_t operator()(const Uuid &u) const
   {
-    return std::hash<std::string>{}(u.str());
+    uint64_t a, b;
+    std::memcpy(&a, u.id, sizeof(a));
+    std::memcpy(&b, u.id + sizeof(a), sizeof(b));
+    return a ^ (b * 0x9e3779b97f4a7c15ull);
   }
 };
 
@@ -90,6 +98,40 @@ std::vector<Json> jtransform(const C & xs)
 }
 
 
+/*
+ * A value shared between copies until one of them writes to it. Reads go
+ * through * and ->, write() hands out a private copy first if anyone else
+ * still holds the value. Copies may be read from any thread, a single Cow
+ * is written from one thread at a time.
+ */
+template <class T>
+class Cow
+{
+  public:
+    template <class ...Args>
+    static Cow make(Args && ...args)
+    {
+      Cow c;
+      c.d_ = std::make_shared<T>(std::forward<Args>(args)...);
+      return c;
+    }
+
+    const T & operator*() const { return *d_; }
+    const T * operator->() const { return d_.get(); }
+
+    T & write()
+    {
+      if(d_.use_count() > 1) d_ = std::make_shared<T>(*d_);
+      return *d_;
+    }
+
+    //true when the two copies still read the same value
+    bool shares(const Cow & x) const { return d_ == x.d_; }
+
+  private:
+    std::shared_ptr<T> d_;
+};
+
 struct Endpoint
 {
   Endpoint() = default;
@@ -101,6 +143,7 @@ struct Endpoint
 
   Json json() const;
   static Endpoint fromJson(const Json &);
+  static Endpoint fromJson(JsonReader &);
 };
 
 bool operator==(const Endpoint &, const Endpoint &);
@@ -116,62 +159,57 @@ badRequest(std::string path, const Json & j, std::out_of_range &e);
 http::Response 
 unexpectedFailure(std::string path, const Json & j, std::exception &e);
 
-struct CmdResult
-{
-  std::string output;
-  int code{0};
-};
-
-CmdResult exec(std::string cmd);
-
 template <class Key, class Value, class ...TT>
 class LinearIdCacheMap
 {
   public:
+    //every call holds the map's mutex, ids are handed out from construct
+    //workers and warm pool threads at once
     Value create(Key key)
     {
-      lk_.lock();
-      if(m_.find(key) != m_.end()) 
-      {
-        auto v = m_.at(key);
-        lk_.unlock();
-        return v;
-      }
-      lk_.unlock();
-
+      std::lock_guard<std::mutex> lk{mtx_};
+      auto i = m_.find(key);
+      if(i != m_.end()) return i->second;
       return m_[key] = v_++;
     }
 
     Value get(Key key) 
     { 
-      lk_.lock();
-      Value v = m_.at(key);
-      lk_.unlock();
-      return v;
+      std::lock_guard<std::mutex> lk{mtx_};
+      return m_.at(key);
+    }
+
+    bool has(Key key)
+    {
+      std::lock_guard<std::mutex> lk{mtx_};
+      return m_.find(key) != m_.end();
     }
 
     void erase(Key key)
     {
-      lk_.lock();
+      std::lock_guard<std::mutex> lk{mtx_};
       m_.erase(key);
-      lk_.unlock();
+    }
+
+    //the value of from is kept under to instead, replacing whatever to had
+    void rename(Key from, Key to)
+    {
+      std::lock_guard<std::mutex> lk{mtx_};
+      auto i = m_.find(from);
+      if(i != m_.end())
+      {
+        Value v = i->second;
+        m_.erase(i);
+        m_[to] = v;
+      }
     }
 
   private:
     std::mutex mtx_;
-    std::unique_lock<std::mutex> lk_{mtx_, std::defer_lock_t{}};
     Value v_{};
     std::unordered_map<Key, Value, TT...> m_;
 };
 
-struct RtReq
-{
-  nlmsghdr header;
-  ifinfomsg msg;
-};
-
-std::string mac_2_ifname(std::string mac);
-
 inline auto extract(Json j, std::string tag, std::string context)
 {
   try { return j.at(tag); }
@@ -0,0 +1,449 @@
+/*
+ * marina-bench: times the hot paths of the core over the model library and
+ * the generated models
+ *
+ *   marina-bench [--filter=embed] [--reps=5] [--format=json|csv]
+ *                [--out=results.json]
+ *                [--baseline=results.json] [--threshold=0.1]
+ *
+ * Every case runs once to warm up and then reps times, a case that changes
+ * what it works on gets it back to where it started before every run, off
+ * the clock. Times are reported
+ * in ns per item (computer, network, lookup ...) so the sizes of a case can
+ * change without making its history meaningless. Given a baseline, from an
+ * earlier --format=json run, the median of every case is held against the
+ * baseline median and the run fails if any is slower by more than threshold.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <gflags/gflags.h>
+#include <fmt/format.h>
+#include "core/blueprint.hxx"
+#include "core/topo.hxx"
+#include "core/embed.hxx"
+#include "core/materialization.hxx"
+#include "common/net/wire.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "test/models/topos/topologies.hxx"
+
+using std::string;
+using std::vector;
+using std::function;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using std::ofstream;
+using std::ostream;
+using std::runtime_error;
+using std::unordered_map;
+using std::shared_ptr;
+using std::make_shared;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using namespace marina;
+
+DEFINE_string(filter, "", "only run the cases whose name holds this");
+DEFINE_int32(reps, 5, "timed runs of every case");
+DEFINE_string(format, "json", "result format, json or csv");
+DEFINE_string(out, "", "where to write the results, stdout if empty");
+DEFINE_string(baseline, "", "json results of an earlier run to compare with");
+DEFINE_double(threshold, 0.1, "the slowdown against the baseline that fails");
+
+namespace
+{
+  //what a case times, built outside of the clock, reset if there is one
+  //runs untimed before every run of f
+  struct Run
+  {
+    size_t items;
+    function<void()> f;
+    function<void()> reset{};
+  };
+
+  struct Case
+  {
+    string name;
+    function<Run()> setup;
+  };
+
+  struct Result
+  {
+    string name;
+    size_t items;
+    //ns per item of every rep, fastest first
+    vector<double> ns;
+
+    double median() const { return ns[ns.size()/2]; }
+  };
+
+  Result measure(const Case & c)
+  {
+    Run r = c.setup();
+    if(r.reset) r.reset();
+    r.f();
+
+    Result x{c.name, r.items, {}};
+    for(int i=0; i<FLAGS_reps; ++i)
+    {
+      if(r.reset) r.reset();
+      auto begin = steady_clock::now();
+      r.f();
+      auto ns = duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+      x.ns.push_back(double(ns) / r.items);
+    }
+    std::sort(x.ns.begin(), x.ns.end());
+    return x;
+  }
+
+  size_t nodes(const Blueprint & bp)
+  {
+    return bp.computers().size() + bp.networks().size();
+  }
+
+  size_t nodes(const TestbedTopology & t)
+  {
+    return t.hosts().size() + t.switches().size();
+  }
+
+  // cases ---------------------------------------------------------------------
+
+  using BpGen = function<Blueprint()>;
+  using TopoGen = function<TestbedTopology()>;
+
+  void embedding(vector<Case> & cs, string name, BpGen bpg, TopoGen tg)
+  {
+    cs.push_back({"embed/" + name, [bpg, tg]()
+    {
+      Blueprint bp = bpg();
+      TestbedTopology t = tg();
+      EChart ec{t};
+      return Run{bp.computers().size(), [bp, ec, t]()
+      {
+        embed(bp, ec, t);
+      }};
+    }});
+
+    cs.push_back({"unembed/" + name, [bpg, tg]()
+    {
+      Blueprint bp = bpg();
+      TestbedTopology t = tg();
+      EChart ec = embed(bp, EChart{t}, t);
+      return Run{bp.computers().size(), [bp, ec]() { unembed(bp, ec); }};
+    }});
+
+    cs.push_back({"load/" + name, [bpg, tg]()
+    {
+      Blueprint bp = bpg();
+      TestbedTopology t = tg();
+      EChart ec = embed(bp, EChart{t}, t);
+      return Run{ec.hmap.size(), [ec]()
+      {
+        for(const auto & h : ec.hmap) h.second.load();
+      }};
+    }});
+  }
+
+  void jsonification(vector<Case> & cs, string name, BpGen bpg)
+  {
+    cs.push_back({"json/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      return Run{nodes(bp), [bp]() { bp.json(); }};
+    }});
+
+    cs.push_back({"fromJson/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      Json j = bp.json();
+      return Run{nodes(bp), [j]() { Blueprint::fromJson(j); }};
+    }});
+
+    cs.push_back({"parse/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      string text = bp.json().dump();
+      return Run{nodes(bp), [text]() { Blueprint::parse(text); }};
+    }});
+
+    //the same text through a Json tree, what parse saves
+    cs.push_back({"parseTree/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      string text = bp.json().dump();
+      return Run{nodes(bp), [text]()
+      {
+        Blueprint::fromJson(Json::parse(text));
+      }};
+    }});
+  }
+
+  //a blueprint document through each encoding and back
+  void encoding(vector<Case> & cs, string name, BpGen bpg)
+  {
+    cs.push_back({"text/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      Json j = bp.json();
+      return Run{nodes(bp), [j]() { Json::parse(j.dump()); }};
+    }});
+
+    cs.push_back({"wire/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      Json j = bp.json();
+      return Run{nodes(bp), [j]() { wire::decode(wire::encode(j)); }};
+    }});
+  }
+
+  void cloning(vector<Case> & cs, string name, BpGen bpg)
+  {
+    cs.push_back({"clone/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      return Run{nodes(bp), [bp]() { bp.clone(); }};
+    }});
+
+    //the first write to every node of a fresh clone, which unshares it
+    cs.push_back({"cloneWrite/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      auto c = make_shared<Blueprint>(bp.clone());
+      return Run{nodes(bp), [c]()
+      {
+        for(auto & x : c->computers()) x.second.cores(4);
+        for(auto & x : c->networks()) x.second.latency(1_ms);
+      },
+      [bp, c]() { *c = bp.clone(); }};
+    }});
+  }
+
+  void jsonification(vector<Case> & cs, string name, TopoGen tg)
+  {
+    cs.push_back({"json/" + name, [tg]()
+    {
+      TestbedTopology t = tg();
+      return Run{nodes(t), [t]() { t.json(); }};
+    }});
+
+    cs.push_back({"fromJson/" + name, [tg]()
+    {
+      TestbedTopology t = tg();
+      Json j = t.json();
+      return Run{nodes(t), [j]() { TestbedTopology::fromJson(j); }};
+    }});
+  }
+
+  void connectivity(vector<Case> & cs, string name, BpGen bpg)
+  {
+    cs.push_back({"connectedComputers/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      return Run{bp.networks().size(), [bp]()
+      {
+        for(const auto & n : bp.networks()) bp.connectedComputers(n.second);
+      }};
+    }});
+  }
+
+  void addressing(vector<Case> & cs, string name, BpGen bpg)
+  {
+    cs.push_back({"assignAddresses/" + name, [bpg]()
+    {
+      Blueprint bp = bpg();
+      auto x = make_shared<Blueprint>(bp.clone());
+      return Run{nodes(bp), [x]()
+      {
+        UuidMap<NetworkMzInfo> mz;
+        size_t vni{0};
+        assignAddresses(*x, mz, [&vni](const Network &) { return ++vni; });
+      },
+      [bp, x]() { *x = bp.clone(); }};
+    }});
+  }
+
+  void lookup(vector<Case> & cs, size_t n)
+  {
+    cs.push_back({fmt::format("UuidMap/{}", n), [n]()
+    {
+      vector<Uuid> ids(n);
+      UuidMap<size_t> m;
+      m.reserve(n);
+      for(size_t i=0; i<n; ++i) m[ids[i]] = i;
+
+      return Run{n, [ids, m]()
+      {
+        size_t sum{0};
+        for(const Uuid & u : ids) sum += m.find(u)->second;
+        if(sum != ids.size()*(ids.size()-1)/2)
+          throw runtime_error{"UuidMap lookup went astray"};
+      }};
+    }});
+  }
+
+  vector<Case> cases()
+  {
+    vector<Case> cs;
+
+    embedding(cs, "hello-marina@minibed", hello_marina, minibed);
+    embedding(cs, "mars@deter2015", mars, deter2015);
+    embedding(cs, "synthetic-256@deter2015",
+        [](){ return synthetic(256); }, deter2015);
+    embedding(cs, "star-1000@star-200",
+        [](){ return star(1000); }, [](){ return starBed(200); });
+    embedding(cs, "fat-tree-16@fat-tree-16",
+        [](){ return fatTree(16); }, [](){ return fatTreeBed(16); });
+    embedding(cs, "random-5000@random-1000",
+        [](){ return randomLans(5000, 128); },
+        [](){ return randomBed(1000, 32); });
+
+    jsonification(cs, "synthetic-10000",
+        BpGen{[](){ return synthetic(10000); }});
+    jsonification(cs, "fat-tree-32", BpGen{[](){ return fatTree(32); }});
+    jsonification(cs, "deter2015", TopoGen{deter2015});
+    jsonification(cs, "fat-tree-bed-32",
+        TopoGen{[](){ return fatTreeBed(32); }});
+
+    encoding(cs, "synthetic-1000", [](){ return synthetic(1000); });
+    encoding(cs, "synthetic-10000", [](){ return synthetic(10000); });
+
+    cloning(cs, "synthetic-1000", [](){ return synthetic(1000); });
+    cloning(cs, "synthetic-10000", [](){ return synthetic(10000); });
+
+    connectivity(cs, "fat-tree-32", [](){ return fatTree(32); });
+    connectivity(cs, "random-10000", [](){ return randomLans(10000, 256); });
+
+    addressing(cs, "synthetic-10000", [](){ return synthetic(10000); });
+    addressing(cs, "random-10000", [](){ return randomLans(10000, 256); });
+
+    lookup(cs, 1000);
+    lookup(cs, 100000);
+
+    return cs;
+  }
+
+  // results -------------------------------------------------------------------
+
+  Json json(const vector<Result> & rs)
+  {
+    Json cs = Json::array();
+    for(const Result & r : rs)
+    {
+      cs.push_back({
+        {"name", r.name},
+        {"items", r.items},
+        {"reps", r.ns.size()},
+        {"median_ns", r.median()},
+        {"min_ns", r.ns.front()},
+        {"max_ns", r.ns.back()}
+      });
+    }
+    Json j;
+    j["cases"] = cs;
+    return j;
+  }
+
+  void csv(ostream & o, const vector<Result> & rs)
+  {
+    o << "name,items,reps,median_ns,min_ns,max_ns" << endl;
+    for(const Result & r : rs)
+      o << fmt::format("{},{},{},{:.1f},{:.1f},{:.1f}", r.name, r.items,
+          r.ns.size(), r.median(), r.ns.front(), r.ns.back()) << endl;
+  }
+
+  void write(ostream & o, const vector<Result> & rs)
+  {
+    if(FLAGS_format == "csv") csv(o, rs);
+    else o << json(rs).dump(2) << endl;
+  }
+
+  //holds the results against a baseline, true if nothing got slower than
+  //the threshold allows
+  bool compare(const vector<Result> & rs, const string & path)
+  {
+    ifstream ifs{path};
+    if(!ifs.good()) throw runtime_error{"cannot read baseline " + path};
+    Json base = Json::parse(ifs);
+
+    unordered_map<string, double> before;
+    for(const Json & c : base.at("cases"))
+      before[c.at("name").get<string>()] = c.at("median_ns").get<double>();
+
+    bool ok{true};
+    cerr << fmt::format("{:<40} {:>12} {:>12} {:>8}",
+        "case", "baseline ns", "ns", "change") << endl;
+
+    for(const Result & r : rs)
+    {
+      auto b = before.find(r.name);
+      if(b == before.end())
+      {
+        cerr << fmt::format("{:<40} {:>12} {:>12.1f} {:>8}",
+            r.name, "-", r.median(), "new") << endl;
+        continue;
+      }
+
+      double change = r.median() / b->second - 1;
+      bool slow = change > FLAGS_threshold;
+      ok = ok && !slow;
+      cerr << fmt::format("{:<40} {:>12.1f} {:>12.1f} {:>+7.1f}%{}",
+          r.name, b->second, r.median(), change*100,
+          slow ? "  REGRESSED" : "") << endl;
+    }
+
+    return ok;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  gflags::SetUsageMessage("usage: marina-bench [flags]");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if(FLAGS_reps < 1) { cerr << "reps must be at least 1" << endl; return 2; }
+  if(FLAGS_format != "json" && FLAGS_format != "csv")
+  {
+    cerr << "unknown format " << FLAGS_format << endl;
+    return 2;
+  }
+
+  vector<Result> rs;
+  for(const Case & c : cases())
+  {
+    if(c.name.find(FLAGS_filter) == string::npos) continue;
+    try
+    {
+      rs.push_back(measure(c));
+      cerr << fmt::format("{:<40} {:>12.1f} ns", c.name, rs.back().median())
+           << endl;
+    }
+    catch(std::exception & e)
+    {
+      cerr << c.name << " failed: " << e.what() << endl;
+      return 2;
+    }
+  }
+
+  if(FLAGS_out.empty()) write(cout, rs);
+  else
+  {
+    ofstream ofs{FLAGS_out};
+    write(ofs, rs);
+  }
+
+  if(FLAGS_baseline.empty()) return 0;
+  try { return compare(rs, FLAGS_baseline) ? 0 : 1; }
+  catch(std::exception & e)
+  {
+    cerr << "baseline comparison failed: " << e.what() << endl;
+    return 2;
+  }
+}
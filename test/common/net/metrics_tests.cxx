@@ -0,0 +1,63 @@
+#include <thread>
+#include <vector>
+#include "common/net/metrics.hxx"
+#include "../../catch.hpp"
+
+using std::thread;
+using std::vector;
+using std::string;
+using namespace marina;
+
+TEST_CASE("histogram-buckets", "[metrics]")
+{
+  for(uint64_t v : {0ul, 1ul, 31ul, 32ul, 33ul, 1000ul, 123456789ul, ~0ul})
+  {
+    size_t b = Histogram::bucketOf(v);
+    REQUIRE( b < Histogram::Buckets );
+    REQUIRE( Histogram::bucketLow(b) <= v );
+    REQUIRE( Histogram::bucketHigh(b) >= v );
+  }
+}
+
+TEST_CASE("histogram-percentiles", "[metrics]")
+{
+  Histogram h;
+  for(uint64_t i=1; i<=10000; ++i) h.record(i);
+
+  REQUIRE( h.count() == 10000 );
+  REQUIRE( h.max() == 10000 );
+
+  //log-linear buckets are accurate to within 1/16
+  auto near = [](uint64_t x, uint64_t y){ return x >= y && x <= y + y/16; };
+  REQUIRE( near(h.percentile(50), 5000) );
+  REQUIRE( near(h.percentile(99), 9900) );
+  REQUIRE( h.percentile(100) == 10000 );
+}
+
+TEST_CASE("histogram-concurrent", "[metrics]")
+{
+  Histogram h;
+  vector<thread> ts;
+  for(int t=0; t<8; ++t)
+    ts.emplace_back([&h](){ for(int i=0; i<100000; ++i) h.record(i % 977); });
+  for(auto & t : ts) t.join();
+
+  REQUIRE( h.count() == 800000 );
+  REQUIRE( h.countAtOrBelow(~0ul) == 800000 );
+}
+
+TEST_CASE("server-metrics-prometheus", "[metrics]")
+{
+  ServerMetrics m{{{"POST", "/construct"}, {"POST", "/status"}}};
+  m.route(0).begin();
+  m.route(0).end(200, 1500, 64);
+  m.route(1).begin();
+
+  string s = m.prometheus();
+  REQUIRE( s.find(
+    R"(marina_http_requests_total{method="POST",route="/construct",code="200"} 1)"
+  ) != string::npos );
+  REQUIRE( s.find(
+    R"(marina_http_requests_in_flight{method="POST",route="/status"} 1)"
+  ) != string::npos );
+}
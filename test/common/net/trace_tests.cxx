@@ -0,0 +1,39 @@
+#include "common/net/trace.hxx"
+#include "../../catch.hpp"
+
+using namespace marina;
+
+TEST_CASE("traceparent-round-trip", "[trace]")
+{
+  TraceContext root = TraceContext{}.child();
+  REQUIRE( root.valid() );
+
+  std::string tp = root.traceparent();
+  REQUIRE( tp.size() == 55 );
+
+  TraceContext c = TraceContext::fromTraceparent(tp);
+  REQUIRE( c.valid() );
+  REQUIRE( c.traceId() == root.traceId() );
+  REQUIRE( c.spanId() == root.spanId() );
+
+  REQUIRE( !TraceContext::fromTraceparent("").valid() );
+  REQUIRE( !TraceContext::fromTraceparent(std::string(55, 'x')).valid() );
+}
+
+TEST_CASE("span-nesting", "[trace]")
+{
+  TraceContext outer_ctx, inner_ctx;
+  {
+    Span outer{"outer"};
+    outer_ctx = outer.context();
+    REQUIRE( Trace::current().spanId() == outer_ctx.spanId() );
+    {
+      Span inner{"inner"};
+      inner_ctx = inner.context();
+      REQUIRE( inner_ctx.traceId() == outer_ctx.traceId() );
+      REQUIRE( inner_ctx.spanId() != outer_ctx.spanId() );
+    }
+    REQUIRE( Trace::current().spanId() == outer_ctx.spanId() );
+  }
+  REQUIRE( !Trace::current().valid() );
+}
@@ -0,0 +1,68 @@
+#include <string>
+#include <stdexcept>
+#include "common/net/wire.hxx"
+#include "../../catch.hpp"
+
+using std::string;
+using std::invalid_argument;
+using namespace marina;
+
+TEST_CASE("wire-roundtrip", "[wire]")
+{
+  Json j = R"({
+    "null": null,
+    "yes": true,
+    "no": false,
+    "small": 7,
+    "big": 18446744073709551615,
+    "neg": -300,
+    "min": -9223372036854775808,
+    "pi": 3.14159,
+    "text": "hello",
+    "empty": "",
+    "list": [1, "two", [3], {}],
+    "id": {"id": "6f1c4b1e-2a3d-4c5e-8f90-a1b2c3d4e5f6"},
+    "bare": "6f1c4b1e-2a3d-4c5e-8f90-a1b2c3d4e5f6",
+    "shouty": "6F1C4B1E-2A3D-4C5E-8F90-A1B2C3D4E5F6",
+    "notuuid": {"id": "nope"}
+  })"_json;
+
+  string w = wire::encode(j);
+  REQUIRE( wire::decode(w) == j );
+  REQUIRE( wire::decode(w).dump() == j.dump() );
+}
+
+TEST_CASE("wire-compact", "[wire]")
+{
+  //repeated keys and uuid objects, the shape of a blueprint
+  Json j = Json::array();
+  for(size_t i=0; i<100; ++i)
+  {
+    Json x;
+    x["id"]["id"] = "6f1c4b1e-2a3d-4c5e-8f90-a1b2c3d4e5f6";
+    x["name"] = "computer";
+    x["cores"] = i;
+    j.push_back(x);
+  }
+
+  string w = wire::encode(j);
+  REQUIRE( wire::decode(w) == j );
+  REQUIRE( w.size() * 2 < j.dump().size() );
+}
+
+TEST_CASE("wire-malformed", "[wire]")
+{
+  string w = wire::encode(R"({"a": [1, 2, 3]})"_json);
+
+  REQUIRE_THROWS_AS( wire::decode(""), invalid_argument );
+  REQUIRE_THROWS_AS( wire::decode("{}"), invalid_argument );
+  REQUIRE_THROWS_AS( wire::decode(w.substr(0, w.size()-1)), invalid_argument );
+  REQUIRE_THROWS_AS( wire::decode(w + "x"), invalid_argument );
+
+  string v2 = w;
+  v2[2] = wire::version + 1;
+  REQUIRE_THROWS_AS( wire::decode(v2), invalid_argument );
+
+  REQUIRE( wire::isWire("application/x-marina-wire; v=1") );
+  REQUIRE( !wire::isWire("application/json") );
+}
@@ -0,0 +1,103 @@
+#include <unordered_set>
+#include "core/blueprint.hxx"
+#include "core/topo.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "test/models/topos/topologies.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::unordered_set;
+using namespace marina;
+
+TEST_CASE("bulk-computers", "[bulk]")
+{
+  Blueprint bp{"bulk"};
+  Computer like{"like"};
+  like.cores(8).memory(2_gb).add_ifx("ifx0", 10_gbps);
+
+  auto lan = bp.network("lan");
+  auto cs = bp.addComputers("c", 100, like);
+  bp.connect(cs, "ifx0", lan);
+
+  REQUIRE( bp.computers().size() == 100 );
+  REQUIRE( bp.links().size() == 100 );
+  REQUIRE( bp.connectedComputers(lan).size() == 100 );
+
+  //copies share nothing with the template or each other but its values
+  unordered_set<string> macs;
+  for(Computer c : cs)
+  {
+    REQUIRE( c.id() != like.id() );
+    REQUIRE( c.cores() == 8 );
+    REQUIRE( c.ifx("ifx0").capacity() == 10_gbps );
+    macs.insert(c.ifx("ifx0").mac());
+  }
+  REQUIRE( macs.size() == 100 );
+  REQUIRE( macs.count(like.ifx("ifx0").mac()) == 0 );
+
+  cs[0].cores(1);
+  cs[0].ifx("ifx0").latency(7_ms);
+  REQUIRE( cs[1].cores() == 8 );
+  REQUIRE( like.ifx("ifx0").latency() == 0_ms );
+}
+
+TEST_CASE("bulk-by-name", "[bulk]")
+{
+  Blueprint bp = synthetic(100);
+  REQUIRE( bp.getComputer("c47").name() == "c47" );
+  REQUIRE( bp.getNetwork("lan2").name() == "lan2" );
+
+  //the name index follows renames, removals and additions
+  bp.getComputer("c47").name("c470");
+  REQUIRE_THROWS_AS( bp.getComputer("c47"), std::out_of_range );
+  REQUIRE( bp.getComputer("c470").name() == "c470" );
+
+  bp.removeComputer("c470");
+  REQUIRE_THROWS_AS( bp.getComputer("c470"), std::out_of_range );
+
+  bp.computer("c47");
+  REQUIRE( bp.getComputer("c47").name() == "c47" );
+
+  bp.removeNetwork("lan2");
+  REQUIRE_THROWS_AS( bp.getNetwork("lan2"), std::out_of_range );
+}
+
+TEST_CASE("bulk-hosts", "[bulk]")
+{
+  TestbedTopology t{"bulk"};
+  Host like{"like"};
+  like.cores(24).add_ifx("eth0", 10_gbps);
+
+  auto sw = t.sw("sw");
+  auto hs = t.addHosts("h", 50, like);
+  t.connect(hs, "eth0", sw, 10_gbps);
+
+  REQUIRE( t.hosts().size() == 50 );
+  REQUIRE( t.connectedHosts(sw).size() == 50 );
+  REQUIRE( t.getHost("h49").cores() == 24 );
+  REQUIRE( hs[0].ifx("eth0").mac() != hs[1].ifx("eth0").mac() );
+}
+
+TEST_CASE("generators", "[bulk]")
+{
+  REQUIRE( star(1000).computers().size() == 1000 );
+  REQUIRE( dumbbell(500).computers().size() == 1000 );
+  REQUIRE( randomLans(1000, 64).computers().size() == 1000 );
+
+  Blueprint ft = fatTree(4);
+  REQUIRE( ft.computers().size() == 16 );
+  REQUIRE( ft.networks().size() == 16 + 4 );
+  //computers, edge to aggregation and aggregation to core
+  REQUIRE( ft.links().size() == 16 + 16 + 16 );
+  for(const auto & c : ft.computers())
+    REQUIRE( ft.connectedNetworks(c.second).size() == 1 );
+
+  REQUIRE( fatTree(16).computers().size() == 1024 );
+
+  TestbedTopology tt = fatTreeBed(4);
+  REQUIRE( tt.hosts().size() == 16 );
+  REQUIRE( tt.switches().size() == 20 );
+  REQUIRE( starBed(1000).hosts().size() == 1000 );
+  REQUIRE( dumbbellBed(10).hosts().size() == 20 );
+  REQUIRE( randomBed(1000, 32).hosts().size() == 1000 );
+}
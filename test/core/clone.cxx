@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "core/blueprint.hxx"
+#include "core/topo.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "test/models/topos/topologies.hxx"
+#include "../catch.hpp"
+
+using namespace marina;
+
+namespace
+{
+  //json of a model with every array in a fixed order, maps do not keep one
+  Json canonical(Json j)
+  {
+    if(j.is_object())
+      for(auto i = j.begin(); i != j.end(); ++i) *i = canonical(*i);
+
+    if(j.is_array())
+    {
+      for(Json & x : j) x = canonical(x);
+      std::sort(j.begin(), j.end(),
+        [](const Json & a, const Json & b){ return a.dump() < b.dump(); });
+    }
+    return j;
+  }
+}
+
+TEST_CASE("clone-blueprint", "[clone]")
+{
+  for(Blueprint bp : {mars(), hello_marina(), synthetic(100)})
+  {
+    Blueprint c = bp.clone();
+    REQUIRE( canonical(c.json()) == canonical(bp.json()) );
+    REQUIRE( c == bp );
+  }
+
+  Blueprint bp = synthetic(40);
+  bp.networks().begin()->second.ipv4("10.47.0.0", 24);
+  Blueprint c = bp.clone();
+  REQUIRE( canonical(c.json()) == canonical(bp.json()) );
+
+  //writes through either side stay on that side
+  Computer & mine = bp.computers().begin()->second;
+  Computer & theirs = c.computers().at(mine.id());
+  mine.cores(47);
+  theirs.name("cloned");
+  theirs.ifx("cifx").latency(7_ms);
+  REQUIRE( mine.name() != "cloned" );
+  REQUIRE( mine.ifx("cifx").latency() == 0_ms );
+  REQUIRE( theirs.cores() != 47 );
+  REQUIRE( theirs.id() == mine.id() );
+  REQUIRE( theirs.ifx("cifx").mac() == mine.ifx("cifx").mac() );
+
+  //so do new nodes and links
+  size_t links = bp.links().size();
+  Computer x = c.computer("x");
+  c.connect({x, x.ifx("cifx")}, c.networks().begin()->second);
+  REQUIRE( bp.links().size() == links );
+  REQUIRE( c.links().size() == links + 1 );
+  REQUIRE( bp.computers().size() + 1 == c.computers().size() );
+
+  //handles taken before the clone stay with the original
+  Blueprint a = synthetic(10);
+  Computer held = a.computers().begin()->second;
+  Blueprint b = a.clone();
+  held.cores(47);
+  REQUIRE( a.computers().at(held.id()).cores() == 47 );
+  REQUIRE( b.computers().at(held.id()).cores() != 47 );
+}
+
+TEST_CASE("clone-topology", "[clone]")
+{
+  for(TestbedTopology tt : {minibed(), deter2015()})
+  {
+    TestbedTopology c = tt.clone();
+    REQUIRE( canonical(c.json()) == canonical(tt.json()) );
+    REQUIRE( c == tt );
+
+    for(const auto & s : tt.switches())
+      REQUIRE( c.connectedHosts(c.switches().at(s.first)).size() ==
+               tt.connectedHosts(s.second).size() );
+  }
+
+  TestbedTopology tt = minibed();
+  TestbedTopology c = tt.clone();
+  Switch & s = c.switches().begin()->second;
+  s.backplane(47_gbps);
+  REQUIRE( tt.switches().at(s.id()).backplane() != 47_gbps );
+
+  Host & h = c.hosts().begin()->second;
+  size_t machines = h.machines().size();
+  h.machines().push_back(Computer{"m"});
+  REQUIRE( tt.hosts().at(h.id()).machines().size() == machines );
+}
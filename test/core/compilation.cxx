@@ -0,0 +1,103 @@
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+#include "core/compilation.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::ofstream;
+using std::ifstream;
+using std::to_string;
+using std::runtime_error;
+using namespace marina;
+
+namespace
+{
+  //lines in a file, the fake compiler leaves one per compile
+  size_t lines(const string & path)
+  {
+    ifstream ifs{path};
+    size_t n{0};
+    for(string s; std::getline(ifs, s); ) ++n;
+    return n;
+  }
+}
+
+TEST_CASE("model-compile-cache", "[compilation]")
+{
+  string root = "/tmp/marina-fake-cc-" + to_string(getpid());
+  string mrsrc = root + "/src", models = root + "/models";
+  exec(Command{{"mkdir", "-p", mrsrc + "/core", models}});
+
+  //stands in for clang++, touches its output and logs every compile, while
+  //there is a stale file it turns away the pch like clang does when a header
+  //was touched since the pch was built
+  string cxx = root + "/cxx";
+  ofstream{cxx}
+    << "#!/bin/sh\n"
+    << "[ \"$1\" = --version ] && { echo fakecc 1.0; exit 0; }\n"
+    << "for x; do case $x in *bad.cxx) exit 1;; esac; done\n"
+    << "pch=; prev=; for x; do\n"
+    << "  [ \"$prev\" = -include-pch ] && pch=$x; prev=$x\n"
+    << "  [ \"$x\" = c++-header ] && rm -f " << root << "/stale\n"
+    << "done\n"
+    << "[ -n \"$pch\" ] && [ -f " << root << "/stale ] && {\n"
+    << "  echo \"fatal error: file has been modified since the precompiled "
+    <<         "header '$pch' was built\"; exit 1; }\n"
+    << "echo \"$@\" >> " << root << "/log\n"
+    << "while [ $# -gt 1 ]; do [ \"$1\" = -o ] && touch \"$2\"; shift; done\n"
+    << "exit 0\n";
+  exec(Command{{"chmod", "+x", cxx}});
+
+  ofstream{mrsrc + "/core/blueprint.hxx"} << "//v1\n";
+  ofstream{models + "/mars.cxx"} << "Blueprint bp() { return mars(); }\n";
+
+  ModelCompiler cc{mrsrc, root + "/cache", cxx};
+  string log = root + "/log";
+
+  string so = cc.compile(models + "/mars.cxx");
+  REQUIRE( !cc.hit() );
+  REQUIRE( ifstream{so}.good() );
+  //the model api headers and the model
+  REQUIRE( lines(log) == 2 );
+
+  //nothing changed, nothing compiled
+  REQUIRE( cc.compile(models + "/mars.cxx") == so );
+  REQUIRE( cc.hit() );
+  REQUIRE( lines(log) == 2 );
+
+  //a changed model is compiled against the headers precompiled before
+  ofstream{models + "/mars.cxx"} << "Blueprint bp() { return venus(); }\n";
+  string so2 = cc.compile(models + "/mars.cxx");
+  REQUIRE( !cc.hit() );
+  REQUIRE( so2 != so );
+  REQUIRE( lines(log) == 3 );
+
+  //so is one whose neighbouring headers changed
+  ofstream{models + "/planets.hxx"} << "Blueprint venus();\n";
+  REQUIRE( cc.compile(models + "/mars.cxx") != so2 );
+  REQUIRE( lines(log) == 4 );
+
+  //new marina headers are a new version, the model api is precompiled again
+  ofstream{mrsrc + "/core/blueprint.hxx"} << "//v2\n";
+  ModelCompiler cc2{mrsrc, root + "/cache", cxx};
+  REQUIRE( cc2.version() != cc.version() );
+  cc2.compile(models + "/mars.cxx");
+  REQUIRE( !cc2.hit() );
+  REQUIRE( lines(log) == 6 );
+
+  //a pch clang turns away is rebuilt and the model compiled again
+  ofstream{root + "/stale"};
+  ofstream{models + "/mars.cxx"} << "Blueprint bp() { return mercury(); }\n";
+  cc2.compile(models + "/mars.cxx");
+  REQUIRE( !cc2.hit() );
+  REQUIRE( lines(log) == 8 );
+  REQUIRE( !ifstream{root + "/stale"}.good() );
+
+  //failures carry the compiler output and leave nothing in the cache
+  ofstream{models + "/bad.cxx"} << "nope\n";
+  REQUIRE_THROWS_AS( cc2.compile(models + "/bad.cxx"), runtime_error );
+  REQUIRE_THROWS_AS( cc2.compile(models + "/bad.cxx"), runtime_error );
+
+  exec(Command{{"rm", "-rf", root}});
+}
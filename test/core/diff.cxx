@@ -0,0 +1,124 @@
+#include <stdexcept>
+#include "core/diff.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::out_of_range;
+using std::invalid_argument;
+using namespace marina;
+
+TEST_CASE("diff-identical", "[diff]")
+{
+  for(Blueprint bp : {mars(), hello_marina(), synthetic(100)})
+  {
+    BlueprintDiff d = diff(bp, bp.clone());
+    REQUIRE( d.empty() );
+    REQUIRE( d.json() == Json::object() );
+  }
+}
+
+TEST_CASE("diff-apply", "[diff]")
+{
+  Blueprint from = synthetic(40);
+  Blueprint to = from.clone();
+
+  //one of everything
+  to.name("synthetic-changed");
+  Computer & c = to.getComputer("c3");
+  c.cores(8).memory(2_gb);
+  c.ifx("ifx0").latency(3_ms);
+  c.remove_ifx("cifx");
+  c.add_ifx("ifx1", 10_gbps);
+
+  Network & n = to.getNetwork("lan1");
+  n.latency(9_ms);
+
+  Network extra = to.network("extra");
+  Computer x = to.computer("x");
+  to.connect({x, x.ifx("cifx")}, extra);
+  to.connect(extra, to.getNetwork("core"));
+  to.connect(extra, to.getNetwork("core"));
+  to.removeComputer("c7");
+  to.removeNetwork("lan2");
+
+  BlueprintDiff d = diff(from, to);
+  REQUIRE( d.name );
+  REQUIRE( d.added_computers.size() == 1 );
+  REQUIRE( d.removed_computers.size() == 1 );
+  REQUIRE( d.changed_computers.size() == 1 );
+  REQUIRE( d.changed_computers[0].cores );
+  REQUIRE( !d.changed_computers[0].os );
+  REQUIRE( d.changed_computers[0].interfaces.size() == 2 );
+  REQUIRE( d.changed_computers[0].removed_interfaces.size() == 1 );
+  REQUIRE( d.added_networks.size() == 1 );
+  REQUIRE( d.removed_networks.size() == 1 );
+  REQUIRE( d.changed_networks.size() == 1 );
+  REQUIRE( d.changed_networks[0].latency );
+  REQUIRE( !d.changed_networks[0].capacity );
+  REQUIRE( d.added_links.size() == 3 );
+  REQUIRE( d.removed_links.empty() );
+
+  Blueprint patched = from.clone();
+  d.apply(patched);
+  REQUIRE( patched == to );
+  REQUIRE( diff(patched, to).empty() );
+
+  //the patch survives the trip through json
+  Blueprint rt = from.clone();
+  BlueprintDiff::fromJson(d.json()).apply(rt);
+  REQUIRE( diff(rt, to).empty() );
+
+  //and runs backwards
+  Blueprint back = to.clone();
+  diff(to, from).apply(back);
+  REQUIRE( diff(back, from).empty() );
+  REQUIRE( back.links().size() == from.links().size() );
+}
+
+TEST_CASE("diff-missing-node", "[diff]")
+{
+  Blueprint from = synthetic(20);
+  Blueprint to = from.clone();
+  to.getComputer("c3").cores(16);
+  to.getNetwork("lan0").capacity(10_gbps);
+  BlueprintDiff d = diff(from, to);
+
+  //a failed patch does not touch the blueprint
+  Blueprint other = synthetic(20);
+  Json before = other.json();
+  REQUIRE_THROWS_AS( d.apply(other), out_of_range );
+  REQUIRE( other.json() == before );
+}
+
+TEST_CASE("diff-stale-patch", "[diff]")
+{
+  Blueprint from = synthetic(20);
+  Blueprint to = from.clone();
+  Network extra = to.network("extra");
+  Computer x = to.computer("x");
+  to.connect({x, x.ifx("cifx")}, extra);
+  BlueprintDiff d = diff(from, to);
+
+  //a patch applied twice finds its nodes already there
+  Blueprint patched = from.clone();
+  d.apply(patched);
+  Json before = patched.json();
+  REQUIRE_THROWS_AS( d.apply(patched), invalid_argument );
+  REQUIRE( patched.json() == before );
+
+  //a link it removes must be there, and as often as it is removed
+  BlueprintDiff r;
+  r.removed_links.push_back(to.links().back());
+  Blueprint other = from.clone();
+  before = other.json();
+  REQUIRE_THROWS_AS( r.apply(other), out_of_range );
+  REQUIRE( other.json() == before );
+
+  const Link & l = from.links().front();
+  r.removed_links = {l};
+  for(const Link & y : from.links())
+    if(y.json() == l.json()) r.removed_links.push_back(l);
+  REQUIRE_THROWS_AS( r.apply(other), out_of_range );
+  REQUIRE( other.json() == before );
+}
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <fmt/format.h>
 #include "core/blueprint.hxx"
 #include "core/util.hxx"
@@ -29,3 +32,90 @@ TEST_CASE("multiout", "[cmd-exec]")
   cout << cr.output;
 }
 
+
+TEST_CASE("argv", "[cmd-exec]")
+{
+  //arguments reach the program as is, no shell gets a say
+  CmdResult cr = exec(Command{{"echo", "a  b", "$HOME", "`ls`"}});
+
+  REQUIRE( cr.code == 0 );
+  REQUIRE( cr.output == "a  b $HOME `ls`\n" );
+}
+
+TEST_CASE("exit-status", "[cmd-exec]")
+{
+  REQUIRE( exec("exit 3").code == 3 );
+  REQUIRE( exec(Command{{"/nonexistent/program"}}).code == 127 );
+  REQUIRE( exec("echo out; echo err 1>&2").output == "out\nerr\n" );
+}
+
+TEST_CASE("timeout", "[cmd-exec]")
+{
+  auto start = std::chrono::steady_clock::now();
+  CmdResult cr = exec(Command{{"sleep", "5"}, std::chrono::milliseconds{100}});
+  auto took = std::chrono::steady_clock::now() - start;
+
+  REQUIRE( cr.timed_out );
+  REQUIRE( cr.code == 128 + 9 );
+  REQUIRE( took < std::chrono::seconds{2} );
+}
+
+TEST_CASE("closed-output", "[cmd-exec]")
+{
+  using std::chrono::steady_clock;
+  using std::chrono::milliseconds;
+
+  //a child that closes its output and goes on running holds up no one
+  Executor ex;
+  auto start = steady_clock::now();
+  auto lingering = ex.submit(Command::shell("exec >&- 2>&-; sleep 1"));
+  CmdResult cr = ex.run(Command{{"echo", "hi"}});
+  REQUIRE( cr.output == "hi\n" );
+  REQUIRE( steady_clock::now() - start < milliseconds{500} );
+
+  //it is still waited for, and still killed when it runs over
+  REQUIRE( lingering.get().code == 0 );
+  REQUIRE( steady_clock::now() - start >= milliseconds{1000} );
+
+  cr = ex.run(Command{{"/bin/sh", "-c", "exec >&- 2>&-; sleep 5"},
+      milliseconds{100}});
+  REQUIRE( cr.timed_out );
+  REQUIRE( cr.code == 128 + 9 );
+}
+
+//counts how many commands a fake backend is working on at once
+struct CountingBackend : public ExecBackend
+{
+  CountingBackend()
+    : fake{[](const Command &){ return CmdResult{"ok\n", 0}; }, 
+           std::chrono::milliseconds{10}}
+  {}
+
+  void start(const Command & c, Done done) override
+  {
+    int n = ++running;
+    for(int p = peak; n > p && !peak.compare_exchange_weak(p, n););
+    fake.start(c, [this,done](CmdResult r){ running--; done(r); });
+  }
+
+  std::atomic<int> running{0}, peak{0};
+  FakeBackend fake;
+};
+
+TEST_CASE("in-flight-limit", "[cmd-exec]")
+{
+  auto *backend = new CountingBackend;
+  Executor ex{std::unique_ptr<ExecBackend>{backend}, 4};
+
+  std::vector<std::future<CmdResult>> fs;
+  for(int i=0; i<20; ++i)
+    fs.push_back(ex.submit(Command{{"qemu-img", "info", std::to_string(i)}}));
+
+  for(auto & f : fs) REQUIRE( f.get().output == "ok\n" );
+
+  REQUIRE( backend->peak == 4 );
+
+  Json s = ex.stats();
+  REQUIRE( s["programs"]["qemu-img"]["count"] == 20 );
+  REQUIRE( s["queued"] == 0 );
+}
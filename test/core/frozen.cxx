@@ -0,0 +1,161 @@
+#include <iostream>
+#include <stdexcept>
+#include "core/frozen.hxx"
+#include "core/embed.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "test/models/topos/topologies.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+using std::invalid_argument;
+using namespace marina;
+
+TEST_CASE("symbol-table", "[frozen]")
+{
+  SymbolTable t;
+  Symbol a = t.intern("ifx0"),
+         b = t.intern("cifx"),
+         e = t.intern("");
+
+  REQUIRE( t.intern("ifx0") == a );
+  REQUIRE( a != b );
+  REQUIRE( t.str(a) == "ifx0" );
+  REQUIRE( t.str(e) == "" );
+
+  //past a few rehashes
+  for(size_t i=0; i<1000; ++i) t.intern("c" + std::to_string(i));
+  REQUIRE( t.size() == 1003 );
+  REQUIRE( t.intern("c500") == t.intern("c" + std::to_string(500)) );
+  REQUIRE( t.str(t.intern("c999")) == "c999" );
+  REQUIRE( t.str(b) == "cifx" );
+}
+
+TEST_CASE("pack-mac", "[frozen]")
+{
+  REQUIRE( packMac("02:0c:f4:17:cc:a3") == 0x020cf417cca3ull );
+  REQUIRE( unpackMac(0x020cf417cca3ull) == "02:0c:f4:17:cc:a3" );
+  REQUIRE( unpackMac(packMac("02:AB:00:00:00:01")) == "02:ab:00:00:00:01" );
+  REQUIRE_THROWS_AS( packMac("02:0c:f4:17:cc"), invalid_argument );
+  REQUIRE_THROWS_AS( packMac("02-0c-f4-17-cc-a3"), invalid_argument );
+}
+
+TEST_CASE("frozen-blueprint", "[frozen]")
+{
+  for(Blueprint bp : {mars(), hello_marina(), synthetic(100)})
+  {
+    FrozenBlueprint fb{bp};
+
+    REQUIRE( fb.json() == bp.json() );
+    REQUIRE( fb.thaw() == bp );
+
+    //the link table agrees with the handle graph
+    for(uint32_t i=0; i<fb.networks().size(); ++i)
+    {
+      const Network & n = bp.networks().at(fb.networks()[i].id);
+      auto expected = bp.connectedComputers(n);
+      auto frozen = fb.connectedComputers(i);
+
+      REQUIRE( frozen.size() == expected.size() );
+      for(size_t k=0; k<frozen.size(); ++k)
+      {
+        const FrozenComputer & c = fb.computers()[frozen[k].first];
+        REQUIRE( c.id == expected[k].first.id() );
+        REQUIRE( unpackMac(fb.interfaces()[frozen[k].second].mac) ==
+                 expected[k].second.mac() );
+      }
+    }
+
+    for(uint32_t i=0; i<fb.computers().size(); ++i)
+    {
+      const Computer & c = bp.computers().at(fb.computers()[i].id);
+      REQUIRE( fb.connectedNetworks(i).size() ==
+               bp.connectedNetworks(c).size() );
+    }
+  }
+}
+
+TEST_CASE("frozen-dangling-links", "[frozen]")
+{
+  //a local embedding keeps the links of its computers and nothing else
+  Blueprint bp = synthetic(40);
+  Blueprint::ComputerMap some;
+  some.insert(*bp.computers().begin());
+  Blueprint local = bp.localEmbedding(some);
+
+  FrozenBlueprint fb{local};
+  REQUIRE( fb.json() == local.json() );
+  REQUIRE( fb.computers().size() == 1 );
+  REQUIRE( fb.connectedNetworks(0).size() == 1 );
+
+  //a link to a node that is not there survives the round trip
+  Link l;
+  l.endpoints = {{
+    Endpoint{Uuid{}},
+    Endpoint{Uuid{}, string{"02:00:00:00:00:01"}}
+  }};
+  Json j = local.json();
+  j["links"].push_back(l.json());
+  Blueprint odd = Blueprint::fromJson(j);
+  FrozenBlueprint fo{odd};
+  REQUIRE( fo.links().back().endpoints[0].vertex == no_vertex );
+  REQUIRE( fo.json() == odd.json() );
+}
+
+TEST_CASE("frozen-topology", "[frozen]")
+{
+  for(TestbedTopology tt : {minibed(), deter2015()})
+  {
+    FrozenTopology ft{tt};
+
+    REQUIRE( ft.json() == tt.json() );
+    REQUIRE( ft.thaw() == tt );
+
+    for(uint32_t s=0; s<ft.switches().size(); ++s)
+    {
+      const Switch & sw = tt.switches().at(ft.switches()[s].id);
+      REQUIRE( ft.connectedHosts(s).size() == tt.connectedHosts(sw).size() );
+    }
+  }
+
+  FrozenTopology ft{minibed()};
+  REQUIRE( ft.switches().size() == 1 );
+  REQUIRE( ft.connectedHosts(0).size() == 2 );
+  for(uint32_t h=0; h<ft.hosts().size(); ++h)
+    REQUIRE( ft.connectedSwitches(h) == vector<uint32_t>{0} );
+}
+
+TEST_CASE("frozen-embed", "[frozen][embed]")
+{
+  TestbedTopology t = minibed();
+  Blueprint b = hello_marina();
+
+  EChart ec = embed(b, EChart{t}, t);
+
+  size_t placed{0};
+  for(const auto & h : ec.hmap) placed += h.second.machines.size();
+  REQUIRE( placed == b.computers().size() );
+
+  //every network is spread over the one switch or sits on a single host
+  for(const auto & n : b.networks())
+    REQUIRE( ec.getEmbedding(n.second).size() <= 1 );
+}
+
+TEST_CASE("frozen-size", "[frozen]")
+{
+  Blueprint bp = synthetic(1000);
+  FrozenBlueprint fb{bp};
+
+  //the whole of it, strings and tables included
+  cout << "frozen synthetic(1000): " << fb.bytes() << " bytes, "
+       << fb.bytes() / (fb.computers().size() + fb.networks().size())
+       << " per node" << endl;
+
+  REQUIRE( fb.interfaces().size() == 2000 );
+  //every computer has the same os and interface names, stored once
+  REQUIRE( fb.str(fb.computers()[0].os) == "ubuntu-server-xenial" );
+  REQUIRE( fb.interfaces()[0].name == fb.interfaces()[2].name );
+  REQUIRE( fb.bytes() < 512 * (fb.computers().size() + fb.networks().size()) );
+}
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include "core/jobs.hxx"
+#include "../catch.hpp"
+
+using std::atomic;
+using std::vector;
+using std::string;
+using std::to_string;
+using std::promise;
+using std::shared_future;
+using std::runtime_error;
+using std::this_thread::sleep_for;
+using std::chrono::milliseconds;
+using namespace marina;
+
+namespace
+{
+  //a job that sits in its first stage until let go
+  JobScheduler::Work gated(shared_future<void> gate, atomic<int> & running)
+  {
+    return [gate,&running](JobProgress & p)
+    {
+      p.begin("disks", 2);
+      running++;
+      gate.wait();
+      p.advance("disks");
+      p.advance("disks");
+      p.begin("boot");
+      p.advance("boot");
+      running--;
+    };
+  }
+}
+
+TEST_CASE("jobs-admission", "[jobs]")
+{
+  promise<void> go;
+  shared_future<void> gate = go.get_future().share();
+  atomic<int> running{0};
+
+  JobScheduler js{2, 3};
+  using A = JobScheduler::Admission;
+
+  for(int i=0; i<5; ++i)
+    REQUIRE( js.submit(to_string(i), "bp", {"disks", "boot"},
+                       gated(gate, running)) == A::Accepted );
+
+  //2 running, 3 queued, the queue is full
+  while(running < 2) sleep_for(milliseconds{1});
+  REQUIRE( js.submit("5", "bp", {}, gated(gate, running)) == A::Busy );
+  REQUIRE( js.submit("0", "bp", {}, gated(gate, running)) == A::Duplicate );
+
+  Json j = js.json();
+  REQUIRE( j["running"] == 2 );
+  REQUIRE( j["queued"] == 3 );
+  REQUIRE( js.json("0")["stages"][0]["state"] == "running" );
+  REQUIRE( js.json("0")["stages"][1]["state"] == "pending" );
+
+  go.set_value();
+  for(int i=0; i<5; ++i) js.wait(to_string(i));
+
+  REQUIRE( running == 0 );
+  for(int i=0; i<5; ++i)
+  {
+    Json x = js.json(to_string(i));
+    REQUIRE( x["state"] == "done" );
+    REQUIRE( x["stages"][0]["done"] == 2 );
+    REQUIRE( x["stages"][1]["state"] == "done" );
+  }
+
+  //a finished id can be submitted again
+  REQUIRE( js.submit("0", "bp", {}, [](JobProgress &){}) == A::Accepted );
+}
+
+TEST_CASE("jobs-cancel", "[jobs]")
+{
+  promise<void> go;
+  shared_future<void> gate = go.get_future().share();
+  atomic<int> running{0};
+
+  JobScheduler js{1, 8};
+  js.submit("a", "bp", {"disks", "boot"}, gated(gate, running));
+  js.submit("b", "bp", {"disks", "boot"}, gated(gate, running));
+  while(running < 1) sleep_for(milliseconds{1});
+
+  //queued jobs go away at once, running ones stop at their next stage
+  REQUIRE( js.cancel("b") );
+  REQUIRE( js.json("b")["state"] == "cancelled" );
+  REQUIRE( js.json("b")["stages"][0]["state"] == "skipped" );
+
+  REQUIRE( js.cancel("a") );
+  go.set_value();
+  js.wait("a");
+
+  Json a = js.json("a");
+  REQUIRE( a["state"] == "cancelled" );
+  REQUIRE( a["stages"][0]["done"] == 2 );
+  REQUIRE( a["stages"][1]["state"] == "skipped" );
+
+  REQUIRE( !js.cancel("a") );
+  REQUIRE( !js.cancel("nope") );
+  REQUIRE_THROWS_AS( js.json("nope"), std::out_of_range );
+}
+
+TEST_CASE("jobs-failure", "[jobs]")
+{
+  JobScheduler js{1, 1};
+  js.submit("x", "bp", {"dir", "networks"}, [](JobProgress & p){
+    p.begin("dir");
+    throw runtime_error{"no space left on device"};
+  });
+  js.wait("x");
+
+  Json x = js.json("x");
+  REQUIRE( x["state"] == "failed" );
+  REQUIRE( x["error"] == "no space left on device" );
+  REQUIRE( x["stages"][0]["state"] == "failed" );
+  REQUIRE( x["stages"][1]["state"] == "skipped" );
+}
@@ -0,0 +1,105 @@
+#include <stdexcept>
+#include "core/json_reader.hxx"
+#include "core/blueprint.hxx"
+#include "core/materialization.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::out_of_range;
+using namespace marina;
+
+namespace
+{
+  //where parsing s stops, as line:column
+  string errorAt(const string & s)
+  {
+    try { Blueprint::parse(s); }
+    catch(JsonParseError &e)
+    {
+      return std::to_string(e.line) + ":" + std::to_string(e.column);
+    }
+    return "";
+  }
+}
+
+TEST_CASE("json-reader-values", "[json-reader]")
+{
+  string s = R"( {"a": [1, -2, 3.5e1, "x\né😀", true, null],
+                  "b": {"c": {}}, "d": 18446744073709551615} )";
+  JsonReader r{s.data(), s.size()};
+
+  string k;
+  r.beginObject();
+
+  REQUIRE( r.key(k) );
+  REQUIRE( k == "a" );
+  r.beginArray();
+  REQUIRE( r.element() );
+  REQUIRE( r.uint() == 1 );
+  REQUIRE( r.element() );
+  REQUIRE( r.integer() == -2 );
+  REQUIRE( r.element() );
+  REQUIRE( r.number() == 35.0 );
+  REQUIRE( r.element() );
+  REQUIRE( r.string() == "x\n\xc3\xa9\xf0\x9f\x98\x80" );
+  REQUIRE( r.element() );
+  REQUIRE( r.boolean() );
+  REQUIRE( r.element() );
+  REQUIRE( r.peek() == JsonReader::Type::Null );
+  r.null();
+  REQUIRE( !r.element() );
+
+  REQUIRE( r.key(k) );
+  REQUIRE( k == "b" );
+  r.skip();
+
+  REQUIRE( r.key(k) );
+  REQUIRE( k == "d" );
+  REQUIRE( r.uint() == 18446744073709551615ull );
+
+  REQUIRE( !r.key(k) );
+  REQUIRE_NOTHROW( r.end() );
+}
+
+TEST_CASE("json-reader-errors", "[json-reader]")
+{
+  REQUIRE( errorAt("") == "1:1" );
+  REQUIRE( errorAt("{\n  \"name\": \"x\",\n  \"id\" 7\n}") == "3:8" );
+  REQUIRE( errorAt("{\"name\": \"x\",}") == "1:14" );
+  REQUIRE( errorAt("{\"name\": \"a\tb\"}") == "1:12" );
+  REQUIRE( errorAt("{\"name\": 01}") == "1:10" );
+
+  string s = "[18446744073709551616]";
+  JsonReader r{s.data(), s.size()};
+  r.beginArray();
+  r.element();
+  REQUIRE_THROWS_AS( r.uint(), JsonParseError );
+
+  string t = "[] x";
+  JsonReader trailing{t.data(), t.size()};
+  trailing.beginArray();
+  REQUIRE( !trailing.element() );
+  REQUIRE_THROWS_AS( trailing.end(), JsonParseError );
+
+  //well formed but not a blueprint
+  REQUIRE_THROWS_AS( Blueprint::parse(R"({"name": "x"})"), out_of_range );
+  REQUIRE_THROWS_AS( Blueprint::parse(R"({"name": 7})"), JsonParseError );
+}
+
+TEST_CASE("json-reader-models", "[json-reader]")
+{
+  for(Blueprint bp : {mars(), hello_marina(), synthetic(100)})
+  {
+    Json j = bp.json();
+    Blueprint parsed = Blueprint::parse(j.dump(2));
+    REQUIRE( parsed.json() == Blueprint::fromJson(j).json() );
+  }
+
+  Blueprint bp = synthetic(40);
+  HostMaterialization hm{bp.localEmbedding(bp.computers())};
+  for(const auto & n : bp.networks()) hm.networks[n.first].vni = 47;
+  string s = hm.json().dump();
+  REQUIRE( HostMaterialization::parse(s.data(), s.size()).json() ==
+           HostMaterialization::fromJson(hm.json()).json() );
+}
@@ -1,5 +1,6 @@
 #include "core/blueprint.hxx"
 #include "core/topo.hxx"
+#include "core/materialization.hxx"
 #include "test/models/blueprints/blueprints.hxx"
 #include "test/models/topos/topologies.hxx"
 #include "../catch.hpp"
@@ -187,3 +188,43 @@ TEST_CASE("deter-round-trip", "[jsonification]")
 
   REQUIRE( t == t_ );
 }
+
+TEST_CASE("mars-local-embedding", "[jsonification]")
+{
+  Blueprint m = mars();
+  Blueprint m_ = m.localEmbedding(m.computers());
+
+  //network to network links do not touch any computer so are left out
+  size_t computer_links{0};
+  for(const Link & l : m.links())
+  {
+    if(m.computers().count(l.endpoints[0].id) || 
+       m.computers().count(l.endpoints[1].id)) ++computer_links;
+  }
+
+  REQUIRE( m.id() == m_.id() );
+  REQUIRE( m.computers().size() == m_.computers().size() );
+  REQUIRE( m_.links().size() == computer_links );
+  for(const auto & c : m.computers())
+    REQUIRE( m_.computers().at(c.first) == c.second );
+}
+
+TEST_CASE("host-materialization-round-trip", "[jsonification]")
+{
+  Blueprint m = mars();
+
+  Blueprint::ComputerMap some;
+  some.insert(*m.computers().begin());
+
+  HostMaterialization hm{m.localEmbedding(some)};
+  size_t vni{47};
+  for(const auto & n : hm.blueprint.networks()) hm.networks[n.first].vni = vni++;
+
+  auto hm_ = HostMaterialization::fromJson(hm.json());
+
+  REQUIRE( hm_.blueprint.computers().size() == 1 );
+  REQUIRE( hm.blueprint == hm_.blueprint );
+  REQUIRE( hm.networks.size() == hm_.networks.size() );
+  for(const auto & n : hm.networks)
+    REQUIRE( hm_.networks.at(n.first).vni == n.second.vni );
+}
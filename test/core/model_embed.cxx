@@ -77,6 +77,31 @@ TEST_CASE("hello-marina", "[embed]")
   */
 }
 
+TEST_CASE("numa-fit", "[embed]")
+{
+  TestbedTopology t = minibed();
+  Blueprint b = hello_marina();
+
+  HostEmbedding he{t.hosts().begin()->second};
+  REQUIRE( he.load().mem.total == 24*1024 );
+
+  //3GB free in all but only 1.5GB on either node
+  he.numa_free_mb = {1536, 1536};
+  REQUIRE( he.load().mem.total == 3072 );
+
+  vector<Computer> cs = b.computers()
+    | map<vector>([](const auto & x){ return x.second; });
+  REQUIRE( cs.size() >= 3 );
+
+  he = he + cs[0];
+  REQUIRE( he.fits() );
+  he = he + cs[1];
+  REQUIRE( he.fits() );
+  he = he + cs[2];
+  REQUIRE( !he.load().overloaded() );
+  REQUIRE( !he.fits() );
+}
+
 TEST_CASE("mars", "[launch]")
 {
   /*
@@ -155,3 +180,21 @@ TEST_CASE("mars", "[launch]")
   //uncomment to dump json representation
   //cout << t.json().dump(2) << endl;
 }
+
+TEST_CASE("tunnel-first", "[embed]")
+{
+  //only one of the hosts said where its tunnels end, the blueprint goes 
+  //there so none of its networks have to span the other one
+  TestbedTopology t = minibed();
+  Blueprint b = hello_marina();
+  EChart ec{t};
+  for(auto & h : ec.hmap)
+    if(h.second.host.name() == "mrtb1") h.second.tunnel_addr = "10.47.0.1";
+
+  EChart ec_ = embed(b, ec, t);
+  for(const auto & h : ec_.hmap)
+  {
+    size_t expect = h.second.tunnel_addr.empty() ? 0 : b.computers().size();
+    REQUIRE( h.second.machines.size() == expect );
+  }
+}
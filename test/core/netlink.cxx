@@ -0,0 +1,85 @@
+#include <net/if.h>
+#include <unistd.h>
+#include <chrono>
+#include <stdexcept>
+#include "core/netlink.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::chrono::milliseconds;
+using namespace marina;
+
+TEST_CASE("link-dump", "[netlink]")
+{
+  auto links = dumpLinks();
+  REQUIRE( !links.empty() );
+
+  bool lo{false};
+  for(const auto & l : links)
+  {
+    REQUIRE( l.index > 0 );
+    REQUIRE( !l.name.empty() );
+    if(l.name == "lo") lo = true;
+  }
+  REQUIRE( lo );
+
+  REQUIRE_THROWS_AS( mac_2_ifname("fe:ff:ff:ff:ff:fe"), std::out_of_range );
+}
+
+TEST_CASE("link-cache", "[netlink]")
+{
+  for(bool follow : {false, true})
+  {
+    LinkCache lc{follow};
+
+    auto lo = lc.byName("lo");
+    REQUIRE( lo );
+    REQUIRE( lo->index == static_cast<int>(if_nametoindex("lo")) );
+    REQUIRE( lo->up() );
+    REQUIRE( lc.byIndex(lo->index)->name == "lo" );
+    REQUIRE( lc.links().size() == dumpLinks().size() );
+
+    //every link with an ethernet address can be found by it, in any case
+    for(const auto & l : lc.links())
+    {
+      if(l.mac.empty() || l.mac == "00:00:00:00:00:00") continue;
+      string upper = l.mac;
+      for(char & c : upper) c = toupper(c);
+      REQUIRE( lc.byMac(upper) );
+    }
+
+    REQUIRE( !lc.waitForName("mrtb-nonesuch", milliseconds{100}) );
+    REQUIRE( lc.waitForName("lo", milliseconds{100}) );
+  }
+}
+
+TEST_CASE("link-batch", "[netlink]")
+{
+  LinkBatch b;
+  REQUIRE_THROWS_AS( b.addAddress(1, "10.47.0.1"), std::invalid_argument );
+  REQUIRE_THROWS_AS( b.addAddress(1, "10.47.0/24"), std::invalid_argument );
+  REQUIRE_THROWS_AS( b.addAddress(1, "10.47.0.1/33"), std::invalid_argument );
+  REQUIRE( b.empty() );
+
+  //changing links takes privileges
+  if(geteuid() != 0) return;
+
+  //things that are already so are fine, the whole batch is reported on
+  int lo = if_nametoindex("lo");
+  b.addAddress(lo, "127.0.0.1/8").setUp(lo).setMtu(0x7fffffff, 1500);
+  REQUIRE( b.size() == 3 );
+  try
+  {
+    b.commit();
+    FAIL( "a change to a link that does not exist went through" );
+  }
+  catch(std::runtime_error &e)
+  {
+    string msg = e.what();
+    REQUIRE( msg.find("mtu 1500") != string::npos );
+    REQUIRE( msg.find("127.0.0.1") == string::npos );
+  }
+  REQUIRE( b.empty() );
+
+  LinkBatch{}.addAddress(lo, "127.0.0.1/8").setUp(lo).commit();
+}
@@ -0,0 +1,156 @@
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "core/exec.hxx"
+#include "core/numa.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::vector;
+using std::ofstream;
+using std::to_string;
+using namespace marina;
+
+namespace
+{
+  //a two socket host, 8 cpus a socket with hyperthread siblings numbered
+  //after all the cores like the kernel does
+  NumaTopology twoSockets()
+  {
+    return NumaTopology{{
+      {0, parseCpuList("0-3,8-11"), 4096},
+      {1, parseCpuList("4-7,12-15"), 4096}
+    }};
+  }
+}
+
+TEST_CASE("cpu-lists", "[numa]")
+{
+  REQUIRE( parseCpuList("0-3,8,10-11\n") == vector<size_t>({0,1,2,3,8,10,11}) );
+  REQUIRE( parseCpuList("") == vector<size_t>{} );
+  REQUIRE_THROWS_AS( parseCpuList("3-1"), std::invalid_argument );
+  REQUIRE_THROWS_AS( parseCpuList("a"), std::invalid_argument );
+
+  REQUIRE( cpuList({11,0,1,2,3,8,10}) == "0-3,8,10-11" );
+  REQUIRE( cpuMask({2,3}) == "c" );
+  REQUIRE( cpuMask({0,12}) == "1001" );
+}
+
+TEST_CASE("numa-detect", "[numa]")
+{
+  string root = "/tmp/marina-fake-sysfs-" + to_string(getpid());
+  string nd = root + "/devices/system/node";
+  exec(Command{{"mkdir", "-p",
+    nd + "/node0/hugepages/hugepages-2048kB",
+    nd + "/node0/hugepages/hugepages-1048576kB",
+    nd + "/node1/hugepages/hugepages-2048kB"
+  }});
+  ofstream{nd + "/node0/cpulist"} << "0-3,8-11" << std::endl;
+  ofstream{nd + "/node1/cpulist"} << "4-7,12-15" << std::endl;
+  ofstream{nd + "/node0/hugepages/hugepages-2048kB/nr_hugepages"} << 512;
+  ofstream{nd + "/node0/hugepages/hugepages-1048576kB/nr_hugepages"} << 2;
+  ofstream{nd + "/node1/hugepages/hugepages-2048kB/nr_hugepages"} << 1024;
+
+  NumaTopology t = NumaTopology::detect(root);
+  exec(Command{{"rm", "-rf", root}});
+
+  REQUIRE( t.nodes().size() == 2 );
+  REQUIRE( t.node(0).hugepage_mb == 1024 + 2048 );
+  REQUIRE( t.node(1).hugepage_mb == 2048 );
+  REQUIRE( t.nodeOf(12) == 1 );
+  REQUIRE_THROWS_AS( t.nodeOf(16), std::out_of_range );
+
+  //whatever this host is, every cpu it has is on some node
+  NumaTopology here = NumaTopology::detect();
+  REQUIRE( !here.nodes().empty() );
+  for(size_t c : parseCpuList("0")) REQUIRE_NOTHROW( here.nodeOf(c) );
+}
+
+TEST_CASE("cpu-placement", "[numa]")
+{
+  //cpu 0 for the host, pmd threads on 1 and 9 of the first socket
+  CpuPlacer p{twoSockets(), {0}, {1, 9}};
+
+  //vms go next to the pmd threads as long as they fit
+  CpuAssignment a = p.place("a", 2);
+  REQUIRE( a.node == 0 );
+  REQUIRE( a.vcpus == vector<size_t>({2, 3}) );
+  REQUIRE( a.emulator == vector<size_t>({0}) );
+
+  CpuAssignment b = p.place("b", 3);
+  REQUIRE( b.node == 0 );
+  REQUIRE( b.vcpus == vector<size_t>({8, 10, 11}) );
+
+  //the first socket is full, rather spill over than double up
+  CpuAssignment c = p.place("c", 4);
+  REQUIRE( c.node == 1 );
+  REQUIRE( c.emulator.size() == 8 );
+
+  //placing the same vm twice changes nothing
+  REQUIRE( p.place("c", 4).vcpus == c.vcpus );
+
+  p.release("a");
+  REQUIRE( p.place("d", 2).vcpus == vector<size_t>({2, 3}) );
+
+  p.rename("d", "e");
+  REQUIRE( !p.assignment("d") );
+  REQUIRE( p.assignment("e")->node == 0 );
+
+  //once everything is taken vcpus double up on the lightest node
+  p.place("f", 4);
+  CpuAssignment g = p.place("g", 2);
+  REQUIRE( g.node == 0 );
+  REQUIRE( p.json()["nodes"][0]["vcpus"] == 7 );
+}
+
+TEST_CASE("process-threads", "[numa]")
+{
+  auto tids = processThreads(getpid());
+  REQUIRE( !tids.empty() );
+  REQUIRE( std::find(tids.begin(), tids.end(), getpid()) != tids.end() );
+}
+
+TEST_CASE("hugepage-ledger", "[numa]")
+{
+  HugepageLedger l{twoSockets()};
+  REQUIRE( l.available() == 8192 );
+
+  REQUIRE( l.reserve("a", 0, 3072) );
+  REQUIRE( !l.reserve("a", 1, 1024) );
+  REQUIRE( !l.reserve("b", 0, 2048) );
+  REQUIRE( l.reserve("b", 1, 2048) );
+  REQUIRE( l.available(0) == 1024 );
+  REQUIRE( l.largestAvailable() == 2048 );
+
+  l.rename("b", "c");
+  l.release("b");
+  REQUIRE( l.available(1) == 2048 );
+  l.release("c");
+  REQUIRE( l.available(1) == 4096 );
+}
+
+TEST_CASE("hugepage-placement", "[numa]")
+{
+  CpuPlacer p{twoSockets(), {0}, {1, 9}};
+
+  //the pmd node is preferred until its memory runs out
+  REQUIRE( p.place("a", 2, 3072).node == 0 );
+  REQUIRE( p.place("b", 2, 2048).node == 1 );
+  REQUIRE( p.place("c", 2, 1024).node == 0 );
+
+  //6GB free in all, but no single node has 3GB
+  REQUIRE_THROWS_AS( p.place("d", 2, 3072), InsufficientHugepages );
+  REQUIRE( !p.assignment("d") );
+
+  //claiming a standby vm hands its memory over to the placement it replaces
+  p.release("c");
+  p.place("warm/0", 2, 1024);
+  p.place("x", 2, 2048);
+  p.rename("warm/0", "x");
+  REQUIRE( p.capacity()["hugepage_available_mb"] == 2048 );
+
+  p.release("a");
+  REQUIRE( p.place("d", 2, 3072).node == 0 );
+}
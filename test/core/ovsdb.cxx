@@ -0,0 +1,296 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "core/ovsdb.hxx"
+#include "core/materialization.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::vector;
+using std::thread;
+using std::to_string;
+using namespace marina;
+
+/*
+ * A stand-in for ovsdb-server that answers transact requests on a unix socket
+ * the way the real server does, well enough to exercise the client. Replies
+ * are written in two pieces and preceded by an echo probe so the client's
+ * framing and keepalive handling get exercised too.
+ */
+struct FakeOvsdb
+{
+  FakeOvsdb()
+    : path{"/tmp/marina-fake-ovsdb-" + to_string(getpid()) + ".sock"}
+  {
+    unlink(path.c_str());
+    lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path)-1);
+    bind(lfd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    listen(lfd, 1);
+    t = thread{[this](){ serve(); }};
+  }
+
+  ~FakeOvsdb()
+  {
+    shutdown(lfd, SHUT_RDWR);
+    close(lfd);
+    t.join();
+    unlink(path.c_str());
+  }
+
+  void write(int fd, string s)
+  {
+    size_t half = s.size()/2;
+    ::send(fd, s.data(), half, MSG_NOSIGNAL);
+    ::send(fd, s.data()+half, s.size()-half, MSG_NOSIGNAL);
+  }
+
+  Json reply(const Json & ops)
+  {
+    Json result = Json::array();
+    for(size_t i=1; i<ops.size(); ++i)
+    {
+      const Json & op = ops[i];
+      Json r = Json::object();
+      if(op["op"] == "insert")
+        r["uuid"] = Json::array({"uuid", "u" + to_string(next_uuid++)});
+      //vswitchd catches up with this and one more commit in the same pass
+      else if(op["op"] == "wait")
+        cur_cfg = next_cfg + 1;
+      else if(op["op"] == "mutate")
+      {
+        for(const auto & m : op["mutations"])
+          if(m[0] == "next_cfg") ++next_cfg;
+        r["count"] = 1;
+      }
+      else if(op["op"] == "select" && op["table"] == "Open_vSwitch")
+      {
+        Json row;
+        row["next_cfg"] = next_cfg;
+        row["cur_cfg"] = cur_cfg;
+        r["rows"] = Json::array({row});
+      }
+      else if(op["op"] == "select" && op["table"] == "Bridge")
+      {
+        //only bridges named like vbr-* exist
+        r["rows"] = Json::array();
+        string name = op["where"][0][2];
+        if(name.find("vbr-") == 0)
+        {
+          Json row;
+          row["_uuid"] = Json::array({"uuid", "uuid-" + name});
+          r["rows"].push_back(row);
+        }
+      }
+      result.push_back(r);
+    }
+    return result;
+  }
+
+  void serve()
+  {
+    int fd = accept(lfd, nullptr, nullptr);
+    if(fd < 0) return;
+
+    string buf;
+    char chunk[4096];
+    for(;;)
+    {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if(n <= 0) break;
+      buf.append(chunk, n);
+
+      size_t len;
+      while((len = jsonValueLength(buf)) > 0)
+      {
+        Json m = Json::parse(buf.substr(0, len));
+        buf.erase(0, len);
+        if(m.count("method") == 0) continue; //echo reply
+
+        transactions.push_back(m["params"]);
+
+        Json echo;
+        echo["method"] = "echo";
+        echo["params"] = Json::array();
+        echo["id"] = "echo";
+        write(fd, echo.dump());
+
+        Json r;
+        r["id"] = m["id"];
+        r["result"] = reply(m["params"]);
+        r["error"] = nullptr;
+        write(fd, r.dump());
+      }
+    }
+    close(fd);
+  }
+
+  size_t count(const Json & ops, string op, string table)
+  {
+    size_t n{0};
+    for(const auto & o : ops)
+      if(o.is_object() && o["op"] == op && o["table"] == table) ++n;
+    return n;
+  }
+
+  string path;
+  int lfd;
+  thread t;
+  vector<Json> transactions;
+  size_t next_uuid{0};
+  int64_t next_cfg{47}, cur_cfg{47};
+};
+
+TEST_CASE("json-rpc-framing", "[ovsdb]")
+{
+  REQUIRE( jsonValueLength("") == 0 );
+  REQUIRE( jsonValueLength("{\"a\":[1,2") == 0 );
+  REQUIRE( jsonValueLength("{\"a\":\"}\"}") == 9 );
+  REQUIRE( jsonValueLength("{\"a\":\"\\\"}\"}{}") == 11 );
+  REQUIRE( jsonValueLength("  [1,[2]] [3]") == 9 );
+}
+
+TEST_CASE("batched-bridges", "[ovsdb]")
+{
+  FakeOvsdb srv;
+  {
+    OvsDb db{srv.path};
+
+    OvsTxn txn;
+    for(size_t i=0; i<2; ++i)
+    {
+      string br = "mrtb-vbr-" + to_string(i);
+      txn.addBridge(br)
+         .addPort(br, "vxlan" + to_string(i), "vxlan",
+             {{"remote_ip", "192.168.247.2"}, {"key", to_string(100+i)}});
+      for(size_t j=0; j<3; ++j)
+        txn.addPort(br, "mrtb-vhu-" + to_string(3*i+j), "dpdkvhostuser");
+    }
+    txn.addPort("mrtb-pbr", "dpdk0", "dpdk");
+
+    db.commit(txn);
+  }
+
+  //one transaction for the changes and one to wait for vswitchd
+  REQUIRE( srv.transactions.size() == 2 );
+
+  const Json & ops = srv.transactions[0];
+  REQUIRE( ops[0] == "Open_vSwitch" );
+  REQUIRE( srv.count(ops, "insert", "Bridge") == 2 );
+  //vxlan + 3 vhost + internal per bridge, and dpdk0
+  REQUIRE( srv.count(ops, "insert", "Port") == 11 );
+  REQUIRE( srv.count(ops, "insert", "Interface") == 11 );
+  //bridges into Open_vSwitch, next_cfg bump, dpdk0 onto existing mrtb-pbr
+  REQUIRE( srv.count(ops, "mutate", "Open_vSwitch") == 2 );
+  REQUIRE( srv.count(ops, "mutate", "Bridge") == 1 );
+
+  for(const auto & o : ops)
+  {
+    if(o.is_object() && o["op"] == "insert" && o["table"] == "Bridge")
+      REQUIRE( o["row"]["ports"][1].size() == 5 );
+  }
+
+  //waits for cur_cfg to move off where it was, and is satisfied by it going
+  //past the cfg of this commit
+  const Json & wait = srv.transactions[1][1];
+  REQUIRE( wait["op"] == "wait" );
+  REQUIRE( wait["until"] == "!=" );
+  REQUIRE( wait["rows"][0]["cur_cfg"] == 47 );
+  REQUIRE( srv.cur_cfg == 49 );
+}
+
+TEST_CASE("delete-bridges", "[ovsdb]")
+{
+  FakeOvsdb srv;
+  {
+    OvsDb db{srv.path};
+    db.commit(
+      OvsTxn{}.delBridge("vbr-0").delBridge("vbr-1").delBridge("gone"),
+      false
+    );
+  }
+
+  //a lookup of all the bridges at once, then a single delete
+  REQUIRE( srv.transactions.size() == 2 );
+  REQUIRE( srv.count(srv.transactions[0], "select", "Bridge") == 3 );
+
+  const Json & del = srv.transactions[1][1];
+  REQUIRE( del["op"] == "mutate" );
+  REQUIRE( del["mutations"][0][1] == "delete" );
+  REQUIRE( del["mutations"][0][2][1].size() == 2 );
+}
+
+TEST_CASE("other-config", "[ovsdb]")
+{
+  FakeOvsdb srv;
+  {
+    OvsDb db{srv.path};
+    db.commit(OvsTxn{}.setOtherConfig({{"pmd-cpu-mask", "202"}}), false);
+  }
+
+  REQUIRE( srv.transactions.size() == 1 );
+  const Json & op = srv.transactions[0][1];
+  REQUIRE( op["table"] == "Open_vSwitch" );
+  REQUIRE( op["mutations"][0][1] == "delete" );
+  REQUIRE( op["mutations"][0][2][1][0] == "pmd-cpu-mask" );
+  REQUIRE( op["mutations"][1][1] == "insert" );
+  REQUIRE( op["mutations"][1][2][1][0][1] == "202" );
+}
+
+TEST_CASE("tunnel-mesh", "[ovsdb]")
+{
+  //one network over 3 hosts, a computer on each
+  Blueprint bp{"mesh"};
+  Network lan = bp.network("lan");
+  Placement pl;
+  size_t k{0};
+  for(string h : {"a", "b", "c"})
+  {
+    Computer x = bp.computer(h);
+    bp.connect({x, x.ifx("cifx")}, lan);
+    pl.hosts[h] = {"10.47.0." + to_string(++k), {x.id()}};
+  }
+
+  UuidMap<NetworkMzInfo> mz;
+  mz[lan.id()].vni = 47;
+
+  for(const auto & p : partition(bp, pl, mz))
+  {
+    const NetworkMzInfo & z = p.second.networks.at(lan.id());
+    REQUIRE( z.remotes.size() == 2 );
+
+    FakeOvsdb srv;
+    {
+      OvsDb db{srv.path};
+      OvsTxn txn;
+      txn.addBridge("mrtb-vbr-0");
+      addTunnels(txn, "mrtb-vbr-0", 0, z, "192.168.247.2");
+      txn.addPort("mrtb-vbr-0", "mrtb-vhu-0", "dpdkvhostuser");
+      db.commit(txn, false);
+    }
+
+    //a tunnel to each of the other hosts, none of them forwarding to
+    //another tunnel, the local port forwards to all of them
+    size_t tunnels{0};
+    for(const auto & o : srv.transactions.at(0))
+    {
+      if(!o.is_object() || o["op"] != "insert" || o["table"] != "Port")
+        continue;
+
+      string name = o["row"]["name"];
+      bool isolated = o["row"].count("protected") == 1 && 
+                      o["row"]["protected"] == true;
+      if(name.find("vxlan") == 0) ++tunnels;
+      REQUIRE( isolated == (name.find("vxlan") == 0) );
+    }
+    REQUIRE( tunnels == 2 );
+  }
+}
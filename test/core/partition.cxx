@@ -0,0 +1,153 @@
+#include <algorithm>
+#include "core/materialization.hxx"
+#include "core/embed.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "test/models/topos/topologies.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+using std::runtime_error;
+using namespace marina;
+
+namespace
+{
+  //the computers of bp dealt out over the hosts of t in turn, every host
+  //with a tunnel address of its own
+  EChart deal(const Blueprint & bp, const TestbedTopology & t)
+  {
+    EChart ec{t};
+    vector<HostEmbedding*> hs;
+    for(auto & h : ec.hmap)
+    {
+      hs.push_back(&h.second);
+      h.second.tunnel_addr = "10.47.0." + std::to_string(hs.size());
+    }
+
+    size_t k{0};
+    for(const auto & c : bp.computers())
+      hs[k++ % hs.size()]->machines.insert(c);
+
+    return ec;
+  }
+}
+
+TEST_CASE("partition", "[partition]")
+{
+  Blueprint bp = synthetic(40);
+  TestbedTopology t = deter2015();
+  EChart ec = deal(bp, t);
+
+  UuidMap<NetworkMzInfo> mz;
+  size_t vni{47};
+  for(const auto & n : bp.networks()) mz[n.first].vni = vni++;
+
+  auto parts = partition(bp, ec, mz);
+
+  unordered_map<string, string> host_at, tunnel_of;
+  for(const auto & h : ec.hmap)
+  {
+    host_at[h.second.tunnel_addr] = h.second.host.name();
+    tunnel_of[h.second.host.name()] = h.second.tunnel_addr;
+  }
+
+  size_t computers{0}, links{0};
+  for(const auto & p : parts)
+  {
+    const HostMaterialization & hm = p.second;
+    const Blueprint & share = hm.blueprint;
+    REQUIRE( share.id() == bp.id() );
+    REQUIRE( share == bp.localEmbedding(share.computers()) );
+    computers += share.computers().size();
+    links += share.links().size();
+
+    for(const auto & n : share.networks())
+    {
+      const NetworkMzInfo & info = hm.networks.at(n.first);
+      REQUIRE( info.vni == mz.at(n.first).vni );
+
+      //a remote is the tunnel address of a host whose share has the network
+      //too, never this one
+      for(const string & addr : info.remotes)
+      {
+        const string & r = host_at.at(addr);
+        REQUIRE( r != p.first );
+        REQUIRE( parts.at(r).blueprint.networks().count(n.first) == 1 );
+        const auto & back = parts.at(r).networks.at(n.first).remotes;
+        REQUIRE( std::find(back.begin(), back.end(), tunnel_of.at(p.first))
+                   != back.end() );
+      }
+    }
+  }
+
+  //every computer and computer link lands in exactly one share
+  REQUIRE( computers == bp.computers().size() );
+  REQUIRE( links == bp.computers().size() );
+
+  //the remotes go over the wire
+  const HostMaterialization & hm = parts.begin()->second;
+  HostMaterialization rt = HostMaterialization::fromJson(hm.json());
+  const Uuid & lan = hm.blueprint.networks().begin()->first;
+  REQUIRE( rt.networks.at(lan).remotes == hm.networks.at(lan).remotes );
+  string s = hm.json().dump();
+  REQUIRE( HostMaterialization::parse(s.data(), s.size())
+             .networks.at(lan).remotes == hm.networks.at(lan).remotes );
+}
+
+TEST_CASE("partition-without-mz", "[partition]")
+{
+  Blueprint bp = hello_marina();
+  TestbedTopology t = minibed();
+  auto parts = partition(bp, deal(bp, t));
+
+  REQUIRE( !parts.empty() );
+  for(const auto & p : parts) REQUIRE( p.second.networks.empty() );
+}
+
+TEST_CASE("partition-placement", "[partition]")
+{
+  Blueprint bp = synthetic(20);
+  TestbedTopology t = minibed();
+  EChart ec = deal(bp, t);
+
+  UuidMap<NetworkMzInfo> mz;
+  size_t vni{47};
+  for(const auto & n : bp.networks()) mz[n.first].vni = vni++;
+
+  //the placement saved with a materialization partitions like the embedding
+  Placement pl = Placement::fromJson(Placement::of(ec).json());
+  auto a = partition(bp, ec, mz), b = partition(bp, pl, mz);
+  REQUIRE( a.size() == b.size() );
+  for(const auto & p : a)
+  {
+    const HostMaterialization & hm = b.at(p.first);
+    REQUIRE( hm.blueprint == p.second.blueprint );
+    for(const auto & n : hm.networks)
+      REQUIRE( n.second.remotes == p.second.networks.at(n.first).remotes );
+  }
+
+  //a network that spans a host without a tunnel address cannot be built
+  pl.hosts.begin()->second.tunnel_addr.clear();
+  REQUIRE_THROWS_AS( partition(bp, pl, mz), runtime_error );
+  REQUIRE_NOTHROW( partition(bp, pl) );
+}
+
+TEST_CASE("assign-addresses", "[partition]")
+{
+  Blueprint bp = synthetic(20);
+  UuidMap<NetworkMzInfo> mz;
+  size_t vni{0};
+  assignAddresses(bp, mz, [&vni](const Network &) { return ++vni; });
+
+  REQUIRE( mz.size() == bp.networks().size() );
+  REQUIRE( vni == bp.networks().size() );
+
+  //addresses run from the start of the network space, never its zero
+  auto lan = bp.getNetwork("lan0");
+  auto cs = bp.connectedComputers(lan);
+  REQUIRE( cs.size() == 16 );
+  for(size_t i=0; i<cs.size(); ++i)
+    REQUIRE( cs[i].second.einfo().ipaddr_v4.addr() ==
+             (lan.ipv4() + uint32_t(i+1)).addr() );
+}
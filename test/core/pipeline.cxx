@@ -0,0 +1,125 @@
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "core/pipeline.hxx"
+#include "../catch.hpp"
+
+using std::atomic;
+using std::vector;
+using std::string;
+using std::to_string;
+using std::runtime_error;
+using std::this_thread::sleep_for;
+using std::chrono::milliseconds;
+using namespace marina;
+
+namespace
+{
+  //tracks how many callers are inside a region at once
+  struct Gauge
+  {
+    atomic<int> now{0}, peak{0};
+
+    void work(int ms)
+    {
+      int n = ++now;
+      int p = peak;
+      while(n > p && !peak.compare_exchange_weak(p, n));
+      sleep_for(milliseconds{ms});
+      --now;
+    }
+  };
+}
+
+TEST_CASE("budget-weights", "[pipeline]")
+{
+  Budget b{"cpu", 8};
+  b.acquire(6);
+  REQUIRE( b.available() == 2 );
+  REQUIRE( !b.tryAcquire(3) );
+  REQUIRE( b.tryAcquire(2) );
+  b.release(8);
+  REQUIRE( b.available() == 8 );
+  REQUIRE_THROWS( b.acquire(9) );
+}
+
+TEST_CASE("stage-concurrency", "[pipeline]")
+{
+  Gauge disk, config, boot;
+  Budget cpu{"cpu", 4};
+  Gauge cpu_use;
+
+  Pipeline p{ {{"disk", 3}, {"config", 1}, {"boot", 8}}, 8 };
+
+  vector<Pipeline::Job> jobs;
+  for(size_t i=0; i<12; ++i)
+  {
+    jobs.push_back({
+      "vm" + to_string(i),
+      {
+        {[&](){ disk.work(5); }},
+        {[&](){ config.work(2); }},
+        {[&](){ boot.work(5); cpu_use.work(0); }, {{&cpu, 2}}}
+      }
+    });
+  }
+
+  auto r = p.run(jobs);
+
+  REQUIRE( r.errors.empty() );
+  REQUIRE( r.timings.size() == 36 );
+  REQUIRE( disk.peak <= 3 );
+  REQUIRE( config.peak == 1 );
+  //each boot claims 2 of the 4 cpus
+  REQUIRE( boot.peak <= 2 );
+  REQUIRE( cpu.available() == 4 );
+}
+
+TEST_CASE("stages-overlap", "[pipeline]")
+{
+  //with one vm per stage at a time, three stages of 10ms over 6 jobs should
+  //take about 80ms pipelined rather than 180ms serially
+  Pipeline p{ {{"a", 1}, {"b", 1}, {"c", 1}}, 6 };
+
+  vector<Pipeline::Job> jobs;
+  for(size_t i=0; i<6; ++i)
+  {
+    auto w = [](){ sleep_for(milliseconds{10}); };
+    jobs.push_back({ "vm" + to_string(i), {{w}, {w}, {w}} });
+  }
+
+  auto r = p.run(jobs);
+  REQUIRE( r.errors.empty() );
+  REQUIRE( r.wall_ms < 150 );
+}
+
+TEST_CASE("failed-jobs", "[pipeline]")
+{
+  Budget io{"io", 1};
+  atomic<int> booted{0};
+
+  Pipeline p{ {{"disk", 2}, {"boot", 2}}, 4 };
+
+  vector<Pipeline::Job> jobs;
+  for(size_t i=0; i<4; ++i)
+  {
+    jobs.push_back({
+      "vm" + to_string(i),
+      {
+        {[i](){ if(i % 2) throw runtime_error{"no disk"}; }, {{&io, 1}}},
+        {[&](){ ++booted; }}
+      }
+    });
+  }
+
+  auto r = p.run(jobs);
+
+  REQUIRE( booted == 2 );
+  REQUIRE( r.errors.size() == 2 );
+  REQUIRE( r.errors.at("vm1") == "disk: no disk" );
+  //budgets of failed steps are given back
+  REQUIRE( io.available() == 1 );
+  REQUIRE_THROWS( p.run({{"bad", {{[](){}}}}}) );
+}
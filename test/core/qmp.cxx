@@ -0,0 +1,121 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <thread>
+#include <string>
+#include <vector>
+#include "core/qmp.hxx"
+#include "../catch.hpp"
+
+using std::string;
+using std::vector;
+using std::thread;
+using std::to_string;
+using namespace marina;
+
+/*
+ * A stand-in for a qemu monitor socket. It greets, negotiates capabilities,
+ * emits an event ahead of every reply and fails any command named `bogus`.
+ */
+struct FakeQmp
+{
+  FakeQmp()
+    : path{"/tmp/marina-fake-qmp-" + to_string(getpid()) + ".sock"}
+  {
+    unlink(path.c_str());
+    lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path)-1);
+    bind(lfd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    listen(lfd, 1);
+    t = thread{[this](){ serve(); }};
+  }
+
+  ~FakeQmp()
+  {
+    shutdown(lfd, SHUT_RDWR);
+    close(lfd);
+    t.join();
+    unlink(path.c_str());
+  }
+
+  void write(int fd, const Json & j)
+  {
+    string s = j.dump() + "\r\n";
+    ::send(fd, s.data(), s.size(), MSG_NOSIGNAL);
+  }
+
+  void serve()
+  {
+    int fd = accept(lfd, nullptr, nullptr);
+    if(fd < 0) return;
+
+    Json greeting;
+    greeting["QMP"]["version"]["qemu"]["major"] = 2;
+    greeting["QMP"]["capabilities"] = Json::array();
+    write(fd, greeting);
+
+    string buf;
+    char chunk[4096];
+    for(;;)
+    {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if(n <= 0) break;
+      buf.append(chunk, n);
+
+      size_t len;
+      while((len = jsonValueLength(buf)) > 0)
+      {
+        Json m = Json::parse(buf.substr(0, len));
+        buf.erase(0, len);
+        commands.push_back(m);
+
+        Json event;
+        event["event"] = "RESUME";
+        write(fd, event);
+
+        Json r;
+        if(m.count("id")) r["id"] = m["id"];
+        if(m["execute"] == "bogus")
+        {
+          r["error"]["class"] = "CommandNotFound";
+          r["error"]["desc"] = "The command bogus has not been found";
+        }
+        else r["return"] = m.count("arguments") ? m["arguments"] : Json::object();
+        write(fd, r);
+      }
+    }
+    close(fd);
+  }
+
+  string path;
+  int lfd;
+  thread t;
+  vector<Json> commands;
+};
+
+TEST_CASE("qmp-execute", "[qmp]")
+{
+  FakeQmp srv;
+  {
+    Qmp qmp{srv.path};
+
+    Json r = qmp.execute("device_add",
+        {{"driver", "virtio-net-pci"}, {"mac", "00:00:00:00:00:01"}});
+    REQUIRE( r["mac"] == "00:00:00:00:00:01" );
+
+    REQUIRE_THROWS( qmp.execute("bogus") );
+
+    //still usable after a command fails
+    qmp.execute("cont");
+  }
+
+  REQUIRE( srv.commands.size() == 4 );
+  REQUIRE( srv.commands[0]["execute"] == "qmp_capabilities" );
+  REQUIRE( srv.commands[1]["arguments"]["driver"] == "virtio-net-pci" );
+  REQUIRE( srv.commands[3]["execute"] == "cont" );
+  REQUIRE( srv.commands[3].count("arguments") == 0 );
+}
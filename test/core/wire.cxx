@@ -0,0 +1,26 @@
+#include "common/net/wire.hxx"
+#include "core/blueprint.hxx"
+#include "core/topo.hxx"
+#include "core/materialization.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+#include "test/models/topos/topologies.hxx"
+#include "../catch.hpp"
+
+using namespace marina;
+
+TEST_CASE("wire-models", "[wire]")
+{
+  Json m = mars().json();
+  REQUIRE( wire::decode(wire::encode(m)) == m );
+  REQUIRE_NOTHROW( Blueprint::fromJson(wire::decode(wire::encode(m))) );
+
+  Json t = deter2015().json();
+  REQUIRE( wire::decode(wire::encode(t)) == t );
+  REQUIRE_NOTHROW( TestbedTopology::fromJson(wire::decode(wire::encode(t))) );
+
+  Blueprint bp = synthetic(100);
+  HostMaterialization hm{bp.localEmbedding(bp.computers())};
+  Json h = hm.json();
+  REQUIRE( wire::decode(wire::encode(h)) == h );
+  REQUIRE( wire::encode(h).size() < h.dump().size() );
+}
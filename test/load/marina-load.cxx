@@ -0,0 +1,318 @@
+/*
+ * marina-load: drives the api gateway with a mix of blueprint and
+ * materialization requests from many clients at once and reports the
+ * throughput and latency of each kind of request
+ *
+ *   marina-load [--api=api] [--concurrency=8] [--duration=30]
+ *               [--mix=save=2,list=2,construct=1,status=4,destruct=1]
+ *               [--computers=16] [--hosts=4] [--json=results.json]
+ *
+ * Before the run the testbed topology is replaced by one of --hosts hosts
+ * named stub0, stub1 ... which are meant to resolve to stub-host-controls,
+ * so only ever point this at a test system. Each client keeps its own
+ * blueprints, a request that needs a blueprint in some state (a construct
+ * needs a saved one, a destruct a constructed one) falls back to the request
+ * that gets it there and is counted as that one. Whatever is left over is
+ * torn down after the run, outside of the numbers.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <gflags/gflags.h>
+#include "common/net/glog.hxx"
+#include "common/net/http_request.hxx"
+#include "common/net/metrics.hxx"
+#include "core/blueprint.hxx"
+#include "core/topo.hxx"
+#include "test/models/blueprints/blueprints.hxx"
+
+using std::string;
+using std::vector;
+using std::array;
+using std::atomic;
+using std::thread;
+using std::mt19937;
+using std::discrete_distribution;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ofstream;
+using std::exception;
+using std::invalid_argument;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::duration;
+using std::chrono::microseconds;
+using std::chrono::seconds;
+using proxygen::HTTPMethod;
+using namespace marina;
+
+DEFINE_string(api, "api", "host of the api gateway");
+DEFINE_string(project, "load", "project the blueprints are saved under");
+DEFINE_int32(concurrency, 8, "clients driving the api at once");
+DEFINE_int32(duration, 30, "seconds to drive the api for");
+DEFINE_string(mix, "save=2,list=2,construct=1,status=4,destruct=1",
+    "relative weights of the requests");
+DEFINE_int32(computers, 16, "computers in every blueprint");
+DEFINE_int32(hosts, 4, "hosts in the testbed topology");
+DEFINE_string(host_prefix, "stub", "the hosts are named this and a number");
+DEFINE_string(json, "", "also write the results as json to this file");
+
+namespace
+{
+  enum Op { Save, List, Construct, Status, Destruct, Ops };
+
+  const array<string, Ops> op_names{
+    "save", "list", "construct", "status", "destruct"
+  };
+
+  struct Stats
+  {
+    Histogram latency; //microseconds
+    atomic<uint64_t> errors{0};
+  };
+
+  array<Stats, Ops> stats;
+
+  //op=weight,... in any order, ops left out are never sent
+  array<double, Ops> parseMix(const string & mix)
+  {
+    array<double, Ops> w{};
+    size_t i{0};
+    while(i < mix.size())
+    {
+      size_t j = mix.find(',', i);
+      if(j == string::npos) j = mix.size();
+      string kv = mix.substr(i, j-i);
+      i = j+1;
+
+      size_t eq = kv.find('=');
+      if(eq == string::npos) throw invalid_argument{"bad mix entry " + kv};
+
+      auto op = std::find(op_names.begin(), op_names.end(), kv.substr(0, eq));
+      if(op == op_names.end())
+        throw invalid_argument{"unknown request " + kv.substr(0, eq)};
+
+      w[op - op_names.begin()] = std::stod(kv.substr(eq+1));
+    }
+
+    if(std::all_of(w.begin(), w.end(), [](double x){ return x <= 0; }))
+      throw invalid_argument{"the mix holds no requests"};
+    return w;
+  }
+
+  //a post to the api, recorded against op unless op is Ops, true if the api
+  //answered ok without any host failing
+  bool post(Op op, const string & path, const Json & body)
+  {
+    auto begin = steady_clock::now();
+    bool ok{false};
+    try
+    {
+      HttpRequest req{HTTPMethod::POST, "https://"+FLAGS_api+path, body.dump()};
+      http::Message m = req.response().get();
+      if(m.msg != nullptr && m.msg->getStatusCode() == 200)
+      {
+        ok = true;
+        try { ok = m.bodyAsJson().count("failed") == 0; }
+        catch(invalid_argument &) { }
+      }
+    }
+    catch(exception &e) { VLOG(1) << path << ": " << e.what(); }
+
+    if(op == Ops) return ok;
+
+    auto us = duration_cast<microseconds>(steady_clock::now()-begin).count();
+    stats[op].latency.record(us);
+    if(!ok) stats[op].errors++;
+    return ok;
+  }
+
+  Json bpRequest(const string & bpid)
+  {
+    Json j;
+    j["project"] = FLAGS_project;
+    j["bpid"] = bpid;
+    return j;
+  }
+
+  //one simulated user, with the blueprints it has saved and constructed
+  struct Client
+  {
+    Client(size_t id) : id{id}, rng(47 + id) {}
+
+    size_t id, made{0};
+    mt19937 rng;
+    vector<string> saved, constructed;
+
+    void run(discrete_distribution<int> pick, steady_clock::time_point end)
+    {
+      while(steady_clock::now() < end) send(Op(pick(rng)));
+    }
+
+    void send(Op op)
+    {
+      if(op == Construct && saved.empty()) op = Save;
+      if(op == Destruct && constructed.empty())
+        op = saved.empty() ? Save : Construct;
+
+      Json j;
+      j["project"] = FLAGS_project;
+
+      switch(op)
+      {
+        case Save:
+        {
+          string name = fmt::format("load-{}-{}", id, made++);
+          j["source"] = synthetic(FLAGS_computers).name(name).json();
+          if(post(Save, "/blueprint/save", j)) saved.push_back(name);
+          break;
+        }
+
+        case List:
+          post(List, "/blueprint/list", j);
+          break;
+
+        case Status:
+          post(Status, "/materialization/status", j);
+          break;
+
+        case Construct:
+        {
+          string bpid = saved.back();
+          saved.pop_back();
+          if(post(Construct, "/materialization/construct", bpRequest(bpid)))
+            constructed.push_back(bpid);
+          else
+            saved.push_back(bpid);
+          break;
+        }
+
+        case Destruct:
+        {
+          string bpid = constructed.back();
+          constructed.pop_back();
+          if(post(Destruct, "/materialization/destruct", bpRequest(bpid)))
+            saved.push_back(bpid);
+          else
+            constructed.push_back(bpid);
+          break;
+        }
+
+        case Ops: break;
+      }
+    }
+
+    void cleanup()
+    {
+      for(const string & bpid : constructed)
+      {
+        post(Ops, "/materialization/destruct", bpRequest(bpid));
+        saved.push_back(bpid);
+      }
+      for(const string & bpid : saved)
+        post(Ops, "/blueprint/delete", bpRequest(bpid));
+    }
+  };
+
+  //every host alike and on one switch, all of them stubs
+  TestbedTopology testbed()
+  {
+    TestbedTopology t{"load"};
+    Host like{"node"};
+    like.cores(24).memory(64_gb).disk(1_tb).add_ifx("eth0", 10_gbps);
+
+    auto sw = t.sw("main-switch").backplane(5_tbps);
+    t.connect(t.addHosts(FLAGS_host_prefix, FLAGS_hosts, like), "eth0", sw,
+        10_gbps);
+    return t;
+  }
+
+  double ms(uint64_t us) { return us / 1000.0; }
+
+  void report(double secs)
+  {
+    cout << fmt::format("{:<10} {:>9} {:>7} {:>8} {:>9} {:>9} {:>9} {:>9}",
+        "request", "count", "errors", "req/s", "p50 ms", "p90 ms", "p99 ms",
+        "max ms") << endl;
+
+    Json j;
+    j["seconds"] = secs;
+    j["concurrency"] = FLAGS_concurrency;
+    j["computers"] = FLAGS_computers;
+    j["hosts"] = FLAGS_hosts;
+
+    for(size_t i=0; i<Ops; ++i)
+    {
+      const Histogram & h = stats[i].latency;
+      if(h.count() == 0) continue;
+
+      cout << fmt::format(
+          "{:<10} {:>9} {:>7} {:>8.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f}",
+          op_names[i], h.count(), stats[i].errors.load(), h.count()/secs,
+          ms(h.percentile(50)), ms(h.percentile(90)), ms(h.percentile(99)),
+          ms(h.max())) << endl;
+
+      Json x;
+      x["count"] = h.count();
+      x["errors"] = stats[i].errors.load();
+      x["per_second"] = h.count()/secs;
+      x["p50_ms"] = ms(h.percentile(50));
+      x["p90_ms"] = ms(h.percentile(90));
+      x["p99_ms"] = ms(h.percentile(99));
+      x["max_ms"] = ms(h.max());
+      j["requests"][op_names[i]] = x;
+    }
+
+    if(!FLAGS_json.empty()) ofstream{FLAGS_json} << j.dump(2) << endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  gflags::SetUsageMessage("usage: marina-load [flags]");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  array<double, Ops> mix;
+  try { mix = parseMix(FLAGS_mix); }
+  catch(exception &e) { cerr << e.what() << endl; return 2; }
+
+  if(!post(Ops, "/materialization/topo", testbed().json()))
+  {
+    cerr << "failed to set up the testbed topology through " << FLAGS_api
+         << endl;
+    return 1;
+  }
+
+  vector<Client> clients;
+  for(int i=0; i<FLAGS_concurrency; ++i) clients.emplace_back(i);
+
+  discrete_distribution<int> pick(mix.begin(), mix.end());
+  auto begin = steady_clock::now();
+  auto end = begin + seconds{FLAGS_duration};
+
+  vector<thread> ts;
+  for(Client & c : clients) ts.emplace_back([&c, pick, end](){
+    c.run(pick, end);
+  });
+  for(thread & t : ts) t.join();
+
+  double secs = duration<double>(steady_clock::now() - begin).count();
+  report(secs);
+
+  ts.clear();
+  for(Client & c : clients) ts.emplace_back([&c](){ c.cleanup(); });
+  for(thread & t : ts) t.join();
+
+  uint64_t errors{0};
+  for(const Stats & s : stats) errors += s.errors;
+  return errors == 0 ? 0 : 1;
+}
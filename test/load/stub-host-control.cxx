@@ -0,0 +1,243 @@
+/*
+ * A stand in for host-control that does nothing but take its time. It
+ * answers /construct, /destruct and /capacity like host-control does and
+ * carries every materialization through the same job admission and launch
+ * pipeline, each step sleeping for as long as its flag says. One stub can
+ * play any number of hosts, the testbed topology just has to name them all
+ * after it.
+ */
+
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <stdexcept>
+#include <gflags/gflags.h>
+#include "common/net/http_server.hxx"
+#include "common/net/wire.hxx"
+#include "core/blueprint.hxx"
+#include "core/util.hxx"
+#include "core/materialization.hxx"
+#include "core/pipeline.hxx"
+#include "core/jobs.hxx"
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::shared_ptr;
+using std::make_shared;
+using std::this_thread::sleep_for;
+using std::chrono::milliseconds;
+using std::exception;
+using std::out_of_range;
+using std::invalid_argument;
+using wangle::SSLContextConfig;
+using namespace marina;
+
+DEFINE_int32(port, 443, "the port to serve on");
+DEFINE_int32(dir_ms, 5, "time to set up the experiment directory");
+DEFINE_int32(network_ms, 20, "time to set up each network");
+DEFINE_int32(disk_ms, 500, "time to create the disk of each computer");
+DEFINE_int32(config_ms, 100, "time to configure each computer");
+DEFINE_int32(boot_ms, 3000, "time to boot each computer");
+DEFINE_int32(destruct_ms, 50, "time to tear down each computer");
+DEFINE_int32(launch_workers, 8, "computers moving through launch at once");
+DEFINE_int32(launch_io, 4, "disk and config steps that may run at once");
+DEFINE_int32(construct_workers, 2, "materializations carried out at once");
+DEFINE_int32(construct_queue, 32, "materializations that may wait");
+DEFINE_int32(hugepage_mb, 65536, "hugepage memory reported to the embedder");
+DEFINE_int32(cores, 24, "cores reported to the embedder");
+DEFINE_string(tunnel_addr, "192.168.247.1",
+    "data plane address reported to the embedder, no tunnel is ever built");
+
+http::Response construct(http::Message);
+http::Response destruct(Json);
+http::Response capacity(http::Message);
+http::Response jobStatus(http::Message);
+
+unique_ptr<JobScheduler> jobs{nullptr};
+
+int main(int argc, char **argv)
+{
+  Glog::init("stub-host-control");
+  Trace::init("stub-host-control");
+
+  gflags::SetUsageMessage("usage: stub-host-control [flags]");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  LOG(INFO) << "stub host-control starting";
+
+  jobs.reset(new JobScheduler{
+      static_cast<size_t>(FLAGS_construct_workers),
+      static_cast<size_t>(FLAGS_construct_queue)
+  });
+
+  SSLContextConfig sslc;
+  sslc.setCertificate(
+      "/marina/cert.pem",
+      "/marina/key.pem",
+      "" //no password on cert
+  );
+
+  HttpsServer srv("0.0.0.0", FLAGS_port, sslc);
+
+  srv.onPost("/construct", construct);
+  srv.onPost("/destruct", jsonIn(destruct));
+  srv.onGet("/capacity", capacity);
+  srv.onGet("/jobs", jobStatus);
+
+  srv.run();
+}
+
+void simulate(int ms) { if(ms > 0) sleep_for(milliseconds{ms}); }
+
+//the launch pipeline of host-control with every step a pause
+PipelineReport launchComputers(const Blueprint & bp, JobProgress & progress)
+{
+  Pipeline pipeline{
+    {
+      {"disk", static_cast<size_t>(FLAGS_launch_io)},
+      {"config", static_cast<size_t>(FLAGS_launch_io)},
+      {"boot", static_cast<size_t>(FLAGS_launch_workers)}
+    },
+    static_cast<size_t>(FLAGS_launch_workers)
+  };
+
+  size_t n = bp.computers().size();
+  progress.begin("disks", n);
+  progress.begin("config", n);
+  progress.begin("boot", n);
+
+  JobProgress *p = &progress;
+  auto step = [p](string stage, int ms)
+  {
+    return [p,stage,ms](){ p->check(); simulate(ms); p->advance(stage); };
+  };
+
+  vector<Pipeline::Job> js;
+  for(const auto & c : bp.computers())
+  {
+    js.push_back({
+      c.second.name(),
+      {
+        {step("disks", FLAGS_disk_ms)},
+        {step("config", FLAGS_config_ms)},
+        {step("boot", FLAGS_boot_ms)}
+      }
+    });
+  }
+
+  return pipeline.run(js);
+}
+
+http::Response construct(http::Message m)
+{
+  shared_ptr<HostMaterialization> hm;
+  try
+  {
+    string body = m.bodyAsString();
+    hm = make_shared<HostMaterialization>(
+        m.encoding() == http::Encoding::Wire ?
+          HostMaterialization::fromJson(wire::decode(body)) :
+          HostMaterialization::parse(body.data(), body.size()));
+  }
+  catch(invalid_argument &e)
+  {
+    LOG(ERROR) << "invalid json: " << e.what();
+    return http::Response{ http::Status::BadRequest(), "invalid json" };
+  }
+  catch(out_of_range &e)
+  {
+    return badRequest("construct", m.bodyAsString(), e);
+  }
+
+  try
+  {
+    const Blueprint & bp = hm->blueprint;
+    auto admission = jobs->submit(
+      bp.id().str(),
+      bp.name(),
+      {"dir", "networks", "disks", "config", "boot"},
+      [hm](JobProgress & progress)
+      {
+        const Blueprint & bp = hm->blueprint;
+
+        progress.begin("dir");
+        simulate(FLAGS_dir_ms);
+        progress.advance("dir");
+
+        progress.begin("networks");
+        simulate(FLAGS_network_ms * int(bp.networks().size()));
+        progress.advance("networks");
+
+        PipelineReport report = launchComputers(bp, progress);
+        LOG(INFO) << "launch " << bp.name() << ": " << report.summary();
+      }
+    );
+
+    Json r;
+    switch(admission)
+    {
+      case JobScheduler::Admission::Accepted:
+        r["status"] = "materializing";
+        return http::Response{ http::Status::OK(), r.dump() };
+
+      case JobScheduler::Admission::Duplicate:
+        r["status"] = "already materializing";
+        return http::Response{ http::Status::Conflict(), r.dump() };
+
+      case JobScheduler::Admission::Busy:
+        r["status"] = "busy";
+        return http::Response{ http::Status::ServiceUnavailable(), r.dump() };
+    }
+  }
+  catch(exception &e)
+  {
+    return unexpectedFailure("construct", m.bodyAsString(), e);
+  }
+
+  throw std::runtime_error{"unreachable"};
+}
+
+http::Response destruct(Json j)
+{
+  try
+  {
+    auto bp = Blueprint::fromJson(j);
+
+    if(jobs->cancel(bp.id().str()))
+      LOG(INFO) << "cancelled materialization of " << bp.name();
+    jobs->wait(bp.id().str());
+
+    simulate(FLAGS_destruct_ms * int(bp.computers().size()));
+
+    Json r;
+    r["status"] = "ok";
+    return http::Response{ http::Status::OK(), r.dump() };
+  }
+  catch(out_of_range &e) { return badRequest("destruct", j, e); }
+  catch(exception &e) { return unexpectedFailure("destruct", j, e); }
+}
+
+//what the stub was told it has, it is never used up so the embedding is all
+//that limits how much a host takes on
+http::Response capacity(http::Message)
+{
+  Json node;
+  node["id"] = 0;
+  node["hugepage_mb"] = FLAGS_hugepage_mb;
+  node["hugepage_available_mb"] = FLAGS_hugepage_mb;
+
+  Json j;
+  j["nodes"] = vector<Json>{node};
+  j["hugepage_mb"] = FLAGS_hugepage_mb;
+  j["hugepage_available_mb"] = FLAGS_hugepage_mb;
+  j["hugepage_largest_available_mb"] = FLAGS_hugepage_mb;
+  j["cores"] = FLAGS_cores;
+  j["tunnel_addr"] = FLAGS_tunnel_addr;
+  return http::Response{ http::Status::OK(), j.dump(2) };
+}
+
+http::Response jobStatus(http::Message)
+{
+  return http::Response{ http::Status::OK(), jobs->json().dump(2) };
+}
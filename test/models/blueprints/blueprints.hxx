@@ -8,6 +8,20 @@ namespace marina
   //Network blueprints
   Blueprint mars();
   Blueprint hello_marina();
+
+  //n computers spread over lans of 16, every lan hooked to a core network
+  Blueprint synthetic(size_t n);
+
+  //generated blueprints for scale, all computers alike
+  //  star        n computers on one network
+  //  dumbbell    two networks of n computers joined by a slow one
+  //  fatTree     k-ary fat tree of networks with k^3/4 computers at the
+  //              edge, k = 16, 32, 74 give ~10^3, 10^4, 10^5
+  //  randomLans  n computers dealt over a random tree of lans
+  Blueprint star(size_t n);
+  Blueprint dumbbell(size_t n);
+  Blueprint fatTree(size_t k);
+  Blueprint randomLans(size_t n, size_t lans, unsigned seed = 47);
 }
 
 #endif
@@ -0,0 +1,114 @@
+#include <random>
+#include "blueprints.hxx"
+
+using std::string;
+using std::to_string;
+using std::vector;
+using std::mt19937;
+using std::uniform_int_distribution;
+using namespace marina;
+
+namespace
+{
+  //the computer every generator stamps out
+  Computer node()
+  {
+    Computer c{"node"};
+    c.os("ubuntu-server-xenial")
+     .memory(1_gb)
+     .cores(2)
+     .disk(10_gb)
+     .add_ifx("ifx0", 1_gbps);
+    return c;
+  }
+
+  Network net(Bandwidth capacity, Latency latency)
+  {
+    Network n{"net"};
+    n.capacity(capacity).latency(latency);
+    return n;
+  }
+}
+
+Blueprint marina::star(size_t n)
+{
+  Blueprint bp{"star-" + to_string(n)};
+  bp.reserve(n, 1, n);
+
+  auto hub = bp.network("hub")
+    .capacity(10_gbps)
+    .latency(1_ms)
+    .ipv4("10.0.0.0", 8);
+
+  bp.connect(bp.addComputers("c", n, node()), "ifx0", hub);
+  return bp;
+}
+
+Blueprint marina::dumbbell(size_t n)
+{
+  Blueprint bp{"dumbbell-" + to_string(n)};
+  bp.reserve(2*n, 3, 2*n + 2);
+
+  auto left = bp.network("left").capacity(10_gbps).latency(1_ms)
+                .ipv4("10.1.0.0", 16),
+       right = bp.network("right").capacity(10_gbps).latency(1_ms)
+                .ipv4("10.2.0.0", 16),
+       bottleneck = bp.network("bottleneck").capacity(100_mbps).latency(20_ms);
+
+  bp.connect(left, bottleneck);
+  bp.connect(right, bottleneck);
+  bp.connect(bp.addComputers("l", n, node()), "ifx0", left);
+  bp.connect(bp.addComputers("r", n, node()), "ifx0", right);
+  return bp;
+}
+
+Blueprint marina::fatTree(size_t k)
+{
+  size_t h = k/2;
+  Blueprint bp{"fat-tree-" + to_string(k)};
+  bp.reserve(k*h*h, k*k + h*h, k*h*h*3);
+
+  auto cores = bp.addNetworks("core", h*h, net(40_gbps, 1_ms));
+  for(size_t p=0; p<k; ++p)
+  {
+    string pod = "pod" + to_string(p) + "-";
+    auto aggs = bp.addNetworks(pod + "agg", h, net(40_gbps, 1_ms)),
+         edges = bp.addNetworks(pod + "edge", h, net(10_gbps, 1_ms));
+
+    //aggregation network a of every pod goes to the a-th group of cores
+    for(size_t a=0; a<h; ++a)
+      for(size_t c=0; c<h; ++c) bp.connect(aggs[a], cores[a*h + c]);
+
+    for(size_t e=0; e<h; ++e)
+    {
+      for(size_t a=0; a<h; ++a) bp.connect(edges[e], aggs[a]);
+
+      auto cs = bp.addComputers(pod + "e" + to_string(e) + "-c", h, node());
+      bp.connect(cs, "ifx0", edges[e]);
+    }
+  }
+  return bp;
+}
+
+Blueprint marina::randomLans(size_t n, size_t lans, unsigned seed)
+{
+  Blueprint bp{"random-" + to_string(n)};
+  bp.reserve(n, lans, n + lans + lans/4);
+  mt19937 gen{seed};
+
+  auto ls = bp.addNetworks("lan", lans, net(1_gbps, 5_ms));
+
+  //a random tree so every lan is reachable, and a few shortcuts
+  for(size_t i=1; i<lans; ++i)
+    bp.connect(ls[i], ls[uniform_int_distribution<size_t>{0, i-1}(gen)]);
+
+  uniform_int_distribution<size_t> any{0, lans-1};
+  for(size_t i=0; i<lans/4; ++i) bp.connect(ls[any(gen)], ls[any(gen)]);
+
+  vector<vector<Computer>> on(lans);
+  for(const Computer & c : bp.addComputers("c", n, node()))
+    on[any(gen)].push_back(c);
+
+  for(size_t i=0; i<lans; ++i) bp.connect(on[i], "ifx0", ls[i]);
+  return bp;
+}
@@ -0,0 +1,32 @@
+#include "blueprints.hxx"
+
+using std::to_string;
+using namespace marina;
+
+Blueprint marina::synthetic(size_t n)
+{
+  Blueprint bp{"synthetic-" + to_string(n)};
+  auto core = bp.network("core").capacity(10_gbps).latency(1_ms)
+    .ipv4("10.0.0.0", 16);
+
+  for(size_t l=0; l*16 < n; ++l)
+  {
+    auto lan = bp.network("lan" + to_string(l))
+      .capacity(1_gbps)
+      .latency(5_ms)
+      .ipv4("10.47.0.0", 24);
+    bp.connect(lan, core);
+
+    for(size_t i=l*16; i<n && i<(l+1)*16; ++i)
+    {
+      auto c = bp.computer("c" + to_string(i))
+        .os("ubuntu-server-xenial")
+        .memory(1_gb)
+        .cores(2)
+        .disk(10_gb)
+        .add_ifx("ifx0", 1_gbps);
+      bp.connect({c, c.ifx("ifx0")}, lan);
+    }
+  }
+  return bp;
+}
@@ -0,0 +1,103 @@
+#include <random>
+#include "topologies.hxx"
+
+using std::string;
+using std::to_string;
+using std::vector;
+using std::mt19937;
+using std::uniform_int_distribution;
+using namespace marina;
+
+namespace
+{
+  //the host every generator stamps out
+  Host node()
+  {
+    Host h{"node"};
+    h.cores(24)
+     .memory(64_gb)
+     .disk(1_tb)
+     .add_ifx("eth0", 10_gbps);
+    return h;
+  }
+}
+
+TestbedTopology marina::starBed(size_t n)
+{
+  TestbedTopology t{"star-" + to_string(n)};
+  t.reserve(n, 1, n);
+
+  auto sw = t.sw("main-switch").backplane(5_tbps);
+  t.connect(t.addHosts("h", n, node()), "eth0", sw, 10_gbps);
+  return t;
+}
+
+TestbedTopology marina::dumbbellBed(size_t n)
+{
+  TestbedTopology t{"dumbbell-" + to_string(n)};
+  t.reserve(2*n, 2, 2*n + 1);
+
+  auto left = t.sw("left").backplane(5_tbps),
+       right = t.sw("right").backplane(5_tbps);
+  t.connect(left, right, 100_gbps);
+
+  t.connect(t.addHosts("l", n, node()), "eth0", left, 10_gbps);
+  t.connect(t.addHosts("r", n, node()), "eth0", right, 10_gbps);
+  return t;
+}
+
+TestbedTopology marina::fatTreeBed(size_t k)
+{
+  size_t h = k/2;
+  TestbedTopology t{"fat-tree-" + to_string(k)};
+  t.reserve(k*h*h, k*k + h*h, k*h*h*3);
+
+  vector<Switch> cores;
+  for(size_t c=0; c<h*h; ++c)
+    cores.push_back(t.sw("core" + to_string(c)).backplane(5_tbps));
+
+  for(size_t p=0; p<k; ++p)
+  {
+    string pod = "pod" + to_string(p) + "-";
+
+    vector<Switch> aggs;
+    for(size_t a=0; a<h; ++a)
+    {
+      aggs.push_back(t.sw(pod + "agg" + to_string(a)).backplane(5_tbps));
+      for(size_t c=0; c<h; ++c) t.connect(aggs[a], cores[a*h + c], 40_gbps);
+    }
+
+    for(size_t e=0; e<h; ++e)
+    {
+      auto edge = t.sw(pod + "edge" + to_string(e)).backplane(1280_gbps);
+      for(const Switch & a : aggs) t.connect(edge, a, 40_gbps);
+
+      auto hs = t.addHosts(pod + "e" + to_string(e) + "-h", h, node());
+      t.connect(hs, "eth0", edge, 10_gbps);
+    }
+  }
+  return t;
+}
+
+TestbedTopology marina::randomBed(size_t n, size_t switches, unsigned seed)
+{
+  TestbedTopology t{"random-" + to_string(n)};
+  t.reserve(n, switches, n + switches);
+  mt19937 gen{seed};
+
+  vector<Switch> sws;
+  for(size_t i=0; i<switches; ++i)
+  {
+    sws.push_back(t.sw("sw" + to_string(i)).backplane(1280_gbps));
+    if(i > 0)
+      t.connect(sws[i], sws[uniform_int_distribution<size_t>{0, i-1}(gen)],
+          40_gbps);
+  }
+
+  uniform_int_distribution<size_t> any{0, switches-1};
+  vector<vector<Host>> on(switches);
+  for(const Host & h : t.addHosts("h", n, node())) on[any(gen)].push_back(h);
+
+  for(size_t i=0; i<switches; ++i) t.connect(on[i], "eth0", sws[i], 10_gbps);
+  return t;
+}
@@ -8,6 +8,12 @@ namespace marina
   //Testbed topology models
   TestbedTopology deter2015();
   TestbedTopology minibed();
+
+  //generated testbeds for scale, shaped like the generated blueprints
+  TestbedTopology starBed(size_t n);
+  TestbedTopology dumbbellBed(size_t n);
+  TestbedTopology fatTreeBed(size_t k);
+  TestbedTopology randomBed(size_t n, size_t switches, unsigned seed = 47);
 }
 
 #endif